@@ -0,0 +1,34 @@
+#include "AssetHandle.h"
+#include "../Logger/Logger.h"
+
+std::vector<std::string> AssetIds::names = { "placeholder" };
+std::unordered_map<std::string, AssetHandle> AssetIds::handles = { { "placeholder", ASSET_HANDLE_PLACEHOLDER } };
+
+AssetHandle AssetIds::Intern(const std::string& assetId)
+{
+	const auto found = handles.find(assetId);
+	if (found != handles.end())
+	{
+		return found->second;
+	}
+	if (names.size() > UINT16_MAX)
+	{
+		LOG(ERROR, ASSETS, "Too many asset ids, {} uses the placeholder", assetId);
+		return ASSET_HANDLE_PLACEHOLDER;
+	}
+
+	const AssetHandle handle = static_cast<AssetHandle>(names.size());
+	names.push_back(assetId);
+	handles.emplace(assetId, handle);
+	return handle;
+}
+
+const std::string& AssetIds::GetName(AssetHandle handle)
+{
+	return handle < names.size() ? names[handle] : names[ASSET_HANDLE_PLACEHOLDER];
+}
+
+int AssetIds::GetCount()
+{
+	return static_cast<int>(names.size());
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+// AssetHandle
+////////////////////////////////////////////////////////////////////////
+// Asset ids like "tank-image" are turned into small integer handles once,
+// when a level is loaded, and components only store the handle. The
+// asset store keeps its textures in an array indexed by handle, so
+// getting a texture while drawing is a plain array index.
+// Handles are given out in the order ids are first seen, so the same
+// level loaded the same way gets the same handles in every run (they're
+// part of the state hash and of replay keyframes).
+// Handle 0 is the placeholder, it's what a missing texture resolves to
+////////////////////////////////////////////////////////////////////////
+typedef uint16_t AssetHandle;
+
+const AssetHandle ASSET_HANDLE_PLACEHOLDER = 0;
+
+class AssetIds
+{
+private:
+	static std::vector<std::string> names; //by handle
+	static std::unordered_map<std::string, AssetHandle> handles;
+
+public:
+	//Returns the id's handle, giving it the next one if it hasn't been seen before
+	static AssetHandle Intern(const std::string& assetId);
+	static const std::string& GetName(AssetHandle handle);
+	static int GetCount(); //number of handles given out, including the placeholder
+};
@@ -0,0 +1,277 @@
+#include "AssetPack.h"
+#include "../Compression/Lz4.h"
+#include "../Determinism/StateHasher.h"
+#include "../Logger/Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+std::string GetAssetPackName(const std::string& filePath)
+{
+	std::filesystem::path path(filePath);
+	if (path.is_absolute())
+	{
+		std::error_code error;
+		path = path.lexically_relative(std::filesystem::current_path(error));
+	}
+	return path.lexically_normal().generic_string();
+}
+
+static uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool WriteAssetPack(const std::string& filePath, const std::vector<AssetPackSource>& sources, AssetPackSummary& summary)
+{
+	summary = AssetPackSummary();
+	std::vector<AssetPackSource> sortedSources(sources);
+	std::sort(sortedSources.begin(), sortedSources.end(), [](const AssetPackSource& a, const AssetPackSource& b) { return a.name < b.name; });
+	for (size_t i = 1; i < sortedSources.size(); i++)
+	{
+		if (sortedSources[i].name == sortedSources[i - 1].name)
+		{
+			LOG(ERROR, ASSETS, "Two files are packed as {}: {} and {}", sortedSources[i].name, sortedSources[i - 1].filePath, sortedSources[i].filePath);
+			return false;
+		}
+	}
+
+	//The whole pack is built in memory, the assets of a 2D game fit easily
+	std::vector<uint8_t> pack(sizeof(AssetPackHeader), 0);
+	std::vector<AssetPackEntry> entries;
+	std::string names;
+	std::vector<uint8_t> compressed;
+	for (const auto& source : sortedSources)
+	{
+		std::ifstream file(source.filePath, std::ios::binary);
+		if (!file.is_open())
+		{
+			LOG(ERROR, ASSETS, "Could not open {} to pack it", source.filePath);
+			return false;
+		}
+		const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (data.size() > ASSET_PACK_MAX_FILE_SIZE)
+		{
+			LOG(ERROR, ASSETS, "{} is {} bytes, too big to pack (the limit is {})", source.filePath, data.size(), ASSET_PACK_MAX_FILE_SIZE);
+			return false;
+		}
+
+		AssetPackEntry entry;
+		std::memset(&entry, 0, sizeof(entry));
+		entry.size = data.size();
+		entry.storedSize = data.size();
+		entry.compression = ASSET_PACK_COMPRESSION_NONE;
+		StateHasher hasher;
+		hasher.AddBytes(data.data(), data.size());
+		entry.contentHash = hasher.GetHash();
+
+		const uint8_t* storedData = data.data();
+		if (source.isCompressible && !data.empty())
+		{
+			//only kept if it saves at least an eighth, otherwise decompressing costs more than the smaller read saves
+			compressed.resize(Lz4CompressBound(data.size()));
+			const size_t compressedSize = Lz4Compress(data.data(), data.size(), compressed.data(), compressed.size());
+			if (compressedSize > 0 && compressedSize <= data.size() - data.size() / 8)
+			{
+				entry.storedSize = compressedSize;
+				entry.compression = ASSET_PACK_COMPRESSION_LZ4;
+				storedData = compressed.data();
+				summary.numCompressed++;
+			}
+		}
+
+		entry.alignment = entry.storedSize >= ASSET_PACK_PAGE_ALIGNED_SIZE ? ASSET_PACK_PAGE_ALIGNMENT : ASSET_PACK_ALIGNMENT;
+		entry.dataOffset = AlignOffset(pack.size(), entry.alignment);
+		pack.resize(static_cast<size_t>(entry.dataOffset), 0);
+		pack.insert(pack.end(), storedData, storedData + entry.storedSize);
+		entry.nameOffset = static_cast<uint32_t>(names.size());
+		entry.nameSize = static_cast<uint32_t>(source.name.size());
+		names += source.name;
+		entries.push_back(entry);
+		summary.totalSize += entry.size;
+	}
+
+	AssetPackHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+	header.version = ASSET_PACK_VERSION;
+	header.headerSize = sizeof(AssetPackHeader);
+	header.numEntries = static_cast<uint32_t>(entries.size());
+	header.indexOffset = AlignOffset(pack.size(), alignof(AssetPackEntry));
+	header.namesOffset = header.indexOffset + entries.size() * sizeof(AssetPackEntry);
+	header.namesSize = names.size();
+	pack.resize(static_cast<size_t>(header.indexOffset), 0);
+	const uint8_t* entryBytes = reinterpret_cast<const uint8_t*>(entries.data());
+	pack.insert(pack.end(), entryBytes, entryBytes + entries.size() * sizeof(AssetPackEntry));
+	pack.insert(pack.end(), names.begin(), names.end());
+	std::memcpy(pack.data(), &header, sizeof(header));
+
+	//Written next to the pack and renamed over it, like binary maps, so a running game keeps the pack it has mapped
+	const std::string tempFilePath = filePath + ".tmp";
+	{
+		std::ofstream file(tempFilePath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			LOG(ERROR, ASSETS, "Could not open {} for writing", tempFilePath);
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(pack.data()), static_cast<std::streamsize>(pack.size()));
+		file.close();
+		if (!file)
+		{
+			LOG(ERROR, ASSETS, "Failed writing asset pack {}", tempFilePath);
+			std::error_code error;
+			std::filesystem::remove(tempFilePath, error);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempFilePath, filePath, error);
+	if (error)
+	{
+		LOG(ERROR, ASSETS, "Could not replace asset pack {}: {}", filePath, error.message());
+		std::filesystem::remove(tempFilePath, error);
+		return false;
+	}
+
+	summary.numEntries = static_cast<int>(entries.size());
+	summary.packSize = pack.size();
+	return true;
+}
+
+bool AssetPack::Open(const std::string& filePath)
+{
+	Close();
+	if (!mappedFile.Open(filePath))
+	{
+		return false;
+	}
+
+	const uint8_t* data = mappedFile.GetData();
+	const uint64_t size = mappedFile.GetSize();
+	const AssetPackHeader* packHeader = reinterpret_cast<const AssetPackHeader*>(data);
+	if (size < sizeof(AssetPackHeader) || std::memcmp(packHeader->magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC)) != 0)
+	{
+		LOG(ERROR, ASSETS, "{} isn't an asset pack", filePath);
+		mappedFile.Close();
+		return false;
+	}
+	if (packHeader->version != ASSET_PACK_VERSION)
+	{
+		LOG(ERROR, ASSETS, "Asset pack {} is version {}, we load version {}, pack it again", filePath, packHeader->version, ASSET_PACK_VERSION);
+		mappedFile.Close();
+		return false;
+	}
+	//done in 64 bits against the file size, so a corrupt header can't overflow its way past the checks
+	const uint64_t indexSize = static_cast<uint64_t>(packHeader->numEntries) * sizeof(AssetPackEntry);
+	if (packHeader->indexOffset % alignof(AssetPackEntry) != 0 || packHeader->indexOffset > size || indexSize > size - packHeader->indexOffset ||
+		packHeader->namesOffset > size || packHeader->namesSize > size - packHeader->namesOffset)
+	{
+		LOG(ERROR, ASSETS, "Asset pack {} is the wrong size for its header, it's probably truncated", filePath);
+		mappedFile.Close();
+		return false;
+	}
+
+	header = packHeader;
+	entries = reinterpret_cast<const AssetPackEntry*>(data + packHeader->indexOffset);
+	names = reinterpret_cast<const char*>(data + packHeader->namesOffset);
+	//every entry is checked once here, so Find() and the loaders can trust them
+	for (uint32_t i = 0; i < header->numEntries; i++)
+	{
+		const AssetPackEntry& entry = entries[i];
+		const bool isValid =
+			entry.dataOffset <= size && entry.storedSize <= size - entry.dataOffset && entry.size <= ASSET_PACK_MAX_FILE_SIZE &&
+			static_cast<uint64_t>(entry.nameOffset) + entry.nameSize <= header->namesSize &&
+			entry.compression <= ASSET_PACK_COMPRESSION_LZ4 &&
+			(entry.compression != ASSET_PACK_COMPRESSION_NONE || entry.storedSize == entry.size) &&
+			(i == 0 || GetEntryName(entries[i - 1]) < GetEntryName(entry));
+		if (!isValid)
+		{
+			LOG(ERROR, ASSETS, "Asset pack {} has a corrupt entry ({})", filePath, i);
+			Close();
+			return false;
+		}
+	}
+	this->filePath = filePath;
+	LOG(INFO, ASSETS, "Asset pack {} opened, {} files", filePath, header->numEntries);
+	return true;
+}
+
+void AssetPack::Close()
+{
+	mappedFile.Close();
+	header = nullptr;
+	entries = nullptr;
+	names = nullptr;
+	filePath.clear();
+}
+
+bool AssetPack::IsOpen() const
+{
+	return header != nullptr;
+}
+
+const std::string& AssetPack::GetFilePath() const
+{
+	return filePath;
+}
+
+int AssetPack::GetNumEntries() const
+{
+	return header ? static_cast<int>(header->numEntries) : 0;
+}
+
+std::string_view AssetPack::GetEntryName(const AssetPackEntry& entry) const
+{
+	return std::string_view(names + entry.nameOffset, entry.nameSize);
+}
+
+bool AssetPack::Find(const std::string& filePath, AssetPackFile& file) const
+{
+	if (!header)
+	{
+		return false;
+	}
+	const std::string name = GetAssetPackName(filePath);
+	const AssetPackEntry* end = entries + header->numEntries;
+	const AssetPackEntry* entry = std::lower_bound(entries, end, name, [this](const AssetPackEntry& entry, const std::string& name) { return GetEntryName(entry) < name; });
+	if (entry == end || GetEntryName(*entry) != name)
+	{
+		return false;
+	}
+	GetEntryFile(*entry, file);
+	return true;
+}
+
+void AssetPack::GetEntryFile(const AssetPackEntry& entry, AssetPackFile& file) const
+{
+	file.data = mappedFile.GetData() + entry.dataOffset;
+	file.storedSize = static_cast<size_t>(entry.storedSize);
+	file.size = static_cast<size_t>(entry.size);
+	file.contentHash = entry.contentHash;
+	file.compression = static_cast<AssetPackCompression>(entry.compression);
+}
+
+std::string AssetPack::GetName(int index) const
+{
+	return std::string(GetEntryName(entries[index]));
+}
+
+void AssetPack::GetFile(int index, AssetPackFile& file) const
+{
+	GetEntryFile(entries[index], file);
+}
+
+bool AssetPack::Read(const AssetPackFile& file, std::vector<uint8_t>& buffer)
+{
+	//Open() checked the sizes, an uncompressed entry has storedSize == size and a compressed one stops at size
+	if (!file.IsCompressed())
+	{
+		buffer.assign(file.data, file.data + file.storedSize);
+		return true;
+	}
+	buffer.resize(file.size);
+	return Lz4Decompress(file.data, file.storedSize, buffer.data(), buffer.size());
+}
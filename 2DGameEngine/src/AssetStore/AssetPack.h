@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../Platform/MappedFile.h"
+
+////////////////////////////////////////////////////////////////////////
+// Asset packs
+////////////////////////////////////////////////////////////////////////
+// Every asset in one file, so a release build opens and maps a single
+// file at startup instead of opening and reading hundreds of loose ones.
+// Written by the 2DGameEngineCooker tool:
+//
+//		AssetPackHeader (48 bytes, little endian)
+//		the entries' data, each one aligned
+//		numEntries AssetPackEntry, sorted by name
+//		the names, one after the other (not zero terminated)
+//
+// Entries are named by their path relative to the game's directory, with
+// forward slashes ("assets/images/tank-panther-right.png"), so the game
+// finds them under the same paths it would load the loose files from.
+// Every entry starts on ASSET_PACK_ALIGNMENT bytes, and big ones on a
+// page of their own, so the data can be used in place as any type.
+// Entries are LZ4 compressed when that makes them noticeably smaller,
+// images that are already compressed are usually stored as they are.
+// At runtime the pack is mapped and looked up with a binary search on
+// the names; an uncompressed entry is a pointer into the mapping.
+////////////////////////////////////////////////////////////////////////
+const char ASSET_PACK_MAGIC[4] = { 'A', 'P', 'A', 'K' };
+const uint32_t ASSET_PACK_VERSION = 1;
+const uint32_t ASSET_PACK_ALIGNMENT = 16;
+const uint32_t ASSET_PACK_PAGE_ALIGNMENT = 4096; //for entries of ASSET_PACK_PAGE_ALIGNED_SIZE or more
+const uint64_t ASSET_PACK_PAGE_ALIGNED_SIZE = 64 * 1024;
+const uint64_t ASSET_PACK_MAX_FILE_SIZE = 1ull << 30; //unpacked, so a corrupt entry can't make Read() allocate without limit
+
+enum AssetPackCompression : uint32_t
+{
+	ASSET_PACK_COMPRESSION_NONE,
+	ASSET_PACK_COMPRESSION_LZ4
+};
+
+struct AssetPackHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t numEntries;
+	uint64_t indexOffset; //the entries
+	uint64_t namesOffset;
+	uint64_t namesSize;
+	uint64_t reserved;
+};
+
+struct AssetPackEntry
+{
+	uint64_t dataOffset;
+	uint64_t storedSize; //in the pack
+	uint64_t size; //once it's decompressed
+	uint64_t contentHash; //StateHasher hash of the decompressed data, it changes whenever the file does
+	uint32_t nameOffset; //from namesOffset
+	uint32_t nameSize;
+	uint32_t compression; //AssetPackCompression
+	uint32_t alignment; //of dataOffset
+};
+
+static_assert(sizeof(AssetPackHeader) == 48, "AssetPackHeader is written to disk as it is, its size can't change");
+static_assert(sizeof(AssetPackEntry) == 48, "AssetPackEntry is written to disk as it is, its size can't change");
+
+//A file to put into a pack
+struct AssetPackSource
+{
+	std::string name; //what the game asks for, see GetAssetPackName()
+	std::string filePath; //where it's read from now
+	bool isCompressible = true; //false for files that are used in place, like binary maps
+};
+
+struct AssetPackSummary
+{
+	int numEntries = 0;
+	int numCompressed = 0;
+	uint64_t totalSize = 0; //of the files
+	uint64_t packSize = 0;
+};
+
+//The name a file is packed under: the path made relative and normal, with forward slashes ("./assets//a.png" is "assets/a.png")
+std::string GetAssetPackName(const std::string& filePath);
+
+bool WriteAssetPack(const std::string& filePath, const std::vector<AssetPackSource>& sources, AssetPackSummary& summary);
+
+//An entry found in a pack. The data points into the mapping, and is only valid while the pack is open
+struct AssetPackFile
+{
+	const uint8_t* data = nullptr;
+	size_t storedSize = 0;
+	size_t size = 0;
+	uint64_t contentHash = 0;
+	AssetPackCompression compression = ASSET_PACK_COMPRESSION_NONE;
+
+	bool IsCompressed() const { return compression != ASSET_PACK_COMPRESSION_NONE; }
+};
+
+class AssetPack
+{
+private:
+	MappedFile mappedFile;
+	std::string filePath;
+	const AssetPackHeader* header = nullptr;
+	const AssetPackEntry* entries = nullptr;
+	const char* names = nullptr;
+
+	std::string_view GetEntryName(const AssetPackEntry& entry) const;
+	void GetEntryFile(const AssetPackEntry& entry, AssetPackFile& file) const;
+
+public:
+	//Maps the pack and checks its header and index. The entries' data isn't read until it's used
+	bool Open(const std::string& filePath);
+	void Close();
+
+	bool IsOpen() const;
+	const std::string& GetFilePath() const;
+	int GetNumEntries() const;
+
+	//filePath is anything GetAssetPackName() takes. Returns false if the pack doesn't have it
+	bool Find(const std::string& filePath, AssetPackFile& file) const;
+	//Every entry by index, in name order
+	std::string GetName(int index) const;
+	void GetFile(int index, AssetPackFile& file) const;
+	//Decompresses a compressed entry into the buffer (or copies an uncompressed one). Returns false if it's corrupt
+	static bool Read(const AssetPackFile& file, std::vector<uint8_t>& buffer);
+};
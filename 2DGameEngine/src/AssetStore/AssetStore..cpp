@@ -1,40 +1,1001 @@
 #include "AssetStore.h"
+#include "CookedAssets.h"
+#include "TextureAtlas.h"
 #include "../Logger/Logger.h"
+#include "../Platform/FileWatcher.h"
+#include "../Profiler/Profiler.h"
 #include <SDL_image.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+const int PLACEHOLDER_TEXTURE_SIZE = 8;
 
 AssetStore::AssetStore()
 {
-	Logger::Log("AssetStore constructor called");
+	LOG(INFO, ASSETS, "AssetStore constructor called");
 }
 
 AssetStore::~AssetStore()
 {
 	ClearAssets();
-	Logger::Log("AssetStore destructor called");
+	LOG(INFO, ASSETS, "AssetStore destructor called");
+}
+
+void AssetStore::ReserveHandle(AssetHandle handle)
+{
+	if (handle < regions.size())
+	{
+		return;
+	}
+	const size_t numHandles = static_cast<size_t>(handle) + 1;
+	regions.resize(numHandles);
+	statuses.resize(numHandles, TEXTURE_STATUS_NONE);
+	refCounts.resize(numHandles, 0);
+	filePaths.resize(numHandles);
+	lastUsedFrames.resize(numHandles, 0);
+	versions.resize(numHandles, 0);
+}
+
+void AssetStore::SetStatus(AssetHandle handle, TextureStatus status)
+{
+	ReserveHandle(handle);
+	statuses[handle] = status;
+}
+
+bool AssetStore::BeginLoad(AssetHandle handle, const std::string& filePath)
+{
+	ReserveHandle(handle);
+	refCounts[handle]++;
+	const TextureStatus status = statuses[handle];
+	if (status == TEXTURE_STATUS_LOADING || status == TEXTURE_STATUS_READY)
+	{
+		if (filePaths[handle] != filePath)
+		{
+			LOG(WARNING, ASSETS, "Texture {} is already in the asset store from {}, keeping that one", AssetIds::GetName(handle), filePaths[handle]);
+		}
+		cacheStats.hits++;
+		return false;
+	}
+	if (status == TEXTURE_STATUS_EVICTED)
+	{
+		numEvicted--;
+		cacheStats.reloads++;
+	}
+	filePaths[handle] = filePath;
+	cacheStats.misses++;
+	return true;
+}
+
+AssetStore::OwnedTexture& AssetStore::KeepTexture(SDL_Texture* texture, bool isAtlasPage)
+{
+	Uint32 format;
+	int width;
+	int height;
+	SDL_QueryTexture(texture, &format, NULL, &width, &height);
+	const size_t textureBytes = static_cast<size_t>(width) * height * SDL_BYTESPERPIXEL(format);
+	textureMemoryBytes += textureBytes;
+	MemoryTracker::RecordAllocation(MEMORY_TAG_ASSETS, textureBytes);
+	numTextures++;
+
+	ownedTextures.push_back({ texture, textureBytes, {}, isAtlasPage });
+	return ownedTextures.back();
+}
+
+void AssetStore::ReleaseOwnedTexture(size_t ownedIndex)
+{
+	OwnedTexture& owned = ownedTextures[ownedIndex];
+	SDL_DestroyTexture(owned.texture);
+	textureMemoryBytes -= owned.bytes;
+	MemoryTracker::RecordFree(MEMORY_TAG_ASSETS, owned.bytes);
+	numTextures--;
+
+	if (ownedIndex + 1 < ownedTextures.size())
+	{
+		owned = std::move(ownedTextures.back());
+	}
+	ownedTextures.pop_back();
+}
+
+size_t AssetStore::FindOwnedTexture(AssetHandle handle) const
+{
+	for (size_t i = 0; i < ownedTextures.size(); i++)
+	{
+		const auto& handles = ownedTextures[i].handles;
+		if (std::find(handles.begin(), handles.end(), handle) != handles.end())
+		{
+			return i;
+		}
+	}
+	return ownedTextures.size();
 }
 
 void AssetStore::ClearAssets()
 {
-	for (auto texture : textures)
+	//the workers write into this object, so nothing can still be decoding once it's cleared
+	while (numDecoding > 0)
+	{
+		CollectDecodedImages(true);
+	}
+	for (auto& image : uploadQueue)
+	{
+		SDL_FreeSurface(image.surface);
+	}
+	uploadQueue.clear();
+	for (auto& image : atlasImages)
+	{
+		SDL_FreeSurface(image.surface);
+	}
+	atlasImages.clear();
+
+	for (auto& owned : ownedTextures)
+	{
+		SDL_DestroyTexture(owned.texture);
+	}
+	ownedTextures.clear();
+	regions.clear();
+	statuses.clear();
+	refCounts.clear();
+	filePaths.clear();
+	lastUsedFrames.clear();
+	versions.clear();
+	numEvicted = 0;
+	if (placeholderTexture)
+	{
+		SDL_DestroyTexture(placeholderTexture);
+		placeholderTexture = nullptr;
+	}
+	placeholderRegion = TextureRegion();
+	numTextures = 0;
+	numAtlasImages = 0;
+	MemoryTracker::RecordFree(MEMORY_TAG_ASSETS, textureMemoryBytes);
+	textureMemoryBytes = 0;
+}
+
+bool AssetStore::MountPack(const std::string& filePath)
+{
+	auto pack = std::make_unique<AssetPack>();
+	if (!pack->Open(filePath))
+	{
+		return false;
+	}
+	//the workers look in the packs, so nothing can be decoding while the list changes
+	while (numDecoding > 0)
+	{
+		CollectDecodedImages(true);
+	}
+	packs.push_back(std::move(pack));
+	return true;
+}
+
+void AssetStore::UnmountPacks()
+{
+	while (numDecoding > 0)
+	{
+		CollectDecodedImages(true);
+	}
+	packs.clear();
+}
+
+int AssetStore::GetNumMountedPacks() const
+{
+	return static_cast<int>(packs.size());
+}
+
+bool AssetStore::FindPackedFile(const std::string& filePath, AssetPackFile& file) const
+{
+	for (auto pack = packs.rbegin(); pack != packs.rend(); ++pack)
+	{
+		if ((*pack)->Find(filePath, file))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+SDL_RWops* AssetStore::OpenFile(const std::string& filePath, std::vector<uint8_t>& buffer) const
+{
+	AssetPackFile file;
+	if (!FindPackedFile(filePath, file))
+	{
+		return SDL_RWFromFile(filePath.c_str(), "rb");
+	}
+	if (!file.IsCompressed())
+	{
+		return SDL_RWFromConstMem(file.data, static_cast<int>(file.size));
+	}
+	if (!AssetPack::Read(file, buffer))
+	{
+		LOG(ERROR, ASSETS, "Could not decompress {} from its asset pack, it's corrupt", filePath);
+		return nullptr;
+	}
+	return SDL_RWFromConstMem(buffer.data(), static_cast<int>(buffer.size()));
+}
+
+bool AssetStore::ReadFile(const std::string& filePath, std::vector<uint8_t>& buffer, const uint8_t*& data, size_t& size) const
+{
+	AssetPackFile file;
+	if (!FindPackedFile(filePath, file))
+	{
+		std::ifstream stream(filePath, std::ios::binary);
+		if (!stream.is_open())
+		{
+			return false;
+		}
+		buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+	else if (!file.IsCompressed())
+	{
+		data = file.data;
+		size = file.size;
+		return true;
+	}
+	else if (!AssetPack::Read(file, buffer))
+	{
+		LOG(ERROR, ASSETS, "Could not decompress {} from its asset pack, it's corrupt", filePath);
+		return false;
+	}
+	data = buffer.data();
+	size = buffer.size();
+	return true;
+}
+
+bool AssetStore::MountCookedAssets(const std::string& directory)
+{
+	const std::string manifestPath = (std::filesystem::path(directory) / COOKED_MANIFEST_FILE_NAME).string();
+	std::vector<uint8_t> buffer;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	if (!ReadFile(manifestPath, buffer, data, size))
+	{
+		return false;
+	}
+	std::vector<CookedManifestEntry> entries;
+	std::string error;
+	if (!ParseCookedManifest(std::string(reinterpret_cast<const char*>(data), size), entries, error))
+	{
+		LOG(ERROR, ASSETS, "Cooked asset manifest {} is corrupt, {}", manifestPath, error);
+		return false;
+	}
+
+	//the workers look cooked files up, so nothing can be decoding while the list changes
+	while (numDecoding > 0)
+	{
+		CollectDecodedImages(true);
+	}
+	for (const auto& entry : entries)
+	{
+		cookedFiles[entry.sourceName] = (std::filesystem::path(directory) / entry.cookedName).generic_string();
+	}
+	LOG(INFO, ASSETS, "Cooked assets mounted from {}, {} files", directory, entries.size());
+	return true;
+}
+
+int AssetStore::GetNumCookedFiles() const
+{
+	return static_cast<int>(cookedFiles.size());
+}
+
+std::string AssetStore::FindCookedFile(const std::string& filePath) const
+{
+	if (cookedFiles.empty())
+	{
+		return std::string();
+	}
+	const auto cookedFile = cookedFiles.find(GetAssetPackName(filePath));
+	return cookedFile != cookedFiles.end() ? cookedFile->second : std::string();
+}
+
+SDL_BlendMode AssetStore::GetPremultipliedBlendMode()
+{
+	return SDL_ComposeCustomBlendMode
+	(
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD
+	);
+}
+
+bool AssetStore::EnablePremultipliedAlpha(SDL_Renderer* renderer)
+{
+	//a renderer that can't blend a custom mode refuses to set it on a texture, that's the only way to ask
+	SDL_Texture* probe = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, 1, 1);
+	const bool isSupported = probe && SDL_SetTextureBlendMode(probe, GetPremultipliedBlendMode()) == 0;
+	if (probe)
+	{
+		SDL_DestroyTexture(probe);
+	}
+	if (!isSupported)
+	{
+		return false;
+	}
+	while (numDecoding > 0)
+	{
+		CollectDecodedImages(true);
+	}
+	isPremultipliedAlpha = true;
+	return true;
+}
+
+bool AssetStore::IsPremultipliedAlpha() const
+{
+	return isPremultipliedAlpha;
+}
+
+//Premultiplies or unpremultiplies an ARGB8888 surface in place, a row at a time as rows can be padded
+static void ConvertSurfaceAlpha(SDL_Surface* surface, bool premultiply)
+{
+	SDL_LockSurface(surface);
+	for (int row = 0; row < surface->h; row++)
+	{
+		uint32_t* pixels = reinterpret_cast<uint32_t*>(static_cast<Uint8*>(surface->pixels) + row * surface->pitch);
+		if (premultiply)
+		{
+			PremultiplyAlpha(pixels, static_cast<size_t>(surface->w));
+		}
+		else
+		{
+			UnpremultiplyAlpha(pixels, static_cast<size_t>(surface->w));
+		}
+	}
+	SDL_UnlockSurface(surface);
+}
+
+SDL_Surface* AssetStore::LoadCookedImage(const std::string& cookedFilePath, bool& isPremultiplied) const
+{
+	std::vector<uint8_t> buffer;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	CookedImageHeader header;
+	if (!ReadFile(cookedFilePath, buffer, data, size))
 	{
-		SDL_DestroyTexture(texture.second);
+		LOG(ERROR, ASSETS, "Could not read cooked image {}", cookedFilePath);
+		return nullptr;
 	}
-	textures.clear();
+	if (!ReadCookedImageHeader(data, size, cookedFilePath, header))
+	{
+		return nullptr;
+	}
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, static_cast<int>(header.width), static_cast<int>(header.height), 32, SDL_PIXELFORMAT_ARGB8888);
+	if (!surface)
+	{
+		return nullptr;
+	}
+	//the rows of a 32 bit surface aren't padded, so the pixels are read (or decompressed) straight into it
+	if (surface->pitch != surface->w * 4 || !ReadCookedImagePixels(data, header, static_cast<uint32_t*>(surface->pixels)))
+	{
+		LOG(ERROR, ASSETS, "Cooked image {} is corrupt", cookedFilePath);
+		SDL_FreeSurface(surface);
+		return nullptr;
+	}
+	isPremultiplied = (header.flags & COOKED_IMAGE_PREMULTIPLIED) != 0;
+	return surface;
+}
+
+SDL_Surface* AssetStore::LoadImage(const std::string& filePath) const
+{
+	SDL_Surface* surface = nullptr;
+	bool isPremultiplied = false;
+	const std::string cookedFilePath = FindCookedFile(filePath);
+	if (!cookedFilePath.empty())
+	{
+		surface = LoadCookedImage(cookedFilePath, isPremultiplied);
+		if (!surface)
+		{
+			LOG(WARNING, ASSETS, "Decoding {} instead of its cooked image", filePath);
+		}
+	}
+	if (!surface)
+	{
+		std::vector<uint8_t> buffer; //only used by compressed images, which are rare as PNGs don't compress any further
+		SDL_RWops* file = OpenFile(filePath, buffer);
+		surface = file ? IMG_Load_RW(file, 1) : nullptr;
+	}
+	if (!surface || isPremultiplied == isPremultipliedAlpha)
+	{
+		return surface;
+	}
+
+	if (surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+	{
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+		SDL_FreeSurface(surface);
+		surface = converted;
+	}
+	if (surface)
+	{
+		ConvertSurfaceAlpha(surface, isPremultipliedAlpha);
+	}
+	return surface;
+}
+
+SDL_Texture* AssetStore::CreateTextureFromSurface(SDL_Renderer* renderer, SDL_Surface* surface) const
+{
+	if (surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+	{
+		return SDL_CreateTextureFromSurface(renderer, surface); //only straight alpha gets here
+	}
+	SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, surface->w, surface->h);
+	if (!texture)
+	{
+		return nullptr;
+	}
+	SDL_LockSurface(surface);
+	const bool isUpdated = SDL_UpdateTexture(texture, NULL, surface->pixels, surface->pitch) == 0;
+	SDL_UnlockSurface(surface);
+	if (!isUpdated)
+	{
+		SDL_DestroyTexture(texture);
+		return nullptr;
+	}
+	SDL_SetTextureBlendMode(texture, isPremultipliedAlpha ? GetPremultipliedBlendMode() : SDL_BLENDMODE_BLEND);
+	return texture;
 }
 
 void AssetStore::AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath)
 {
-	SDL_Surface* surface = IMG_Load(filePath.c_str());
-	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+	const AssetHandle handle = AssetIds::Intern(assetId);
+	if (BeginLoad(handle, filePath))
+	{
+		CreateTexture(renderer, handle, filePath, LoadImage(filePath));
+	}
+}
+
+bool AssetStore::CreateTexture(SDL_Renderer* renderer, AssetHandle handle, const std::string& filePath, SDL_Surface* surface)
+{
+	ReserveHandle(handle);
+	SDL_Texture* texture = surface ? CreateTextureFromSurface(renderer, surface) : nullptr;
+	SDL_FreeSurface(surface);
+	if (!texture)
+	{
+		LOG(ERROR, ASSETS, "Could not load texture {} from {}", AssetIds::GetName(handle), filePath);
+		SetStatus(handle, TEXTURE_STATUS_FAILED);
+		regions[handle] = placeholderRegion;
+		return false;
+	}
+
+	//Add the texture to the array, at its handle
+	int width;
+	int height;
+	SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+	regions[handle] = { texture, { 0, 0, width, height } };
+	KeepTexture(texture, false).handles.push_back(handle);
+	SetStatus(handle, TEXTURE_STATUS_READY);
+
+	LOG(INFO, ASSETS, "New texture addedd to asset store with id = {}", AssetIds::GetName(handle));
+	return true;
+}
+
+void AssetStore::StartDecoding(AssetHandle handle, const std::string& filePath, DecodePurpose purpose)
+{
+	if (!decodePool)
+	{
+		decodePool = std::make_unique<ThreadPool>();
+	}
+	if (purpose != DECODE_FOR_RELOAD)
+	{
+		SetStatus(handle, TEXTURE_STATUS_LOADING);
+	}
+	numDecoding++;
+	if (purpose == DECODE_FOR_ATLAS)
+	{
+		numAtlasDecoding++;
+	}
+
+	decodePool->Submit([this, handle, filePath, purpose]()
+	{
+		//decoding and converting are CPU only, nothing here touches the renderer
+		SDL_Surface* surface = LoadImage(filePath);
+		if (surface && purpose != DECODE_FOR_TEXTURE && surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+		{
+			//the atlas copies pixels by hand, so its images all get the page's format. A reload might land on a page too
+			SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+			SDL_FreeSurface(surface);
+			surface = converted;
+		}
+
+		//notified under the lock, so the store can't be gone by the time this thread touches imageDecoded
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decodedImages.push_back({ handle, filePath, surface, purpose });
+		imageDecoded.notify_one();
+	});
+}
+
+void AssetStore::CollectDecodedImages(bool wait)
+{
+	{
+		std::unique_lock<std::mutex> lock(decodedMutex);
+		if (wait && numDecoding > 0)
+		{
+			imageDecoded.wait(lock, [this] { return !decodedImages.empty(); });
+		}
+		collectedImages.swap(decodedImages);
+	}
+
+	for (auto& image : collectedImages)
+	{
+		numDecoding--;
+		if (image.purpose != DECODE_FOR_ATLAS)
+		{
+			uploadQueue.push_back(std::move(image));
+			continue;
+		}
+
+		numAtlasDecoding--;
+		for (auto& atlasImage : atlasImages)
+		{
+			if (atlasImage.handle == image.handle && !atlasImage.isDecoded)
+			{
+				atlasImage.surface = image.surface;
+				atlasImage.isDecoded = true;
+				break;
+			}
+		}
+	}
+	collectedImages.clear();
+}
+
+AssetHandle AssetStore::LoadTextureAsync(const std::string& assetId, const std::string& filePath)
+{
+	const AssetHandle handle = AssetIds::Intern(assetId);
+	if (BeginLoad(handle, filePath))
+	{
+		StartDecoding(handle, filePath, DECODE_FOR_TEXTURE);
+	}
+	return handle;
+}
+
+void AssetStore::AddAtlasImage(const std::string& assetId, const std::string& filePath)
+{
+	const AssetHandle handle = AssetIds::Intern(assetId);
+	if (BeginLoad(handle, filePath))
+	{
+		atlasImages.push_back({ handle, filePath });
+		StartDecoding(handle, filePath, DECODE_FOR_ATLAS);
+	}
+}
+
+void AssetStore::ReleaseTexture(AssetHandle handle)
+{
+	if (handle >= refCounts.size() || refCounts[handle] == 0)
+	{
+		LOG(WARNING, ASSETS, "Texture {} was released more times than it was loaded", AssetIds::GetName(handle));
+		return;
+	}
+	refCounts[handle]--;
+}
+
+void AssetStore::Update(SDL_Renderer* renderer, double uploadBudgetMilliseconds)
+{
+	ReloadUsedTextures();
+	UploadDecodedImages(renderer, uploadBudgetMilliseconds);
+	EvictTextures();
+	//textures drawn from here on are stamped with the frame the next Update() looks at
+	useFrame++;
+}
+
+void AssetStore::UploadDecodedImages(SDL_Renderer* renderer, double budgetMilliseconds)
+{
+	CollectDecodedImages(false);
+	if (uploadQueue.empty())
+	{
+		return;
+	}
+	PROFILE_SCOPE("AssetStore::UploadDecodedImages");
+
+	const Uint64 start = SDL_GetPerformanceCounter();
+	const double budgetTicks = budgetMilliseconds * SDL_GetPerformanceFrequency() / 1000.0;
+	do
+	{
+		DecodedImage image = std::move(uploadQueue.front());
+		uploadQueue.pop_front();
+		if (image.purpose == DECODE_FOR_RELOAD)
+		{
+			ApplyReload(renderer, image.handle, image.filePath, image.surface);
+		}
+		else
+		{
+			CreateTexture(renderer, image.handle, image.filePath, image.surface);
+		}
+	} while (!uploadQueue.empty() && static_cast<double>(SDL_GetPerformanceCounter() - start) < budgetTicks);
+}
+
+void AssetStore::WaitForTextures(SDL_Renderer* renderer)
+{
+	while (numDecoding > 0 || !uploadQueue.empty())
+	{
+		//only sleeps when there's nothing to upload in the meantime
+		CollectDecodedImages(uploadQueue.empty());
+		UploadDecodedImages(renderer, std::numeric_limits<double>::infinity());
+	}
+}
+
+void AssetStore::ReloadUsedTextures()
+{
+	if (numEvicted == 0)
+	{
+		return;
+	}
+	for (size_t handle = 0; handle < statuses.size(); handle++)
+	{
+		if (statuses[handle] == TEXTURE_STATUS_EVICTED && lastUsedFrames[handle] == useFrame)
+		{
+			//reloaded on its own, even if it came from an atlas page
+			numEvicted--;
+			cacheStats.misses++;
+			cacheStats.reloads++;
+			LOG(INFO, ASSETS, "Evicted texture {} is drawn again, reloading it", AssetIds::GetName(static_cast<AssetHandle>(handle)));
+			StartDecoding(static_cast<AssetHandle>(handle), filePaths[handle], DECODE_FOR_TEXTURE);
+		}
+	}
+}
+
+void AssetStore::EvictTextures()
+{
+	while (textureMemoryBytes > textureMemoryBudget)
+	{
+		//least recently drawn first. Referenced textures and ones drawn in the last frame are never evicted
+		size_t victim = ownedTextures.size();
+		uint32_t victimLastUsedFrame = 0;
+		for (size_t i = 0; i < ownedTextures.size(); i++)
+		{
+			bool isEvictable = true;
+			uint32_t lastUsedFrame = 0;
+			for (AssetHandle handle : ownedTextures[i].handles)
+			{
+				if (refCounts[handle] > 0 || lastUsedFrames[handle] >= useFrame)
+				{
+					isEvictable = false;
+					break;
+				}
+				lastUsedFrame = std::max(lastUsedFrame, lastUsedFrames[handle]);
+			}
+			if (isEvictable && (victim == ownedTextures.size() || lastUsedFrame < victimLastUsedFrame))
+			{
+				victim = i;
+				victimLastUsedFrame = lastUsedFrame;
+			}
+		}
+		if (victim == ownedTextures.size())
+		{
+			return; //everything left is in use, the budget can't be met
+		}
+		EvictTexture(victim);
+	}
+}
+
+void AssetStore::EvictTexture(size_t ownedIndex)
+{
+	OwnedTexture& owned = ownedTextures[ownedIndex];
+	for (AssetHandle handle : owned.handles)
+	{
+		regions[handle] = TextureRegion();
+		statuses[handle] = TEXTURE_STATUS_EVICTED;
+		numEvicted++;
+	}
+	if (owned.isAtlasPage)
+	{
+		numAtlasImages -= static_cast<int>(owned.handles.size());
+	}
+	LOG(INFO, ASSETS, "Evicted {} ({} bytes, {} images) to stay in the texture budget", owned.isAtlasPage ? "an atlas page" : AssetIds::GetName(owned.handles.front()), owned.bytes, owned.handles.size());
+	cacheStats.evictions++;
+	ReleaseOwnedTexture(ownedIndex);
+}
+
+TextureStatus AssetStore::GetTextureStatus(AssetHandle handle) const
+{
+	return handle < statuses.size() ? statuses[handle] : TEXTURE_STATUS_NONE;
+}
+
+uint32_t AssetStore::GetTextureVersion(AssetHandle handle) const
+{
+	return handle < versions.size() ? versions[handle] : 0;
+}
+
+//Copies the image onto the page with ATLAS_PADDING pixels around it that repeat its edge pixels. Both are ARGB8888
+static void CopyPaddedImage(SDL_Surface* image, SDL_Surface* page, int x, int y)
+{
+	SDL_LockSurface(image);
+	SDL_LockSurface(page);
+	for (int row = -ATLAS_PADDING; row < image->h + ATLAS_PADDING; row++)
+	{
+		const int imageRow = std::clamp(row, 0, image->h - 1);
+		const Uint32* source = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(image->pixels) + imageRow * image->pitch);
+		Uint32* destination = reinterpret_cast<Uint32*>(static_cast<Uint8*>(page->pixels) + (y + row) * page->pitch) + x;
+		for (int col = -ATLAS_PADDING; col < image->w + ATLAS_PADDING; col++)
+		{
+			destination[col] = source[std::clamp(col, 0, image->w - 1)];
+		}
+	}
+	SDL_UnlockSurface(page);
+	SDL_UnlockSurface(image);
+}
+
+bool AssetStore::BuildAtlas(SDL_Renderer* renderer, const std::string& layoutCachePath)
+{
+	PROFILE_SCOPE("AssetStore::BuildAtlas");
+	bool isComplete = true;
+
+	//The images have been decoding since they were added, the layout needs the size of every one of them
+	while (numAtlasDecoding > 0)
+	{
+		CollectDecodedImages(true);
+	}
+	std::vector<AtlasImage> images;
+	std::vector<SDL_Surface*> surfaces;
+	std::vector<AssetHandle> handles;
+	for (const auto& pending : atlasImages)
+	{
+		SDL_Surface* surface = pending.surface;
+		if (!surface || surface->w <= 0 || surface->h <= 0)
+		{
+			LOG(ERROR, ASSETS, "Could not load texture {} from {}", AssetIds::GetName(pending.handle), pending.filePath);
+			SDL_FreeSurface(surface);
+			SetStatus(pending.handle, TEXTURE_STATUS_FAILED);
+			isComplete = false;
+			continue;
+		}
+		//a packed image has its content hash, which saves looking at the file on disk (that might not be there)
+		AssetPackFile packedFile;
+		const uint64_t fileStamp = FindPackedFile(pending.filePath, packedFile) ? packedFile.contentHash : GetAtlasFileStamp(pending.filePath);
+		images.push_back({ pending.filePath, surface->w, surface->h, fileStamp });
+		surfaces.push_back(surface);
+		handles.push_back(pending.handle);
+	}
+	atlasImages.clear();
+	if (images.empty())
+	{
+		return isComplete;
+	}
+
+	int maxPageSize = ATLAS_MAX_PAGE_SIZE;
+	SDL_RendererInfo rendererInfo;
+	if (SDL_GetRendererInfo(renderer, &rendererInfo) == 0 && rendererInfo.max_texture_width > 0 && rendererInfo.max_texture_height > 0)
+	{
+		maxPageSize = std::min({ maxPageSize, rendererInfo.max_texture_width, rendererInfo.max_texture_height });
+	}
+
+	AtlasLayout layout;
+	const uint64_t signature = GetAtlasSignature(images, maxPageSize);
+	if (LoadAtlasLayout(layoutCachePath, signature, images, layout))
+	{
+		LOG(INFO, ASSETS, "Atlas layout for {} images loaded from {}", images.size(), layoutCachePath);
+	}
+	else
+	{
+		PackAtlas(images, maxPageSize, layout);
+		SaveAtlasLayout(layoutCachePath, signature, layout);
+		LOG(INFO, ASSETS, "Packed {} images into {} atlas pages, layout saved to {}", images.size(), layout.pages.size(), layoutCachePath);
+	}
+
+	//Put every image on its page, then make one texture per page
+	std::vector<SDL_Surface*> pageSurfaces;
+	for (const auto& page : layout.pages)
+	{
+		SDL_Surface* pageSurface = SDL_CreateRGBSurfaceWithFormat(0, page.width, page.height, 32, SDL_PIXELFORMAT_ARGB8888);
+		if (pageSurface)
+		{
+			SDL_FillRect(pageSurface, NULL, 0);
+		}
+		pageSurfaces.push_back(pageSurface);
+	}
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const AtlasPlacement& placement = layout.placements[i];
+		if (pageSurfaces[placement.page])
+		{
+			CopyPaddedImage(surfaces[i], pageSurfaces[placement.page], placement.x, placement.y);
+		}
+		SDL_FreeSurface(surfaces[i]);
+	}
+
+	std::vector<SDL_Texture*> pageTextures;
+	std::vector<size_t> pageOwnedIndices; //where each page is in ownedTextures
+	for (SDL_Surface* pageSurface : pageSurfaces)
+	{
+		SDL_Texture* texture = pageSurface ? CreateTextureFromSurface(renderer, pageSurface) : nullptr;
+		SDL_FreeSurface(pageSurface);
+		if (!texture)
+		{
+			LOG(ERROR, ASSETS, "Could not create an atlas page: {}", SDL_GetError());
+			isComplete = false;
+		}
+		else
+		{
+			KeepTexture(texture, true);
+		}
+		pageTextures.push_back(texture);
+		pageOwnedIndices.push_back(texture ? ownedTextures.size() - 1 : 0);
+	}
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const AtlasPlacement& placement = layout.placements[i];
+		SDL_Texture* texture = pageTextures[placement.page];
+		if (!texture)
+		{
+			SetStatus(handles[i], TEXTURE_STATUS_FAILED);
+			continue;
+		}
+		ReserveHandle(handles[i]);
+		regions[handles[i]] = { texture, { placement.x, placement.y, images[i].width, images[i].height } };
+		ownedTextures[pageOwnedIndices[placement.page]].handles.push_back(handles[i]);
+		SetStatus(handles[i], TEXTURE_STATUS_READY);
+		numAtlasImages++;
+		LOG(INFO, ASSETS, "New texture addedd to asset store with id = {}, atlas page {}", AssetIds::GetName(handles[i]), placement.page);
+	}
+	return isComplete;
+}
+
+//Writes a new image of the same size over an old one on an atlas page, padding included, so the rest of the page is untouched
+static bool UpdateAtlasImage(SDL_Texture* page, const SDL_Rect& rect, SDL_Surface* image)
+{
+	SDL_Surface* padded = SDL_CreateRGBSurfaceWithFormat(0, rect.w + 2 * ATLAS_PADDING, rect.h + 2 * ATLAS_PADDING, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (!padded)
+	{
+		return false;
+	}
+	CopyPaddedImage(image, padded, ATLAS_PADDING, ATLAS_PADDING);
+
+	//the renderer may have picked another format for the page when it was created
+	Uint32 pageFormat;
+	SDL_QueryTexture(page, &pageFormat, NULL, NULL, NULL);
+	SDL_Surface* pixels = padded;
+	if (pageFormat != SDL_PIXELFORMAT_ARGB8888)
+	{
+		pixels = SDL_ConvertSurfaceFormat(padded, pageFormat, 0);
+		SDL_FreeSurface(padded);
+	}
+	const SDL_Rect paddedRect = { rect.x - ATLAS_PADDING, rect.y - ATLAS_PADDING, rect.w + 2 * ATLAS_PADDING, rect.h + 2 * ATLAS_PADDING };
+	const bool isUpdated = pixels && SDL_UpdateTexture(page, &paddedRect, pixels->pixels, pixels->pitch) == 0;
+	SDL_FreeSurface(pixels);
+	return isUpdated;
+}
+
+int AssetStore::ReloadFile(const std::string& filePath)
+{
+	const std::string changedPath = NormalizeFilePath(filePath);
+	int numReloading = 0;
+	for (size_t handle = 0; handle < statuses.size(); handle++)
+	{
+		const TextureStatus status = statuses[handle];
+		if ((status != TEXTURE_STATUS_READY && status != TEXTURE_STATUS_FAILED) || filePaths[handle].empty() || NormalizeFilePath(filePaths[handle]) != changedPath)
+		{
+			continue; //loading and evicted textures read the file when they get to it anyway
+		}
+		LOG(INFO, ASSETS, "{} changed, reloading texture {}", filePath, AssetIds::GetName(static_cast<AssetHandle>(handle)));
+		//a failed texture is loaded like the first time, a ready one stays on screen until its replacement is uploaded
+		StartDecoding(static_cast<AssetHandle>(handle), filePaths[handle], status == TEXTURE_STATUS_READY ? DECODE_FOR_RELOAD : DECODE_FOR_TEXTURE);
+		numReloading++;
+	}
+	return numReloading;
+}
+
+void AssetStore::ApplyReload(SDL_Renderer* renderer, AssetHandle handle, const std::string& filePath, SDL_Surface* surface)
+{
+	if (!surface)
+	{
+		LOG(ERROR, ASSETS, "Could not reload texture {} from {}, keeping the old one", AssetIds::GetName(handle), filePath);
+		return;
+	}
+	const size_t ownedIndex = FindOwnedTexture(handle);
+	if (statuses[handle] != TEXTURE_STATUS_READY || ownedIndex == ownedTextures.size())
+	{
+		//evicted while it was decoding, it reads the new file when it's drawn again
+		SDL_FreeSurface(surface);
+		return;
+	}
+
+	TextureRegion& region = regions[handle];
+	const bool isOnAtlasPage = ownedTextures[ownedIndex].isAtlasPage;
+	if (isOnAtlasPage && surface->w == region.rect.w && surface->h == region.rect.h && UpdateAtlasImage(region.texture, region.rect, surface))
+	{
+		SDL_FreeSurface(surface);
+		versions[handle]++;
+		LOG(INFO, ASSETS, "Texture {} reloaded into its place on the atlas", AssetIds::GetName(handle));
+		return;
+	}
+
+	SDL_Texture* texture = CreateTextureFromSurface(renderer, surface);
 	SDL_FreeSurface(surface);
+	if (!texture)
+	{
+		LOG(ERROR, ASSETS, "Could not reload texture {} from {}: {}, keeping the old one", AssetIds::GetName(handle), filePath, SDL_GetError());
+		return;
+	}
+	if (isOnAtlasPage)
+	{
+		//it doesn't fit its old place any more, so it leaves the page and the other images on it stay as they are
+		auto& pageHandles = ownedTextures[ownedIndex].handles;
+		pageHandles.erase(std::find(pageHandles.begin(), pageHandles.end(), handle));
+		numAtlasImages--;
+	}
+	else
+	{
+		ReleaseOwnedTexture(ownedIndex);
+	}
+	int width;
+	int height;
+	SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+	region = { texture, { 0, 0, width, height } };
+	KeepTexture(texture, false).handles.push_back(handle);
+	versions[handle]++;
+	LOG(INFO, ASSETS, "Texture {} reloaded", AssetIds::GetName(handle));
+}
 
-	//Add the texture to the map
-	textures.emplace(assetId, texture);
+void AssetStore::ResolveMissingTextures(SDL_Renderer* renderer)
+{
+	if (!placeholderTexture)
+	{
+		//magenta and black checkers, so a missing texture is obvious on screen
+		Uint32 pixels[PLACEHOLDER_TEXTURE_SIZE * PLACEHOLDER_TEXTURE_SIZE];
+		for (int y = 0; y < PLACEHOLDER_TEXTURE_SIZE; y++)
+		{
+			for (int x = 0; x < PLACEHOLDER_TEXTURE_SIZE; x++)
+			{
+				pixels[y * PLACEHOLDER_TEXTURE_SIZE + x] = ((x / 2 + y / 2) % 2) ? 0xFF000000 : 0xFFFF00FF;
+			}
+		}
+		placeholderTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, PLACEHOLDER_TEXTURE_SIZE, PLACEHOLDER_TEXTURE_SIZE);
+		if (placeholderTexture)
+		{
+			SDL_UpdateTexture(placeholderTexture, NULL, pixels, PLACEHOLDER_TEXTURE_SIZE * sizeof(Uint32));
+			placeholderRegion = { placeholderTexture, { 0, 0, PLACEHOLDER_TEXTURE_SIZE, PLACEHOLDER_TEXTURE_SIZE } };
+		}
+	}
 
-	Logger::Log("New texture addedd to asset store with id = " + assetId);
+	ReserveHandle(static_cast<AssetHandle>(AssetIds::GetCount() - 1));
+	for (size_t handle = 0; handle < regions.size(); handle++)
+	{
+		if (statuses[handle] == TEXTURE_STATUS_LOADING || statuses[handle] == TEXTURE_STATUS_EVICTED)
+		{
+			continue; //not drawn until it's uploaded
+		}
+		if (!regions[handle].texture)
+		{
+			if (handle != ASSET_HANDLE_PLACEHOLDER)
+			{
+				LOG(WARNING, ASSETS, "No texture was loaded for {}, it will be drawn with the placeholder", AssetIds::GetName(static_cast<AssetHandle>(handle)));
+			}
+			regions[handle] = placeholderRegion;
+		}
+	}
+}
+
+int AssetStore::GetNumTextures() const
+{
+	return numTextures;
+}
+
+int AssetStore::GetNumAtlasImages() const
+{
+	return numAtlasImages;
+}
+
+int AssetStore::GetNumLoadingTextures() const
+{
+	return numDecoding + static_cast<int>(uploadQueue.size());
 }
 
-SDL_Texture* AssetStore::GetTexture(const std::string& assetId)
+size_t AssetStore::GetTextureMemoryUsage() const
 {
-	return textures[assetId]; 
-}
\ No newline at end of file
+	return textureMemoryBytes;
+}
+
+void AssetStore::SetTextureMemoryBudget(size_t bytes)
+{
+	textureMemoryBudget = bytes;
+}
+
+size_t AssetStore::GetTextureMemoryBudget() const
+{
+	return textureMemoryBudget;
+}
+
+const AssetCacheStats& AssetStore::GetCacheStats() const
+{
+	return cacheStats;
+}
@@ -1,13 +1,194 @@
 #pragma once
 
-#include <map>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <SDL.h>
+#include "AssetHandle.h"
+#include "AssetPack.h"
+#include "../Jobs/ThreadPool.h"
+#include "../Memory/MemoryTracker.h"
 
+enum TextureStatus : uint8_t
+{
+	TEXTURE_STATUS_NONE, //never asked for
+	TEXTURE_STATUS_LOADING, //being decoded, or decoded and waiting to be uploaded
+	TEXTURE_STATUS_READY,
+	TEXTURE_STATUS_FAILED, //drawn with the placeholder
+	TEXTURE_STATUS_EVICTED //dropped to stay in the memory budget, reloaded when it's drawn again
+};
+
+const size_t DEFAULT_TEXTURE_MEMORY_BUDGET = 512 * 1024 * 1024;
+
+struct AssetCacheStats
+{
+	uint64_t hits = 0; //loads of a texture that was already there (or on its way)
+	uint64_t misses = 0; //loads and reloads that had to decode the image
+	uint64_t evictions = 0; //textures dropped to stay in the budget, an atlas page counts once
+	uint64_t reloads = 0; //evicted textures that were drawn or loaded again, counted in misses too
+};
+
+//Where an image is. Its own texture when it was loaded on its own, or a rect on an atlas page when it was packed
+struct TextureRegion
+{
+	SDL_Texture* texture = nullptr; //nullptr if the texture was never loaded
+	SDL_Rect rect = { 0, 0, 0, 0 };
+
+	//Takes a rect on the image (a sprite's srcRect) to the texture. It's clipped to the image, like SDL clips to a
+	//whole texture, so a sprite never shows a bit of its neighbour on the atlas page
+	SDL_Rect MapRect(const SDL_Rect& imageRect) const
+	{
+		const int left = std::clamp(imageRect.x, 0, rect.w);
+		const int top = std::clamp(imageRect.y, 0, rect.h);
+		const int right = std::clamp(imageRect.x + imageRect.w, left, rect.w);
+		const int bottom = std::clamp(imageRect.y + imageRect.h, top, rect.h);
+		return { rect.x + left, rect.y + top, right - left, bottom - top };
+	}
+};
+
+////////////////////////////////////////////////////////////////////////
+// AssetStore
+////////////////////////////////////////////////////////////////////////
+// Owns the textures and gives them out by asset handle.
+// Images are decoded on a pool of worker threads, so a level with many
+// images decodes them on every core at once. Only the main thread talks
+// to the renderer: decoded images are queued back to it, and
+// Update() turns them into textures once a frame, up to a
+// time budget, so streaming textures in never stalls a frame for long.
+// LoadTextureAsync() returns the handle straight away; a texture that is
+// still loading simply isn't drawn until it's ready. Its status can be
+// polled with GetTextureStatus(), or WaitForTextures() blocks until
+// everything that's loading is done.
+// Atlas images start decoding as soon as they're added, and
+// BuildAtlas() waits for the last of them before it packs.
+// It's also a cache. Every load takes a reference to the texture and
+// ReleaseTexture() gives it back; loading an id that's already there
+// just takes another reference, so levels that share images share the
+// textures. Released textures stay around until the store is over its
+// memory budget, then the least recently drawn ones are evicted (an atlas
+// page only goes once none of its images is referenced). An evicted
+// texture that's drawn again is reloaded on its own, in the background.
+// Files are read from the mounted asset packs when they have them, and
+// from disk otherwise, so a release build can ship one pack while loose
+// files still work in development. A packed file is handed to SDL's
+// loaders straight from the pack's mapping.
+// Images cooked by 2DGameEngineCooker (see CookedAssets.h) are found
+// through the manifest of the mounted cooked directory. They're already
+// decoded, so loading one is a read and a copy into the texture with
+// SDL_UpdateTexture, SDL_image never sees it. With premultiplied alpha
+// enabled every texture is premultiplied (loose images are converted as
+// they're decoded) and blended as such, so filtering and scaling sprites
+// doesn't bleed dark fringes in from their transparent pixels.
+// ReloadFile() is for hot reloading: the textures loaded from a changed
+// file keep being drawn as they were until the new image is decoded, and
+// are swapped for it between frames.
+////////////////////////////////////////////////////////////////////////
 class AssetStore
 {
 private:
-	std::map<std::string, SDL_Texture*> textures; //create map for textures
+	struct PendingAtlasImage
+	{
+		AssetHandle handle;
+		std::string filePath;
+		SDL_Surface* surface = nullptr; //ARGB8888, set once it's decoded
+		bool isDecoded = false;
+	};
+
+	enum DecodePurpose : uint8_t
+	{
+		DECODE_FOR_TEXTURE, //becomes a texture of its own
+		DECODE_FOR_ATLAS, //waits for BuildAtlas()
+		DECODE_FOR_RELOAD //the file changed, replaces a texture that's already there
+	};
+
+	struct DecodedImage
+	{
+		AssetHandle handle;
+		std::string filePath;
+		SDL_Surface* surface; //nullptr if it couldn't be loaded
+		DecodePurpose purpose;
+	};
+
+	struct OwnedTexture
+	{
+		SDL_Texture* texture;
+		size_t bytes;
+		std::vector<AssetHandle> handles; //drawn from this texture, every image on it for an atlas page
+		bool isAtlasPage;
+	};
+
+	//regions by asset handle. Handles without a texture of their own share the placeholder once resolved
+	std::vector<TextureRegion, TrackingAllocator<TextureRegion, MEMORY_TAG_ASSETS>> regions;
+	std::vector<OwnedTexture, TrackingAllocator<OwnedTexture, MEMORY_TAG_ASSETS>> ownedTextures; //every texture we created, atlas pages included
+	std::vector<PendingAtlasImage> atlasImages; //waiting for BuildAtlas()
+	//the rest of what we know about each handle
+	std::vector<TextureStatus> statuses;
+	std::vector<uint32_t> refCounts;
+	std::vector<std::string> filePaths; //where it was loaded from, so it can be reloaded
+	mutable std::vector<uint32_t> lastUsedFrames; //stamped by GetTextureRegion()
+	std::vector<uint32_t> versions; //bumped every time the file is reloaded
+	uint32_t useFrame = 1; //counts Update() calls
+	size_t textureMemoryBudget = DEFAULT_TEXTURE_MEMORY_BUDGET;
+	int numEvicted = 0; //handles evicted and not reloaded yet
+	AssetCacheStats cacheStats;
+	SDL_Texture* placeholderTexture = nullptr;
+	TextureRegion placeholderRegion;
+	int numTextures = 0; //textures made from files (an atlas page counts once), the placeholder isn't counted
+	int numAtlasImages = 0;
+	size_t textureMemoryBytes = 0; //estimated from the size and pixel format of every texture, SDL owns the actual memory
+
+	std::vector<std::unique_ptr<AssetPack>> packs; //looked in last mounted first. Never changed while anything is decoding
+	std::unordered_map<std::string, std::string> cookedFiles; //source asset pack names to their cooked files, same rule as packs
+	bool isPremultipliedAlpha = false; //same rule as packs, the workers read it
+
+	std::unique_ptr<ThreadPool> decodePool; //started by the first image that needs decoding
+	std::mutex decodedMutex;
+	std::condition_variable imageDecoded;
+	std::vector<DecodedImage> decodedImages; //pushed by the workers, under decodedMutex
+	std::vector<DecodedImage> collectedImages; //swapped with decodedImages by the main thread, so neither is freed
+	std::deque<DecodedImage> uploadQueue; //decoded, waiting for Update()
+	int numDecoding = 0; //submitted and not collected yet
+	int numAtlasDecoding = 0;
+
+	void ReserveHandle(AssetHandle handle);
+	void SetStatus(AssetHandle handle, TextureStatus status);
+	//Takes a reference and remembers the file. Returns false if the texture is already there or on its way, a cache hit
+	bool BeginLoad(AssetHandle handle, const std::string& filePath);
+	//Owns the texture from now on and counts its memory
+	OwnedTexture& KeepTexture(SDL_Texture* texture, bool isAtlasPage);
+	//Makes the handle's texture from the surface (which it frees), or points the handle at the placeholder if it can't
+	bool CreateTexture(SDL_Renderer* renderer, AssetHandle handle, const std::string& filePath, SDL_Surface* surface);
+	//Destroys the texture and stops counting it, it's swapped with the last one so indices after it aren't kept
+	void ReleaseOwnedTexture(size_t ownedIndex);
+	//Where the handle's texture is in ownedTextures, ownedTextures.size() if it has none
+	size_t FindOwnedTexture(AssetHandle handle) const;
+	//The whole file, from a pack if one has it or from disk. A packed, uncompressed file is used in place, anything else
+	//is read into buffer. Returns false if it can't be read
+	bool ReadFile(const std::string& filePath, std::vector<uint8_t>& buffer, const uint8_t*& data, size_t& size) const;
+	//Thread safe, it's called by the decode workers. Cooked images come back as ARGB8888, and so does everything once
+	//alpha is premultiplied
+	SDL_Surface* LoadImage(const std::string& filePath) const;
+	SDL_Surface* LoadCookedImage(const std::string& cookedFilePath, bool& isPremultiplied) const;
+	//ARGB8888 surfaces are copied into a texture of the same format with SDL_UpdateTexture, anything else goes through
+	//SDL_CreateTextureFromSurface(). The texture is blended the way the store's alpha is
+	SDL_Texture* CreateTextureFromSurface(SDL_Renderer* renderer, SDL_Surface* surface) const;
+	void StartDecoding(AssetHandle handle, const std::string& filePath, DecodePurpose purpose);
+	//Takes what the workers have finished since the last call. With wait set it blocks until there's something, if anything is still decoding
+	void CollectDecodedImages(bool wait);
+	void UploadDecodedImages(SDL_Renderer* renderer, double budgetMilliseconds);
+	//Evicted textures that were drawn in the last frame start loading again
+	void ReloadUsedTextures();
+	//Evicts the least recently used unreferenced textures until the store is back in its budget
+	void EvictTextures();
+	void EvictTexture(size_t ownedIndex);
+	//Puts the new pixels behind the handle (and frees the surface). An atlas image of the same size is written into its
+	//place on the page, anything else gets a texture of its own. The old texture is kept if the new one can't be made
+	void ApplyReload(SDL_Renderer* renderer, AssetHandle handle, const std::string& filePath, SDL_Surface* surface);
 
 
 public:
@@ -15,8 +196,77 @@ public:
 	~AssetStore();
 
 	void ClearAssets();
+
+	//Files in the pack are loaded from it from now on, instead of from disk. Returns false if it can't be opened
+	bool MountPack(const std::string& filePath);
+	void UnmountPacks();
+	int GetNumMountedPacks() const;
+	//Looks the file up in the mounted packs. The data stays valid until the packs are unmounted
+	bool FindPackedFile(const std::string& filePath, AssetPackFile& file) const;
+	//Images cooked into the directory are loaded from there from now on (it can be in a mounted pack). Returns false if
+	//it has no manifest. Call it before loading anything
+	bool MountCookedAssets(const std::string& directory);
+	int GetNumCookedFiles() const;
+	//Where the file was cooked to, empty if it wasn't
+	std::string FindCookedFile(const std::string& filePath) const;
+	//Every texture is premultiplied from now on, if the renderer can blend that. Returns false (and changes nothing) if it
+	//can't, SDL's software renderer can't. Call it before loading anything
+	bool EnablePremultipliedAlpha(SDL_Renderer* renderer);
+	bool IsPremultipliedAlpha() const;
+	//One + (1 - source alpha) for both color and alpha
+	static SDL_BlendMode GetPremultipliedBlendMode();
+	//Opens a file for SDL's loaders (IMG_Load_RW(), TTF_OpenFontRW(), Mix_LoadWAV_RW()), from a pack if one has it or from
+	//disk. A packed file is read from the pack's mapping, without a copy; a compressed one is decompressed into buffer,
+	//which has to outlive the SDL_RWops. Returns nullptr if the file can't be opened
+	SDL_RWops* OpenFile(const std::string& filePath, std::vector<uint8_t>& buffer) const;
+	//Every load takes a reference to the texture, whether it had to be loaded or not
+
+	//Loads the texture right away, on this thread
 	void AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath);
-	SDL_Texture* GetTexture(const std::string& assetId);
+	//Starts decoding the image on a worker and returns straight away. It becomes a texture in a later Update()
+	AssetHandle LoadTextureAsync(const std::string& assetId, const std::string& filePath);
+	//Starts decoding the image on a worker, it's packed into the atlas by the next BuildAtlas()
+	void AddAtlasImage(const std::string& assetId, const std::string& filePath);
+	//Gives back a reference taken by a load. The texture stays cached until the budget needs the memory
+	void ReleaseTexture(AssetHandle handle);
+	//Packs every queued image into a few atlas pages (see TextureAtlas.h). The layout is loaded from layoutCachePath
+	//when it was saved for the same images, and packed and saved there otherwise. Returns false if an image or page failed
+	bool BuildAtlas(SDL_Renderer* renderer, const std::string& layoutCachePath);
+	//The file changed on disk: every texture loaded from it is decoded again in the background and replaced in a later
+	//Update(), and one that failed to load is tried again. Returns how many textures that is
+	int ReloadFile(const std::string& filePath);
+	//Points every interned handle that has no texture at a placeholder (magenta checkers), logging each one.
+	//Call once the level is loaded, so missing assets are found then and not while drawing. Textures still loading are left alone
+	void ResolveMissingTextures(SDL_Renderer* renderer);
+
+	//Main thread, once a frame before drawing. Turns decoded images into textures until uploadBudgetMilliseconds is used
+	//up (but always at least one), reloads evicted textures that were drawn, and evicts what's over the memory budget
+	void Update(SDL_Renderer* renderer, double uploadBudgetMilliseconds);
+	//Blocks until every texture that's loading is ready or has failed
+	void WaitForTextures(SDL_Renderer* renderer);
+	TextureStatus GetTextureStatus(AssetHandle handle) const;
+	//Changes when the texture's pixels are replaced by a reload, so anything drawn from them and kept can be redrawn
+	uint32_t GetTextureVersion(AssetHandle handle) const;
+
+	const TextureRegion& GetTextureRegion(AssetHandle handle) const
+	{
+		if (handle >= regions.size())
+		{
+			return placeholderRegion;
+		}
+		lastUsedFrames[handle] = useFrame; //for the eviction order, and so an evicted texture that's drawn comes back
+		return regions[handle];
+	}
+
+	//Textures that aren't referenced are evicted once the store uses more than this. Referenced ones never are
+	void SetTextureMemoryBudget(size_t bytes);
+	size_t GetTextureMemoryBudget() const;
+	const AssetCacheStats& GetCacheStats() const;
+
+	int GetNumTextures() const;
+	int GetNumAtlasImages() const;
+	int GetNumLoadingTextures() const;
+	size_t GetTextureMemoryUsage() const;
 
 
-};
\ No newline at end of file
+};
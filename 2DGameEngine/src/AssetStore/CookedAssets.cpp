@@ -0,0 +1,206 @@
+#include "CookedAssets.h"
+#include "AssetPack.h"
+#include "../Compression/Lz4.h"
+#include "../Logger/Logger.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+//x * a / 255, rounded, without a division
+static uint32_t MultiplyChannel(uint32_t channel, uint32_t alpha)
+{
+	const uint32_t product = channel * alpha + 128;
+	return (product + (product >> 8)) >> 8;
+}
+
+void PremultiplyAlpha(uint32_t* pixels, size_t numPixels)
+{
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		const uint32_t pixel = pixels[i];
+		const uint32_t alpha = pixel >> 24;
+		if (alpha == 255)
+		{
+			continue; //most pixels of most sprites
+		}
+		const uint32_t red = MultiplyChannel((pixel >> 16) & 0xFF, alpha);
+		const uint32_t green = MultiplyChannel((pixel >> 8) & 0xFF, alpha);
+		const uint32_t blue = MultiplyChannel(pixel & 0xFF, alpha);
+		pixels[i] = (alpha << 24) | (red << 16) | (green << 8) | blue;
+	}
+}
+
+void UnpremultiplyAlpha(uint32_t* pixels, size_t numPixels)
+{
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		const uint32_t pixel = pixels[i];
+		const uint32_t alpha = pixel >> 24;
+		if (alpha == 255 || alpha == 0)
+		{
+			continue; //nothing to undo, or nothing left to undo it with
+		}
+		const uint32_t red = std::min<uint32_t>(255, (((pixel >> 16) & 0xFF) * 255 + alpha / 2) / alpha);
+		const uint32_t green = std::min<uint32_t>(255, (((pixel >> 8) & 0xFF) * 255 + alpha / 2) / alpha);
+		const uint32_t blue = std::min<uint32_t>(255, ((pixel & 0xFF) * 255 + alpha / 2) / alpha);
+		pixels[i] = (alpha << 24) | (red << 16) | (green << 8) | blue;
+	}
+}
+
+//Written next to the file and renamed over it, like binary maps and asset packs, so a reader never sees half of one
+static bool WriteFileAtomically(const std::string& filePath, const void* data, size_t size)
+{
+	const std::string tempFilePath = filePath + ".tmp";
+	{
+		std::ofstream file(tempFilePath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			LOG(ERROR, ASSETS, "Could not open {} for writing", tempFilePath);
+			return false;
+		}
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		file.close();
+		if (!file)
+		{
+			LOG(ERROR, ASSETS, "Failed writing {}", tempFilePath);
+			std::error_code error;
+			std::filesystem::remove(tempFilePath, error);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempFilePath, filePath, error);
+	if (error)
+	{
+		LOG(ERROR, ASSETS, "Could not replace {}: {}", filePath, error.message());
+		std::filesystem::remove(tempFilePath, error);
+		return false;
+	}
+	return true;
+}
+
+bool WriteCookedImage(const std::string& filePath, int width, int height, const uint32_t* pixels, bool isCompressible, uint64_t sourceHash)
+{
+	const size_t pixelsSize = static_cast<size_t>(width) * height * sizeof(uint32_t);
+	const uint8_t* pixelBytes = reinterpret_cast<const uint8_t*>(pixels);
+
+	CookedImageHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, COOKED_IMAGE_MAGIC, sizeof(header.magic));
+	header.version = COOKED_IMAGE_VERSION;
+	header.headerSize = sizeof(CookedImageHeader);
+	header.width = static_cast<uint32_t>(width);
+	header.height = static_cast<uint32_t>(height);
+	header.compression = ASSET_PACK_COMPRESSION_NONE;
+	header.flags = COOKED_IMAGE_PREMULTIPLIED;
+	header.storedSize = pixelsSize;
+	header.sourceHash = sourceHash;
+
+	std::vector<uint8_t> compressed;
+	const uint8_t* storedPixels = pixelBytes;
+	if (isCompressible && pixelsSize > 0)
+	{
+		//same rule as asset packs, only kept if it saves at least an eighth
+		compressed.resize(Lz4CompressBound(pixelsSize));
+		const size_t compressedSize = Lz4Compress(pixelBytes, pixelsSize, compressed.data(), compressed.size());
+		if (compressedSize > 0 && compressedSize <= pixelsSize - pixelsSize / 8)
+		{
+			header.compression = ASSET_PACK_COMPRESSION_LZ4;
+			header.storedSize = compressedSize;
+			storedPixels = compressed.data();
+		}
+	}
+
+	std::vector<uint8_t> blob(sizeof(CookedImageHeader));
+	std::memcpy(blob.data(), &header, sizeof(header));
+	blob.insert(blob.end(), storedPixels, storedPixels + header.storedSize);
+	return WriteFileAtomically(filePath, blob.data(), blob.size());
+}
+
+bool ReadCookedImageHeader(const uint8_t* data, size_t size, const std::string& filePath, CookedImageHeader& header)
+{
+	if (size < sizeof(CookedImageHeader) || std::memcmp(data, COOKED_IMAGE_MAGIC, sizeof(COOKED_IMAGE_MAGIC)) != 0)
+	{
+		LOG(ERROR, ASSETS, "{} isn't a cooked image", filePath);
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.version != COOKED_IMAGE_VERSION)
+	{
+		LOG(ERROR, ASSETS, "Cooked image {} is version {}, we load version {}, cook it again", filePath, header.version, COOKED_IMAGE_VERSION);
+		return false;
+	}
+	//in 64 bits, width and height are 32 bits each so their product can't overflow
+	const uint64_t pixelsSize = static_cast<uint64_t>(header.width) * header.height * sizeof(uint32_t);
+	const bool isValid =
+		header.headerSize == sizeof(CookedImageHeader) && header.width > 0 && header.height > 0 &&
+		header.width <= INT32_MAX / sizeof(uint32_t) && header.height <= INT32_MAX &&
+		header.compression <= ASSET_PACK_COMPRESSION_LZ4 &&
+		(header.compression != ASSET_PACK_COMPRESSION_NONE || header.storedSize == pixelsSize) &&
+		header.storedSize <= size - sizeof(CookedImageHeader);
+	if (!isValid)
+	{
+		LOG(ERROR, ASSETS, "Cooked image {} is the wrong size for its header, it's probably truncated", filePath);
+		return false;
+	}
+	return true;
+}
+
+bool ReadCookedImagePixels(const uint8_t* data, const CookedImageHeader& header, uint32_t* pixels)
+{
+	const uint8_t* storedPixels = data + sizeof(CookedImageHeader);
+	const size_t pixelsSize = static_cast<size_t>(header.width) * header.height * sizeof(uint32_t);
+	if (header.compression == ASSET_PACK_COMPRESSION_NONE)
+	{
+		std::memcpy(pixels, storedPixels, pixelsSize);
+		return true;
+	}
+	return Lz4Decompress(storedPixels, static_cast<size_t>(header.storedSize), reinterpret_cast<uint8_t*>(pixels), pixelsSize);
+}
+
+bool ParseCookedManifest(const std::string& text, std::vector<CookedManifestEntry>& entries, std::string& error)
+{
+	entries.clear();
+	std::istringstream lines(text);
+	std::string line;
+	for (int lineNumber = 1; std::getline(lines, line); lineNumber++)
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back(); //edited on Windows
+		}
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		const size_t firstTab = line.find('\t');
+		const size_t secondTab = firstTab == std::string::npos ? std::string::npos : line.find('\t', firstTab + 1);
+		CookedManifestEntry entry;
+		if (secondTab == std::string::npos || firstTab == 0 || secondTab == firstTab + 1 ||
+			std::sscanf(line.c_str() + secondTab + 1, "%16" SCNx64, &entry.inputHash) != 1)
+		{
+			error = "line " + std::to_string(lineNumber) + " isn't <source> TAB <cooked> TAB <hash>";
+			return false;
+		}
+		entry.sourceName = line.substr(0, firstTab);
+		entry.cookedName = line.substr(firstTab + 1, secondTab - firstTab - 1);
+		entries.push_back(entry);
+	}
+	return true;
+}
+
+bool WriteCookedManifest(const std::string& filePath, const std::vector<CookedManifestEntry>& entries)
+{
+	std::string text = "# Cooked by 2DGameEngineCooker: source, cooked file, hash of the input\n";
+	char hash[17];
+	for (const auto& entry : entries)
+	{
+		std::snprintf(hash, sizeof(hash), "%016" PRIx64, entry.inputHash);
+		text += entry.sourceName + "\t" + entry.cookedName + "\t" + hash + "\n";
+	}
+	return WriteFileAtomically(filePath, text.data(), text.size());
+}
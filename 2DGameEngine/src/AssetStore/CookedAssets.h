@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+// Cooked assets
+////////////////////////////////////////////////////////////////////////
+// What the 2DGameEngineCooker "cook" command makes from ./assets, so the
+// game does as little work as possible loading them:
+//
+//		images become .cimg files: the pixels already decoded, as
+//		ARGB8888 with the alpha premultiplied, optionally LZ4 compressed
+//		text maps (.map) become binary maps (.bmap), see MapFile.h
+//
+// Every cooked file goes under the cooked directory at its source's
+// asset pack name plus its new extension (./assets/images/tree.png is
+// cooked to <cooked>/assets/images/tree.png.cimg), and manifest.txt
+// lists them, one line per source:
+//
+//		<source name> TAB <cooked name> TAB <input hash, 16 hex digits>
+//
+// The input hash covers the source file's contents and everything that
+// changes how it's cooked, so cooking again only redoes the sources
+// whose hash changed. The game finds cooked files through the manifest
+// (AssetStore::MountCookedAssets()), and a cooked directory can be put
+// in an asset pack like any other.
+//
+// A .cimg is a CookedImageHeader (48 bytes, little endian) followed by
+// the pixels, width * 4 bytes a row with no padding.
+////////////////////////////////////////////////////////////////////////
+const char COOKED_IMAGE_MAGIC[4] = { 'C', 'I', 'M', 'G' };
+const uint32_t COOKED_IMAGE_VERSION = 1;
+const char* const COOKED_IMAGE_EXTENSION = ".cimg";
+const char* const COOKED_MAP_EXTENSION = ".bmap";
+const char* const COOKED_MANIFEST_FILE_NAME = "manifest.txt";
+
+enum CookedImageFlags : uint32_t
+{
+	COOKED_IMAGE_PREMULTIPLIED = 1 << 0
+};
+
+struct CookedImageHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t width;
+	uint32_t height;
+	uint32_t compression; //AssetPackCompression
+	uint32_t flags; //CookedImageFlags
+	uint32_t reserved;
+	uint64_t storedSize; //of the pixels after the header
+	uint64_t sourceHash; //StateHasher hash of the source image file
+};
+
+static_assert(sizeof(CookedImageHeader) == 48, "CookedImageHeader is written to disk as it is, its size can't change");
+
+struct CookedManifestEntry
+{
+	std::string sourceName; //as GetAssetPackName() names it
+	std::string cookedName; //relative to the cooked directory
+	uint64_t inputHash = 0;
+};
+
+//Pixels are ARGB8888 words. Premultiplying rounds to the nearest value, unpremultiplying can't give back what an
+//alpha near 0 lost, so it's only for renderers that can't blend premultiplied alpha
+void PremultiplyAlpha(uint32_t* pixels, size_t numPixels);
+void UnpremultiplyAlpha(uint32_t* pixels, size_t numPixels);
+
+//Pixels are premultiplied ARGB8888, width * height of them. They're LZ4 compressed when isCompressible is set and that
+//makes them noticeably smaller
+bool WriteCookedImage(const std::string& filePath, int width, int height, const uint32_t* pixels, bool isCompressible, uint64_t sourceHash);
+//Checks the header against the size of the file it starts. filePath is only for the errors
+bool ReadCookedImageHeader(const uint8_t* data, size_t size, const std::string& filePath, CookedImageHeader& header);
+//Decompresses (or copies) the pixels of a cooked image that passed ReadCookedImageHeader() into width * height words.
+//Returns false if they're corrupt
+bool ReadCookedImagePixels(const uint8_t* data, const CookedImageHeader& header, uint32_t* pixels);
+
+//Returns false, with a message, at the first line that isn't an entry. Comment lines start with #
+bool ParseCookedManifest(const std::string& text, std::vector<CookedManifestEntry>& entries, std::string& error);
+bool WriteCookedManifest(const std::string& filePath, const std::vector<CookedManifestEntry>& entries);
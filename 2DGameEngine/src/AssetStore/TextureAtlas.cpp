@@ -0,0 +1,194 @@
+#include "TextureAtlas.h"
+#include "../Logger/Logger.h"
+#include "../Determinism/StateHasher.h"
+#include "../Serialization/BinaryArchive.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+//imgui compiles its own copy of the packer with static functions, so this one is private to this file as well
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imgui/imstb_rectpack.h>
+
+const uint32_t ATLAS_LAYOUT_MAGIC = 0x53414c54; //"TLAS"
+const uint32_t ATLAS_LAYOUT_VERSION = 1;
+
+uint64_t GetAtlasFileStamp(const std::string& filePath)
+{
+	std::error_code error;
+	const uintmax_t size = std::filesystem::file_size(filePath, error);
+	if (error)
+	{
+		return 0;
+	}
+	const auto writeTime = std::filesystem::last_write_time(filePath, error);
+	if (error)
+	{
+		return 0;
+	}
+	StateHasher hasher;
+	hasher(static_cast<uint64_t>(size), static_cast<int64_t>(writeTime.time_since_epoch().count()));
+	return hasher.GetHash();
+}
+
+uint64_t GetAtlasSignature(const std::vector<AtlasImage>& images, int maxPageSize)
+{
+	StateHasher hasher;
+	hasher(ATLAS_LAYOUT_VERSION, maxPageSize, ATLAS_PADDING, images.size());
+	for (const auto& image : images)
+	{
+		hasher(image.filePath, image.width, image.height, image.fileStamp);
+	}
+	return hasher.GetHash();
+}
+
+void PackAtlas(const std::vector<AtlasImage>& images, int maxPageSize, AtlasLayout& layout)
+{
+	layout.pages.clear();
+	layout.placements.assign(images.size(), AtlasPlacement());
+
+	std::vector<stbrp_rect> remaining;
+	remaining.reserve(images.size());
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		stbrp_rect rect = {};
+		rect.id = static_cast<int>(i);
+		rect.w = images[i].width + 2 * ATLAS_PADDING;
+		rect.h = images[i].height + 2 * ATLAS_PADDING;
+		remaining.push_back(rect);
+	}
+
+	std::vector<stbrp_node> nodes(static_cast<size_t>(maxPageSize));
+	std::vector<stbrp_rect> unpacked;
+	while (!remaining.empty())
+	{
+		//one page per pass, whatever doesn't fit goes on to the next one
+		stbrp_context context;
+		stbrp_init_target(&context, maxPageSize, maxPageSize, nodes.data(), static_cast<int>(nodes.size()));
+		stbrp_pack_rects(&context, remaining.data(), static_cast<int>(remaining.size()));
+
+		const int page = static_cast<int>(layout.pages.size());
+		AtlasPage pageSize;
+		unpacked.clear();
+		for (const auto& rect : remaining)
+		{
+			if (!rect.was_packed)
+			{
+				unpacked.push_back(rect);
+				continue;
+			}
+			layout.placements[rect.id] = { page, rect.x + ATLAS_PADDING, rect.y + ATLAS_PADDING };
+			//the page is only as big as what's on it
+			pageSize.width = std::max(pageSize.width, static_cast<int>(rect.x + rect.w));
+			pageSize.height = std::max(pageSize.height, static_cast<int>(rect.y + rect.h));
+		}
+
+		if (unpacked.size() == remaining.size())
+		{
+			//nothing fit, so the first image is bigger than a page. It gets a page to itself rather than being lost
+			const stbrp_rect& rect = unpacked.front();
+			layout.placements[rect.id] = { page, ATLAS_PADDING, ATLAS_PADDING };
+			pageSize = { static_cast<int>(rect.w), static_cast<int>(rect.h) };
+			unpacked.erase(unpacked.begin());
+		}
+		layout.pages.push_back(pageSize);
+		remaining.swap(unpacked);
+	}
+}
+
+bool LoadAtlasLayout(const std::string& filePath, uint64_t signature, const std::vector<AtlasImage>& images, AtlasLayout& layout)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	const std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	BinaryReader reader(buffer.data(), buffer.size());
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint64_t savedSignature = 0;
+	reader(magic, version, savedSignature);
+	if (magic != ATLAS_LAYOUT_MAGIC || version != ATLAS_LAYOUT_VERSION || savedSignature != signature)
+	{
+		return false;
+	}
+
+	const uint64_t numPages = reader.ReadVarUInt();
+	const uint64_t numPlacements = reader.ReadVarUInt();
+	if (reader.HasFailed() || numPlacements != images.size() || numPages > images.size())
+	{
+		return false;
+	}
+	layout.pages.resize(static_cast<size_t>(numPages));
+	for (auto& page : layout.pages)
+	{
+		page.width = static_cast<int>(reader.ReadVarInt());
+		page.height = static_cast<int>(reader.ReadVarInt());
+	}
+	layout.placements.resize(static_cast<size_t>(numPlacements));
+	for (size_t i = 0; i < layout.placements.size(); i++)
+	{
+		AtlasPlacement& placement = layout.placements[i];
+		placement.page = static_cast<int>(reader.ReadVarInt());
+		placement.x = static_cast<int>(reader.ReadVarInt());
+		placement.y = static_cast<int>(reader.ReadVarInt());
+		if (placement.page < 0 || placement.page >= static_cast<int>(numPages))
+		{
+			return false;
+		}
+		//the image and the padding around it have to be on the page, or building it would write past the page's pixels
+		const AtlasPage& page = layout.pages[placement.page];
+		const int64_t right = static_cast<int64_t>(placement.x) + images[i].width + ATLAS_PADDING;
+		const int64_t bottom = static_cast<int64_t>(placement.y) + images[i].height + ATLAS_PADDING;
+		if (placement.x < ATLAS_PADDING || placement.y < ATLAS_PADDING || right > page.width || bottom > page.height)
+		{
+			LOG(WARNING, ASSETS, "Atlas layout {} puts {} outside its page, packing again", filePath, images[i].filePath);
+			return false;
+		}
+	}
+	return !reader.HasFailed() && reader.IsAtEnd();
+}
+
+bool SaveAtlasLayout(const std::string& filePath, uint64_t signature, const AtlasLayout& layout)
+{
+	std::vector<uint8_t> buffer;
+	BinaryWriter writer(buffer);
+	writer(ATLAS_LAYOUT_MAGIC, ATLAS_LAYOUT_VERSION, signature);
+	writer.WriteVarUInt(layout.pages.size());
+	writer.WriteVarUInt(layout.placements.size());
+	for (const auto& page : layout.pages)
+	{
+		writer.WriteVarInt(page.width);
+		writer.WriteVarInt(page.height);
+	}
+	for (const auto& placement : layout.placements)
+	{
+		writer.WriteVarInt(placement.page);
+		writer.WriteVarInt(placement.x);
+		writer.WriteVarInt(placement.y);
+	}
+
+	std::error_code error;
+	const std::filesystem::path directory = std::filesystem::path(filePath).parent_path();
+	if (!directory.empty())
+	{
+		std::filesystem::create_directories(directory, error);
+	}
+	std::ofstream file(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG(ERROR, ASSETS, "Could not open {} for writing", filePath);
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+	if (!file)
+	{
+		LOG(ERROR, ASSETS, "Failed writing atlas layout {}", filePath);
+		return false;
+	}
+	return true;
+}
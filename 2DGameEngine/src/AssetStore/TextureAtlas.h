@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+// Texture atlas layout
+////////////////////////////////////////////////////////////////////////
+// Where every image of a level goes when they're packed together into a
+// few big pages, so the sprites of a level share textures and draw in
+// long batches. Packing is done with the rect packer that comes with
+// imgui (imstb_rectpack.h).
+// Every image gets ATLAS_PADDING pixels around it that repeat its edge
+// pixels, so filtering at the border of a sprite never picks up its
+// neighbour on the page.
+// The layout only depends on the images (their paths, sizes and when the
+// files were last written), so it's saved next to the game and the next
+// startup with the same images loads it instead of packing again.
+// This part knows nothing about SDL, the asset store builds the pages.
+////////////////////////////////////////////////////////////////////////
+
+const int ATLAS_MAX_PAGE_SIZE = 2048;
+const int ATLAS_PADDING = 2;
+
+struct AtlasImage
+{
+	std::string filePath;
+	int width = 0;
+	int height = 0;
+	uint64_t fileStamp = 0; //size and last write time of the file, a changed file gives a different layout signature
+};
+
+struct AtlasPlacement
+{
+	int page = 0;
+	int x = 0; //first pixel of the image itself, the padding is around it
+	int y = 0;
+};
+
+struct AtlasPage
+{
+	int width = 0;
+	int height = 0;
+};
+
+struct AtlasLayout
+{
+	std::vector<AtlasPage> pages;
+	std::vector<AtlasPlacement> placements; //one per image, in the order the images were given
+};
+
+//Size and last write time of a file, 0 if it doesn't exist
+uint64_t GetAtlasFileStamp(const std::string& filePath);
+
+//Changes whenever an image, its order or the packing settings change
+uint64_t GetAtlasSignature(const std::vector<AtlasImage>& images, int maxPageSize);
+
+//Packs the images into as few pages of at most maxPageSize as it can. An image too big for a page gets a page of its own
+void PackAtlas(const std::vector<AtlasImage>& images, int maxPageSize, AtlasLayout& layout);
+
+//A cached layout is only used if it was saved for the same signature and images, and every image fits on its page
+//with its padding. Otherwise it returns false and the images have to be packed again
+bool LoadAtlasLayout(const std::string& filePath, uint64_t signature, const std::vector<AtlasImage>& images, AtlasLayout& layout);
+bool SaveAtlasLayout(const std::string& filePath, uint64_t signature, const AtlasLayout& layout);
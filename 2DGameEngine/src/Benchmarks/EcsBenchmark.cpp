@@ -0,0 +1,353 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include "../ECS/ECS.h"
+#include "../Components/TransformComponent.h"
+#include "../Components/RigidBodyComponent.h"
+#include "../Systems/MovementSystem.h"
+#include "../Memory/MemoryTracker.h"
+
+////////////////////////////////////////////////////////////////////////
+// ECS micro-benchmarks
+////////////////////////////////////////////////////////////////////////
+// Times the core Registry operations at different entity counts and
+// reports ns per operation and heap bytes allocated per operation.
+// Any change to the storage or scheduling in src/ECS should be compared
+// against the numbers from this before it goes in:
+//
+//		2DGameEngineBenchmarks --json before.json
+//		(make the change, rebuild)
+//		2DGameEngineBenchmarks --json after.json
+//
+//	--sizes <a,b,c>   entity counts to run at (default 1000,100000,1000000)
+//	--repeat <n>      runs per measurement, the fastest is kept (default 3)
+//	--filter <text>   only run benchmarks whose name contains the text
+//	--json <file>     also write the results as JSON
+//	--log             keep registry logging on, with ECS debug messages (off by default, it would dominate every number)
+////////////////////////////////////////////////////////////////////////
+
+
+struct BenchmarkResult
+{
+	std::string name;
+	int numEntities;
+	double nanosecondsPerOp;
+	double bytesPerOp;
+	double allocationsPerOp;
+};
+
+//What a benchmark body gets: a registry already set up by the prepare step,
+//and the number of entities to work on
+struct BenchmarkContext
+{
+	std::unique_ptr<Registry> registry;
+	std::vector<Entity> entities;
+	double checksum = 0.0; //results get added in here so the optimiser can't throw the work away
+};
+
+struct Benchmark
+{
+	const char* name;
+	std::function<void(BenchmarkContext&, int)> prepare; //not timed
+	std::function<void(BenchmarkContext&, int)> run; //timed, must do numEntities operations
+};
+
+static std::unique_ptr<Registry> MakeRegistry()
+{
+	auto registry = std::make_unique<Registry>();
+	registry->RegisterComponent<TransformComponent>();
+	registry->RegisterComponent<RigidBodyComponent>();
+	registry->AddSystem<MovementSystem>();
+	return registry;
+}
+
+static void CreateEntities(BenchmarkContext& context, int numEntities)
+{
+	context.entities.clear();
+	context.entities.reserve(numEntities);
+	for (int i = 0; i < numEntities; i++)
+	{
+		context.entities.push_back(context.registry->CreateEntity());
+	}
+}
+
+static void CreateMovers(BenchmarkContext& context, int numEntities)
+{
+	CreateEntities(context, numEntities);
+	for (auto& entity : context.entities)
+	{
+		entity.AddComponent<TransformComponent>(glm::vec2(0.0, 0.0), glm::vec2(1.0, 1.0), 0.0);
+		entity.AddComponent<RigidBodyComponent>(glm::vec2(10.0, 5.0));
+	}
+}
+
+static std::vector<Benchmark> MakeBenchmarks()
+{
+	std::vector<Benchmark> benchmarks;
+
+	benchmarks.push_back
+	({
+		"CreateEntity",
+		[](BenchmarkContext& context, int) { context.registry = MakeRegistry(); },
+		[](BenchmarkContext& context, int numEntities)
+		{
+			for (int i = 0; i < numEntities; i++)
+			{
+				context.checksum += context.registry->CreateEntity().GetId();
+			}
+		}
+	});
+
+	benchmarks.push_back
+	({
+		"AddComponent",
+		[](BenchmarkContext& context, int numEntities)
+		{
+			context.registry = MakeRegistry();
+			CreateEntities(context, numEntities);
+		},
+		[](BenchmarkContext& context, int)
+		{
+			for (auto& entity : context.entities)
+			{
+				context.registry->AddComponent<TransformComponent>(entity, glm::vec2(1.0, 2.0), glm::vec2(1.0, 1.0), 0.0);
+			}
+		}
+	});
+
+	benchmarks.push_back
+	({
+		"GetComponent",
+		[](BenchmarkContext& context, int numEntities)
+		{
+			context.registry = MakeRegistry();
+			CreateMovers(context, numEntities);
+		},
+		[](BenchmarkContext& context, int)
+		{
+			for (auto& entity : context.entities)
+			{
+				context.checksum += context.registry->ReadComponent<TransformComponent>(entity).position.x;
+			}
+		}
+	});
+
+	benchmarks.push_back
+	({
+		"RemoveComponent",
+		[](BenchmarkContext& context, int numEntities)
+		{
+			context.registry = MakeRegistry();
+			CreateMovers(context, numEntities);
+		},
+		[](BenchmarkContext& context, int)
+		{
+			for (auto& entity : context.entities)
+			{
+				context.registry->RemoveComponent<RigidBodyComponent>(entity);
+			}
+		}
+	});
+
+	benchmarks.push_back
+	({
+		"RegistryUpdateFlush",
+		[](BenchmarkContext& context, int numEntities)
+		{
+			context.registry = MakeRegistry();
+			CreateMovers(context, numEntities);
+		},
+		[](BenchmarkContext& context, int)
+		{
+			//adds every pending entity to the systems
+			context.registry->Update();
+		}
+	});
+
+	benchmarks.push_back
+	({
+		"SystemIteration",
+		[](BenchmarkContext& context, int numEntities)
+		{
+			context.registry = MakeRegistry();
+			CreateMovers(context, numEntities);
+			context.registry->Update();
+		},
+		[](BenchmarkContext& context, int)
+		{
+			context.registry->GetSystem<MovementSystem>().Update(1.0 / 60.0);
+		}
+	});
+
+	benchmarks.push_back
+	({
+		"KillEntity",
+		[](BenchmarkContext& context, int numEntities)
+		{
+			context.registry = MakeRegistry();
+			CreateMovers(context, numEntities);
+			context.registry->Update();
+		},
+		[](BenchmarkContext& context, int)
+		{
+			//flag every entity, then the registry update actually removes them
+			for (auto& entity : context.entities)
+			{
+				context.registry->KillEntity(entity);
+			}
+			context.registry->Update();
+		}
+	});
+
+	return benchmarks;
+}
+
+static BenchmarkResult RunBenchmark(const Benchmark& benchmark, int numEntities, int repetitions, double& checksum)
+{
+	BenchmarkResult result = { benchmark.name, numEntities, 0.0, 0.0, 0.0 };
+	double bestNanoseconds = -1.0;
+
+	for (int repetition = 0; repetition < repetitions; repetition++)
+	{
+		BenchmarkContext context;
+		benchmark.prepare(context, numEntities);
+
+		//MemoryTracker counts every heap allocation, so we can see what the registry allocates while it's timed
+		const uint64_t bytesBefore = MemoryTracker::GetTotalAllocatedBytes();
+		const uint64_t allocationsBefore = MemoryTracker::GetTotalAllocations();
+		const auto start = std::chrono::steady_clock::now();
+
+		benchmark.run(context, numEntities);
+
+		const auto end = std::chrono::steady_clock::now();
+		const double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+
+		//keep the fastest run, the others were disturbed by something else
+		if (bestNanoseconds < 0.0 || nanoseconds < bestNanoseconds)
+		{
+			bestNanoseconds = nanoseconds;
+			result.bytesPerOp = static_cast<double>(MemoryTracker::GetTotalAllocatedBytes() - bytesBefore) / numEntities;
+			result.allocationsPerOp = static_cast<double>(MemoryTracker::GetTotalAllocations() - allocationsBefore) / numEntities;
+		}
+		checksum += context.checksum;
+	}
+
+	result.nanosecondsPerOp = bestNanoseconds / numEntities;
+	return result;
+}
+
+static void WriteJson(const std::string& filePath, const std::vector<BenchmarkResult>& results)
+{
+	std::ofstream file(filePath);
+	if (!file.is_open())
+	{
+		std::fprintf(stderr, "Could not write %s\n", filePath.c_str());
+		return;
+	}
+
+#if defined(NDEBUG)
+	const char* configuration = "Release";
+#else
+	const char* configuration = "Debug";
+#endif
+
+	file << "{\n  \"configuration\": \"" << configuration << "\",\n  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const auto& result = results[i];
+		char line[256];
+		std::snprintf(line, sizeof(line),
+			"    { \"name\": \"%s\", \"entities\": %d, \"ns_per_op\": %.3f, \"bytes_per_op\": %.3f, \"allocations_per_op\": %.4f }%s\n",
+			result.name.c_str(), result.numEntities, result.nanosecondsPerOp, result.bytesPerOp, result.allocationsPerOp,
+			(i + 1 < results.size()) ? "," : "");
+		file << line;
+	}
+	file << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<int> sizes = { 1000, 100000, 1000000 };
+	int repetitions = 3;
+	std::string filter;
+	std::string jsonPath;
+	bool keepLogging = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc)
+		{
+			sizes.clear();
+			for (const char* token = argv[++i]; *token; )
+			{
+				sizes.push_back(std::atoi(token));
+				const char* comma = std::strchr(token, ',');
+				token = comma ? comma + 1 : token + std::strlen(token);
+			}
+		}
+		else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+		{
+			repetitions = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+		{
+			jsonPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--log") == 0)
+		{
+			keepLogging = true;
+		}
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--sizes 1000,100000] [--repeat n] [--filter name] [--json file] [--log]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Logger::SetEnabled(keepLogging);
+	if (keepLogging)
+	{
+		Logger::SetCategoryLevel(LOG_CATEGORY_ECS, LOG_DEBUG);
+	}
+
+	std::vector<BenchmarkResult> results;
+	double checksum = 0.0;
+
+	std::printf("%-22s %10s %14s %14s %14s\n", "benchmark", "entities", "ns/op", "bytes/op", "allocs/op");
+	for (const auto& benchmark : MakeBenchmarks())
+	{
+		if (!filter.empty() && std::string(benchmark.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+		for (const int numEntities : sizes)
+		{
+			if (numEntities <= 0)
+			{
+				continue;
+			}
+			const BenchmarkResult result = RunBenchmark(benchmark, numEntities, repetitions, checksum);
+			std::printf("%-22s %10d %14.2f %14.2f %14.4f\n", result.name.c_str(), result.numEntities, result.nanosecondsPerOp, result.bytesPerOp, result.allocationsPerOp);
+			std::fflush(stdout);
+			results.push_back(result);
+		}
+	}
+
+	if (!jsonPath.empty())
+	{
+		WriteJson(jsonPath, results);
+	}
+
+	//printing the checksum means none of the timed work can be optimised out
+	std::printf("checksum %g\n", checksum);
+	return 0;
+}
@@ -13,7 +13,7 @@ struct AnimationComponent
 
 
 
-	AnimationComponent(int numFrame = 1, int frameSpeedRate = 1, bool isLoop = true)
+	AnimationComponent(int numFrames = 1, int frameSpeedRate = 1, bool isLoop = true)
 	{
 		this->numFrames = numFrames;
 		this->currentFrame = 1;
@@ -22,6 +22,10 @@ struct AnimationComponent
 		this->startTime = SDL_GetTicks();
 	}
 
-
-
+	//startTime comes from the wall clock, so it's left out of the simulation state on purpose
+	template <typename TArchive>
+	void Serialize(TArchive& archive)
+	{
+		archive(numFrames, currentFrame, frameSpeedRate, isLoop);
+	}
 };
\ No newline at end of file
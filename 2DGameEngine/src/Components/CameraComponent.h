@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <SDL.h>
+
+struct CameraComponent
+{
+	glm::vec2 position; //world position shown at the top left of the viewport
+	float zoom; //screen pixels per world pixel
+	SDL_Rect viewport; //where on screen the camera draws. Presentation only, set every frame before drawing and not part of the state hash
+
+	CameraComponent(glm::vec2 position = glm::vec2(0, 0), float zoom = 1.0f, SDL_Rect viewport = { 0, 0, 0, 0 })
+	{
+		this->position = position;
+		this->zoom = zoom;
+		this->viewport = viewport;
+	}
+
+	//The part of the world the camera can see
+	SDL_FRect GetWorldRect() const
+	{
+		return { position.x, position.y, viewport.w / zoom, viewport.h / zoom };
+	}
+
+	//The viewport depends on the window (none at all when headless), so it's left out and a snapshot or hash of the
+	//camera is the same on every machine
+	template <typename TArchive>
+	void Serialize(TArchive& archive)
+	{
+		archive(position.x, position.y, zoom);
+	}
+};
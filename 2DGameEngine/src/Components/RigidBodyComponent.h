@@ -11,4 +11,10 @@ struct RigidBodyComponent
 	{
 		this->velocity = velocity;
 	}
+
+	template <typename TArchive>
+	void Serialize(TArchive& archive)
+	{
+		archive(velocity.x, velocity.y);
+	}
 };
\ No newline at end of file
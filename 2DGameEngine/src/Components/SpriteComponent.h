@@ -1,24 +1,34 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include <string>
+#include <type_traits>
 #include <SDL.h>
+#include "../AssetStore/AssetHandle.h"
 
 struct SpriteComponent
 {
-	std::string assetId;
+	AssetHandle assetHandle; //from AssetIds::Intern() when the level loads, never a string lookup per frame
 	int width;
 	int height;
 	int zIndex;
 	SDL_Rect srcRect;
 
 	//Always have a default. This will prevent fatal build errors
-	SpriteComponent(std::string assetId = "", int width = 0, int height = 0, int zIndex = 0, int srcRectX = 0, int srcRectY = 0)
+	SpriteComponent(AssetHandle assetHandle = ASSET_HANDLE_PLACEHOLDER, int width = 0, int height = 0, int zIndex = 0, int srcRectX = 0, int srcRectY = 0)
 	{
-		this->assetId = assetId;
+		this->assetHandle = assetHandle;
 		this->width = width;
 		this->height = height;
 		this->zIndex = zIndex;
 		this->srcRect = { srcRectX, srcRectY, width, height };
 	}
-};
\ No newline at end of file
+
+	template <typename TArchive>
+	void Serialize(TArchive& archive)
+	{
+		archive(assetHandle, width, height, zIndex, srcRect.x, srcRect.y, srcRect.w, srcRect.h);
+	}
+};
+
+//no strings or pointers to own, so copying a sprite is just copying its bytes
+static_assert(std::is_trivially_copyable_v<SpriteComponent>, "SpriteComponent must stay trivially copyable");
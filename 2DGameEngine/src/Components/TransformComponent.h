@@ -21,5 +21,12 @@ struct TransformComponent
 		this->rotation = rotation;
 	}
 	//struct now has data (stuff at top) and a way of initialising a transform component usin a constructor method, the TransformComponent()
+
+	//lists the data that makes up the simulation state (used for hashing and saving)
+	template <typename TArchive>
+	void Serialize(TArchive& archive)
+	{
+		archive(position.x, position.y, scale.x, scale.y, rotation);
+	}
 };
 
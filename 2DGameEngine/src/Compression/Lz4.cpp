@@ -0,0 +1,217 @@
+#include "Lz4.h"
+#include <cstring>
+#include <limits>
+#include <vector>
+
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5; //the last bytes of a block are always literals
+const size_t LZ4_MATCH_FIND_LIMIT = 12; //and no match starts this close to the end
+const size_t LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_BITS = 16;
+
+static uint32_t Read32(const uint8_t* bytes)
+{
+	uint32_t value;
+	std::memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static uint32_t Hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+size_t Lz4CompressBound(size_t sourceSize)
+{
+	return sourceSize + sourceSize / 255 + 16;
+}
+
+//A length that doesn't fit in its 4 bits of the token goes on in bytes of 255, ended by one that's smaller
+static bool WriteLength(size_t length, uint8_t* destination, size_t capacity, size_t& position)
+{
+	for (; length >= 255; length -= 255)
+	{
+		if (position >= capacity)
+		{
+			return false;
+		}
+		destination[position++] = 255;
+	}
+	if (position >= capacity)
+	{
+		return false;
+	}
+	destination[position++] = static_cast<uint8_t>(length);
+	return true;
+}
+
+//One sequence: the literals from the anchor, then a match (skipped for the last sequence, matchLength 0)
+static bool WriteSequence(const uint8_t* literals, size_t numLiterals, size_t offset, size_t matchLength, uint8_t* destination, size_t capacity, size_t& position)
+{
+	if (position >= capacity)
+	{
+		return false;
+	}
+	const size_t tokenPosition = position++;
+	const size_t matchCode = matchLength > 0 ? matchLength - LZ4_MIN_MATCH : 0;
+	destination[tokenPosition] = static_cast<uint8_t>(((numLiterals < 15 ? numLiterals : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+	if (numLiterals >= 15 && !WriteLength(numLiterals - 15, destination, capacity, position))
+	{
+		return false;
+	}
+	if (numLiterals > capacity - position)
+	{
+		return false;
+	}
+	if (numLiterals > 0)
+	{
+		std::memcpy(destination + position, literals, numLiterals);
+		position += numLiterals;
+	}
+	if (matchLength == 0)
+	{
+		return true;
+	}
+
+	if (capacity - position < 2)
+	{
+		return false;
+	}
+	destination[position++] = static_cast<uint8_t>(offset);
+	destination[position++] = static_cast<uint8_t>(offset >> 8);
+	return matchCode < 15 || WriteLength(matchCode - 15, destination, capacity, position);
+}
+
+size_t Lz4Compress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationCapacity)
+{
+	if (sourceSize > std::numeric_limits<uint32_t>::max())
+	{
+		return 0;
+	}
+	size_t position = 0;
+	size_t anchor = 0; //start of the literals not written yet
+	if (sourceSize > LZ4_MATCH_FIND_LIMIT)
+	{
+		std::vector<uint32_t> lastSeen(static_cast<size_t>(1) << LZ4_HASH_BITS, 0);
+		const size_t matchEnd = sourceSize - LZ4_LAST_LITERALS;
+		size_t current = 0;
+		while (current + LZ4_MATCH_FIND_LIMIT <= sourceSize)
+		{
+			const uint32_t sequence = Read32(source + current);
+			const uint32_t hash = Hash(sequence);
+			const size_t candidate = lastSeen[hash];
+			lastSeen[hash] = static_cast<uint32_t>(current);
+			if (candidate >= current || current - candidate > LZ4_MAX_OFFSET || Read32(source + candidate) != sequence)
+			{
+				//skips ahead faster the longer nothing has matched, so data that doesn't compress goes by quickly
+				current += 1 + ((current - anchor) >> 6);
+				continue;
+			}
+
+			size_t matchStart = current;
+			size_t matchFrom = candidate;
+			while (matchStart > anchor && matchFrom > 0 && source[matchStart - 1] == source[matchFrom - 1])
+			{
+				matchStart--;
+				matchFrom--;
+			}
+			size_t matchLength = current - matchStart + LZ4_MIN_MATCH;
+			while (matchStart + matchLength < matchEnd && source[matchFrom + matchLength] == source[matchStart + matchLength])
+			{
+				matchLength++;
+			}
+			if (!WriteSequence(source + anchor, matchStart - anchor, matchStart - matchFrom, matchLength, destination, destinationCapacity, position))
+			{
+				return 0;
+			}
+			current = matchStart + matchLength;
+			anchor = current;
+			if (current + LZ4_MATCH_FIND_LIMIT <= sourceSize)
+			{
+				//what was just matched over can be matched again
+				lastSeen[Hash(Read32(source + current - 2))] = static_cast<uint32_t>(current - 2);
+			}
+		}
+	}
+	if (!WriteSequence(source + anchor, sourceSize - anchor, 0, 0, destination, destinationCapacity, position))
+	{
+		return 0;
+	}
+	return position;
+}
+
+static bool ReadLength(const uint8_t* source, size_t sourceSize, size_t& position, size_t& length)
+{
+	uint8_t byte;
+	do
+	{
+		if (position >= sourceSize)
+		{
+			return false;
+		}
+		byte = source[position++];
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+bool Lz4Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize)
+{
+	size_t in = 0;
+	size_t out = 0;
+	while (in < sourceSize)
+	{
+		const uint8_t token = source[in++];
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !ReadLength(source, sourceSize, in, numLiterals))
+		{
+			return false;
+		}
+		if (numLiterals > sourceSize - in || numLiterals > destinationSize - out)
+		{
+			return false;
+		}
+		if (numLiterals > 0)
+		{
+			std::memcpy(destination + out, source + in, numLiterals);
+			in += numLiterals;
+			out += numLiterals;
+		}
+		if (in == sourceSize)
+		{
+			break; //the last sequence has no match
+		}
+
+		if (sourceSize - in < 2)
+		{
+			return false;
+		}
+		const size_t offset = source[in] | (static_cast<size_t>(source[in + 1]) << 8);
+		in += 2;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(source, sourceSize, in, matchLength))
+		{
+			return false;
+		}
+		matchLength += LZ4_MIN_MATCH;
+		if (offset == 0 || offset > out || matchLength > destinationSize - out)
+		{
+			return false;
+		}
+		const uint8_t* match = destination + out - offset;
+		if (offset >= matchLength)
+		{
+			std::memcpy(destination + out, match, matchLength);
+		}
+		else
+		{
+			//overlapping, the match repeats what it's writing (a run), so it has to go a byte at a time
+			for (size_t i = 0; i < matchLength; i++)
+			{
+				destination[out + i] = match[i];
+			}
+		}
+		out += matchLength;
+	}
+	return out == destinationSize;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////
+// LZ4
+////////////////////////////////////////////////////////////////////////
+// Compression in the LZ4 block format, for asset pack entries and
+// replay keyframes. It's written for decompression speed, not ratio:
+// decompressing is little more than memcpy, so a compressed entry
+// costs about what reading it did. Compression is a single greedy pass
+// with a hash table of the last place each 4 bytes were seen, fast
+// enough for the cooker and for a keyframe every few seconds.
+// The output is a plain LZ4 block (no frame header or checksum), so
+// the stored size and the original size have to be kept with it.
+// Blocks are limited to 4GB.
+////////////////////////////////////////////////////////////////////////
+
+//Most a block of sourceSize bytes can grow to when it doesn't compress
+size_t Lz4CompressBound(size_t sourceSize);
+
+//Returns the compressed size, or 0 if it didn't fit in destinationCapacity
+size_t Lz4Compress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationCapacity);
+
+//destinationSize is the original size. Returns false if the block is corrupt or doesn't decompress to exactly that
+//many bytes, it never reads or writes outside the two buffers
+bool Lz4Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize);
@@ -0,0 +1,181 @@
+#include "StateHashLog.h"
+#include "../Logger/Logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+bool StateHashLog::Open(const std::string& filePath)
+{
+	file.open(filePath, std::ios::out | std::ios::trunc);
+	namedPools.reset();
+	if (!file.is_open())
+	{
+		LOG(ERROR, GAME, "Could not open state hash log {}", filePath);
+		return false;
+	}
+	return true;
+}
+
+void StateHashLog::Close()
+{
+	if (file.is_open())
+	{
+		file.close();
+	}
+}
+
+bool StateHashLog::IsOpen() const
+{
+	return file.is_open();
+}
+
+uint64_t StateHashLog::Record(int tick, const Registry& registry)
+{
+	const int numPools = std::min(registry.GetNumComponentPools(), static_cast<int>(MAX_COMPONENTS));
+
+	//hash each pool on its own so a mismatch can be traced back to a component type
+	uint64_t poolHashes[MAX_COMPONENTS] = {};
+	StateHasher combined;
+	combined.Add(tick);
+
+	const uint64_t signaturesHash = registry.HashEntitySignatures();
+	const uint64_t randomHash = registry.HashSystemRandomState();
+	combined.Add(signaturesHash);
+	combined.Add(randomHash);
+
+	for (int componentId = 0; componentId < numPools; componentId++)
+	{
+		if (registry.HasComponentPool(componentId))
+		{
+			poolHashes[componentId] = registry.HashComponentPool(componentId);
+			combined.Add(componentId);
+			combined.Add(poolHashes[componentId]);
+		}
+	}
+
+	if (file.is_open())
+	{
+		char buffer[64];
+		for (int componentId = 0; componentId < numPools; componentId++)
+		{
+			if (registry.HasComponentPool(componentId) && !namedPools.test(componentId))
+			{
+				file << "# pool " << componentId << " " << registry.GetComponentPoolName(componentId) << "\n";
+				namedPools.set(componentId);
+			}
+		}
+
+		std::snprintf(buffer, sizeof(buffer), "%d %016llx s:%016llx r:%016llx", tick,
+			static_cast<unsigned long long>(combined.GetHash()),
+			static_cast<unsigned long long>(signaturesHash),
+			static_cast<unsigned long long>(randomHash));
+		file << buffer;
+		for (int componentId = 0; componentId < numPools; componentId++)
+		{
+			if (registry.HasComponentPool(componentId))
+			{
+				std::snprintf(buffer, sizeof(buffer), " %d:%016llx", componentId, static_cast<unsigned long long>(poolHashes[componentId]));
+				file << buffer;
+			}
+		}
+		file << "\n";
+	}
+
+	return combined.GetHash();
+}
+
+//Reads the next tick line, collecting any pool names on the way
+static bool ReadTickLine(std::ifstream& file, std::string& line, std::map<std::string, std::string>& poolNames)
+{
+	while (std::getline(file, line))
+	{
+		if (line.rfind("# pool ", 0) == 0)
+		{
+			std::istringstream stream(line.substr(7));
+			std::string id;
+			std::string name;
+			stream >> id;
+			std::getline(stream >> std::ws, name);
+			poolNames[id] = name;
+			continue;
+		}
+		if (!line.empty())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool StateHashLog::Compare(const std::string& filePathA, const std::string& filePathB)
+{
+	std::ifstream fileA(filePathA);
+	std::ifstream fileB(filePathB);
+	if (!fileA.is_open() || !fileB.is_open())
+	{
+		LOG(ERROR, GAME, "Could not open state hash logs to compare");
+		return false;
+	}
+
+	std::map<std::string, std::string> poolNames;
+	std::string lineA;
+	std::string lineB;
+	int ticksCompared = 0;
+
+	while (true)
+	{
+		const bool hasA = ReadTickLine(fileA, lineA, poolNames);
+		const bool hasB = ReadTickLine(fileB, lineB, poolNames);
+		if (!hasA || !hasB)
+		{
+			if (hasA != hasB)
+			{
+				LOG(ERROR, GAME, "State hash logs have a different number of ticks (matched for {} ticks)", ticksCompared);
+				return false;
+			}
+			break;
+		}
+
+		if (lineA != lineB)
+		{
+			//find the first field that differs, skipping the tick number and the combined hash
+			std::istringstream streamA(lineA);
+			std::istringstream streamB(lineB);
+			std::string tick;
+			std::string fieldA;
+			std::string fieldB;
+			streamA >> tick >> fieldA;
+			streamB >> fieldB >> fieldB;
+
+			std::string culprit = "unknown";
+			while (streamA >> fieldA && streamB >> fieldB)
+			{
+				if (fieldA != fieldB)
+				{
+					const std::string key = fieldA.substr(0, fieldA.find(':'));
+					if (key == "s")
+					{
+						culprit = "entity signatures (entities or components were added/removed differently)";
+					}
+					else if (key == "r")
+					{
+						culprit = "system random number generators";
+					}
+					else
+					{
+						culprit = "component " + key + " (" + poolNames[key] + ")";
+					}
+					break;
+				}
+			}
+
+			LOG(ERROR, GAME, "State diverged at tick {} in {}", tick, culprit);
+			return false;
+		}
+		ticksCompared++;
+	}
+
+	LOG(INFO, GAME, "State hash logs match for all {} ticks", ticksCompared);
+	return true;
+}
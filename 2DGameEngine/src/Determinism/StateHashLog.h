@@ -0,0 +1,36 @@
+#pragma once
+
+#include <bitset>
+#include <fstream>
+#include <string>
+#include "../ECS/ECS.h"
+
+////////////////////////////////////////////////////////////////////////
+// StateHashLog
+////////////////////////////////////////////////////////////////////////
+// Writes the state hash of every tick to a text file, one line per tick:
+//
+//		<tick> <combined hash> s:<signatures> r:<random> <componentId>:<pool hash> ...
+//
+// Lines starting with '#' name the component pools. Two logs from runs with
+// the same seed and input should be identical, and Compare() tells us the
+// first tick and component where they went different.
+////////////////////////////////////////////////////////////////////////
+class StateHashLog
+{
+private:
+	std::ofstream file;
+	std::bitset<MAX_COMPONENTS> namedPools; //pools whose name has already been written
+
+public:
+	bool Open(const std::string& filePath);
+	void Close();
+	bool IsOpen() const;
+
+	//Hashes all the component pools, entity signatures and system random
+	//generators. Writes a line to the log if it's open and returns the combined hash
+	uint64_t Record(int tick, const Registry& registry);
+
+	//Returns true if both logs match. Otherwise logs the first diverging tick and component
+	static bool Compare(const std::string& filePathA, const std::string& filePathB);
+};
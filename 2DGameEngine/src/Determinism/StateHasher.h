@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+////////////////////////////////////////////////////////////////////////
+// StateHasher
+////////////////////////////////////////////////////////////////////////
+// Fast 64 bit hash of simulation state. Components describe their data
+// once in a Serialize(archive) function, and the hasher is just one kind
+// of archive that can be passed to it:
+//
+//		template <typename TArchive>
+//		void Serialize(TArchive& archive)
+//		{
+//			archive(position.x, position.y);
+//		}
+//
+// Values are hashed field by field (never as raw struct bytes), so
+// padding or uninitialised bytes can't make two identical states differ.
+////////////////////////////////////////////////////////////////////////
+class StateHasher
+{
+private:
+	uint64_t hash;
+
+	static uint64_t Mix(uint64_t value)
+	{
+		//finaliser from splitmix64, cheap and spreads every input bit over the whole hash
+		value ^= value >> 30;
+		value *= 0xbf58476d1ce4e5b9ull;
+		value ^= value >> 27;
+		value *= 0x94d049bb133111ebull;
+		value ^= value >> 31;
+		return value;
+	}
+
+public:
+	StateHasher(uint64_t seed = 0x9e3779b97f4a7c15ull) : hash(seed) {}
+
+	void AddWord(uint64_t word)
+	{
+		hash = Mix(hash ^ (word + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2)));
+	}
+
+	void AddBytes(const void* bytes, size_t size)
+	{
+		const unsigned char* data = static_cast<const unsigned char*>(bytes);
+		while (size >= 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, data, 8);
+			AddWord(word);
+			data += 8;
+			size -= 8;
+		}
+		uint64_t tail = 0;
+		std::memcpy(&tail, data, size);
+		AddWord(tail ^ (static_cast<uint64_t>(size) << 56));
+	}
+
+	template <typename T>
+	void Add(const T& value)
+	{
+		static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "StateHasher can only hash plain values, give the type a Serialize function");
+		uint64_t word = 0;
+		std::memcpy(&word, &value, sizeof(T));
+		AddWord(word);
+	}
+
+	void Add(const std::string& value)
+	{
+		AddWord(value.size());
+		AddBytes(value.data(), value.size());
+	}
+
+	//archive interface used by Serialize(archive)
+	template <typename ...TValues>
+	void operator ()(const TValues& ...values)
+	{
+		(Add(values), ...);
+	}
+
+	uint64_t GetHash() const
+	{
+		return hash;
+	}
+};
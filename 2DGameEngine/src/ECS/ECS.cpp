@@ -1,18 +1,48 @@
 #include "ECS.h"
 #include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
 #include <algorithm>
+#include <cstring>
 
 int IComponent::nextId = 0; //need to define the static member variable that was declared in the header file 
 
 
+std::string GetReadableTypeName(const char* typeName)
+{
+	std::string name = typeName;
+	for (const char* prefix : { "class ", "struct " })
+	{
+		if (name.rfind(prefix, 0) == 0)
+		{
+			name.erase(0, std::strlen(prefix));
+		}
+	}
+
+	//GCC/Clang put the length of the name in front of it
+	size_t digits = 0;
+	while (digits < name.size() && name[digits] >= '0' && name[digits] <= '9')
+	{
+		digits++;
+	}
+	name.erase(0, digits);
+	return name;
+}
+
+
 int Entity::GetId() const
 {
 	return id;
 }
 
+void Entity::Kill()
+{
+	registry->KillEntity(*this);
+}
+
 void System::AddEntityToSystem(Entity entity)
 {
 	entities.push_back(entity);
+	OnEntityAdded(entity);
 }
 
 void System::RemoveEntityFromSystem(Entity entity)
@@ -38,7 +68,7 @@ void System::RemoveEntityFromSystem(Entity entity)
 			entities.begin(),
 			entities.end(),
 
-			[&entity](Entity other)
+			[this, &entity](Entity other)
 			{
 				//can use operator overloading here.
 				//this is where we can just use the values to compare without
@@ -50,7 +80,12 @@ void System::RemoveEntityFromSystem(Entity entity)
 				/* 1 - before operator overloading*/ 
 				//return entity.GetId() == other.GetId(); //lambda function, returns true or false
 				/* 2 - after operator overloading*/ 
-				return entity == other;
+				if (entity == other)
+				{
+					OnEntityRemoved(other);
+					return true;
+				}
+				return false;
 			}
 		),
 
@@ -58,22 +93,114 @@ void System::RemoveEntityFromSystem(Entity entity)
 	);
 }
 
-std::vector<Entity> System::GetSystemEntities() const
+void System::RemoveEntitiesFromSystem(const std::vector<bool>& isEntityRemoved)
+{
+	//same remove-erase idiom as above, but for a whole batch of entities at once.
+	//Removing them one at a time would scan the vector once per entity
+	entities.erase
+	(
+		std::remove_if
+		(
+			entities.begin(),
+			entities.end(),
+			[this, &isEntityRemoved](Entity other)
+			{
+				const auto id = static_cast<size_t>(other.GetId());
+				if (id < isEntityRemoved.size() && isEntityRemoved[id])
+				{
+					OnEntityRemoved(other);
+					return true;
+				}
+				return false;
+			}
+		),
+		entities.end()
+	);
+}
+
+void System::ClearEntities()
+{
+	entities.clear();
+	OnEntitiesCleared();
+}
+
+const EntityList& System::GetSystemEntities() const
 {
 	return entities;
 }
 
+size_t System::GetNumEntities() const
+{
+	return entities.size();
+}
+
+const std::string& System::GetName() const
+{
+	return name;
+}
+
+void System::SetName(const std::string& systemName)
+{
+	name = systemName;
+}
+
+double System::GetLastUpdateTime() const
+{
+	return lastUpdateMilliseconds;
+}
+
+void System::SetLastUpdateTime(double milliseconds)
+{
+	lastUpdateMilliseconds = milliseconds;
+}
+
+void System::AddHardwareCounters(const HardwareCounterValues& counters)
+{
+	hardwareCounterTotals += counters;
+	numCountedEntities += entities.size();
+}
+
+const HardwareCounterValues& System::GetHardwareCounterTotals() const
+{
+	return hardwareCounterTotals;
+}
+
+uint64_t System::GetNumCountedEntities() const
+{
+	return numCountedEntities;
+}
+
 const Signature& System::GetComponentSignature() const
 {
 	return componentSignature;
 }
 
+Random& System::GetRandom()
+{
+	return random;
+}
+
 
 Entity Registry::CreateEntity()
 {
 	int entityId;
 
-	entityId = numEntities++;
+	if (freeIds.empty())
+	{
+		//no free ids to reuse, so make a new one
+		entityId = numEntities++;
+	}
+	else
+	{
+		//reuse an id from a previously killed entity
+		entityId = freeIds.front();
+		freeIds.pop_front();
+	}
+	if (entityId >= static_cast<int>(isEntityAlive.size()))
+	{
+		isEntityAlive.resize(entityId + 1, false);
+	}
+	isEntityAlive[entityId] = true;
 
 	Entity entity(entityId);
 	entity.registry = this;
@@ -85,7 +212,7 @@ Entity Registry::CreateEntity()
 		entityComponentSignatures.resize(entityId + 1);
 	}
 	
-	Logger::Log("Entity created with ID = " + std::to_string(entityId));
+	LOG(DEBUG, ECS, "Entity created with ID = {}", entityId);
 	//Here we are trying to add an integer to a string.
 	//To fix issues, we need to set the integer to be a string
 	//as C++ doesn't like adding an int to a string
@@ -105,10 +232,10 @@ void Registry::AddEntityToSystems(Entity entity)
 	//Match entityComponentSignatures <--> systemComponentSignature
 	const auto entityComponentSignature = entityComponentSignatures[entityId];
 
-	//Loop all the systems
-	for (auto& system : systems)
+	//Loop all the systems, in the order they were added
+	for (auto& system : orderedSystems)
 	{
-		const auto& systemComponentSignature = system.second->GetComponentSignature();
+		const auto& systemComponentSignature = system->GetComponentSignature();
 
 		//true or false for if component signatures in system match component signatures that the entity carries
 		bool isInterested = (entityComponentSignature & systemComponentSignature) == systemComponentSignature; //bitwise & (AND) operator (comparison)
@@ -116,7 +243,7 @@ void Registry::AddEntityToSystems(Entity entity)
 		if (isInterested)
 		{
 			//Add entity to system
-			system.second->AddEntityToSystem(entity);
+			system->AddEntityToSystem(entity);
 		}
 	}
 
@@ -126,6 +253,8 @@ void Registry::AddEntityToSystems(Entity entity)
 
 void Registry::Update()
 {
+	PROFILE_SCOPE("Registry::Update");
+
 	//TODO: Add the entities that are waiting to be created	to the active Systems
 	
 	for (auto entity : entitiesToBeAdded)
@@ -138,8 +267,296 @@ void Registry::Update()
 	
 	
 	
-	//TODO: Remove the entities that are waiting to be killed from the active Systems
+	//Remove the entities that are waiting to be killed from the active Systems
+	if (!entitiesToBeKilled.empty())
+	{
+		isEntityKilled.assign(numEntities, false);
+		for (auto entity : entitiesToBeKilled)
+		{
+			const auto entityId = entity.GetId();
+			isEntityKilled[entityId] = true;
+
+			//the entity no longer has any components, and its id can be reused
+			Signature& signature = entityComponentSignatures[entityId];
+			for (size_t componentId = 0; componentId < MAX_COMPONENTS && signature.any(); componentId++)
+			{
+				if (signature.test(componentId))
+				{
+					numComponentsPerType[componentId]--;
+					signature.reset(componentId);
+					if (entityId < componentPools[componentId]->GetSize())
+					{
+						componentPools[componentId]->MarkDirty(entityId);
+					}
+				}
+			}
+			isEntityAlive[entityId] = false;
+			freeIds.push_back(entityId);
+		}
+
+		for (auto& system : orderedSystems)
+		{
+			system->RemoveEntitiesFromSystem(isEntityKilled);
+		}
+		entitiesToBeKilled.clear();
+	}
+}
+
+void Registry::KillEntity(Entity entity)
+{
+	//a stale handle to an entity that's already been killed would put its id in freeIds a second time
+	const int entityId = entity.GetId();
+	if (entityId < 0 || entityId >= static_cast<int>(isEntityAlive.size()) || !isEntityAlive[entityId])
+	{
+		LOG(DEBUG, ECS, "Entity id = {} is already dead, not killing it again", entityId);
+		return;
+	}
+	entitiesToBeKilled.insert(entity);
+}
+
+void Registry::KillAllEntities()
+{
+	for (int entityId = 0; entityId < static_cast<int>(isEntityAlive.size()); entityId++)
+	{
+		if (isEntityAlive[entityId])
+		{
+			Entity entity(entityId);
+			entity.registry = this;
+			entitiesToBeKilled.insert(entity);
+		}
+	}
+}
+
+int Registry::GetNumLiveEntities() const
+{
+	return numEntities - static_cast<int>(freeIds.size());
+}
 
 
+const std::vector<std::shared_ptr<System>>& Registry::GetSystems() const
+{
+	return orderedSystems;
+}
 
+void Registry::SetRandomSeed(uint64_t seed)
+{
+	randomSeed = seed;
+	for (size_t i = 0; i < orderedSystems.size(); i++)
+	{
+		orderedSystems[i]->GetRandom().Seed(randomSeed, i);
+	}
+}
+
+int Registry::GetNumComponentPools() const
+{
+	return static_cast<int>(componentPools.size());
+}
+
+bool Registry::HasComponentPool(int componentId) const
+{
+	return componentId >= 0 && componentId < static_cast<int>(componentPools.size()) && componentPools[componentId];
+}
+
+const char* Registry::GetComponentPoolName(int componentId) const
+{
+	return HasComponentPool(componentId) ? componentPools[componentId]->GetName() : "";
+}
+
+int Registry::GetNumComponents(int componentId) const
+{
+	return (componentId >= 0 && componentId < static_cast<int>(MAX_COMPONENTS)) ? numComponentsPerType[componentId] : 0;
+}
+
+int Registry::GetComponentPoolSize(int componentId) const
+{
+	return HasComponentPool(componentId) ? componentPools[componentId]->GetSize() : 0;
+}
+
+size_t Registry::GetComponentPoolMemoryUsage(int componentId) const
+{
+	return HasComponentPool(componentId) ? componentPools[componentId]->GetMemoryUsage() : 0;
+}
+
+uint64_t Registry::HashComponentPool(int componentId) const
+{
+	if (!HasComponentPool(componentId))
+	{
+		return 0;
+	}
+	return componentPools[componentId]->Hash(entityComponentSignatures, componentId);
+}
+
+uint64_t Registry::HashEntitySignatures() const
+{
+	StateHasher hasher;
+	hasher.Add(numEntities);
+	for (const auto& signature : entityComponentSignatures)
+	{
+		hasher.Add(signature.to_ullong());
+	}
+	return hasher.GetHash();
+}
+
+uint64_t Registry::HashSystemRandomState() const
+{
+	StateHasher hasher;
+	for (const auto& system : orderedSystems)
+	{
+		hasher.Add(system->GetRandom().GetState());
+	}
+	return hasher.GetHash();
+}
+
+void Registry::SaveState(BinaryWriter& writer) const
+{
+	//entities and which components they have
+	writer.WriteVarUInt(numEntities);
+	writer.WriteVarUInt(entityComponentSignatures.size());
+	for (const auto& signature : entityComponentSignatures)
+	{
+		writer.WriteVarUInt(signature.to_ullong());
+	}
+
+	writer.WriteVarUInt(entitiesToBeAdded.size());
+	for (const auto& entity : entitiesToBeAdded)
+	{
+		writer.WriteVarUInt(entity.GetId());
+	}
+
+	writer.WriteVarUInt(entitiesToBeKilled.size());
+	for (const auto& entity : entitiesToBeKilled)
+	{
+		writer.WriteVarUInt(entity.GetId());
+	}
+
+	//the order of the free ids decides which id the next entity gets
+	writer.WriteVarUInt(freeIds.size());
+	for (const auto id : freeIds)
+	{
+		writer.WriteVarUInt(id);
+	}
+
+	//component data, pool by pool
+	writer.WriteVarUInt(componentPools.size());
+	for (size_t componentId = 0; componentId < componentPools.size(); componentId++)
+	{
+		const bool hasPool = componentPools[componentId] != nullptr;
+		writer.Add(hasPool);
+		if (hasPool)
+		{
+			componentPools[componentId]->Save(writer, entityComponentSignatures, static_cast<int>(componentId));
+		}
+	}
+
+	//systems, in order: their random generators and their entities (the order
+	//entities are in decides the order they get updated, so it's saved as is)
+	writer.WriteVarUInt(orderedSystems.size());
+	for (const auto& system : orderedSystems)
+	{
+		writer.Add(system->GetRandom().GetState());
+		writer.Add(system->GetRandom().GetIncrement());
+
+		const auto& systemEntities = system->GetSystemEntities();
+		writer.WriteVarUInt(systemEntities.size());
+		for (const auto& entity : systemEntities)
+		{
+			writer.WriteVarUInt(entity.GetId());
+		}
+	}
+}
+
+bool Registry::LoadState(BinaryReader& reader)
+{
+	numEntities = static_cast<int>(reader.ReadVarUInt());
+	entityComponentSignatures.resize(reader.ReadVarUInt());
+	numComponentsPerType.fill(0);
+	for (auto& signature : entityComponentSignatures)
+	{
+		signature = Signature(reader.ReadVarUInt());
+		for (size_t componentId = 0; componentId < MAX_COMPONENTS; componentId++)
+		{
+			numComponentsPerType[componentId] += signature.test(componentId) ? 1 : 0;
+		}
+	}
+
+	entitiesToBeAdded.clear();
+	const uint64_t numToBeAdded = reader.ReadVarUInt();
+	for (uint64_t i = 0; i < numToBeAdded && !reader.HasFailed(); i++)
+	{
+		Entity entity(static_cast<int>(reader.ReadVarUInt()));
+		entity.registry = this;
+		entitiesToBeAdded.insert(entity);
+	}
+
+	entitiesToBeKilled.clear();
+	const uint64_t numToBeKilled = reader.ReadVarUInt();
+	for (uint64_t i = 0; i < numToBeKilled && !reader.HasFailed(); i++)
+	{
+		Entity entity(static_cast<int>(reader.ReadVarUInt()));
+		entity.registry = this;
+		entitiesToBeKilled.insert(entity);
+	}
+
+	freeIds.clear();
+	isEntityAlive.assign(static_cast<size_t>(std::max(numEntities, 0)), true);
+	const uint64_t numFreeIds = reader.ReadVarUInt();
+	for (uint64_t i = 0; i < numFreeIds && !reader.HasFailed(); i++)
+	{
+		const int entityId = static_cast<int>(reader.ReadVarUInt());
+		freeIds.push_back(entityId);
+		if (entityId >= 0 && entityId < numEntities)
+		{
+			isEntityAlive[entityId] = false;
+		}
+	}
+
+	const uint64_t numPools = reader.ReadVarUInt();
+	if (numPools > componentPools.size())
+	{
+		LOG(ERROR, ECS, "Snapshot has component types that aren't registered");
+		return false;
+	}
+	for (uint64_t componentId = 0; componentId < numPools; componentId++)
+	{
+		bool hasPool = false;
+		reader.Add(hasPool);
+		if (hasPool != (componentPools[componentId] != nullptr))
+		{
+			LOG(ERROR, ECS, "Snapshot component pools don't match the registered component types");
+			return false;
+		}
+		if (hasPool)
+		{
+			componentPools[componentId]->Load(reader, entityComponentSignatures, static_cast<int>(componentId));
+		}
+	}
+
+	if (reader.ReadVarUInt() != orderedSystems.size())
+	{
+		LOG(ERROR, ECS, "Snapshot systems don't match the systems in the registry");
+		return false;
+	}
+	for (auto& system : orderedSystems)
+	{
+		uint64_t state = 0;
+		uint64_t increment = 0;
+		reader(state, increment);
+		system->GetRandom().SetState(state, increment);
+
+		system->ClearEntities();
+		const uint64_t numSystemEntities = reader.ReadVarUInt();
+		for (uint64_t i = 0; i < numSystemEntities && !reader.HasFailed(); i++)
+		{
+			Entity entity(static_cast<int>(reader.ReadVarUInt()));
+			entity.registry = this;
+			system->AddEntityToSystem(entity);
+		}
+	}
+
+	if (reader.HasFailed())
+	{
+		LOG(ERROR, ECS, "Snapshot data is truncated");
+		return false;
+	}
+	return true;
 }
@@ -5,10 +5,21 @@
 #include <unordered_map>
 #include <typeindex>
 #include <set>
+#include <deque>
+#include <array>
 #include <memory>
+#include <algorithm>
+#include <string>
+#include <typeinfo>
 #include "../Logger/Logger.h"
+#include "../Random/Random.h"
+#include "../Determinism/StateHasher.h"
+#include "../Serialization/BinaryArchive.h"
+#include "../Profiler/HardwareCounters.h"
+#include "../Memory/MemoryTracker.h"
 
 const unsigned int MAX_COMPONENTS = 32;
+const int POOL_HASH_CHECK_INTERVAL = 60; //debug builds check a pool's cached hashes every this many Hash() calls
 
 ////////////////////////////////////////////////////////////////////////
 // Signature
@@ -18,6 +29,9 @@ const unsigned int MAX_COMPONENTS = 32;
 ////////////////////////////////////////////////////////////////////////
 typedef std::bitset<MAX_COMPONENTS> Signature;
 
+//turns a typeid name into just the class name ("class MovementSystem" on MSVC, "14MovementSystem" on GCC)
+std::string GetReadableTypeName(const char* typeName);
+
 
 struct IComponent //interface
 {
@@ -54,6 +68,7 @@ public:
 	Entity(int id) : id(id) {}; 
 	// "id(id) makes sure parametre id is passed and initialises the member variable id of the class
 	int GetId() const;
+	void Kill();
 
 	Entity(const Entity& entity) = default;
 	 
@@ -71,11 +86,15 @@ public:
 	template <typename TComponent> void RemoveComponent();
 	template <typename TComponent> bool HasComponent() const;
 	template <typename TComponent> TComponent& GetComponent() const;
+	template <typename TComponent> const TComponent& ReadComponent() const;
 
 	//Hold a pointer to the entity's owner registry
 	class Registry* registry; //see line 42 for description
 };
 
+//the list of entities a system works on, counted as ECS memory
+typedef std::vector<Entity, TrackingAllocator<Entity, MEMORY_TAG_ECS>> EntityList;
+
 
 ////////////////////////////////////////////////////////////////////////
 // System
@@ -87,16 +106,41 @@ class System
 {
 private:
 	Signature componentSignature;
-	std::vector<Entity> entities;
+	EntityList entities;
+	Random random; //seeded by the registry, use this instead of rand() so the simulation stays deterministic
+
+	std::string name; //type name of the system, set by the registry when it's added
+	double lastUpdateMilliseconds = 0.0; //how long the system's last Update() took
+	HardwareCounterValues hardwareCounterTotals; //summed over every update timed with hardware counters on
+	uint64_t numCountedEntities = 0; //entities processed over those updates, to get misses per entity
+
+protected:
+	//Called whenever the system's entity list changes, for systems that keep their own data per entity
+	virtual void OnEntityAdded(Entity /*entity*/) {}
+	virtual void OnEntityRemoved(Entity /*entity*/) {}
+	virtual void OnEntitiesCleared() {}
 
 public:
 	System() = default;
-	~System() = default;
+	virtual ~System() = default;
 
 	void AddEntityToSystem(Entity entity);
 	void RemoveEntityFromSystem(Entity entity);
-	std::vector<Entity> GetSystemEntities() const;
+	//removes every entity whose id is flagged in one pass, keeping the order of the rest
+	void RemoveEntitiesFromSystem(const std::vector<bool>& isEntityRemoved);
+	void ClearEntities();
+	const EntityList& GetSystemEntities() const; //only valid until the next registry Update()
+	size_t GetNumEntities() const;
 	const Signature& GetComponentSignature() const;
+	Random& GetRandom();
+
+	const std::string& GetName() const;
+	void SetName(const std::string& systemName);
+	double GetLastUpdateTime() const;
+	void SetLastUpdateTime(double milliseconds);
+	void AddHardwareCounters(const HardwareCounterValues& counters);
+	const HardwareCounterValues& GetHardwareCounterTotals() const;
+	uint64_t GetNumCountedEntities() const;
 
 	//Defines the component type that enities must have to be considered by the system
 	template <typename TComponent> void RequireComponent();
@@ -113,20 +157,75 @@ class IPool //this class is only abstract
 {
 public:
 	virtual ~IPool() {}
+
+	//hash of the components of every entity whose signature has componentId turned on. Only the
+	//slots marked dirty since the last call are hashed again, the rest are cached
+	virtual uint64_t Hash(const std::vector<Signature>& entitySignatures, int componentId) = 0;
+	//the slot's signature bit changed, so what it adds to the hash has to be worked out again
+	virtual void MarkDirty(int index) = 0;
+
+	//name of the component type, used when reporting which pool differs between two runs
+	virtual const char* GetName() const = 0;
+
+	//number of slots in the pool and the bytes they take up, for the performance overlay
+	virtual int GetSize() const = 0;
+	virtual size_t GetMemoryUsage() const = 0;
+
+	//save/load the components of every entity whose signature has componentId turned on
+	virtual void Save(BinaryWriter& writer, const std::vector<Signature>& entitySignatures, int componentId) = 0;
+	virtual void Load(BinaryReader& reader, const std::vector<Signature>& entitySignatures, int componentId) = 0;
 }; //forcing the destructor IPool to be virtual,
    //you're forcing the class to be only abstract
 
 
+// The pool's hash is the XOR of one hash per entity that has the
+// component, so it doesn't depend on order and a slot can be swapped
+// in and out of it on its own. Every slot handed out for writing by
+// Get() or written by Set() is marked dirty, and Hash() only hashes
+// the dirty slots again, so a tick costs what it changed rather than
+// the whole pool. Reading through the const Get() marks nothing.
+// A change made through a reference kept from an earlier tick would
+// never be seen, so debug builds rehash the whole pool every
+// POOL_HASH_CHECK_INTERVAL calls and log when it doesn't match.
 template <typename T>
 class Pool: public IPool //template class
 { //inherit from IPool
 private: 
-	std::vector<T> data;
+	std::vector<T, TrackingAllocator<T, MEMORY_TAG_ECS>> data;
+
+	std::vector<uint64_t, TrackingAllocator<uint64_t, MEMORY_TAG_ECS>> slotHashes; //what each slot adds to poolHash, 0 if it has no component
+	std::vector<uint8_t, TrackingAllocator<uint8_t, MEMORY_TAG_ECS>> isSlotDirty;
+	std::vector<int, TrackingAllocator<int, MEMORY_TAG_ECS>> dirtySlots;
+	bool isEverySlotDirty = true;
+	uint64_t poolHash = 0;
+#ifndef NDEBUG
+	int numHashesSinceCheck = 0;
+#endif
+
+	void MarkEverySlotDirty()
+	{
+		isEverySlotDirty = true;
+		dirtySlots.clear();
+		std::fill(isSlotDirty.begin(), isSlotDirty.end(), 0);
+	}
+
+	uint64_t HashSlot(const std::vector<Signature>& entitySignatures, int componentId, size_t index)
+	{
+		//slots of entities that don't have this component hold stale data, leave them out
+		if (index >= data.size() || index >= entitySignatures.size() || !entitySignatures[index].test(componentId))
+		{
+			return 0;
+		}
+		StateHasher hasher;
+		hasher.Add(static_cast<int>(index));
+		data[index].Serialize(hasher);
+		return hasher.GetHash();
+	}
 
 public: 
 	Pool(int size = 100)
 	{
-		data.resize(size); //resize is from <vector> which is included
+		Resize(size);
 	}
 	
 	virtual ~Pool() = default;
@@ -136,41 +235,143 @@ public:
 		return data.empty();
 	}
 
-	int GetSize() const
+	int GetSize() const override
 	{
 		return data.size();
 	}
 
+	size_t GetMemoryUsage() const override
+	{
+		return data.capacity() * sizeof(T);
+	}
+
 	void Resize(int n)
 	{
+		if (n < static_cast<int>(data.size()))
+		{
+			MarkEverySlotDirty();
+		}
 		data.resize(n);
+		slotHashes.resize(n, 0);
+		isSlotDirty.resize(n, 0);
 	}
 
 	void Clear()
 	{
-		data.clear();
+		Resize(0);
 	}
 
 	void Add(T object)
 	{
 		data.push_back(object);
+		slotHashes.push_back(0);
+		isSlotDirty.push_back(0);
+		MarkDirty(static_cast<int>(data.size()) - 1);
 	}
 
 	void Set(int index, T object)
 	{
+		MarkDirty(index);
 		data[index] = object;
 	}
 
 	T& Get(int index)
 	{
+		MarkDirty(index);
 		return static_cast<T&>(data[index]);
 	}
 
+	const T& Get(int index) const
+	{
+		return data[index];
+	}
+
 	T& operator [](unsigned int index)
 	{
+		MarkDirty(static_cast<int>(index));
 		return data[index];
 	}
 
+	void MarkDirty(int index) override
+	{
+		if (!isEverySlotDirty && !isSlotDirty[index])
+		{
+			isSlotDirty[index] = 1;
+			dirtySlots.push_back(index);
+		}
+	}
+
+	uint64_t Hash(const std::vector<Signature>& entitySignatures, int componentId) override
+	{
+#ifndef NDEBUG
+		if (!isEverySlotDirty && ++numHashesSinceCheck >= POOL_HASH_CHECK_INTERVAL)
+		{
+			//a slot that isn't dirty has to hash to what it did last time
+			numHashesSinceCheck = 0;
+			for (size_t i = 0; i < data.size(); i++)
+			{
+				if (!isSlotDirty[i] && slotHashes[i] != HashSlot(entitySignatures, componentId, i))
+				{
+					LOG(ERROR, ECS, "{} of entity {} changed without being marked dirty, was a component reference kept past its tick?", GetName(), i);
+					MarkDirty(static_cast<int>(i));
+				}
+			}
+		}
+#endif
+		if (isEverySlotDirty)
+		{
+			poolHash = 0;
+			for (size_t i = 0; i < data.size(); i++)
+			{
+				slotHashes[i] = HashSlot(entitySignatures, componentId, i);
+				poolHash ^= slotHashes[i];
+			}
+			isEverySlotDirty = false;
+			return poolHash;
+		}
+
+		for (const int index : dirtySlots)
+		{
+			const uint64_t slotHash = HashSlot(entitySignatures, componentId, index);
+			poolHash ^= slotHashes[index] ^ slotHash;
+			slotHashes[index] = slotHash;
+			isSlotDirty[index] = 0;
+		}
+		dirtySlots.clear();
+		return poolHash;
+	}
+
+	const char* GetName() const override
+	{
+		return typeid(T).name();
+	}
+
+	void Save(BinaryWriter& writer, const std::vector<Signature>& entitySignatures, int componentId) override
+	{
+		const size_t count = std::min(data.size(), entitySignatures.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			if (entitySignatures[i].test(componentId))
+			{
+				data[i].Serialize(writer);
+			}
+		}
+	}
+
+	void Load(BinaryReader& reader, const std::vector<Signature>& entitySignatures, int componentId) override
+	{
+		//the signatures are loaded first, so we know exactly which slots to fill
+		data.clear();
+		Resize(static_cast<int>(entitySignatures.size()));
+		MarkEverySlotDirty();
+		for (size_t i = 0; i < entitySignatures.size(); i++)
+		{
+			if (entitySignatures[i].test(componentId))
+			{
+				data[i].Serialize(reader);
+			}
+		}
+	}
 };
 
 
@@ -191,6 +392,10 @@ private:
 	//[Pool index = entity ID]
 	/*std::vector<IPool*> componentPools; */ //old, we now use smart pointers
 	std::vector<std::shared_ptr<IPool>> componentPools;
+
+	//How many entities have each component, kept up to date as components
+	//are added/removed so nothing has to scan the signatures to find out
+	std::array<int, MAX_COMPONENTS> numComponentsPerType{};
 	//We say IPool instead of Pool because we don't 
 	//know the type, so if we use IPool as the parent class,
 	//we don't need to specify the type each time.
@@ -207,21 +412,37 @@ private:
 	//std::unordered_map<std::type_index, System*> systems;
 	std::unordered_map<std::type_index, std::shared_ptr<System>> systems; //smart pointer implementation
 
+	//The same systems in the order they were added. Iterating the unordered_map
+	//can give a different order on different runs/platforms, so anything that
+	//loops over all systems uses this instead to stay deterministic
+	std::vector<std::shared_ptr<System>> orderedSystems;
+
+	//every system's random number generator is seeded from this
+	uint64_t randomSeed = 0;
+
 	//Set of entities that are flagged to be added or removed
 	//in the next registry Update()
 	std::set<Entity> entitiesToBeAdded;
 	std::set<Entity> entitiesToBeKilled;
 
+	//Ids of killed entities, handed out again by CreateEntity before making new ones
+	std::deque<int> freeIds;
+	//[index = entity id], false once the entity has been killed, so killing it again doesn't free its id twice
+	std::vector<bool> isEntityAlive;
+
+	//scratch flags used by Update() to remove all the killed entities from the systems in one go
+	std::vector<bool> isEntityKilled;
+
 public: 
 	//Registry() = default; //Replaced for use of smart pointers
 	Registry() 
 	{ 
-		Logger::Log("Registry constructor called"); 
+		LOG(INFO, ECS, "Registry constructor called");
 	}
 
 	~Registry()
 	{
-		Logger::Log("Registry destructor called");
+		LOG(INFO, ECS, "Registry destructor called");
 	}
 
 	// The registry Update() finally processes the entities that are waiting to be added/killed
@@ -229,9 +450,17 @@ public:
 
 	//Entity management
 	Entity CreateEntity();	
+	void KillEntity(Entity entity); //the entity is removed in the next registry Update()
+	void KillAllEntities(); //every live entity, e.g. when a level is unloaded
+	int GetNumLiveEntities() const; //entities created and not killed yet
 
 
 	///// Component management /////
+	// Assigns the component type id and creates its pool up front. Component ids are
+	// otherwise handed out on first use, so registering every type in a fixed order
+	// at startup keeps the ids (and therefore the state hashes) the same between runs
+	template <typename TComponent> void RegisterComponent();
+
 	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
 	// when we use "...TArgs", this just means that we have many 
 	// arguments to add, but we don't know how many. Could be 1 or 5
@@ -246,7 +475,10 @@ public:
 	// Checks if an entity HasComponent<T>()
 	template <typename TComponent> bool HasComponent(Entity entity) const;
 
+	// For changing the component: it's marked dirty for the next state hash, so don't keep the reference past this tick
 	template <typename TComponent> TComponent& GetComponent(Entity entity) const;
+	// For only looking at it, which leaves the cached hash alone
+	template <typename TComponent> const TComponent& ReadComponent(Entity entity) const;
 
 
 	///// Systems Management /////
@@ -255,6 +487,31 @@ public:
 	template <typename TSystem> void RemoveSystem();
 	template <typename TSystem> bool HasSystem() const;
 	template <typename TSystem> TSystem& GetSystem() const;
+	const std::vector<std::shared_ptr<System>>& GetSystems() const;
+
+	// Reseeds the random number generator of every system (and of systems added later)
+	void SetRandomSeed(uint64_t seed);
+
+
+	///// State hashing /////
+	// Used by deterministic mode to compare two runs tick by tick
+	int GetNumComponentPools() const;
+	bool HasComponentPool(int componentId) const;
+	const char* GetComponentPoolName(int componentId) const;
+	uint64_t HashComponentPool(int componentId) const;
+	int GetNumComponents(int componentId) const; //entities that currently have this component
+	int GetComponentPoolSize(int componentId) const;
+	size_t GetComponentPoolMemoryUsage(int componentId) const;
+	uint64_t HashEntitySignatures() const;
+	uint64_t HashSystemRandomState() const;
+
+
+	///// Snapshots /////
+	// Saves/restores every entity, component and system membership, so a
+	// replay can jump straight to a keyframe. The same systems and component
+	// types must be registered when loading as when the snapshot was saved
+	void SaveState(BinaryWriter& writer) const;
+	bool LoadState(BinaryReader& reader);
 
 
 	// CHecks the component signature of an entity and add the 
@@ -280,13 +537,25 @@ void Registry::AddSystem(TArgs&& ...args)
 	std::shared_ptr<TSystem> newSystem = std::make_shared<TSystem>(std::forward<TArgs>(args)...); //new object of type newSystem
 	//add new object (newSystem) to unordered map. systems is name of unordered map. Key and Value pair needed
 	systems.insert(std::make_pair(std::type_index(typeid(TSystem)), newSystem)); //(key,value).		Key is of type "type_index" (line 191 (subject to change))
-	
+
+	newSystem->SetName(GetReadableTypeName(typeid(TSystem).name()));
+
+	//the system's position in the order picks its random stream
+	newSystem->GetRandom().Seed(randomSeed, orderedSystems.size());
+	orderedSystems.push_back(newSystem);
+
 }
 
 template <typename TSystem>
 void Registry::RemoveSystem()
 {
 	auto system = systems.find(std::type_index(typeid(TSystem)));
+	if (system == systems.end())
+	{
+		return;
+	}
+
+	orderedSystems.erase(std::remove(orderedSystems.begin(), orderedSystems.end(), system->second), orderedSystems.end());
 	systems.erase(system);
 }
 
@@ -307,11 +576,10 @@ TSystem& Registry::GetSystem() const
 
 
 
-template <typename TComponent, typename ...TArgs>
-void Registry::AddComponent(Entity entity, TArgs&& ...args)
+template <typename TComponent>
+void Registry::RegisterComponent()
 {
 	const auto componentId = Component<TComponent>::GetId(); //get componentId
-	const auto entityId = entity.GetId(); //get entityId  
 
 	if (componentId >= componentPools.size()) //if new component type
 	{ //if new component type, resize the pool
@@ -325,6 +593,16 @@ void Registry::AddComponent(Entity entity, TArgs&& ...args)
 		std::shared_ptr<Pool<TComponent>> newComponentPool = std::make_shared<Pool<TComponent>>();
 		componentPools[componentId] = newComponentPool; //assign new pool for that position of componentPools
 	}
+}
+
+template <typename TComponent, typename ...TArgs>
+void Registry::AddComponent(Entity entity, TArgs&& ...args)
+{
+	const auto componentId = Component<TComponent>::GetId(); //get componentId
+	const auto entityId = entity.GetId(); //get entityId  
+
+	//make sure the pool for this component type exists
+	RegisterComponent<TComponent>();
 
 	//fetch position from componentpools vector
 	//Pool<TComponent>* componentPool = componentPools[componentId];
@@ -339,10 +617,14 @@ void Registry::AddComponent(Entity entity, TArgs&& ...args)
 	TComponent newComponent(std::forward<TArgs>(args)...); //this constructs the component of type TComponent
 
 	componentPool->Set(entityId, newComponent); //this is value i want to set in pool position
+	if (!entityComponentSignatures[entityId].test(componentId))
+	{
+		numComponentsPerType[componentId]++;
+	}
 	entityComponentSignatures[entityId].set(componentId); //enable component in signature (turns on in the bitset)
 
 
-	Logger::Log("Component id = " + std::to_string(componentId) + " was added to entity id " + std::to_string(entityId));
+	LOG(DEBUG, ECS, "Component id = {} was added to entity id {}", componentId, entityId);
 }
 
 /*
@@ -392,15 +674,23 @@ void Registry::RemoveComponent(Entity entity)
 {
 	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
+	if (entityComponentSignatures[entityId].test(componentId))
+	{
+		numComponentsPerType[componentId]--;
+	}
 	entityComponentSignatures[entityId].set(componentId, false);
+	if (HasComponentPool(componentId) && entityId < componentPools[componentId]->GetSize())
+	{
+		componentPools[componentId]->MarkDirty(entityId);
+	}
 
-	Logger::Log("Component id = " + std::to_string(componentId) + " was removed from entity id " + std::to_string(entityId));
+	LOG(DEBUG, ECS, "Component id = {} was removed from entity id {}", componentId, entityId);
 }
 
 template <typename TComponent>
 bool Registry::HasComponent(Entity entity) const
 {
-	const auto componentId = Component<TComponent>::Getid();
+	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
 	return entityComponentSignatures[entityId].test(componentId);
 }
@@ -415,6 +705,13 @@ template <typename TComponent> TComponent& Registry::GetComponent(Entity entity)
 	return componentPool->Get(entityId);
 }
 
+template <typename TComponent> const TComponent& Registry::ReadComponent(Entity entity) const
+{
+	const auto componentId = Component<TComponent>::GetId();
+	const Pool<TComponent>& componentPool = static_cast<const Pool<TComponent>&>(*componentPools[componentId]);
+	return componentPool.Get(entity.GetId());
+}
+
 
 template <typename TComponent, typename ...TArgs>
 void Entity::AddComponent(TArgs&& ...args)
@@ -465,4 +762,10 @@ template <typename TComponent>
 TComponent& Entity::GetComponent() const
 {
 	return registry->GetComponent<TComponent>(*this); //my attempt was also correct for this
+}
+
+template <typename TComponent>
+const TComponent& Entity::ReadComponent() const
+{
+	return registry->ReadComponent<TComponent>(*this);
 }
\ No newline at end of file
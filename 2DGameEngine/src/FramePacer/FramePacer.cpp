@@ -0,0 +1,195 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+//how long before the deadline we stop sleeping and start spinning.
+//clock_nanosleep is accurate to tens of microseconds, SDL_Delay to a couple of ms
+#if defined(__linux__)
+const double SPIN_THRESHOLD_SECONDS = 0.0002;
+#else
+const double SPIN_THRESHOLD_SECONDS = 0.002;
+#endif
+
+
+void FrameTimeHistory::Add(double milliseconds)
+{
+	samples[next] = milliseconds;
+	next = (next + 1) % FRAME_HISTORY_SIZE;
+	if (count < FRAME_HISTORY_SIZE)
+	{
+		count++;
+	}
+}
+
+void FrameTimeHistory::Clear()
+{
+	count = 0;
+	next = 0;
+}
+
+int FrameTimeHistory::GetCount() const
+{
+	return count;
+}
+
+double FrameTimeHistory::GetLatest() const
+{
+	if (count == 0)
+	{
+		return 0.0;
+	}
+	return samples[(next + FRAME_HISTORY_SIZE - 1) % FRAME_HISTORY_SIZE];
+}
+
+double FrameTimeHistory::GetSample(int index) const
+{
+	//when the window isn't full yet the oldest sample is in slot 0
+	const int oldest = (count < FRAME_HISTORY_SIZE) ? 0 : next;
+	return samples[(oldest + index) % FRAME_HISTORY_SIZE];
+}
+
+FrameTimeSummary FrameTimeHistory::GetSummary() const
+{
+	FrameTimeSummary summary;
+	if (count == 0)
+	{
+		return summary;
+	}
+
+	//work on a copy on the stack so the history itself keeps its order
+	double sorted[FRAME_HISTORY_SIZE];
+	double total = 0.0;
+	for (int i = 0; i < count; i++)
+	{
+		sorted[i] = samples[i];
+		total += samples[i];
+	}
+	std::sort(sorted, sorted + count);
+
+	//nearest-rank percentile
+	auto percentile = [&sorted, this](double p)
+	{
+		int rank = static_cast<int>(p * count + 0.5) - 1;
+		rank = std::clamp(rank, 0, count - 1);
+		return sorted[rank];
+	};
+
+	summary.min = sorted[0];
+	summary.avg = total / count;
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	return summary;
+}
+
+
+FramePacer::FramePacer(int targetFps)
+{
+	counterFrequency = SDL_GetPerformanceFrequency();
+	SetTargetFps(targetFps);
+	Reset();
+}
+
+void FramePacer::SetTargetFps(int fps)
+{
+	targetFps = std::max(fps, 0);
+	countsPerFrame = (targetFps > 0) ? counterFrequency / targetFps : 0;
+}
+
+int FramePacer::GetTargetFps() const
+{
+	return targetFps;
+}
+
+void FramePacer::Reset()
+{
+	previousFrameStart = SDL_GetPerformanceCounter();
+	frameTimes.Clear();
+	updateTimes.Clear();
+	renderTimes.Clear();
+}
+
+double FramePacer::CountsToMilliseconds(Uint64 counts) const
+{
+	return (counts * 1000.0) / counterFrequency;
+}
+
+void FramePacer::SleepUntil(Uint64 targetCounter) const
+{
+	const Uint64 spinCounts = static_cast<Uint64>(SPIN_THRESHOLD_SECONDS * counterFrequency);
+
+	//Coarse sleep: give the CPU back for everything but the last little bit
+	Uint64 now = SDL_GetPerformanceCounter();
+	if (now + spinCounts < targetCounter)
+	{
+		const Uint64 sleepCounts = targetCounter - now - spinCounts;
+#if defined(__linux__)
+		const Uint64 nanoseconds = (sleepCounts * 1000000000ull) / counterFrequency;
+		timespec request;
+		request.tv_sec = static_cast<time_t>(nanoseconds / 1000000000ull);
+		request.tv_nsec = static_cast<long>(nanoseconds % 1000000000ull);
+		clock_nanosleep(CLOCK_MONOTONIC, 0, &request, nullptr);
+#else
+		SDL_Delay(static_cast<Uint32>((sleepCounts * 1000) / counterFrequency));
+#endif
+	}
+
+	//Fine wait: spin on the performance counter until we reach the target
+	while (SDL_GetPerformanceCounter() < targetCounter)
+	{
+	}
+}
+
+double FramePacer::WaitForNextFrame()
+{
+	if (countsPerFrame > 0)
+	{
+		SleepUntil(previousFrameStart + countsPerFrame);
+	}
+
+	const Uint64 frameStart = SDL_GetPerformanceCounter();
+	const Uint64 elapsed = frameStart - previousFrameStart;
+	previousFrameStart = frameStart;
+
+	const double frameMilliseconds = CountsToMilliseconds(elapsed);
+	frameTimes.Add(frameMilliseconds);
+
+	return frameMilliseconds / 1000.0;
+}
+
+void FramePacer::BeginUpdate()
+{
+	updateStart = SDL_GetPerformanceCounter();
+}
+
+void FramePacer::EndUpdate()
+{
+	updateTimes.Add(CountsToMilliseconds(SDL_GetPerformanceCounter() - updateStart));
+}
+
+void FramePacer::BeginRender()
+{
+	renderStart = SDL_GetPerformanceCounter();
+}
+
+void FramePacer::EndRender()
+{
+	renderTimes.Add(CountsToMilliseconds(SDL_GetPerformanceCounter() - renderStart));
+}
+
+const FrameTimeHistory& FramePacer::GetFrameTimes() const
+{
+	return frameTimes;
+}
+
+const FrameTimeHistory& FramePacer::GetUpdateTimes() const
+{
+	return updateTimes;
+}
+
+const FrameTimeHistory& FramePacer::GetRenderTimes() const
+{
+	return renderTimes;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <SDL.h>
+
+const int FRAME_HISTORY_SIZE = 240; //how many frames of timing history we keep (1 second at 240fps)
+const int DEFAULT_TARGET_FPS = 240;
+
+
+////////////////////////////////////////////////////////////////////////
+// FrameTimeHistory
+////////////////////////////////////////////////////////////////////////
+// Rolling window of the last FRAME_HISTORY_SIZE timings in milliseconds.
+// Once the window is full the oldest sample gets overwritten.
+////////////////////////////////////////////////////////////////////////
+struct FrameTimeSummary
+{
+	double min = 0.0;
+	double avg = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+};
+
+class FrameTimeHistory
+{
+private:
+	double samples[FRAME_HISTORY_SIZE] = {};
+	int count = 0; //how many slots hold real samples
+	int next = 0; //slot the next sample is written to
+
+public:
+	void Add(double milliseconds);
+	void Clear();
+
+	int GetCount() const;
+	double GetLatest() const;
+
+	//index 0 is the oldest sample still in the window
+	double GetSample(int index) const;
+
+	//min/avg/p95/p99 over everything currently in the window
+	FrameTimeSummary GetSummary() const;
+};
+
+
+////////////////////////////////////////////////////////////////////////
+// FramePacer
+////////////////////////////////////////////////////////////////////////
+// Keeps the game loop at the target frame rate using the high resolution
+// performance counter. SDL_Delay only has millisecond granularity (and
+// often oversleeps by a couple of ms), so we sleep coarsely for most of
+// the remaining time and then spin for the last bit to hit the target.
+////////////////////////////////////////////////////////////////////////
+class FramePacer
+{
+private:
+	Uint64 counterFrequency; //performance counter ticks per second
+	Uint64 countsPerFrame = 0; //0 means uncapped
+	int targetFps = 0;
+
+	Uint64 previousFrameStart = 0;
+	Uint64 updateStart = 0;
+	Uint64 renderStart = 0;
+
+	FrameTimeHistory frameTimes;
+	FrameTimeHistory updateTimes;
+	FrameTimeHistory renderTimes;
+
+	double CountsToMilliseconds(Uint64 counts) const;
+	void SleepUntil(Uint64 targetCounter) const;
+
+public:
+	FramePacer(int targetFps = DEFAULT_TARGET_FPS);
+
+	//0 (or less) removes the cap and lets the loop run as fast as it can
+	void SetTargetFps(int fps);
+	int GetTargetFps() const;
+
+	//Call once right before the game loop starts so the first frame
+	//doesn't count the time spent loading
+	void Reset();
+
+	//Waits until the target frame time has passed since the previous frame
+	//started, then starts a new frame. Returns the delta time in seconds
+	double WaitForNextFrame();
+
+	void BeginUpdate();
+	void EndUpdate();
+	void BeginRender();
+	void EndRender();
+
+	const FrameTimeHistory& GetFrameTimes() const;
+	const FrameTimeHistory& GetUpdateTimes() const;
+	const FrameTimeHistory& GetRenderTimes() const;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <SDL.h>
+#include "../ECS/ECS.h"
+#include "../Profiler/HardwareCounters.h"
+
+//Times a system's update for as long as it's in scope and stores the result on the system:
+//
+//		{
+//			SystemTimer timer(movementSystem);
+//			movementSystem.Update(deltaTime);
+//		}
+//
+//When hardware counters are enabled on this thread, the counter deltas are added to the system too
+class SystemTimer
+{
+private:
+	System& system;
+	HardwareCounterValues startCounters;
+	bool hasCounters;
+	Uint64 startCounter;
+
+public:
+	SystemTimer(System& system) : system(system)
+	{
+		hasCounters = HardwareCounters::IsEnabled() && HardwareCounters::Read(startCounters);
+		startCounter = SDL_GetPerformanceCounter();
+	}
+
+	~SystemTimer()
+	{
+		const Uint64 elapsed = SDL_GetPerformanceCounter() - startCounter;
+		HardwareCounterValues endCounters;
+		if (hasCounters && HardwareCounters::Read(endCounters))
+		{
+			system.AddHardwareCounters(endCounters - startCounters);
+		}
+		system.SetLastUpdateTime((elapsed * 1000.0) / SDL_GetPerformanceFrequency());
+	}
+};
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <SDL.h>
 #include <SDL_image.h>
+#include <SDL_ttf.h>
 #include <glm/glm.hpp>
 #include "Game.h"
 #include "../Logger/Logger.h"
@@ -11,6 +12,12 @@
 #include "../Components/SpriteComponent.h"
 #include "../Systems/RenderSystem.h"	
 #include "../Components/AnimationComponent.h"
+#include "../Components/CameraComponent.h"
+#include "../FramePacer/SystemTimer.h"
+#include "../Profiler/Profiler.h"
+#include "../Profiler/HardwareCounters.h"
+#include "../Memory/MemoryTracker.h"
+#include <cstdio>
 #include <fstream>
 
 //use "" when the file being included is in the same folder, otherwise use <> as this signifies for the compiler to search for the file in the dependencies
@@ -31,19 +38,60 @@ Game::Game() // "Game::" is the scope resolution, or, who owns the method. In th
 	//registry = new Registry(); //Replace this with smart pointer
 	registry = std::make_unique<Registry>(); //unqiue smart pointer
 	assetStore = std::make_unique<AssetStore>();
-	Logger::Log("game constructor called");
+
+	//Register every component type in a fixed order so they always get the same ids,
+	//no matter which one happens to be used first
+	registry->RegisterComponent<TransformComponent>();
+	registry->RegisterComponent<RigidBodyComponent>();
+	registry->RegisterComponent<SpriteComponent>();
+	registry->RegisterComponent<AnimationComponent>();
+	registry->RegisterComponent<CameraComponent>();
+
+	LOG(INFO, GAME, "game constructor called");
 }
 
 Game::~Game()
 {
-	Logger::Log("game destructor called");
+	LOG(INFO, GAME, "game destructor called");
 }
 
 void Game::Initialize()
 {
+	if (isHeadless)
+	{
+		//No video or audio, we only need the timer and the event queue (so ctrl+c still quits)
+		if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) != 0)
+		{
+			LOG(ERROR, GAME, "Error initialising SDL in headless mode: {}", SDL_GetError());
+			return;
+		}
+		windowWidth = 0;
+		windowHeight = 0;
+
+		if (offscreenWidth > 0 && offscreenHeight > 0)
+		{
+			offscreenSurface = SDL_CreateRGBSurfaceWithFormat(0, offscreenWidth, offscreenHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+			renderer = offscreenSurface ? SDL_CreateSoftwareRenderer(offscreenSurface) : nullptr;
+			if (!renderer)
+			{
+				LOG(ERROR, RENDER, "Error creating offscreen software renderer: {}", SDL_GetError());
+				return;
+			}
+			windowWidth = offscreenWidth;
+			windowHeight = offscreenHeight;
+			LOG(INFO, GAME, "Running headless, rendering offscreen at {}x{}", offscreenWidth, offscreenHeight);
+		}
+		else
+		{
+			LOG(INFO, GAME, "Running headless, no window or renderer will be created");
+		}
+		isRunning = true;
+		return;
+	}
+
 	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) //try to initialise. 
 	{ //if cannot initialise, give error message
-		Logger::Err("Error initialising SDL");
+		LOG(ERROR, GAME, "Error initialising SDL: {}", SDL_GetError());
 		return;
 	}
 
@@ -67,7 +115,7 @@ void Game::Initialize()
 	);
 	if (!window)
 	{
-		Logger::Err("Error creating SDL window");
+		LOG(ERROR, RENDER, "Error creating SDL window: {}", SDL_GetError());
 		return;
 	}
 	// "-1" means to get the default.  Is asking what display number will this
@@ -81,33 +129,192 @@ void Game::Initialize()
 	); //no special flags if 0
 	if (!renderer)
 	{
-		Logger::Err("Error creating SDL renderer");
+		LOG(ERROR, RENDER, "Error creating SDL renderer: {}", SDL_GetError());
 		return;
 	}
 
 	SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN); //changes video mode to true full screen
 
+	performanceOverlay.Initialize(renderer, windowWidth, windowHeight);
+
 	isRunning = true; //was able to do everything correctly if this is reached
 }
 
 void Game::ProcessInput()
 {
+	//a new frame starts here, so everything since the last one is the previous frame's allocations
+	CheckFrameAllocations();
+
+	PROFILE_SCOPE("Game::ProcessInput");
+
+	tickInputEvents.clear();
+
+	//keyframes are taken before the input of their tick, so playback can start from one
+	if (replayRecorder.IsOpen() && currentTick % keyframeInterval == 0)
+	{
+		replayRecorder.WriteKeyframe(currentTick, *registry);
+	}
+
 	SDL_Event sdlEvent;
 	while (SDL_PollEvent(&sdlEvent)) // & means reference
 	{ //while 
-		switch (sdlEvent.type)
+		if (sdlEvent.type == SDL_RENDER_TARGETS_RESET)
+		{
+			tilemap.InvalidateChunks(); //the baked chunks were lost with the render targets
+			continue;
+		}
+		if (HandleDebugKey(sdlEvent))
 		{
-		case SDL_QUIT:
+			continue; //debug keys aren't gameplay input, so they don't get recorded
+		}
+
+		InputEvent inputEvent;
+		if (!TranslateSdlEvent(sdlEvent, inputEvent))
+		{
+			continue; //not an event gameplay cares about
+		}
+
+		//while replaying, live input is ignored apart from closing the game
+		if (isReplaying && inputEvent.type != INPUT_QUIT)
+		{
+			continue;
+		}
+		tickInputEvents.push_back(inputEvent);
+	}
+
+	if (isReplaying)
+	{
+		if (replayPlayer.IsFinished(currentTick))
+		{
+			LOG(INFO, GAME, "Replay finished at tick {}", currentTick);
 			isRunning = false;
-			break; //always add after switch case
+			return;
+		}
+		replayPlayer.ReadEventsForTick(currentTick, tickInputEvents);
+	}
+
+	for (const auto& inputEvent : tickInputEvents)
+	{
+		if (replayRecorder.IsOpen())
+		{
+			replayRecorder.WriteEvent(inputEvent);
+		}
+		HandleInputEvent(inputEvent);
+	}
+}
+
+bool Game::TranslateSdlEvent(const SDL_Event& sdlEvent, InputEvent& inputEvent) const
+{
+	inputEvent.tick = currentTick;
+	switch (sdlEvent.type)
+	{
+	case SDL_QUIT:
+		inputEvent.type = INPUT_QUIT;
+		return true;
 
-		case SDL_KEYDOWN:
-			if (sdlEvent.key.keysym.sym == SDLK_ESCAPE)
-			{ //if escape key pressed
-				isRunning = false;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		if (sdlEvent.key.repeat)
+		{
+			return false; //held keys are already down, no need to record the repeats
+		}
+		inputEvent.type = (sdlEvent.type == SDL_KEYDOWN) ? INPUT_KEY_DOWN : INPUT_KEY_UP;
+		inputEvent.code = sdlEvent.key.keysym.sym;
+		return true;
+
+	case SDL_MOUSEMOTION:
+		inputEvent.type = INPUT_MOUSE_MOTION;
+		inputEvent.x = sdlEvent.motion.x;
+		inputEvent.y = sdlEvent.motion.y;
+		return true;
+
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		inputEvent.type = (sdlEvent.type == SDL_MOUSEBUTTONDOWN) ? INPUT_MOUSE_BUTTON_DOWN : INPUT_MOUSE_BUTTON_UP;
+		inputEvent.code = sdlEvent.button.button;
+		inputEvent.x = sdlEvent.button.x;
+		inputEvent.y = sdlEvent.button.y;
+		return true;
+	}
+	return false;
+}
+
+void Game::CheckFrameAllocations()
+{
+	lastFrameAllocations = MemoryTracker::GetFrameAllocations();
+	lastFrameWorkerAllocations = MemoryTracker::GetFrameWorkerAllocations();
+	if (currentTick > allocationWarmupTicks)
+	{
+		totalWorkerAllocations += lastFrameWorkerAllocations;
+	}
+	if (frameAllocationLimit >= 0 && currentTick > allocationWarmupTicks && lastFrameAllocations > static_cast<uint64_t>(frameAllocationLimit))
+	{
+		numFramesOverAllocationLimit++;
+		LOG(ERROR, GAME, "Tick {} made {} heap allocations, the limit is {}", currentTick - 1, lastFrameAllocations, frameAllocationLimit);
+	}
+	//started after logging, so the error message doesn't count against the next frame (LOG only copies the
+	//arguments here, the logger thread formatting and writing it out is counted as a worker)
+	MemoryTracker::BeginFrame();
+}
+
+bool Game::HandleDebugKey(const SDL_Event& sdlEvent)
+{
+	if (sdlEvent.type != SDL_KEYDOWN || sdlEvent.key.repeat)
+	{
+		return false;
+	}
+
+	switch (sdlEvent.key.keysym.sym)
+	{
+	case SDLK_F1:
+		performanceOverlay.Toggle();
+		return true;
+
+	case SDLK_F3:
+		//dump the last few seconds of profiler zones
+		Profiler::WriteChromeTrace("profile-" + std::to_string(currentTick) + ".json");
+		return true;
+
+	case SDLK_F5:
+		SwitchScene();
+		return true;
+	}
+	return false;
+}
+
+void Game::HandleInputEvent(const InputEvent& inputEvent)
+{
+	switch (inputEvent.type)
+	{
+	case INPUT_QUIT:
+		isRunning = false;
+		break; //always add after switch case
+
+	case INPUT_KEY_DOWN:
+		if (inputEvent.code == SDLK_ESCAPE)
+		{ //if escape key pressed
+			isRunning = false;
+		}
+		else if (cameraEntityId >= 0)
+		{
+			//arrow keys move the camera a tile at a time, +/- zoom in and out
+			CameraComponent& camera = GetCamera();
+			const float step = 64.0f / camera.zoom;
+			switch (inputEvent.code)
+			{
+			case SDLK_LEFT: camera.position.x -= step; break;
+			case SDLK_RIGHT: camera.position.x += step; break;
+			case SDLK_UP: camera.position.y -= step; break;
+			case SDLK_DOWN: camera.position.y += step; break;
+			case SDLK_EQUALS: camera.zoom = std::min(camera.zoom * 1.25f, 8.0f); break;
+			case SDLK_MINUS: camera.zoom = std::max(camera.zoom / 1.25f, 0.125f); break;
+			default: break;
 			}
-			break;
 		}
+		break;
+
+	default:
+		break;
 	}
 }
 
@@ -120,54 +327,135 @@ void Game::ProcessInput()
 
 
 
-void Game::LoadLevel(int level)
+void Game::LoadSystemsAndAssets()
 {
-	// TODO:
-	// Entitiy tank = registry.CreateEntity();
-	// tank.AddComponent<TransformComponent>();
-	// tank.AddComponent<BoxColliderComponent>();
-	// tank.AddComponent<SpriteComponent>("./assets/images/tank.png");
+	//Give the asset ids their handles first, in the same order whether or not textures get loaded,
+	//so the handles (which are part of the state hash) match between the game and the headless server
+	for (const char* assetId : { "tank-image", "truck-image", "chopper-image", "tilemap-image", "tiger-tank-image" })
+	{
+		AssetIds::Intern(assetId);
+	}
 
+	//Created whether or not anything gets drawn, so entity ids match between the game and the headless server
+	Entity camera = registry->CreateEntity();
+	camera.AddComponent<CameraComponent>(glm::vec2(0, 0), 1.0f); //the viewport is set from the window when drawing
+	cameraEntityId = camera.GetId();
 
-	//Add the systems that need to be processed in the game
-	registry->AddSystem<MovementSystem>();
-	registry->AddSystem<RenderSystem>();
+	//Add the systems that need to be processed in the game. They stay when we switch scenes
+	if (!registry->HasSystem<MovementSystem>())
+	{
+		registry->AddSystem<MovementSystem>();
+	}
 
+	//Render systems and textures need a renderer, so a headless game skips them entirely (unless it renders offscreen)
+	if (renderer)
+	{
+		if (!registry->HasSystem<RenderSystem>())
+		{
+			registry->AddSystem<RenderSystem>();
+			registry->GetSystem<RenderSystem>().SetBatching(isRenderBatchingEnabled);
+			tilemap.SetChunkCaching(isTileChunkCachingEnabled);
+		}
 
-	//Adding assets to the asset store
-	assetStore->AddTexture(renderer, "tank-image", "./assets/images/tank-panther-right.png");
-	assetStore->AddTexture(renderer, "truck-image", "./assets/images/truck-ford-right.png");
-	assetStore->AddTexture(renderer, "tilemap-image", "./assets/tilemaps/jungle.png");
+		//Adding assets to the asset store. The scene's images share atlas pages, so its sprites and tiles draw in long batches.
+		//Images the other scene already has are only referenced again, the rest are packed onto a page of their own
+		if (isStressTest)
+		{
+			LoadSceneTexture("tiger-tank-image", "./assets/images/tank-tiger-right.png");
+			LoadSceneTexture("truck-image", "./assets/images/truck-ford-right.png");
+			LoadSceneTexture("tilemap-image", "./assets/tilemaps/jungle.png");
+			assetStore->BuildAtlas(renderer, "./cache/stress-atlas.layout");
+		}
+		else
+		{
+			LoadSceneTexture("tank-image", "./assets/images/tank-panther-right.png");
+			LoadSceneTexture("truck-image", "./assets/images/truck-ford-right.png");
+			LoadSceneTexture("tilemap-image", "./assets/tilemaps/jungle.png");
+			assetStore->BuildAtlas(renderer, "./cache/level-atlas.layout");
+		}
+	}
+}
 
-	// Load the tilemap
-	// We need to load the tilemap texture from ./assets/tilemaps/jungle.png
-	// We need to load the file ./assets/tilemaps/jungle.map 
-	int tileSize = 32;
-	double tileScale = 2.0;
-	int mapNumCols = 25;
-	int mapNumRows = 20;
+void Game::LoadSceneTexture(const std::string& assetId, const std::string& filePath)
+{
+	assetStore->AddAtlasImage(assetId, filePath);
+	sceneTextures.push_back(AssetIds::Intern(assetId));
+}
 
-	std::fstream mapFile;
-	mapFile.open("./assets/tilemaps/jungle.map");
+void Game::UnloadScene()
+{
+	registry->KillAllEntities();
+	registry->Update(); //the ids are free for the next scene straight away
+	cameraEntityId = -1;
 
-	for (int y = 0; y < mapNumRows; y++)
+	//the textures stay in the asset store until it's over its budget, so a scene that uses them again gets them back for free
+	for (AssetHandle handle : sceneTextures)
 	{
-		for (int x = 0; x < mapNumCols; x++)
-		{ //there are two digits for each tilemap sprite in the mapFile e.g.21,08,13
-			char ch;
-			mapFile.get(ch);
-			int srcRectY = std::atoi(&ch) * tileSize; //atoi = ascii to integer
-			mapFile.get(ch);
-			int srcRectX = std::atoi(&ch) * tileSize;
-			mapFile.ignore(); //skip comma
+		assetStore->ReleaseTexture(handle);
+	}
+	sceneTextures.clear();
+}
 
-			Entity tile = registry->CreateEntity(); 
-			tile.AddComponent<TransformComponent>(glm::vec2(x * (tileScale * tileSize), y * (tileScale * tileSize)), glm::vec2(tileScale, tileScale), 0.0); //add transform component to tile entity, based on x and y column and row position
-			tile.AddComponent<SpriteComponent>("tilemap-image", tileSize, tileSize, 0, srcRectX, srcRectY); //add sprite based on tilemap in assetstore, with size (32,32), and where in the png is the subsection for the source rectangle
-			//tiles are alawys going to be rendered first so to not be above other assets, therefore we pass zIndex 0
+void Game::SwitchScene()
+{
+	//keyframes only have the registry in them, not which scene it is or its tilemap
+	if (isReplaying || replayRecorder.IsOpen())
+	{
+		LOG(WARNING, GAME, "Can't switch scenes while recording or replaying");
+		return;
+	}
+	PROFILE_SCOPE("Game::SwitchScene");
+
+	UnloadScene();
+	isStressTest = !isStressTest;
+	if (isStressTest)
+	{
+		if (stressPreset.name.empty())
+		{
+			stressPreset = *FindStressPreset("jungle");
 		}
+		LoadStressScene();
+	}
+	else
+	{
+		LoadLevel(1);
+	}
+	if (renderer)
+	{
+		assetStore->ResolveMissingTextures(renderer);
+	}
+	if (registry->HasSystem<RenderSystem>())
+	{
+		registry->GetSystem<RenderSystem>().SetWorldSize(tilemap.GetWidth(), tilemap.GetHeight());
 	}
-	mapFile.close();  
+
+	const AssetCacheStats& cacheStats = assetStore->GetCacheStats();
+	LOG
+	(
+		INFO, GAME, "Switched to the {} at tick {}, texture cache: {} hits, {} misses, {} evictions, {} reloads",
+		isStressTest ? "stress scene" : "level", currentTick, cacheStats.hits, cacheStats.misses, cacheStats.evictions, cacheStats.reloads
+	);
+}
+
+void Game::LoadStressScene()
+{
+	LoadSystemsAndAssets();
+	stressScene.Load(*registry, tilemap, stressPreset, randomSeed);
+}
+
+void Game::LoadLevel(int level)
+{
+	// TODO:
+	// Entitiy tank = registry.CreateEntity();
+	// tank.AddComponent<TransformComponent>();
+	// tank.AddComponent<BoxColliderComponent>();
+	// tank.AddComponent<SpriteComponent>("./assets/images/tank.png");
+
+
+	LoadSystemsAndAssets();
+
+	// Load the tilemap
+	LoadLevelMap();
 
 	//create an entity
 	Entity tank = registry->CreateEntity();
@@ -179,7 +467,7 @@ void Game::LoadLevel(int level)
 	//Now we just ask to add the entity itself, without asking the registry ourselves
 	tank.AddComponent<TransformComponent>(glm::vec2(10.0, 10.0), glm::vec2(1.0, 1.0), 0.0); //starting position, scale, rotation
 	tank.AddComponent<RigidBodyComponent>(glm::vec2(20.0, 0.0)); //velocity
-	tank.AddComponent<SpriteComponent>("tank-image", 32, 32, 2); //image name, size in pixels, size in pixels, zIndex
+	tank.AddComponent<SpriteComponent>(AssetIds::Intern("tank-image"), 32, 32, 2); //image handle, size in pixels, size in pixels, zIndex
 
 	//Remove a component from the entity
 	//tank.RemoveComponent<TranformComponent>();
@@ -188,14 +476,14 @@ void Game::LoadLevel(int level)
 	Entity truck = registry->CreateEntity();
 	truck.AddComponent<TransformComponent>(glm::vec2(10.0, 10.0), glm::vec2(1.0, 1.0), 0.0); //position, scale, rotation
 	truck.AddComponent<RigidBodyComponent>(glm::vec2(25.0, 0.0)); //velocity
-	truck.AddComponent<SpriteComponent>("truck-image", 32, 32, 1); //Size
+	truck.AddComponent<SpriteComponent>(AssetIds::Intern("truck-image"), 32, 32, 1); //Size
 
 
 	//helicopter
 	Entity helicopter = registry->CreateEntity();
 	helicopter.AddComponent<TransformComponent>(glm::vec2(50.0, 10.0), glm::vec2(1.0, 1.0), 0.0); //starting position, scale, rotation
 	helicopter.AddComponent<RigidBodyComponent>(glm::vec2(20.0, 0.0)); //velocity
-	helicopter.AddComponent<SpriteComponent>("chopper-image", 32, 32, 2); //image name, size in pixels, size in pixels, zIndex
+	helicopter.AddComponent<SpriteComponent>(AssetIds::Intern("chopper-image"), 32, 32, 2); //image handle (there's no chopper texture yet, it's drawn with the placeholder), size in pixels, size in pixels, zIndex
 	helicopter.AddComponent<AnimationComponent>();
 
 
@@ -204,6 +492,103 @@ void Game::LoadLevel(int level)
 
 
 
+void Game::LoadLevelMap(bool preferTextMap)
+{
+	// The tilemap texture is ./assets/tilemaps/jungle.png, and the tiles are cooked from
+	// ./assets/tilemaps/jungle.map into jungle.bmap by the 2DGameEngineCooker tool.
+	// Called again by hot reloading, so a map that only had tiles change keeps the chunks that didn't.
+	// When the assets have been cooked the map cooked with them is used instead
+	MapFile mapFile;
+	bool isMapOpen = false;
+	if (!preferTextMap)
+	{
+		const std::string cookedMapFilePath = assetStore->FindCookedFile(LEVEL_TEXT_MAP_FILE_PATH);
+		const std::string mapFilePath = cookedMapFilePath.empty() ? LEVEL_MAP_FILE_PATH : cookedMapFilePath;
+		AssetPackFile packedMap;
+		isMapOpen = assetStore->FindPackedFile(mapFilePath, packedMap) && !packedMap.IsCompressed()
+			? mapFile.Open(packedMap.data, packedMap.size, mapFilePath) //used in place from the pack's mapping
+			: mapFile.Open(mapFilePath);
+	}
+	if (isMapOpen)
+	{
+		tilemap.Reload(std::move(mapFile)); //the tiles are used straight from the file
+	}
+	else
+	{
+		//the text map still works, it's just slower to load
+		if (!preferTextMap)
+		{
+			LOG(WARNING, ASSETS, "No cooked {}, importing {} instead (cook it with 2DGameEngineCooker map {} -o {})", LEVEL_MAP_FILE_PATH, LEVEL_TEXT_MAP_FILE_PATH, LEVEL_TEXT_MAP_FILE_PATH, LEVEL_MAP_FILE_PATH);
+		}
+		const int tilesetNumCols = 10; //jungle.png is 10 tiles across
+		int mapNumCols = 0;
+		int mapNumRows = 0;
+		std::vector<uint16_t> tiles;
+		if (ImportTextMap(LEVEL_TEXT_MAP_FILE_PATH, tilesetNumCols, mapNumCols, mapNumRows, tiles))
+		{
+			if (mapNumCols != tilemap.GetNumCols() || mapNumRows != tilemap.GetNumRows() || tilemap.GetNumLayers() != 1)
+			{
+				tilemap.Create(mapNumCols, mapNumRows, 32, 2.0f, AssetIds::Intern("tilemap-image"), tilesetNumCols);
+			}
+			//SetTile() only marks a chunk for re-baking if its tile actually changes
+			for (int y = 0; y < mapNumRows; y++)
+			{
+				for (int x = 0; x < mapNumCols; x++)
+				{
+					tilemap.SetTile(x, y, tiles[static_cast<size_t>(y) * mapNumCols + x]);
+				}
+			}
+		}
+	}
+}
+
+void Game::ReloadChangedAssets()
+{
+	assetWatcher.TakeChangedFiles(changedAssetFiles);
+	if (changedAssetFiles.empty())
+	{
+		return;
+	}
+	PROFILE_SCOPE("Game::ReloadChangedAssets");
+
+	const std::string mapFilePath = NormalizeFilePath(LEVEL_MAP_FILE_PATH);
+	const std::string textMapFilePath = NormalizeFilePath(LEVEL_TEXT_MAP_FILE_PATH);
+	bool isMapChanged = false;
+	bool isTextMapChanged = false;
+	for (const std::string& filePath : changedAssetFiles)
+	{
+		//textures are decoded again in the background and swapped in by a later AssetStore::Update()
+		int numReloaded = assetStore->ReloadFile(filePath);
+		if (!isStressTest && filePath == mapFilePath)
+		{
+			isMapChanged = true;
+			numReloaded++;
+		}
+		else if (!isStressTest && filePath == textMapFilePath)
+		{
+			isTextMapChanged = true;
+			numReloaded++;
+		}
+		if (numReloaded == 0)
+		{
+			LOG(DEBUG, ASSETS, "{} changed, nothing loaded from it", filePath);
+		}
+	}
+
+	//an edited text map wins over the cooked one, which still has the old tiles until it's cooked again.
+	//When both changed together the text map was most likely just cooked, so the cooked one is up to date
+	if (isMapChanged || isTextMapChanged)
+	{
+		const bool preferTextMap = isTextMapChanged && !isMapChanged;
+		if (preferTextMap)
+		{
+			LOG(INFO, ASSETS, "{} changed, importing it instead of the cooked {} that has the old tiles", LEVEL_TEXT_MAP_FILE_PATH, LEVEL_MAP_FILE_PATH);
+		}
+		LoadLevelMap(preferTextMap);
+		registry->GetSystem<RenderSystem>().SetWorldSize(tilemap.GetWidth(), tilemap.GetHeight());
+	}
+}
+
 void Game::Setup()
 {
 /*
@@ -251,25 +636,90 @@ void Game::Setup()
 	
 */ //all of this has been moved to LoadLevel()
 	
-	LoadLevel(1);
+	if (!assetPackPath.empty())
+	{
+		if (isAssetHotReloadEnabled)
+		{
+			//the watcher sees the loose files, and a packed copy would be loaded instead of the changed one
+			LOG(INFO, ASSETS, "Hot reloading loads the loose files under ./assets, {} isn't used", assetPackPath);
+		}
+		else if (!assetStore->MountPack(assetPackPath))
+		{
+			LOG(INFO, ASSETS, "No asset pack at {}, loading loose files", assetPackPath);
+		}
+	}
+	if (!cookedAssetsPath.empty())
+	{
+		if (isAssetHotReloadEnabled)
+		{
+			//same as the pack, a cooked copy would hide the change
+			LOG(INFO, ASSETS, "Hot reloading decodes the source files under ./assets, {} isn't used", cookedAssetsPath);
+		}
+		else if (!assetStore->MountCookedAssets(cookedAssetsPath))
+		{
+			LOG(INFO, ASSETS, "No cooked assets in {}, decoding the source files", cookedAssetsPath);
+		}
+	}
+	if (renderer && !assetStore->EnablePremultipliedAlpha(renderer))
+	{
+		LOG(INFO, ASSETS, "The renderer can't blend premultiplied alpha, textures are loaded with straight alpha");
+	}
+	if (renderer)
+	{
+		if (TTF_Init() != 0)
+		{
+			LOG(ERROR, RENDER, "Error initialising SDL_ttf, no text will be drawn: {}", SDL_GetError());
+		}
+		else
+		{
+			textRenderer.Initialize(renderer, assetStore->IsPremultipliedAlpha());
+			hudFont = textRenderer.LoadFont(*assetStore, HUD_FONT_FILE_PATH, HUD_FONT_SIZE);
+		}
+	}
+
+	if (isStressTest)
+	{
+		LoadStressScene();
+	}
+	else
+	{
+		LoadLevel(1);
+	}
+	if (renderer)
+	{
+		assetStore->ResolveMissingTextures(renderer);
+		if (isAssetHotReloadEnabled)
+		{
+			assetWatcher.Start("./assets");
+		}
+	}
+	if (registry->HasSystem<RenderSystem>())
+	{
+		registry->GetSystem<RenderSystem>().SetWorldSize(tilemap.GetWidth(), tilemap.GetHeight());
+	}
+
+	if (isReplaying && replaySeekTick > 0)
+	{
+		SeekReplay(replaySeekTick);
+	}
 }
 
 void Game::Update()
 {
-	//TODO: If we're too fast, waste some time until we reach MILLISECS_PER_FRAME
-	//while (!SDL_TICKS_PASSED(SDL_GetTicks(), millisecsPreviousFrame + MILLISECS_PER_FRAME));
-	int timeToWait = MILLISECS_PER_FRAME - (SDL_GetTicks() - millisecsPreviousFrame);
-	if ((timeToWait > 0 && timeToWait <= MILLISECS_PER_FRAME))
+	//If we're too fast, waste some time until we reach the target frame time.
+	//The frame pacer sleeps most of the way and then spins to get an accurate frame time,
+	//and gives us back the difference since the last frame, in seconds
+	double deltaTime;
 	{
-		SDL_Delay(timeToWait);
+		PROFILE_SCOPE("FramePacer::WaitForNextFrame");
+		deltaTime = framePacer.WaitForNextFrame();
 	}
-	//if i want an uncapped framerate, I can comment out the if statement above
-
-	//the difference in ticks since the last frame, converted to seconds
-	double deltaTime = (SDL_GetTicks() - millisecsPreviousFrame) / 1000.0f;
-
-	//store the current frame time
-	millisecsPreviousFrame = SDL_GetTicks();
+	PROFILE_SCOPE("Game::Update");
+	if (fixedDeltaTime > 0.0)
+	{
+		deltaTime = fixedDeltaTime;
+	}
+	framePacer.BeginUpdate();
 
 	//these two lines below no longer needed, this will be done in the MovementSystem
 	//playerPosition.x += playerVelocity.x * deltaTime;
@@ -285,18 +735,54 @@ void Game::Update()
 
 
 	//Update the registry to process the entities that are waiting to be created/deleted
+	const Uint64 registryUpdateStart = SDL_GetPerformanceCounter();
 	registry->Update();
+	registryUpdateMilliseconds = (SDL_GetPerformanceCounter() - registryUpdateStart) * 1000.0 / SDL_GetPerformanceFrequency();
 
 	//Invoke all systems that need to update
-	registry->GetSystem<MovementSystem>().Update(deltaTime);
+	{
+		MovementSystem& movementSystem = registry->GetSystem<MovementSystem>();
+		SystemTimer timer(movementSystem);
+		movementSystem.Update(deltaTime);
+	}
 	//registry->GetSystem<CollisionSystem>().Update();
 
-	
+	//In deterministic mode hash the whole simulation state so runs can be compared tick by tick
+	if (isDeterministic)
+	{
+		lastStateHash = stateHashLog.Record(currentTick, *registry);
+	}
+
+	//spawns and kills happen at the end of the tick, the registry picks them up at the start of the next one
+	if (isStressTest)
+	{
+		stressScene.Update(*registry);
+	}
+	if (sceneSwitchInterval > 0 && (currentTick + 1) % sceneSwitchInterval == 0)
+	{
+		SwitchScene();
+	}
+
+	framePacer.EndUpdate();
 
+	//the row is written at the end of the update, so the render columns are from the previous frame
+	if (frameReport.IsOpen())
+	{
+		frameReport.WriteFrame(currentTick, framePacer.GetFrameTimes().GetLatest(), framePacer.GetUpdateTimes().GetLatest(), registryUpdateMilliseconds, *registry);
+	}
+	currentTick++;
 }
 
 void Game::Render()
 {
+	if (!renderer)
+	{
+		return; //nothing to draw to
+	}
+	PROFILE_SCOPE("Game::Render");
+
+	framePacer.BeginRender();
+
 	//set colour, clear the renderer, present the renderer
 
 	SDL_SetRenderDrawColor(renderer, 21, 21, 21, 255); //colour and transparency. R,G,B,T
@@ -332,16 +818,79 @@ void Game::Render()
 
 	//TODO: Render game objects...
 
-	registry->GetSystem<RenderSystem>().Update(renderer, assetStore);
+	if (assetWatcher.IsRunning())
+	{
+		ReloadChangedAssets();
+	}
+	assetStore->Update(renderer, TEXTURE_UPLOAD_BUDGET_MS);
+	//the whole window, every frame, since a loaded snapshot doesn't carry it
+	CameraComponent& camera = GetCamera();
+	camera.viewport = { 0, 0, windowWidth, windowHeight };
+	tilemap.Render(renderer, *assetStore, camera);
+	{
+		RenderSystem& renderSystem = registry->GetSystem<RenderSystem>();
+		SystemTimer timer(renderSystem);
+		renderSystem.Update(renderer, assetStore, camera);
+	}
+	RenderText();
+
+	//drawn last so it's on top, and outside the system timers so it doesn't show up in them
+	performanceOverlay.Render(framePacer, *registry, *assetStore);
 
 	SDL_RenderPresent(renderer);
 
+	framePacer.EndRender();
+}
+
+void Game::RenderText()
+{
+	if (hudFont == FONT_HANDLE_INVALID)
+	{
+		return;
+	}
+	PROFILE_SCOPE("Game::RenderText");
+
+	//formatted into a buffer on the stack, a string that's already been drawn doesn't allocate or shape again
+	char text[64];
+	const SDL_Color labelColor = { 255, 255, 255, 220 };
+	const int lineSkip = textRenderer.GetLineSkip(hudFont);
+	const RenderSystem& renderSystem = registry->GetSystem<RenderSystem>();
+	if (isEntityLabelsEnabled)
+	{
+		const float labelHeight = static_cast<float>(textRenderer.GetLineHeight(hudFont));
+		for (const auto& layer : renderSystem.GetRenderQueue().GetLayers())
+		{
+			for (const auto& item : layer.items)
+			{
+				std::snprintf(text, sizeof(text), "#%d", item.entity.GetId());
+				//centred just above the sprite
+				textRenderer.DrawText(hudFont, text, item.dstRect.x + item.dstRect.w * 0.5f, item.dstRect.y - labelHeight, labelColor, TEXT_ALIGN_CENTER);
+			}
+		}
+	}
 
+	const SDL_Color hudColor = { 255, 255, 255, 255 };
+	const float x = 10.0f;
+	float y = static_cast<float>(windowHeight - 4 * lineSkip - 10);
+	std::snprintf(text, sizeof(text), "Tick %d", currentTick);
+	textRenderer.DrawText(hudFont, text, x, y, hudColor);
+	y += lineSkip;
+	std::snprintf(text, sizeof(text), "Entities %d", registry->GetNumLiveEntities());
+	textRenderer.DrawText(hudFont, text, x, y, hudColor);
+	y += lineSkip;
+	std::snprintf(text, sizeof(text), "Sprites %d, %d draw calls", renderSystem.GetNumVisibleSprites(), renderSystem.GetNumDrawCalls());
+	textRenderer.DrawText(hudFont, text, x, y, hudColor);
+	y += lineSkip;
+	std::snprintf(text, sizeof(text), "Frame %.1f ms", framePacer.GetFrameTimes().GetLatest());
+	textRenderer.DrawText(hudFont, text, x, y, hudColor);
+
+	textRenderer.Flush();
 }
 
 void Game::Run()
 {
 	Setup();
+	framePacer.Reset(); //don't count the level loading as part of the first frame
 	while (isRunning)
 	{
 		ProcessInput();
@@ -350,10 +899,320 @@ void Game::Run()
 	}
 }
 
+void Game::RunTicks(int numTicks)
+{
+	Setup();
+
+	//no frame cap, every tick runs straight after the previous one
+	framePacer.SetTargetFps(0);
+	framePacer.Reset();
+
+	const Uint64 startCounter = SDL_GetPerformanceCounter();
+	int tick = 0;
+	for (; tick < numTicks && isRunning; tick++)
+	{
+		ProcessInput();
+		Update();
+		Render();
+	}
+	const double elapsedSeconds = static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+
+	LOG(INFO, GAME, "Ran {} ticks in {} ms ({} ticks per second)", tick, elapsedSeconds * 1000.0, elapsedSeconds > 0.0 ? tick / elapsedSeconds : 0.0);
+}
+
+void Game::SetTargetFps(int fps)
+{
+	framePacer.SetTargetFps(fps);
+}
+
+const FramePacer& Game::GetFramePacer() const
+{
+	return framePacer;
+}
+
+void Game::SetHeadless(bool headless)
+{
+	isHeadless = headless;
+}
+
+bool Game::IsHeadless() const
+{
+	return isHeadless;
+}
+
+void Game::SetFixedDeltaTime(double seconds)
+{
+	fixedDeltaTime = seconds;
+}
+
+void Game::SetOffscreenRender(int width, int height)
+{
+	offscreenWidth = width;
+	offscreenHeight = height;
+}
+
+void Game::SetRenderBatching(bool enabled)
+{
+	isRenderBatchingEnabled = enabled;
+}
+
+void Game::SetTileChunkCaching(bool enabled)
+{
+	isTileChunkCachingEnabled = enabled;
+}
+
+void Game::SetTextureMemoryBudget(size_t bytes)
+{
+	assetStore->SetTextureMemoryBudget(bytes);
+}
+
+void Game::SetAssetHotReload(bool enabled)
+{
+	isAssetHotReloadEnabled = enabled;
+}
+
+void Game::SetAssetPack(const std::string& filePath)
+{
+	assetPackPath = filePath;
+}
+
+void Game::SetCookedAssets(const std::string& directory)
+{
+	cookedAssetsPath = directory;
+}
+
+void Game::SetEntityLabels(bool enabled)
+{
+	isEntityLabelsEnabled = enabled;
+}
+
+static void LogFrameTimeSummary(const char* name, const FrameTimeHistory& history)
+{
+	const FrameTimeSummary summary = history.GetSummary();
+	LOG(INFO, GAME, "{} ms: min {} avg {} p95 {} p99 {}", name, summary.min, summary.avg, summary.p95, summary.p99);
+}
+
+//One line per system with its IPC and counter misses per entity, over every update since hardware counters were enabled
+static void LogHardwareCounterReport(const Registry& registry)
+{
+	for (const auto& system : registry.GetSystems())
+	{
+		const HardwareCounterValues& totals = system->GetHardwareCounterTotals();
+		const double numEntities = static_cast<double>(std::max<uint64_t>(system->GetNumCountedEntities(), 1));
+
+		std::string line = system->GetName() + ": IPC ";
+		if (HardwareCounters::IsSupported(HW_CYCLES) && HardwareCounters::IsSupported(HW_INSTRUCTIONS) && totals.HasRun() && totals.values[HW_CYCLES] > 0)
+		{
+			line += std::to_string(static_cast<double>(totals.values[HW_INSTRUCTIONS]) / totals.values[HW_CYCLES]);
+		}
+		else
+		{
+			line += "n/a";
+		}
+
+		for (int counter = HW_CYCLES; counter < NUM_HW_COUNTERS; counter++)
+		{
+			if (counter == HW_INSTRUCTIONS)
+			{
+				continue;
+			}
+			line += std::string(", ") + GetHardwareCounterName(counter) + "/entity ";
+			line += HardwareCounters::IsSupported(counter) && totals.HasRun() ? std::to_string(totals.GetScaled(counter) / numEntities) : "n/a";
+		}
+		LOG(INFO, GAME, "{}", line);
+	}
+}
+
+void Game::EnableDeterministicMode(uint64_t seed)
+{
+	isDeterministic = true;
+	randomSeed = seed;
+	registry->SetRandomSeed(seed);
+
+	//the wall clock is never the same twice, so use a fixed tick
+	if (fixedDeltaTime <= 0.0)
+	{
+		fixedDeltaTime = 1.0 / 60.0;
+	}
+	LOG(INFO, GAME, "Deterministic mode enabled with seed {}", seed);
+}
+
+bool Game::OpenStateHashLog(const std::string& filePath)
+{
+	return stateHashLog.Open(filePath);
+}
+
+int Game::GetCurrentTick() const
+{
+	return currentTick;
+}
+
+uint64_t Game::GetLastStateHash() const
+{
+	return lastStateHash;
+}
+
+bool Game::StartRecording(const std::string& filePath, int keyframeInterval)
+{
+	if (!isDeterministic)
+	{
+		LOG(ERROR, GAME, "Replays can only be recorded in deterministic mode");
+		return false;
+	}
+
+	ReplayHeader header;
+	header.seed = randomSeed;
+	header.tickRate = static_cast<int>(1.0 / fixedDeltaTime + 0.5);
+	header.keyframeInterval = std::max(keyframeInterval, 1);
+	this->keyframeInterval = header.keyframeInterval;
+	return replayRecorder.Open(filePath, header);
+}
+
+bool Game::StartReplay(const std::string& filePath, int seekTick)
+{
+	if (!replayPlayer.Open(filePath))
+	{
+		return false;
+	}
+
+	//the replay only plays back the same way with the same seed and tick
+	const ReplayHeader& header = replayPlayer.GetHeader();
+	fixedDeltaTime = 1.0 / std::max(header.tickRate, 1);
+	EnableDeterministicMode(header.seed);
+
+	isReplaying = true;
+	replaySeekTick = seekTick;
+	return true;
+}
+
+void Game::SetStressPreset(const StressPreset& preset)
+{
+	stressPreset = preset;
+	isStressTest = true;
+}
+
+void Game::SetSceneSwitchInterval(int ticks)
+{
+	sceneSwitchInterval = std::max(ticks, 0);
+}
+
+bool Game::OpenFrameReport(const std::string& filePath)
+{
+	return frameReport.Open(filePath);
+}
+
+void Game::SetFrameAllocationLimit(int maxAllocations, int warmupTicks)
+{
+	frameAllocationLimit = maxAllocations;
+	allocationWarmupTicks = warmupTicks;
+}
+
+int Game::GetNumFramesOverAllocationLimit() const
+{
+	return numFramesOverAllocationLimit;
+}
+
+void Game::SeekReplay(int tick)
+{
+	const int keyframeTick = replayPlayer.SeekToKeyframe(tick, *registry);
+	if (keyframeTick < 0)
+	{
+		LOG(ERROR, GAME, "No replay keyframe before tick {}, playing from the start", tick);
+		return;
+	}
+	currentTick = keyframeTick;
+
+	//simulate the few ticks between the keyframe and the one we want as fast as possible
+	const int targetFps = framePacer.GetTargetFps();
+	framePacer.SetTargetFps(0);
+	while (currentTick < tick && isRunning)
+	{
+		ProcessInput();
+		Update();
+	}
+	framePacer.SetTargetFps(targetFps);
+
+	LOG(INFO, GAME, "Replay jumped to tick {} from keyframe at tick {}", currentTick, keyframeTick);
+}
+
+CameraComponent& Game::GetCamera() const
+{
+	return registry->GetComponent<CameraComponent>(Entity(cameraEntityId));
+}
+
 void Game::Destroy()
 {
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
+	//print the timings of the last frames so we can see how stable the frame rate was
+	LogFrameTimeSummary("Frame", framePacer.GetFrameTimes());
+	LogFrameTimeSummary("Update", framePacer.GetUpdateTimes());
+	LogFrameTimeSummary("Render", framePacer.GetRenderTimes());
+	if (registry->HasSystem<RenderSystem>())
+	{
+		const RenderSystem& renderSystem = registry->GetSystem<RenderSystem>();
+		LOG
+		(
+			INFO, RENDER, "Render path: {}, {} draw calls for {} visible sprites in the last frame",
+			renderSystem.IsBatchingEnabled() ? "batched" : "one sprite at a time", renderSystem.GetNumDrawCalls(), renderSystem.GetNumVisibleSprites()
+		);
+		LOG
+		(
+			INFO, RENDER, "Tilemap: {}, {} draw calls in the last frame, {} chunks cached",
+			tilemap.IsChunkCachingEnabled() ? "cached chunks" : "one tile at a time", tilemap.GetNumDrawCalls(), tilemap.GetNumResidentChunks()
+		);
+	}
+	if (hudFont != FONT_HANDLE_INVALID)
+	{
+		LOG
+		(
+			INFO, RENDER, "Text: {} draw calls for {} glyphs in the last frame, {} strings cached on {} glyph pages",
+			textRenderer.GetNumDrawCalls(), textRenderer.GetNumGlyphsDrawn(), textRenderer.GetNumShapedTexts(), textRenderer.GetNumPages()
+		);
+	}
+	if (HardwareCounters::IsEnabled())
+	{
+		LogHardwareCounterReport(*registry);
+	}
+	if (renderer)
+	{
+		const AssetCacheStats& cacheStats = assetStore->GetCacheStats();
+		LOG
+		(
+			INFO, ASSETS, "Texture cache: {} hits, {} misses, {} evictions, {} reloads, {} bytes of textures left",
+			cacheStats.hits, cacheStats.misses, cacheStats.evictions, cacheStats.reloads, assetStore->GetTextureMemoryUsage()
+		);
+	}
+	MemoryTracker::LogReport();
+	if (frameAllocationLimit >= 0)
+	{
+		LOG(INFO, GAME, "{} frames went over the limit of {} heap allocations", numFramesOverAllocationLimit, frameAllocationLimit);
+		LOG(INFO, GAME, "Worker threads made {} heap allocations after the warm up, not counted against the limit", totalWorkerAllocations);
+	}
+
+	//the level or stress scene is torn down before the asset store goes
+	UnloadScene();
+	assetWatcher.Stop();
+	performanceOverlay.Destroy();
+	textRenderer.Destroy(); //closes the fonts, before TTF_Quit()
+	if (TTF_WasInit())
+	{
+		TTF_Quit();
+	}
+	tilemap.DestroyTextures();
+	if (renderer)
+	{
+		SDL_DestroyRenderer(renderer);
+	}
+	if (offscreenSurface)
+	{
+		SDL_FreeSurface(offscreenSurface);
+	}
+	if (window)
+	{
+		SDL_DestroyWindow(window);
+	}
+	replayRecorder.Close(currentTick);
+	stateHashLog.Close();
+	frameReport.Close();
 	SDL_Quit();
 	//delete registry;
 }
\ No newline at end of file
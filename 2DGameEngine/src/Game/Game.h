@@ -24,35 +24,185 @@
 #include <SDL.h>
 #include "../ECS/ECS.h"
 #include "../AssetStore/AssetStore.h"
+#include "../Components/CameraComponent.h"
+#include "../Tilemap/Tilemap.h"
+#include "../FramePacer/FramePacer.h"
+#include "../Determinism/StateHashLog.h"
+#include "../Replay/Replay.h"
+#include "../Stress/StressScene.h"
+#include "../Stats/FrameReport.h"
+#include "../Overlay/PerformanceOverlay.h"
+#include "../Platform/FileWatcher.h"
+#include "../Render/TextRenderer.h"
 
-const int FPS = 240; //framerate we want to run the game
-const int MILLISECS_PER_FRAME = 1000 / FPS; //target frametime. 1000=1second, determins how many miliseconds are per frame
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0; //per frame, for textures that finished decoding on the asset store's workers
+const char* const ASSET_PACK_FILE_PATH = "./assets.pak"; //packed from ./assets by 2DGameEngineCooker, loose files are used without it
+const char* const COOKED_ASSETS_DIRECTORY = "./cooked"; //cooked from ./assets by 2DGameEngineCooker, the source files are decoded without it
+const char* const LEVEL_MAP_FILE_PATH = "./assets/tilemaps/jungle.bmap"; //cooked from LEVEL_TEXT_MAP_FILE_PATH
+const char* const LEVEL_TEXT_MAP_FILE_PATH = "./assets/tilemaps/jungle.map";
+const char* const HUD_FONT_FILE_PATH = "./assets/fonts/arial.ttf";
+const int HUD_FONT_SIZE = 14;
 
 class Game
 {
 private:
 	bool isRunning;
-	int millisecsPreviousFrame = 0;
-	SDL_Window* window;
-	SDL_Renderer* renderer;
+	bool isHeadless = false; //no window, renderer or audio. Only the registry and simulation systems run
+	int offscreenWidth = 0; //when headless with a size set, sprites are still drawn by a software renderer into a surface
+	int offscreenHeight = 0;
+	SDL_Surface* offscreenSurface = nullptr;
+	bool isRenderBatchingEnabled = true;
+	bool isTileChunkCachingEnabled = true;
+	double fixedDeltaTime = 0.0; //when > 0 every update uses this instead of the measured frame time
+	bool isDeterministic = false; //fixed tick, seeded randomness and a state hash every tick
+	int currentTick = 0; //number of simulation ticks run so far
+	uint64_t randomSeed = 0;
+	uint64_t lastStateHash = 0;
+	StateHashLog stateHashLog;
+
+	//Input recording and replay. Input for each tick is collected here first,
+	//from SDL when playing or from the replay file when replaying
+	std::vector<InputEvent> tickInputEvents;
+	ReplayRecorder replayRecorder;
+	ReplayPlayer replayPlayer;
+	bool isReplaying = false;
+	int replaySeekTick = 0;
+	int keyframeInterval = DEFAULT_KEYFRAME_INTERVAL;
+
+	bool TranslateSdlEvent(const SDL_Event& sdlEvent, InputEvent& inputEvent) const;
+	void HandleInputEvent(const InputEvent& inputEvent);
+	bool HandleDebugKey(const SDL_Event& sdlEvent); //F1/F3/F5, never recorded or replayed
+	void SeekReplay(int tick);
+
+	//Stress testing: a generated scene instead of the level, and a CSV row of timings every tick
+	bool isStressTest = false;
+	StressPreset stressPreset;
+	StressScene stressScene;
+	FrameReport frameReport;
+
+	//Textures the level or stress scene took a reference to, they're given back when it's unloaded
+	std::vector<AssetHandle> sceneTextures;
+	int sceneSwitchInterval = 0; //ticks, 0 = never
+	void LoadSceneTexture(const std::string& assetId, const std::string& filePath);
+	void UnloadScene(); //kills every entity and releases the scene's textures, the systems stay
+	void SwitchScene(); //unloads the level and loads the stress scene, or the other way round (F5)
+	double registryUpdateMilliseconds = 0.0;
+
+	//Heap allocations per frame, on the main thread. After the warm up ticks, every frame that allocates
+	//more than the limit is logged and counted (-1 = no limit). Worker threads are only counted, they have no limit
+	int frameAllocationLimit = -1;
+	int allocationWarmupTicks = 0;
+	uint64_t lastFrameAllocations = 0;
+	uint64_t lastFrameWorkerAllocations = 0;
+	uint64_t totalWorkerAllocations = 0; //since the warm up
+	int numFramesOverAllocationLimit = 0;
+	void CheckFrameAllocations();
+
+	FramePacer framePacer; //keeps us at the target framerate and records frame/update/render times
+	PerformanceOverlay performanceOverlay;
+	SDL_Window* window = nullptr;
+	SDL_Renderer* renderer = nullptr;
 
 	//Registry* registry; //Replaced with smart pointer
 	std::unique_ptr<Registry> registry;
 	std::unique_ptr<AssetStore> assetStore;
 
+	//The camera is an entity like everything else, so it's part of the state hash and the replay keyframes
+	int cameraEntityId = -1;
+	CameraComponent& GetCamera() const;
+
+	Tilemap tilemap; //the level's ground tiles, they aren't entities
+	//Loads the level's tiles, or reloads them when the map changed. The text map is imported instead of the cooked one
+	//when it's the file that changed, the cooked map is out of date until it's cooked again
+	void LoadLevelMap(bool preferTextMap = false);
+
+	std::string assetPackPath = ASSET_PACK_FILE_PATH; //empty to load loose files only
+	std::string cookedAssetsPath = COOKED_ASSETS_DIRECTORY; //empty to decode the source files
+
+	//Hot reloading: files changed under ./assets are reloaded between frames while the game runs
+	bool isAssetHotReloadEnabled = false;
+	FileWatcher assetWatcher;
+	std::vector<std::string> changedAssetFiles;
+	void ReloadChangedAssets();
+
+	//Text drawn over the game: HUD counters, and a label over every visible sprite when they're turned on
+	TextRenderer textRenderer;
+	FontHandle hudFont = FONT_HANDLE_INVALID;
+	bool isEntityLabelsEnabled = false;
+	void RenderText();
+
 public:
 	Game(); //constructor
 	~Game(); //destructor
 
 	void Initialize();
 	void Run();
+	void RunTicks(int numTicks); //runs a fixed number of ticks as fast as possible, then returns
 	void Setup();
 	void LoadLevel(int level);
+	void LoadSystemsAndAssets();
+	void LoadStressScene();
 	void ProcessInput();
 	void Update();
 	void Render();
 	void Destroy();
 
+	//target framerate can be changed at runtime, 0 = uncapped
+	void SetTargetFps(int fps);
+	const FramePacer& GetFramePacer() const;
+
+	//must be set before Initialize()
+	void SetHeadless(bool headless);
+	bool IsHeadless() const;
+	void SetFixedDeltaTime(double seconds);
+	//Headless, but everything is still drawn with SDL's software renderer into a width x height surface,
+	//so render times can be measured without a window. Must be set before Initialize()
+	void SetOffscreenRender(int width, int height);
+	//Batched sprite drawing (on by default), off draws one sprite at a time. Must be set before Setup()
+	void SetRenderBatching(bool enabled);
+	//Tile chunks baked into cached textures (on by default), off draws every visible tile every frame
+	void SetTileChunkCaching(bool enabled);
+	//Unreferenced textures are evicted, least recently drawn first, once textures use more than this
+	void SetTextureMemoryBudget(size_t bytes);
+	//Watches ./assets and reloads textures and the level's map when their files change (off by default). Must be set before Setup()
+	void SetAssetHotReload(bool enabled);
+	//Assets are loaded from this pack when it exists, instead of the loose files under ./assets. Empty for loose files only.
+	//Must be set before Setup()
+	void SetAssetPack(const std::string& filePath);
+	//Images and maps are loaded from the cooked files in this directory (it can be in the pack) when it has a manifest.
+	//Empty for the source files only. Must be set before Setup()
+	void SetCookedAssets(const std::string& directory);
+	//Draws every visible sprite's entity id over it (off by default), hundreds of labels a frame in a busy scene
+	void SetEntityLabels(bool enabled);
+
+	//Deterministic mode: the simulation runs with a fixed tick and seeded random numbers,
+	//and all component pools are hashed every tick so two runs can be compared.
+	//Must be set before Initialize()
+	void EnableDeterministicMode(uint64_t seed);
+	bool OpenStateHashLog(const std::string& filePath);
+	int GetCurrentTick() const;
+	uint64_t GetLastStateHash() const;
+
+	//Records every input event to a replay file, with a registry keyframe every
+	//keyframeInterval ticks. Needs deterministic mode
+	bool StartRecording(const std::string& filePath, int keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+	//Plays back a replay instead of live input (turns on deterministic mode with the replay's seed).
+	//seekTick jumps to the closest keyframe first, so earlier ticks don't have to be simulated.
+	//Must be called before Initialize()
+	bool StartReplay(const std::string& filePath, int seekTick = 0);
+
+	//Loads a generated stress scene instead of the level (see StressScene.h). Must be called before Setup()
+	void SetStressPreset(const StressPreset& preset);
+	//Switches between the level and the stress scene every n ticks (0 = never), so the textures only one of them uses
+	//are released, evicted when they're over the texture budget, and loaded again on the way back. Not while recording or replaying
+	void SetSceneSwitchInterval(int ticks);
+	//Writes frame, system and memory stats for every tick to a CSV file
+	bool OpenFrameReport(const std::string& filePath);
+
+	//Heap allocation budget per frame once the game has warmed up, our target is 0
+	void SetFrameAllocationLimit(int maxAllocations, int warmupTicks);
+	int GetNumFramesOverAllocationLimit() const;
+
 	int windowWidth;
 	int windowHeight;
 
@@ -0,0 +1,66 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(int numThreads)
+{
+	if (numThreads <= 0)
+	{
+		//hardware_concurrency() is 0 when it can't tell
+		numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+	}
+	this->numThreads = numThreads;
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		isStopping = true;
+	}
+	jobAvailable.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::WorkerThread()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobAvailable.wait(lock, [this] { return isStopping || !jobs.empty(); });
+			if (jobs.empty())
+			{
+				return; //stopping, and everything queued has been done
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		jobs.push_back(std::move(job));
+	}
+	if (workers.empty())
+	{
+		for (int i = 0; i < numThreads; i++)
+		{
+			workers.emplace_back(&ThreadPool::WorkerThread, this);
+		}
+	}
+	jobAvailable.notify_one();
+}
+
+int ThreadPool::GetNumThreads() const
+{
+	return numThreads;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+// ThreadPool
+////////////////////////////////////////////////////////////////////////
+// A few worker threads that run jobs in the order they were submitted.
+// It's for slow work that doesn't touch the game state or SDL's video
+// functions, like decoding images while a level loads. Jobs hand their
+// results back to the main thread themselves.
+// Jobs are submitted from one thread (the main one).
+// The threads are only started by the first Submit(), so a headless run
+// that never loads anything never has them. The destructor lets the
+// queued jobs finish before it joins the threads.
+////////////////////////////////////////////////////////////////////////
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex jobsMutex;
+	std::condition_variable jobAvailable;
+	int numThreads;
+	bool isStopping = false;
+
+	void WorkerThread();
+
+public:
+	//0 threads means one per core, less the one the main thread runs on
+	explicit ThreadPool(int numThreads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator =(const ThreadPool&) = delete;
+
+	void Submit(std::function<void()> job);
+	int GetNumThreads() const;
+};
@@ -1,44 +1,628 @@
 #include "Logger.h"
-#include <iostream>
+#include "../Memory/MemoryTracker.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <string>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+bool Logger::isEnabled = true;
+LogType Logger::categoryLevels[NUM_LOG_CATEGORIES] = { LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO };
+
+const char* GetLogCategoryName(int category)
+{
+	switch (category)
+	{
+	case LOG_CATEGORY_GENERAL: return "general";
+	case LOG_CATEGORY_ECS: return "ecs";
+	case LOG_CATEGORY_ASSETS: return "assets";
+	case LOG_CATEGORY_RENDER: return "render";
+	case LOG_CATEGORY_GAME: return "game";
+	}
+	return "unknown";
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Log queue
+////////////////////////////////////////////////////////////////////////
+// Bounded multi-producer single-consumer queue (Dmitry Vyukov's design).
+// Every slot has a sequence number that says whether it's free for the
+// producer of that lap or holds a record for the consumer, so producers
+// only ever do one compare-exchange on the write position and no locks.
+////////////////////////////////////////////////////////////////////////
+const size_t LOG_QUEUE_SIZE = 4096; //must be a power of two
+const size_t LOG_RECORD_PAYLOAD_SIZE = LOG_ARGUMENTS_SIZE; //longer messages get cut off
+
+struct LogRecord
+{
+	std::atomic<size_t> sequence;
+	LogType type;
+	LogCategory category;
+	uint16_t length;
+	bool isTruncated; //some of the arguments didn't fit
+	uint32_t fullLength; //of the text before it was cut off to fit the payload
+	const char* format; //nullptr when the payload is already the message text
+	int64_t timestamp; //system clock, in seconds
+	uint8_t payload[LOG_RECORD_PAYLOAD_SIZE]; //message text, or the captured LogArguments
+};
+
+struct LogQueue
+{
+	LogRecord records[LOG_QUEUE_SIZE];
+	alignas(64) std::atomic<size_t> writePosition{ 0 };
+	alignas(64) size_t readPosition = 0; //only the background thread reads
+
+	LogQueue()
+	{
+		for (size_t i = 0; i < LOG_QUEUE_SIZE; i++)
+		{
+			records[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	//Returns false if the queue is full
+	bool TryPush(LogType type, LogCategory category, const char* format, int64_t timestamp, const void* payload, size_t length, bool isTruncated)
+	{
+		size_t position = writePosition.load(std::memory_order_relaxed);
+		LogRecord* record;
+		for (;;)
+		{
+			record = &records[position & (LOG_QUEUE_SIZE - 1)];
+			const size_t sequence = record->sequence.load(std::memory_order_acquire);
+			const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0)
+			{
+				//the slot is free for this lap, try to claim it
+				if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false; //the consumer hasn't got to this slot yet
+			}
+			else
+			{
+				position = writePosition.load(std::memory_order_relaxed); //someone else claimed it
+			}
+		}
+
+		record->type = type;
+		record->category = category;
+		record->format = format;
+		record->isTruncated = isTruncated;
+		record->fullLength = static_cast<uint32_t>(std::min<size_t>(length, UINT32_MAX));
+		record->timestamp = timestamp;
+		record->length = static_cast<uint16_t>(std::min(length, LOG_RECORD_PAYLOAD_SIZE));
+		std::memcpy(record->payload, payload, record->length);
+		record->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Background thread only. The record stays valid until Pop()
+	LogRecord* Peek()
+	{
+		LogRecord* record = &records[readPosition & (LOG_QUEUE_SIZE - 1)];
+		if (record->sequence.load(std::memory_order_acquire) != readPosition + 1)
+		{
+			return nullptr;
+		}
+		return record;
+	}
+
+	void Pop(LogRecord* record)
+	{
+		record->sequence.store(readPosition + LOG_QUEUE_SIZE, std::memory_order_release);
+		readPosition++;
+	}
+};
+
+
+//A message in the history, cut short if it doesn't fit
+struct LogHistorySlot
+{
+	LogType type;
+	LogCategory category;
+	uint16_t length;
+	char text[LOG_HISTORY_MESSAGE_SIZE];
+};
+
+//Where a batch of messages is formatted. The background thread keeps one for as long as it runs, so the strings
+//only grow to their working size once
+struct LogBuffers
+{
+	std::string message;
+	std::string consoleBatch;
+	std::string fileBatch;
+};
+
+////////////////////////////////////////////////////////////////////////
+// Logger state
+////////////////////////////////////////////////////////////////////////
+// Everything lives in one object so it's created and destroyed in a
+// known order, and the destructor writes out what's left at exit
+////////////////////////////////////////////////////////////////////////
+struct LoggerState
+{
+	LogQueue queue;
+	std::thread thread;
+	std::once_flag startFlag;
+	std::atomic<bool> isRunning{ false };
+	std::atomic<bool> isShutdown{ false };
+	std::atomic<uint64_t> numPushed{ 0 };
+	std::atomic<uint64_t> numWritten{ 0 };
+	std::atomic<uint64_t> numDropped{ 0 };
+	uint64_t numDroppedReported = 0;
+
+	std::mutex outputMutex; //held while writing a batch, so a direct write after Shutdown() can't interleave with it
+	FILE* logFile = nullptr;
+
+	std::mutex historyMutex;
+	std::vector<LogHistorySlot, TrackingAllocator<LogHistorySlot, MEMORY_TAG_LOGGER>> history; //all LOG_HISTORY_SIZE slots, allocated with the first message
+	size_t historySize = 0; //slots in use
+	size_t historyNext = 0;
+
+	//the timestamp text only changes once a second, so it's only formatted then
+	int64_t cachedTimestamp = -1;
+	char cachedTimestampText[32] = {};
+
+	~LoggerState()
+	{
+		Logger::Shutdown();
+		if (logFile)
+		{
+			std::fclose(logFile);
+		}
+	}
+};
+
+static LoggerState state;
+
+static int64_t GetTimestamp()
+{
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static const char* FormatTimestamp(int64_t timestamp)
+{
+	if (timestamp != state.cachedTimestamp)
+	{
+		const std::time_t time = static_cast<std::time_t>(timestamp);
+		struct tm timeinfo;
+#if defined(_WIN32)
+		localtime_s(&timeinfo, &time);
+#else
+		localtime_r(&time, &timeinfo);
+#endif
+		//strftime returns 0 if it doesn't fit, so the text is always terminated either way
+		if (std::strftime(state.cachedTimestampText, sizeof(state.cachedTimestampText), "%d-%b-%Y %H:%M:%S", &timeinfo) == 0)
+		{
+			state.cachedTimestampText[0] = '\0';
+		}
+		state.cachedTimestamp = timestamp;
+	}
+	return state.cachedTimestampText;
+}
+
+static void AddToHistory(LogType type, LogCategory category, const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(state.historyMutex);
+	if (state.history.empty())
+	{
+		state.history.resize(LOG_HISTORY_SIZE);
+	}
+	LogHistorySlot& slot = state.history[state.historyNext];
+	slot.type = type;
+	slot.category = category;
+	slot.length = static_cast<uint16_t>(std::min(message.size(), LOG_HISTORY_MESSAGE_SIZE));
+	std::memcpy(slot.text, message.data(), slot.length);
+	if (message.size() > LOG_HISTORY_MESSAGE_SIZE)
+	{
+		std::memcpy(slot.text + LOG_HISTORY_MESSAGE_SIZE - 3, "...", 3);
+	}
+	state.historyNext = (state.historyNext + 1) % LOG_HISTORY_SIZE;
+	state.historySize = std::min(state.historySize + 1, LOG_HISTORY_SIZE);
+}
+
+//Reads the next captured argument and appends it as text. Returns false when there are none left
+static bool AppendArgument(const uint8_t*& data, const uint8_t* end, std::string& output)
+{
+	if (data >= end)
+	{
+		return false;
+	}
+	const LogArgumentType type = static_cast<LogArgumentType>(*data++);
+
+	char buffer[32];
+	int64_t signedValue;
+	uint64_t unsignedValue;
+	double doubleValue;
+	uint16_t length;
+	switch (type)
+	{
+	case LOG_ARGUMENT_INT:
+		std::memcpy(&signedValue, data, sizeof(signedValue));
+		data += sizeof(signedValue);
+		std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(signedValue));
+		output += buffer;
+		return true;
+
+	case LOG_ARGUMENT_UINT:
+	case LOG_ARGUMENT_POINTER:
+		std::memcpy(&unsignedValue, data, sizeof(unsignedValue));
+		data += sizeof(unsignedValue);
+		std::snprintf(buffer, sizeof(buffer), type == LOG_ARGUMENT_POINTER ? "0x%llx" : "%llu", static_cast<unsigned long long>(unsignedValue));
+		output += buffer;
+		return true;
+
+	case LOG_ARGUMENT_DOUBLE:
+		std::memcpy(&doubleValue, data, sizeof(doubleValue));
+		data += sizeof(doubleValue);
+		std::snprintf(buffer, sizeof(buffer), "%g", doubleValue);
+		output += buffer;
+		return true;
+
+	case LOG_ARGUMENT_BOOL:
+		output += (*data++) ? "true" : "false";
+		return true;
+
+	case LOG_ARGUMENT_CHAR:
+		output += static_cast<char>(*data++);
+		return true;
+
+	case LOG_ARGUMENT_STRING:
+		std::memcpy(&length, data, sizeof(length));
+		data += sizeof(length);
+		output.append(reinterpret_cast<const char*>(data), length);
+		data += length;
+		return true;
+	}
+	return false;
+}
+
+//Replaces every {} in the format with the next captured argument
+static void AppendFormatted(const char* format, const uint8_t* arguments, size_t argumentsSize, std::string& output)
+{
+	const uint8_t* data = arguments;
+	const uint8_t* end = arguments + argumentsSize;
+	for (const char* c = format; *c; c++)
+	{
+		if (c[0] == '{' && c[1] == '}')
+		{
+			if (!AppendArgument(data, end, output))
+			{
+				output += "{?}"; //more placeholders than arguments, or the arguments got cut off
+			}
+			c++;
+		}
+		else if ((c[0] == '{' && c[1] == '{') || (c[0] == '}' && c[1] == '}'))
+		{
+			output += *c;
+			c++;
+		}
+		else
+		{
+			output += *c;
+		}
+	}
+}
+
+//Formats one message into the console and file batches. fullLength is how long the text was before it was cut off
+//to fit the payload
+static void AppendMessage(LogType type, LogCategory category, int64_t timestamp, const char* format, const uint8_t* payload, size_t length, bool isTruncated, size_t fullLength, LogBuffers& buffers)
+{
+	static const char* const prefixes[] = { "DBG: [", "LOG: [", "WRN: [", "ERR: [" };
+	static const char* const colours[] = { "\x1B[90m", "\x1B[32m", "\x1B[33m", "\x1B[91m" };
+
+	std::string& message = buffers.message;
+	message.assign(prefixes[type]);
+	message += FormatTimestamp(timestamp);
+	message += "]: ";
+	if (category != LOG_CATEGORY_GENERAL)
+	{
+		message += "[";
+		message += GetLogCategoryName(category);
+		message += "] ";
+	}
+	if (format)
+	{
+		AppendFormatted(format, payload, length, message);
+	}
+	else
+	{
+		message.append(reinterpret_cast<const char*>(payload), length);
+	}
+	char note[80];
+	if (isTruncated)
+	{
+		std::snprintf(note, sizeof(note), "... [arguments past %zu bytes left out]", LOG_ARGUMENTS_SIZE);
+		message += note;
+	}
+	else if (fullLength > length)
+	{
+		std::snprintf(note, sizeof(note), "... [cut off, %zu of %zu bytes]", length, fullLength);
+		message += note;
+	}
 
+	// \x1B[32m - changes colour to green (grey for debug, yellow for warnings, red for errors)
+	// \033[0m - disable colour mentioned previously
+	buffers.consoleBatch += colours[type];
+	buffers.consoleBatch += message;
+	buffers.consoleBatch += "\033[0m\n";
+	if (state.logFile)
+	{
+		buffers.fileBatch += message;
+		buffers.fileBatch += '\n';
+	}
+	AddToHistory(type, category, message);
+}
+
+static void WriteBatch(const LogBuffers& buffers)
+{
+	//one write per batch instead of a flush per line
+	if (!buffers.consoleBatch.empty())
+	{
+		std::fwrite(buffers.consoleBatch.data(), 1, buffers.consoleBatch.size(), stdout);
+		std::fflush(stdout);
+	}
+	if (state.logFile && !buffers.fileBatch.empty())
+	{
+		std::fwrite(buffers.fileBatch.data(), 1, buffers.fileBatch.size(), state.logFile);
+		std::fflush(state.logFile);
+	}
+}
+
+//Takes everything that's in the queue right now and writes it out. Returns how many records there were
+static size_t DrainQueue(LogBuffers& buffers)
+{
+	std::lock_guard<std::mutex> lock(state.outputMutex);
+	buffers.consoleBatch.clear();
+	buffers.fileBatch.clear();
+
+	size_t numRecords = 0;
+	LogRecord* record;
+	while (numRecords < LOG_QUEUE_SIZE && (record = state.queue.Peek()))
+	{
+		AppendMessage(record->type, record->category, record->timestamp, record->format, record->payload, record->length, record->isTruncated, record->fullLength, buffers);
+		state.queue.Pop(record);
+		numRecords++;
+	}
 
-std::vector<LogEntry> Logger::messages; //need to define what was declared in the header file
+	const uint64_t numDropped = state.numDropped.load(std::memory_order_relaxed);
+	if (numDropped != state.numDroppedReported)
+	{
+		char text[96];
+		const int textLength = std::snprintf(text, sizeof(text), "%llu log messages were dropped, the log queue was full", static_cast<unsigned long long>(numDropped - state.numDroppedReported));
+		AppendMessage(LOG_WARNING, LOG_CATEGORY_GENERAL, GetTimestamp(), nullptr, reinterpret_cast<const uint8_t*>(text), textLength, false, textLength, buffers);
+		state.numDroppedReported = numDropped;
+	}
 
+	WriteBatch(buffers);
+	state.numWritten.fetch_add(numRecords, std::memory_order_release);
+	return numRecords;
+}
 
-std::string CurrentDateTimeToString()
+static void BackgroundThread()
 {
-	std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-	std::string output(30, '\0');
-	struct tm timeinfo;
-	localtime_s(&timeinfo, &now);
-	std::strftime(&output[0], output.size(), "%d-%b-%Y %H:%M:%S", &timeinfo);
-	return output;
+	LogBuffers buffers;
+	while (state.isRunning.load(std::memory_order_acquire))
+	{
+		if (DrainQueue(buffers) == 0)
+		{
+			//nothing to do, a short sleep keeps this cheap and still gets messages out quickly
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	DrainQueue(buffers); //whatever came in while stopping
 }
 
-//time_t - the "_t" usually shows it's a C data type
-// strftime - can look at online documentation for what each "%" does
+static void StartBackgroundThread()
+{
+	std::call_once(state.startFlag, []()
+	{
+		state.isRunning.store(true, std::memory_order_release);
+		state.thread = std::thread(BackgroundThread);
+	});
+}
 
+//Used once the background thread has been stopped
+static void WriteDirectly(LogType type, LogCategory category, const char* format, const void* payload, size_t length, bool isTruncated)
+{
+	std::lock_guard<std::mutex> lock(state.outputMutex);
+	LogBuffers buffers;
+	AppendMessage(type, category, GetTimestamp(), format, static_cast<const uint8_t*>(payload), std::min(length, LOG_RECORD_PAYLOAD_SIZE), isTruncated, length, buffers);
+	WriteBatch(buffers);
+}
 
+//Errors wait for space in the queue, everything else is dropped if it's full
+static void Push(LogType type, LogCategory category, const char* format, const void* payload, size_t length, bool isTruncated = false)
+{
+	if (state.isShutdown.load(std::memory_order_acquire))
+	{
+		WriteDirectly(type, category, format, payload, length, isTruncated);
+		return;
+	}
+	StartBackgroundThread();
+
+	const int64_t timestamp = GetTimestamp();
+	while (!state.queue.TryPush(type, category, format, timestamp, payload, length, isTruncated))
+	{
+		if (type < LOG_ERROR)
+		{
+			state.numDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		std::this_thread::yield();
+	}
+	state.numPushed.fetch_add(1, std::memory_order_release);
+}
+
+
+
+void Logger::SetEnabled(bool enabled)
+{
+	isEnabled = enabled;
+}
 
 void Logger::Log(const std::string& message)
 {
-	LogEntry logEntry;
-	logEntry.type = LOG_INFO;
-	logEntry.message = "LOG: [" + CurrentDateTimeToString() + "]: " + message;
-	std::cout << "\x1B[32m" << logEntry.message << "\033[0m" << std::endl;
-	messages.push_back(logEntry);
+	if (!IsEnabled(LOG_INFO, LOG_CATEGORY_GENERAL))
+	{
+		return;
+	}
+	Push(LOG_INFO, LOG_CATEGORY_GENERAL, nullptr, message.data(), message.size());
 }
-// \x1B[32m - changes colour to green
-// |033[0m - disable colour mentioned previously
 
 void Logger::Err(const std::string& message)
 {
-	LogEntry logEntry;
-	logEntry.type = LOG_ERROR;
-	logEntry.message = "ERR: [" + CurrentDateTimeToString() + "]: " + message;
-	messages.push_back(logEntry);
-	std::cerr << "\x1B[91m" << logEntry.message << "\033[0m" << std::endl;
+	Push(LOG_ERROR, LOG_CATEGORY_GENERAL, nullptr, message.data(), message.size());
+}
+
+void Logger::Write(LogType level, LogCategory category, const char* format, const LogArguments& arguments)
+{
+	Push(level, category, format, arguments.data, arguments.size, arguments.isTruncated);
+}
+
+void Logger::SetLevel(LogType level)
+{
+	for (int category = 0; category < NUM_LOG_CATEGORIES; category++)
+	{
+		categoryLevels[category] = level;
+	}
+}
+
+void Logger::SetCategoryLevel(LogCategory category, LogType level)
+{
+	categoryLevels[category] = level;
+}
+
+static bool ParseLogLevel(const std::string& text, LogType& level)
+{
+	static const char* const names[] = { "debug", "info", "warning", "error" };
+	for (int i = LOG_DEBUG; i <= LOG_ERROR; i++)
+	{
+		if (text == names[i])
+		{
+			level = static_cast<LogType>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Logger::SetLevelsFromString(const std::string& filter)
+{
+	size_t start = 0;
+	while (start <= filter.size())
+	{
+		size_t end = filter.find(',', start);
+		if (end == std::string::npos)
+		{
+			end = filter.size();
+		}
+		const std::string entry = filter.substr(start, end - start);
+		start = end + 1;
+		if (entry.empty())
+		{
+			continue;
+		}
+
+		//"level" sets every category, "category=level" just that one
+		const size_t equals = entry.find('=');
+		LogType level;
+		if (!ParseLogLevel(equals == std::string::npos ? entry : entry.substr(equals + 1), level))
+		{
+			Err("Unknown log level in " + entry + ", expected debug, info, warning or error");
+			return false;
+		}
+		if (equals == std::string::npos)
+		{
+			SetLevel(level);
+			continue;
+		}
+
+		const std::string categoryName = entry.substr(0, equals);
+		int category = 0;
+		while (category < NUM_LOG_CATEGORIES && categoryName != GetLogCategoryName(category))
+		{
+			category++;
+		}
+		if (category == NUM_LOG_CATEGORIES)
+		{
+			Err("Unknown log category " + categoryName);
+			return false;
+		}
+		SetCategoryLevel(static_cast<LogCategory>(category), level);
+	}
+	return true;
+}
+
+bool Logger::SetLogFile(const std::string& filePath)
+{
+	FILE* file = std::fopen(filePath.c_str(), "w");
+	if (!file)
+	{
+		Err("Could not open log file " + filePath);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(state.outputMutex);
+	if (state.logFile)
+	{
+		std::fclose(state.logFile);
+	}
+	state.logFile = file;
+	return true;
+}
+
+void Logger::Flush()
+{
+	const uint64_t target = state.numPushed.load(std::memory_order_acquire);
+	while (state.isRunning.load(std::memory_order_acquire) && state.numWritten.load(std::memory_order_acquire) < target)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void Logger::Shutdown()
+{
+	if (state.isShutdown.exchange(true))
+	{
+		return;
+	}
+	state.isRunning.store(false, std::memory_order_release);
+	if (state.thread.joinable())
+	{
+		state.thread.join();
+	}
+
+	//a message pushed just as we were stopping could have missed the thread's last pass
+	LogBuffers buffers;
+	DrainQueue(buffers);
+}
+
+std::vector<LogEntry> Logger::GetMessages()
+{
+	std::lock_guard<std::mutex> lock(state.historyMutex);
+	std::vector<LogEntry> messages;
+	messages.reserve(state.historySize);
+	const size_t first = (state.historySize < LOG_HISTORY_SIZE) ? 0 : state.historyNext;
+	for (size_t i = 0; i < state.historySize; i++)
+	{
+		const LogHistorySlot& slot = state.history[(first + i) % LOG_HISTORY_SIZE];
+		messages.push_back({ slot.type, slot.category, std::string(slot.text, slot.length) });
+	}
+	return messages;
+}
+
+uint64_t Logger::GetNumDroppedMessages()
+{
+	return state.numDropped.load(std::memory_order_relaxed);
 }
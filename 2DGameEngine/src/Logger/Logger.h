@@ -1,27 +1,248 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector> //vector here can be seen as a list
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 
+//Also the log levels, in order of importance
 enum LogType
 {
+	LOG_DEBUG,
 	LOG_INFO,
 	LOG_WARNING,
 	LOG_ERROR
 };
 
+//Subsystems that can be filtered separately at runtime
+enum LogCategory : uint8_t
+{
+	LOG_CATEGORY_GENERAL,
+	LOG_CATEGORY_ECS,
+	LOG_CATEGORY_ASSETS,
+	LOG_CATEGORY_RENDER,
+	LOG_CATEGORY_GAME,
+	NUM_LOG_CATEGORIES
+};
+
+const char* GetLogCategoryName(int category);
+
 struct LogEntry
 {
 	LogType type;
+	LogCategory category;
 	std::string message;
 };
 
+const size_t LOG_HISTORY_SIZE = 1024; //how many of the latest messages GetMessages() keeps
+const size_t LOG_HISTORY_MESSAGE_SIZE = 256; //bytes of text kept per message in the history, longer ones end in "..." there
+const size_t LOG_ARGUMENTS_SIZE = 224; //bytes of captured arguments, or of text from Log()/Err(), per message
+
+
+////////////////////////////////////////////////////////////////////////
+// LogArguments
+////////////////////////////////////////////////////////////////////////
+// The arguments of a LOG() call, captured as typed values: a type byte
+// followed by the value (strings are copied in with their length).
+// They're only turned into text by the logger's background thread
+////////////////////////////////////////////////////////////////////////
+enum LogArgumentType : uint8_t
+{
+	LOG_ARGUMENT_INT,
+	LOG_ARGUMENT_UINT,
+	LOG_ARGUMENT_DOUBLE,
+	LOG_ARGUMENT_BOOL,
+	LOG_ARGUMENT_CHAR,
+	LOG_ARGUMENT_STRING,
+	LOG_ARGUMENT_POINTER
+};
+
+template <typename T> struct UnsupportedLogArgument : std::false_type {};
+
+class LogArguments
+{
+private:
+	void AddValue(LogArgumentType type, const void* value, size_t valueSize)
+	{
+		if (size + 1 + valueSize > LOG_ARGUMENTS_SIZE)
+		{
+			isTruncated = true;
+			return;
+		}
+		data[size++] = type;
+		std::memcpy(data + size, value, valueSize);
+		size += valueSize;
+	}
+
+	void AddString(std::string_view text)
+	{
+		//keep at least the length, cutting the text short if it doesn't all fit
+		if (size + 1 + sizeof(uint16_t) > LOG_ARGUMENTS_SIZE)
+		{
+			isTruncated = true;
+			return;
+		}
+		const uint16_t length = static_cast<uint16_t>(std::min(text.size(), LOG_ARGUMENTS_SIZE - size - 1 - sizeof(uint16_t)));
+		data[size++] = LOG_ARGUMENT_STRING;
+		std::memcpy(data + size, &length, sizeof(length));
+		size += sizeof(length);
+		std::memcpy(data + size, text.data(), length);
+		size += length;
+		isTruncated = isTruncated || length < text.size();
+	}
+
+public:
+	uint8_t data[LOG_ARGUMENTS_SIZE];
+	size_t size = 0;
+	bool isTruncated = false;
+
+	template <typename T>
+	void Add(const T& value)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+		{
+			AddValue(LOG_ARGUMENT_BOOL, &value, sizeof(bool));
+		}
+		else if constexpr (std::is_same_v<T, char>)
+		{
+			AddValue(LOG_ARGUMENT_CHAR, &value, sizeof(char));
+		}
+		else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+		{
+			if constexpr (std::is_signed_v<T> || std::is_enum_v<T>)
+			{
+				const int64_t number = static_cast<int64_t>(value);
+				AddValue(LOG_ARGUMENT_INT, &number, sizeof(number));
+			}
+			else
+			{
+				const uint64_t number = static_cast<uint64_t>(value);
+				AddValue(LOG_ARGUMENT_UINT, &number, sizeof(number));
+			}
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			const double number = static_cast<double>(value);
+			AddValue(LOG_ARGUMENT_DOUBLE, &number, sizeof(number));
+		}
+		else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>)
+		{
+			AddString(value ? std::string_view(value) : std::string_view("(null)"));
+		}
+		else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+		{
+			AddString(std::string_view(value));
+		}
+		else if constexpr (std::is_pointer_v<T>)
+		{
+			const uint64_t address = reinterpret_cast<uintptr_t>(value);
+			AddValue(LOG_ARGUMENT_POINTER, &address, sizeof(address));
+		}
+		else
+		{
+			static_assert(UnsupportedLogArgument<T>::value, "LOG() can only take numbers, bools, chars, strings and pointers");
+		}
+	}
+};
+
 
+////////////////////////////////////////////////////////////////////////
+// Logger
+////////////////////////////////////////////////////////////////////////
+// Log() and Err() only copy the message into a lock-free queue, they
+// never format, allocate or touch the console. A background thread
+// takes the messages off the queue, adds the timestamp, and writes them
+// out in batches to the console (and the log file if there is one).
+// If the queue is full, Log() drops the message (the number dropped gets
+// reported) while Err() waits for space, so errors are never lost.
+// A message only carries LOG_ARGUMENTS_SIZE bytes: text from Log()/Err()
+// past that is cut off, and so are LOG() arguments that don't fit, and
+// the line that's written out ends by saying so.
+// The background thread formats into buffers it keeps, and the history
+// is a fixed number of fixed size slots, so once they've been allocated
+// writing a message out makes no heap allocations.
+// The background thread starts with the first message and is stopped,
+// after writing everything out, when the program exits.
+////////////////////////////////////////////////////////////////////////
 class Logger
 {
+private:
+	static LogType categoryLevels[NUM_LOG_CATEGORIES];
+	static void Write(LogType level, LogCategory category, const char* format, const LogArguments& arguments);
+
 public:
-	static std::vector<LogEntry> messages;
-	static void Log(const std::string& message);
-	static void Err(const std::string& message);
-};
\ No newline at end of file
+	static bool isEnabled; //when false, only errors get logged
+	static void SetEnabled(bool enabled);
+	static void Log(const std::string& message); //info, general category
+	static void Err(const std::string& message); //error, general category
+
+	//Lowest level that still gets logged, per category or for all of them
+	static void SetLevel(LogType level);
+	static void SetCategoryLevel(LogCategory category, LogType level);
+	//Sets levels from text like "warning", "ecs=debug" or "info,assets=debug,render=error"
+	static bool SetLevelsFromString(const std::string& filter);
+
+	static bool IsEnabled(LogType level, LogCategory category)
+	{
+		return level >= LOG_ERROR || (isEnabled && level >= categoryLevels[category]);
+	}
+
+	//Used by the LOG() macro. format is kept as a pointer, so it has to be a string literal
+	template <typename ...TArgs>
+	static void Write(LogType level, LogCategory category, const char* format, const TArgs& ...args)
+	{
+		LogArguments arguments;
+		(arguments.Add(args), ...);
+		Write(level, category, format, arguments);
+	}
+
+	//Also writes every message to a file, on top of the console
+	static bool SetLogFile(const std::string& filePath);
+
+	//Blocks until every message logged so far has been written out
+	static void Flush();
+	//Writes out everything and stops the background thread. Anything logged after this is written straight away
+	static void Shutdown();
+
+	//The last LOG_HISTORY_SIZE messages, oldest first
+	static std::vector<LogEntry> GetMessages();
+	static uint64_t GetNumDroppedMessages();
+};
+
+
+////////////////////////////////////////////////////////////////////////
+// LOG(level, category, format, arguments...)
+////////////////////////////////////////////////////////////////////////
+//		LOG(DEBUG, ECS, "Component id = {} was added to entity id {}", componentId, entityId);
+//
+// level is DEBUG, INFO, WARNING or ERROR and category one of the
+// LogCategory names without the prefix. Every {} in the format is
+// replaced by the next argument, {{ and }} give literal braces.
+// Levels below LOG_COMPILE_LEVEL aren't compiled in at all, and if a
+// level is filtered out at runtime none of the arguments are evaluated.
+// The arguments are copied as they are, and only formatted into text
+// on the logger's background thread
+////////////////////////////////////////////////////////////////////////
+#ifndef LOG_COMPILE_LEVEL
+#if defined(NDEBUG)
+#define LOG_COMPILE_LEVEL LOG_INFO
+#else
+#define LOG_COMPILE_LEVEL LOG_DEBUG
+#endif
+#endif
+
+#define LOG(level, category, ...) \
+	do \
+	{ \
+		if constexpr (LOG_##level >= LOG_COMPILE_LEVEL) \
+		{ \
+			if (Logger::IsEnabled(LOG_##level, LOG_CATEGORY_##category)) \
+			{ \
+				Logger::Write(LOG_##level, LOG_CATEGORY_##category, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
@@ -1,15 +1,159 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <string>
 #include "./Game/game.h"
+#include "./Profiler/Profiler.h"
+#include "./Profiler/HardwareCounters.h"
 
 
 int main(int argc, char* argv[]) //arguement character, array of argument values
 {
     Game game; //not using "new" means it will be stored in the stack and then destroyed when the scope ends
 
+    //command line options
+    //  --fps <n>     target framerate, 0 = uncapped
+    //  --headless    no window, renderer or audio
+    //  --ticks <n>   run n ticks as fast as possible and exit
+    //  --record <file>   record input to a replay file (runs deterministic at 60 ticks per second)
+    //  --replay <file>   play back a replay instead of live input
+    //  --seek <tick>     start the replay at this tick
+    //  --trace <file>    write the profiler zones as a Chrome trace on exit (F3 writes one at any time)
+    //  --hw-counters     count cycles/instructions/cache and branch misses per system (Linux only)
+    //  --no-batching     draw one sprite at a time instead of batching sprites by texture
+    //  --no-tile-cache   draw every visible tile every frame instead of baked tilemap chunks
+    //  --texture-budget <MB>   texture memory kept before unused textures are evicted
+    //  --switch-scene-every <ticks>   switch between the level and a stress scene (F5 switches at any time)
+    //  --hot-reload      reload textures and the level's map when their files under ./assets change (loads loose files, not the pack)
+    //  --pack <file>     load assets from this pack instead of ./assets.pak
+    //  --no-pack         load the loose files under ./assets even if there's a pack
+    //  --cooked <dir>    load cooked images and maps from this directory instead of ./cooked
+    //  --no-cooked       decode the source images and maps even if they've been cooked
+    //  --labels          draw every visible sprite's entity id over it
+    //  --log-filter <spec>   log levels, e.g. "warning" or "info,ecs=debug" (debug messages only exist in Debug builds)
+    int numTicks = 0;
+    std::string recordPath;
+    std::string replayPath;
+    int seekTick = 0;
+    std::string tracePath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+        {
+            game.SetTargetFps(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            game.SetHeadless(true);
+        }
+        else if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            numTicks = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            recordPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--seek") == 0 && i + 1 < argc)
+        {
+            seekTick = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--hw-counters") == 0)
+        {
+            HardwareCounters::Enable(); //carries on without them if they can't be opened
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-batching") == 0)
+        {
+            game.SetRenderBatching(false);
+        }
+        else if (std::strcmp(argv[i], "--no-tile-cache") == 0)
+        {
+            game.SetTileChunkCaching(false);
+        }
+        else if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+        {
+            game.SetTextureMemoryBudget(static_cast<size_t>(std::atoi(argv[++i])) * 1024 * 1024);
+        }
+        else if (std::strcmp(argv[i], "--switch-scene-every") == 0 && i + 1 < argc)
+        {
+            game.SetSceneSwitchInterval(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--hot-reload") == 0)
+        {
+            game.SetAssetHotReload(true);
+        }
+        else if (std::strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+        {
+            game.SetAssetPack(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--no-pack") == 0)
+        {
+            game.SetAssetPack("");
+        }
+        else if (std::strcmp(argv[i], "--cooked") == 0 && i + 1 < argc)
+        {
+            game.SetCookedAssets(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--no-cooked") == 0)
+        {
+            game.SetCookedAssets("");
+        }
+        else if (std::strcmp(argv[i], "--labels") == 0)
+        {
+            game.SetEntityLabels(true);
+        }
+        else if (std::strcmp(argv[i], "--log-filter") == 0 && i + 1 < argc)
+        {
+            if (!Logger::SetLevelsFromString(argv[++i]))
+            {
+                return 1;
+            }
+        }
+    }
+
+    if (!replayPath.empty())
+    {
+        if (!game.StartReplay(replayPath, seekTick))
+        {
+            return 1;
+        }
+    }
+    else if (!recordPath.empty())
+    {
+        //the game has to run at the same fixed tick it's recorded at
+        game.SetTargetFps(60);
+        game.SetFixedDeltaTime(1.0 / 60.0);
+        game.EnableDeterministicMode(1);
+        if (!game.StartRecording(recordPath))
+        {
+            return 1;
+        }
+    }
+
+    Profiler::SetThreadName("Main");
     game.Initialize();
-    game.Run();
+    if (numTicks > 0)
+    {
+        game.RunTicks(numTicks);
+    }
+    else
+    {
+        game.Run();
+    }
     game.Destroy();
 
+    if (!tracePath.empty())
+    {
+        Profiler::WriteChromeTrace(tracePath);
+    }
 
     return 0;
 }
@@ -0,0 +1,138 @@
+#include "MemoryTracker.h"
+#include "../Logger/Logger.h"
+#include <cstdlib>
+
+struct AtomicTagStats
+{
+	std::atomic<size_t> liveBytes{ 0 };
+	std::atomic<size_t> peakBytes{ 0 };
+	std::atomic<uint64_t> numAllocations{ 0 };
+	std::atomic<uint64_t> numFrees{ 0 };
+};
+
+static AtomicTagStats tagStats[NUM_MEMORY_TAGS];
+
+static std::atomic<uint64_t> totalAllocations{ 0 };
+static std::atomic<uint64_t> totalAllocatedBytes{ 0 };
+static thread_local uint64_t threadAllocations = 0; //plain and zero initialised, so it's safe to touch in operator new on any thread
+static uint64_t frameStartAllocations = 0; //the main thread's
+static uint64_t frameStartTotalAllocations = 0;
+
+const char* GetMemoryTagName(int tag)
+{
+	switch (tag)
+	{
+	case MEMORY_TAG_ECS: return "ECS";
+	case MEMORY_TAG_ASSETS: return "Assets";
+	case MEMORY_TAG_LOGGER: return "Logger";
+	case MEMORY_TAG_RENDER: return "Render";
+	case MEMORY_TAG_TILEMAP: return "Tilemap";
+	}
+	return "unknown";
+}
+
+void MemoryTracker::RecordAllocation(MemoryTag tag, size_t bytes)
+{
+	AtomicTagStats& stats = tagStats[tag];
+	const size_t liveBytes = stats.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	stats.numAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	size_t peakBytes = stats.peakBytes.load(std::memory_order_relaxed);
+	while (liveBytes > peakBytes && !stats.peakBytes.compare_exchange_weak(peakBytes, liveBytes, std::memory_order_relaxed))
+	{
+	}
+}
+
+void MemoryTracker::RecordFree(MemoryTag tag, size_t bytes)
+{
+	AtomicTagStats& stats = tagStats[tag];
+	stats.liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+	stats.numFrees.fetch_add(1, std::memory_order_relaxed);
+}
+
+MemoryTagStats MemoryTracker::GetStats(MemoryTag tag)
+{
+	MemoryTagStats stats;
+	stats.liveBytes = tagStats[tag].liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = tagStats[tag].peakBytes.load(std::memory_order_relaxed);
+	stats.numAllocations = tagStats[tag].numAllocations.load(std::memory_order_relaxed);
+	stats.numFrees = tagStats[tag].numFrees.load(std::memory_order_relaxed);
+	return stats;
+}
+
+uint64_t MemoryTracker::GetTotalAllocations()
+{
+	return totalAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryTracker::GetTotalAllocatedBytes()
+{
+	return totalAllocatedBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryTracker::GetThreadAllocations()
+{
+	return threadAllocations;
+}
+
+void MemoryTracker::BeginFrame()
+{
+	frameStartAllocations = threadAllocations;
+	frameStartTotalAllocations = GetTotalAllocations();
+}
+
+uint64_t MemoryTracker::GetFrameAllocations()
+{
+	return threadAllocations - frameStartAllocations;
+}
+
+uint64_t MemoryTracker::GetFrameWorkerAllocations()
+{
+	//read after the total, so a worker allocating in between can only make this smaller, never wrap
+	const uint64_t frameAllocations = GetFrameAllocations();
+	const uint64_t frameTotalAllocations = GetTotalAllocations() - frameStartTotalAllocations;
+	return frameTotalAllocations > frameAllocations ? frameTotalAllocations - frameAllocations : 0;
+}
+
+void MemoryTracker::LogReport()
+{
+	for (int tag = 0; tag < NUM_MEMORY_TAGS; tag++)
+	{
+		const MemoryTagStats stats = GetStats(static_cast<MemoryTag>(tag));
+		LOG
+		(
+			INFO, GENERAL, "Memory {}: live {} KB, peak {} KB, {} allocations, {} frees",
+			GetMemoryTagName(tag), stats.liveBytes / 1024, stats.peakBytes / 1024, stats.numAllocations, stats.numFrees
+		);
+	}
+	LOG(INFO, GENERAL, "Memory total: {} heap allocations, {} KB allocated over the whole run", GetTotalAllocations(), GetTotalAllocatedBytes() / 1024);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Global new/delete
+////////////////////////////////////////////////////////////////////////
+// Only counts, so it stays cheap enough to leave on in every build.
+// The default array and nothrow versions call these, so they get counted too
+////////////////////////////////////////////////////////////////////////
+void* operator new(size_t size)
+{
+	threadAllocations++;
+	totalAllocations.fetch_add(1, std::memory_order_relaxed);
+	totalAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+////////////////////////////////////////////////////////////////////////
+// MemoryTracker
+////////////////////////////////////////////////////////////////////////
+// Keeps live bytes, peak bytes and allocation counts per subsystem.
+// Containers opt in by using TrackingAllocator with their tag:
+//
+//		std::vector<T, TrackingAllocator<T, MEMORY_TAG_ECS>> data;
+//
+// and memory we don't allocate ourselves (SDL textures) is reported with
+// RecordAllocation()/RecordFree().
+// Separately, the global operator new is replaced so every heap
+// allocation in the process gets counted (just the number and bytes, not
+// the tag), in total and per thread. The game snapshots the main
+// thread's count at the start of every frame, which is how we catch
+// anything allocating in the steady state. The logger, decode and file
+// watcher threads allocate on their own schedule, so they're counted
+// apart and never charged to the frame that happens to be running.
+////////////////////////////////////////////////////////////////////////
+
+enum MemoryTag : uint8_t
+{
+	MEMORY_TAG_ECS, //component pools and system entity lists
+	MEMORY_TAG_ASSETS, //textures and the asset store's own maps
+	MEMORY_TAG_LOGGER, //kept log messages
+	MEMORY_TAG_RENDER, //render lists
+	MEMORY_TAG_TILEMAP, //tile index arrays and chunk bookkeeping
+	NUM_MEMORY_TAGS
+};
+
+const char* GetMemoryTagName(int tag);
+
+struct MemoryTagStats
+{
+	size_t liveBytes = 0;
+	size_t peakBytes = 0;
+	uint64_t numAllocations = 0;
+	uint64_t numFrees = 0;
+};
+
+class MemoryTracker
+{
+public:
+	static void RecordAllocation(MemoryTag tag, size_t bytes);
+	static void RecordFree(MemoryTag tag, size_t bytes);
+	static MemoryTagStats GetStats(MemoryTag tag);
+
+	//Every heap allocation in the process, tagged or not
+	static uint64_t GetTotalAllocations();
+	static uint64_t GetTotalAllocatedBytes();
+
+	//Heap allocations made by the calling thread
+	static uint64_t GetThreadAllocations();
+
+	//Allocations since the last BeginFrame(), the game calls it at the start of every frame on the main thread.
+	//GetFrameAllocations() only counts the thread that called BeginFrame() (call it from that thread), and
+	//GetFrameWorkerAllocations() everything the other threads allocated in the meantime
+	static void BeginFrame();
+	static uint64_t GetFrameAllocations();
+	static uint64_t GetFrameWorkerAllocations();
+
+	//Logs every tag and the process wide totals
+	static void LogReport();
+};
+
+template <typename T, MemoryTag Tag>
+class TrackingAllocator
+{
+public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef TrackingAllocator<U, Tag> other;
+	};
+
+	TrackingAllocator() = default;
+	template <typename U> TrackingAllocator(const TrackingAllocator<U, Tag>&) {}
+
+	T* allocate(size_t n)
+	{
+		MemoryTracker::RecordAllocation(Tag, n * sizeof(T));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* memory, size_t n)
+	{
+		MemoryTracker::RecordFree(Tag, n * sizeof(T));
+		::operator delete(memory);
+	}
+
+	template <typename U> bool operator ==(const TrackingAllocator<U, Tag>&) const { return true; }
+	template <typename U> bool operator !=(const TrackingAllocator<U, Tag>&) const { return false; }
+};
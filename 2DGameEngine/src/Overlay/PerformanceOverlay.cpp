@@ -0,0 +1,284 @@
+#include "PerformanceOverlay.h"
+#include "../Stats/ProcessStats.h"
+#include "../Profiler/Profiler.h"
+#include "../Profiler/HardwareCounters.h"
+#include "../Memory/MemoryTracker.h"
+#include <imgui/imgui.h>
+#include <imgui/imgui_sdl.h>
+#include <cstdio>
+
+const double STATS_REFRESH_SECONDS = 0.25;
+
+static double CounterToMilliseconds(Uint64 counter)
+{
+	return (counter * 1000.0) / SDL_GetPerformanceFrequency();
+}
+
+static float GetFrameTimeSample(void* data, int index)
+{
+	return static_cast<float>(static_cast<const FrameTimeHistory*>(data)->GetSample(index));
+}
+
+//Misses per entity, or n/a when this machine (or VM) doesn't have the counter or it never got to count, rather than a 0 that looks real
+static void HardwareCounterText(const HardwareCounterValues& totals, int counter, double numEntities)
+{
+	if (HardwareCounters::IsSupported(counter) && totals.HasRun())
+	{
+		ImGui::Text("%.3f", totals.GetScaled(counter) / numEntities);
+	}
+	else
+	{
+		ImGui::TextUnformatted("n/a");
+	}
+}
+
+//Formats into the caller's stack buffer, these are drawn for several rows every frame
+static const char* FormatBytes(size_t bytes, char (&buffer)[32])
+{
+	if (bytes >= 1024 * 1024)
+	{
+		std::snprintf(buffer, sizeof(buffer), "%.2f MB", bytes / (1024.0 * 1024.0));
+	}
+	else
+	{
+		std::snprintf(buffer, sizeof(buffer), "%.1f KB", bytes / 1024.0);
+	}
+	return buffer;
+}
+
+void PerformanceOverlay::Initialize(SDL_Renderer* renderer, int windowWidth, int windowHeight)
+{
+	this->renderer = renderer;
+	ImGui::CreateContext();
+	ImGuiSDL::Initialize(renderer, windowWidth, windowHeight);
+	ImGui::GetIO().IniFilename = NULL; //don't leave an imgui.ini next to the game
+	isInitialized = true;
+}
+
+void PerformanceOverlay::Destroy()
+{
+	if (!isInitialized)
+	{
+		return;
+	}
+	ImGuiSDL::Deinitialize();
+	ImGui::DestroyContext();
+	isInitialized = false;
+}
+
+void PerformanceOverlay::Toggle()
+{
+	isVisible = !isVisible;
+	lastRefreshCounter = 0; //refresh straight away when it's opened
+}
+
+bool PerformanceOverlay::IsVisible() const
+{
+	return isVisible;
+}
+
+void PerformanceOverlay::RefreshStats(const Registry& registry, const AssetStore& assetStore)
+{
+	componentPoolStats.clear();
+	componentMemoryBytes = 0;
+	for (int componentId = 0; componentId < registry.GetNumComponentPools(); componentId++)
+	{
+		if (!registry.HasComponentPool(componentId))
+		{
+			continue;
+		}
+		ComponentPoolStats stats;
+		stats.name = GetReadableTypeName(registry.GetComponentPoolName(componentId));
+		stats.numComponents = registry.GetNumComponents(componentId);
+		stats.poolSize = registry.GetComponentPoolSize(componentId);
+		stats.memoryBytes = registry.GetComponentPoolMemoryUsage(componentId);
+		componentMemoryBytes += stats.memoryBytes;
+		componentPoolStats.push_back(stats);
+	}
+
+	numTextures = assetStore.GetNumTextures();
+	numAtlasImages = assetStore.GetNumAtlasImages();
+	numLoadingTextures = assetStore.GetNumLoadingTextures();
+	textureMemoryBytes = assetStore.GetTextureMemoryUsage();
+	textureMemoryBudget = assetStore.GetTextureMemoryBudget();
+	assetCacheStats = assetStore.GetCacheStats();
+	residentBytes = GetCurrentResidentBytes();
+	for (int tag = 0; tag < NUM_MEMORY_TAGS; tag++)
+	{
+		memoryTagStats[tag] = MemoryTracker::GetStats(static_cast<MemoryTag>(tag));
+	}
+	peakResidentBytes = GetPeakResidentBytes();
+}
+
+void PerformanceOverlay::UpdateInput()
+{
+	ImGuiIO& io = ImGui::GetIO();
+
+	const Uint64 counter = SDL_GetPerformanceCounter();
+	io.DeltaTime = lastFrameCounter ? static_cast<float>(CounterToMilliseconds(counter - lastFrameCounter) / 1000.0) : 1.0f / 60.0f;
+	if (io.DeltaTime <= 0.0f)
+	{
+		io.DeltaTime = 1.0f / 60.0f;
+	}
+	lastFrameCounter = counter;
+
+	int mouseX;
+	int mouseY;
+	const Uint32 buttons = SDL_GetMouseState(&mouseX, &mouseY);
+	io.MousePos = ImVec2(static_cast<float>(mouseX), static_cast<float>(mouseY));
+	io.MouseDown[0] = (buttons & SDL_BUTTON(SDL_BUTTON_LEFT)) != 0;
+	io.MouseDown[1] = (buttons & SDL_BUTTON(SDL_BUTTON_RIGHT)) != 0;
+}
+
+void PerformanceOverlay::DrawWindow(const FramePacer& framePacer, const Registry& registry)
+{
+	ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowSize(ImVec2(460.0f, 0.0f), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Performance (F1)");
+
+	const FrameTimeHistory& frameTimes = framePacer.GetFrameTimes();
+	const FrameTimeSummary frameSummary = frameTimes.GetSummary();
+	ImGui::Text("%.1f fps  |  overlay %.3f ms", frameSummary.avg > 0.0 ? 1000.0 / frameSummary.avg : 0.0, overlayMilliseconds);
+	ImGui::Text("frame ms  min %.2f  avg %.2f  p95 %.2f  p99 %.2f", frameSummary.min, frameSummary.avg, frameSummary.p95, frameSummary.p99);
+
+	//the graphs read the frame pacer's ring buffers directly, nothing gets copied
+	const ImVec2 graphSize(0.0f, 50.0f);
+	ImGui::PlotLines("frame", GetFrameTimeSample, const_cast<FrameTimeHistory*>(&frameTimes), static_cast<int>(frameTimes.GetCount()), 0, NULL, 0.0f, FLT_MAX, graphSize);
+	const FrameTimeHistory& updateTimes = framePacer.GetUpdateTimes();
+	ImGui::PlotLines("update", GetFrameTimeSample, const_cast<FrameTimeHistory*>(&updateTimes), static_cast<int>(updateTimes.GetCount()), 0, NULL, 0.0f, FLT_MAX, graphSize);
+	const FrameTimeHistory& renderTimes = framePacer.GetRenderTimes();
+	ImGui::PlotLines("render", GetFrameTimeSample, const_cast<FrameTimeHistory*>(&renderTimes), static_cast<int>(renderTimes.GetCount()), 0, NULL, 0.0f, FLT_MAX, graphSize);
+
+	if (ImGui::CollapsingHeader("Systems", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Text("%d live entities", registry.GetNumLiveEntities());
+		ImGui::Columns(3, "systems");
+		ImGui::Text("system"); ImGui::NextColumn();
+		ImGui::Text("ms"); ImGui::NextColumn();
+		ImGui::Text("entities"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (const auto& system : registry.GetSystems())
+		{
+			ImGui::TextUnformatted(system->GetName().c_str()); ImGui::NextColumn();
+			ImGui::Text("%.3f", system->GetLastUpdateTime()); ImGui::NextColumn();
+			ImGui::Text("%d", static_cast<int>(system->GetNumEntities())); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+
+	if (HardwareCounters::IsEnabled() && ImGui::CollapsingHeader("Hardware counters (per entity)", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Columns(5, "counters");
+		ImGui::Text("system"); ImGui::NextColumn();
+		ImGui::Text("IPC"); ImGui::NextColumn();
+		ImGui::Text("L1D miss"); ImGui::NextColumn();
+		ImGui::Text("LLC miss"); ImGui::NextColumn();
+		ImGui::Text("br miss"); ImGui::NextColumn();
+		ImGui::Separator();
+		const bool isIpcSupported = HardwareCounters::IsSupported(HW_CYCLES) && HardwareCounters::IsSupported(HW_INSTRUCTIONS);
+		for (const auto& system : registry.GetSystems())
+		{
+			const HardwareCounterValues& totals = system->GetHardwareCounterTotals();
+			const double numEntities = static_cast<double>(std::max<uint64_t>(system->GetNumCountedEntities(), 1));
+			ImGui::TextUnformatted(system->GetName().c_str()); ImGui::NextColumn();
+			if (isIpcSupported && totals.HasRun())
+			{
+				//both are scaled the same way, so the raw counts give the same ratio
+				ImGui::Text("%.2f", totals.values[HW_CYCLES] ? static_cast<double>(totals.values[HW_INSTRUCTIONS]) / totals.values[HW_CYCLES] : 0.0);
+			}
+			else
+			{
+				ImGui::TextUnformatted("n/a");
+			}
+			ImGui::NextColumn();
+			HardwareCounterText(totals, HW_L1D_MISSES, numEntities); ImGui::NextColumn();
+			HardwareCounterText(totals, HW_LLC_MISSES, numEntities); ImGui::NextColumn();
+			HardwareCounterText(totals, HW_BRANCH_MISSES, numEntities); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+
+	if (ImGui::CollapsingHeader("Components", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Columns(4, "components");
+		ImGui::Text("component"); ImGui::NextColumn();
+		ImGui::Text("count"); ImGui::NextColumn();
+		ImGui::Text("pool size"); ImGui::NextColumn();
+		ImGui::Text("memory"); ImGui::NextColumn();
+		ImGui::Separator();
+		char bytesText[32];
+		for (const auto& stats : componentPoolStats)
+		{
+			ImGui::TextUnformatted(stats.name.c_str()); ImGui::NextColumn();
+			ImGui::Text("%d", stats.numComponents); ImGui::NextColumn();
+			ImGui::Text("%d", stats.poolSize); ImGui::NextColumn();
+			ImGui::TextUnformatted(FormatBytes(stats.memoryBytes, bytesText)); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+		ImGui::Text("component pools total: %s", FormatBytes(componentMemoryBytes, bytesText));
+	}
+
+	if (ImGui::CollapsingHeader("Memory", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		char bytesText[32];
+		char otherBytesText[32];
+		ImGui::Text("textures: %d (%d images atlased, %d loading), %s of %s", numTextures, numAtlasImages, numLoadingTextures, FormatBytes(textureMemoryBytes, bytesText), FormatBytes(textureMemoryBudget, otherBytesText));
+		ImGui::Text
+		(
+			"texture cache: %llu hits, %llu misses, %llu evictions, %llu reloads",
+			static_cast<unsigned long long>(assetCacheStats.hits),
+			static_cast<unsigned long long>(assetCacheStats.misses),
+			static_cast<unsigned long long>(assetCacheStats.evictions),
+			static_cast<unsigned long long>(assetCacheStats.reloads)
+		);
+		ImGui::Text("resident: %s (peak %s)", FormatBytes(residentBytes, bytesText), FormatBytes(peakResidentBytes, otherBytesText));
+		ImGui::Text
+		(
+			"heap allocations this frame so far: %llu, %llu on worker threads",
+			static_cast<unsigned long long>(MemoryTracker::GetFrameAllocations()),
+			static_cast<unsigned long long>(MemoryTracker::GetFrameWorkerAllocations())
+		);
+
+		ImGui::Columns(4, "memory tags");
+		ImGui::Text("tag"); ImGui::NextColumn();
+		ImGui::Text("live"); ImGui::NextColumn();
+		ImGui::Text("peak"); ImGui::NextColumn();
+		ImGui::Text("allocations"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (int tag = 0; tag < NUM_MEMORY_TAGS; tag++)
+		{
+			const MemoryTagStats& stats = memoryTagStats[tag];
+			ImGui::TextUnformatted(GetMemoryTagName(tag)); ImGui::NextColumn();
+			ImGui::TextUnformatted(FormatBytes(stats.liveBytes, bytesText)); ImGui::NextColumn();
+			ImGui::TextUnformatted(FormatBytes(stats.peakBytes, bytesText)); ImGui::NextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(stats.numAllocations)); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+
+	ImGui::End();
+}
+
+void PerformanceOverlay::Render(const FramePacer& framePacer, const Registry& registry, const AssetStore& assetStore)
+{
+	if (!isInitialized || !isVisible)
+	{
+		return;
+	}
+	PROFILE_SCOPE("PerformanceOverlay::Render");
+	const Uint64 startCounter = SDL_GetPerformanceCounter();
+
+	if (CounterToMilliseconds(startCounter - lastRefreshCounter) >= STATS_REFRESH_SECONDS * 1000.0 || lastRefreshCounter == 0)
+	{
+		RefreshStats(registry, assetStore);
+		lastRefreshCounter = startCounter;
+	}
+
+	UpdateInput();
+	ImGui::NewFrame();
+	DrawWindow(framePacer, registry);
+	ImGui::Render();
+	ImGuiSDL::Render(ImGui::GetDrawData());
+
+	overlayMilliseconds = CounterToMilliseconds(SDL_GetPerformanceCounter() - startCounter);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <SDL.h>
+#include <string>
+#include <vector>
+#include "../ECS/ECS.h"
+#include "../AssetStore/AssetStore.h"
+#include "../FramePacer/FramePacer.h"
+#include "../Memory/MemoryTracker.h"
+
+////////////////////////////////////////////////////////////////////////
+// PerformanceOverlay
+////////////////////////////////////////////////////////////////////////
+// Dear ImGui window drawn on top of the game (toggle with F1) showing
+// frame/update/render graphs, how long each system took and how many
+// entities it has, every component pool's size and memory, and how much
+// texture memory the asset store is holding.
+// The graphs read straight from the frame pacer's history and the pool
+// and memory numbers are only refreshed a few times a second, so the
+// overlay costs next to nothing. What it does cost is shown at the top
+// of the window, and it's drawn after the timed render systems.
+////////////////////////////////////////////////////////////////////////
+class PerformanceOverlay
+{
+private:
+	struct ComponentPoolStats
+	{
+		std::string name;
+		int numComponents = 0;
+		int poolSize = 0;
+		size_t memoryBytes = 0;
+	};
+
+	bool isInitialized = false;
+	bool isVisible = false;
+	SDL_Renderer* renderer = nullptr;
+
+	//refreshed every STATS_REFRESH_SECONDS rather than every frame
+	std::vector<ComponentPoolStats> componentPoolStats;
+	size_t componentMemoryBytes = 0;
+	size_t textureMemoryBytes = 0;
+	size_t textureMemoryBudget = 0;
+	AssetCacheStats assetCacheStats;
+	int numTextures = 0;
+	int numAtlasImages = 0;
+	int numLoadingTextures = 0;
+	size_t residentBytes = 0;
+	size_t peakResidentBytes = 0;
+	MemoryTagStats memoryTagStats[NUM_MEMORY_TAGS];
+	Uint64 lastRefreshCounter = 0;
+
+	Uint64 lastFrameCounter = 0;
+	double overlayMilliseconds = 0.0; //how long the overlay took last frame
+
+	void RefreshStats(const Registry& registry, const AssetStore& assetStore);
+	void UpdateInput();
+	void DrawWindow(const FramePacer& framePacer, const Registry& registry);
+
+public:
+	void Initialize(SDL_Renderer* renderer, int windowWidth, int windowHeight);
+	void Destroy();
+
+	void Toggle();
+	bool IsVisible() const;
+
+	//Draws the overlay if it's visible, call after the game has been rendered and before presenting
+	void Render(const FramePacer& framePacer, const Registry& registry, const AssetStore& assetStore);
+};
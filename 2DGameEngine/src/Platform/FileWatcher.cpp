@@ -0,0 +1,213 @@
+#include "FileWatcher.h"
+#include "../Logger/Logger.h"
+#include <filesystem>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+std::string NormalizeFilePath(const std::string& filePath)
+{
+	std::error_code error;
+	const std::filesystem::path absolutePath = std::filesystem::absolute(filePath, error);
+	return (error ? std::filesystem::path(filePath) : absolutePath).lexically_normal().generic_string();
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+bool FileWatcher::Start(const std::string& directory)
+{
+	Stop();
+	std::error_code error;
+	if (!std::filesystem::is_directory(directory, error))
+	{
+		LOG(ERROR, ASSETS, "Can't watch {}, it isn't a directory", directory);
+		return false;
+	}
+	this->directory = directory;
+	isStopping = false;
+	thread = std::thread([this]()
+	{
+		if (!WatchWithInotify())
+		{
+			WatchByPolling();
+		}
+	});
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	if (thread.joinable())
+	{
+		isStopping = true;
+		thread.join();
+	}
+	std::lock_guard<std::mutex> lock(changesMutex);
+	changes.clear();
+}
+
+bool FileWatcher::IsRunning() const
+{
+	return thread.joinable();
+}
+
+void FileWatcher::AddChange(const std::string& filePath)
+{
+	std::lock_guard<std::mutex> lock(changesMutex);
+	changes[NormalizeFilePath(filePath)] = Clock::now();
+}
+
+void FileWatcher::TakeChangedFiles(std::vector<std::string>& changedFiles)
+{
+	changedFiles.clear();
+	const Clock::time_point settledBefore = Clock::now() - std::chrono::milliseconds(FILE_WATCHER_SETTLE_MS);
+	std::lock_guard<std::mutex> lock(changesMutex);
+	for (auto change = changes.begin(); change != changes.end();)
+	{
+		if (change->second <= settledBefore)
+		{
+			changedFiles.push_back(change->first);
+			change = changes.erase(change);
+		}
+		else
+		{
+			++change;
+		}
+	}
+}
+
+#if defined(__linux__)
+bool FileWatcher::WatchWithInotify()
+{
+	const int inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify < 0)
+	{
+		LOG(WARNING, ASSETS, "inotify isn't available, polling {} for changes instead", directory);
+		return false;
+	}
+
+	//inotify isn't recursive, every directory gets its own watch
+	const uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+	std::unordered_map<int, std::string> watchedDirectories;
+	auto watchDirectory = [&](const std::string& path)
+	{
+		const int watch = inotify_add_watch(inotify, path.c_str(), watchMask);
+		if (watch >= 0)
+		{
+			watchedDirectories[watch] = path;
+		}
+	};
+	auto watchTree = [&](const std::string& root)
+	{
+		watchDirectory(root);
+		std::error_code error;
+		for (auto entry = std::filesystem::recursive_directory_iterator(root, error); !error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+		{
+			std::error_code entryError; //kept apart, an error here must not end the walk
+			if (entry->is_directory(entryError))
+			{
+				watchDirectory(entry->path().string());
+			}
+		}
+	};
+	watchTree(directory);
+	LOG(INFO, ASSETS, "Watching {} for changes ({} directories)", directory, watchedDirectories.size());
+
+	alignas(inotify_event) char buffer[4096];
+	while (!isStopping)
+	{
+		pollfd pollInotify = { inotify, POLLIN, 0 };
+		if (poll(&pollInotify, 1, FILE_WATCHER_SETTLE_MS) <= 0)
+		{
+			continue; //timed out, so the stop flag gets checked regularly
+		}
+		const ssize_t length = read(inotify, buffer, sizeof(buffer));
+		for (ssize_t position = 0; position < length;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + position);
+			position += sizeof(inotify_event) + event->len;
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				LOG(WARNING, ASSETS, "Too many changes under {} at once, some of them were missed", directory);
+				continue;
+			}
+			const auto watched = watchedDirectories.find(event->wd);
+			if (watched == watchedDirectories.end() || event->len == 0)
+			{
+				continue;
+			}
+			const std::string path = watched->second + "/" + event->name;
+			if (event->mask & IN_ISDIR)
+			{
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					watchTree(path);
+				}
+			}
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				//saved, or written somewhere else and renamed over it
+				AddChange(path);
+			}
+		}
+	}
+	close(inotify);
+	return true;
+}
+#else
+bool FileWatcher::WatchWithInotify()
+{
+	return false;
+}
+#endif
+
+void FileWatcher::WatchByPolling()
+{
+	LOG(INFO, ASSETS, "Polling {} for changes every {} ms", directory, FILE_WATCHER_POLL_MS);
+	std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+	bool isFirstScan = true;
+	while (!isStopping)
+	{
+		std::error_code error;
+		for (auto entry = std::filesystem::recursive_directory_iterator(directory, error); !error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+		{
+			std::error_code entryError; //kept apart, an error here must not end the walk
+			if (!entry->is_regular_file(entryError))
+			{
+				continue;
+			}
+			const std::filesystem::file_time_type writeTime = entry->last_write_time(entryError);
+			if (entryError)
+			{
+				continue;
+			}
+			const std::string path = entry->path().string();
+			const auto known = writeTimes.find(path);
+			if (known == writeTimes.end())
+			{
+				writeTimes.emplace(path, writeTime);
+				if (!isFirstScan)
+				{
+					AddChange(path);
+				}
+			}
+			else if (known->second != writeTime)
+			{
+				known->second = writeTime;
+				AddChange(path);
+			}
+		}
+		isFirstScan = false;
+
+		for (int waited = 0; waited < FILE_WATCHER_POLL_MS && !isStopping; waited += FILE_WATCHER_SETTLE_MS)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(FILE_WATCHER_SETTLE_MS));
+		}
+	}
+}
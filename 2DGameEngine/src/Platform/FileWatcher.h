@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+const int FILE_WATCHER_SETTLE_MS = 100; //a file has to be left alone this long before it's reported, editors save in several steps
+const int FILE_WATCHER_POLL_MS = 500; //how often the fallback scans the directory
+
+//The same file always gives the same string: "./assets/images/tank.png", "assets//images/tank.png" and the full path to it
+//are all the full path, with forward slashes
+std::string NormalizeFilePath(const std::string& filePath);
+
+////////////////////////////////////////////////////////////////////////
+// FileWatcher
+////////////////////////////////////////////////////////////////////////
+// Watches every file under a directory on a background thread, for
+// reloading assets while the game runs. On Linux it's told about writes
+// by inotify (new subdirectories are watched as they appear), anywhere
+// else, or if inotify can't be used, the thread scans the directory for
+// changed write times every FILE_WATCHER_POLL_MS.
+// Changes are collected under a lock, and the main thread takes the
+// files that have settled once a frame, so nothing is ever reloaded
+// halfway through being saved.
+////////////////////////////////////////////////////////////////////////
+class FileWatcher
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::string directory;
+	std::thread thread;
+	std::atomic<bool> isStopping{ false };
+	std::mutex changesMutex;
+	std::unordered_map<std::string, Clock::time_point> changes; //normalised path, when it last changed
+
+	void AddChange(const std::string& filePath);
+	//Returns false if inotify can't be used, the thread then falls back to polling
+	bool WatchWithInotify();
+	void WatchByPolling();
+
+public:
+	FileWatcher() = default;
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator =(const FileWatcher&) = delete;
+
+	//Returns false if the directory doesn't exist
+	bool Start(const std::string& directory);
+	void Stop();
+	bool IsRunning() const;
+
+	//Replaces the list with the files that changed and have settled since the last call, as normalised paths
+	void TakeChangedFiles(std::vector<std::string>& changedFiles);
+};
@@ -0,0 +1,123 @@
+#include "MappedFile.h"
+#include "../Logger/Logger.h"
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0))
+{
+}
+
+MappedFile& MappedFile::operator =(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		data = std::exchange(other.data, nullptr);
+		size = std::exchange(other.size, 0);
+	}
+	return *this;
+}
+
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false; //missing files are normal for callers that fall back to something else, so they log it themselves
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		LOG(ERROR, ASSETS, "Can't map {}, it's empty or its size can't be read", filePath);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	//the view keeps the file open, the handles aren't needed any more
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+	if (!view)
+	{
+		LOG(ERROR, ASSETS, "Couldn't map {} into memory (error {})", filePath, GetLastError());
+		return false;
+	}
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int file = open(filePath.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false; //missing files are normal for callers that fall back to something else, so they log it themselves
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		LOG(ERROR, ASSETS, "Can't map {}, it's empty or its size can't be read", filePath);
+		return false;
+	}
+	void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file); //the mapping keeps the file open
+	if (view == MAP_FAILED)
+	{
+		LOG(ERROR, ASSETS, "Couldn't map {} into memory", filePath);
+		return false;
+	}
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<size_t>(fileStat.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!data)
+	{
+		return;
+	}
+#if defined(_WIN32)
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<uint8_t*>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return data != nullptr;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////
+// MappedFile
+////////////////////////////////////////////////////////////////////////
+// A read only file mapped into memory. Opening it doesn't read anything,
+// pages are loaded by the OS the first time they're touched, so data can
+// be used straight from the file without copying it into our own buffers.
+// The mapping lasts until Close() or the MappedFile is destroyed, and
+// moves with the object, never copies
+////////////////////////////////////////////////////////////////////////
+class MappedFile
+{
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator =(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator =(MappedFile&& other) noexcept;
+
+	//Returns false (and logs why) if the file can't be opened or mapped. Empty files can't be mapped
+	bool Open(const std::string& filePath);
+	void Close();
+
+	bool IsOpen() const;
+	const uint8_t* GetData() const;
+	size_t GetSize() const;
+};
@@ -0,0 +1,190 @@
+#include "HardwareCounters.h"
+#include "../Logger/Logger.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+const char* GetHardwareCounterName(int counter)
+{
+	switch (counter)
+	{
+	case HW_CYCLES: return "cycles";
+	case HW_INSTRUCTIONS: return "instructions";
+	case HW_L1D_MISSES: return "L1D misses";
+	case HW_LLC_MISSES: return "LLC misses";
+	case HW_BRANCH_MISSES: return "branch misses";
+	}
+	return "unknown";
+}
+
+#if defined(__linux__)
+
+//All the counters of a thread are opened as one group, so a single read() gets them all
+//and the kernel always schedules them together
+struct ThreadCounters
+{
+	bool isEnabled = false;
+	int leaderFd = -1;
+	int fds[NUM_HW_COUNTERS] = { -1, -1, -1, -1, -1 };
+	int groupIndex[NUM_HW_COUNTERS] = { -1, -1, -1, -1, -1 }; //position of each counter in the group read, -1 if unsupported
+	int numInGroup = 0;
+};
+
+static thread_local ThreadCounters threadCounters;
+
+static void SetEventConfig(int counter, perf_event_attr& attr)
+{
+	attr.type = PERF_TYPE_HARDWARE;
+	switch (counter)
+	{
+	case HW_CYCLES: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+	case HW_INSTRUCTIONS: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+	case HW_LLC_MISSES: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+	case HW_BRANCH_MISSES: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+	case HW_L1D_MISSES:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	}
+}
+
+static int OpenEvent(int counter, int groupFd)
+{
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	SetEventConfig(counter, attr);
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.disabled = (groupFd == -1) ? 1 : 0; //the leader starts the whole group once everything is open
+	attr.exclude_kernel = 1; //user space only, that's all perf_event_paranoid 2 lets us see anyway
+	attr.exclude_hv = 1;
+
+	//pid 0 and cpu -1: this thread, on whichever cpu it runs
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+bool HardwareCounters::Enable()
+{
+	ThreadCounters& counters = threadCounters;
+	if (counters.isEnabled)
+	{
+		return true;
+	}
+
+	std::string unsupported;
+	int firstError = 0;
+	for (int counter = 0; counter < NUM_HW_COUNTERS; counter++)
+	{
+		const int fd = OpenEvent(counter, counters.leaderFd);
+		if (fd == -1)
+		{
+			firstError = firstError ? firstError : errno;
+			unsupported += std::string(unsupported.empty() ? "" : ", ") + GetHardwareCounterName(counter);
+			continue;
+		}
+		if (counters.leaderFd == -1)
+		{
+			counters.leaderFd = fd;
+		}
+		counters.fds[counter] = fd;
+		counters.groupIndex[counter] = counters.numInGroup++;
+	}
+
+	if (counters.leaderFd == -1)
+	{
+		LOG(ERROR, GENERAL, "Hardware counters unavailable ({}), check /proc/sys/kernel/perf_event_paranoid or the container's seccomp profile", std::strerror(firstError));
+		return false;
+	}
+	if (!unsupported.empty())
+	{
+		LOG(INFO, GENERAL, "Hardware counters not supported here: {}", unsupported);
+	}
+
+	ioctl(counters.leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(counters.leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	counters.isEnabled = true;
+	return true;
+}
+
+void HardwareCounters::Disable()
+{
+	ThreadCounters& counters = threadCounters;
+	for (int counter = 0; counter < NUM_HW_COUNTERS; counter++)
+	{
+		if (counters.fds[counter] != -1)
+		{
+			close(counters.fds[counter]);
+		}
+	}
+	counters = ThreadCounters();
+}
+
+bool HardwareCounters::IsEnabled()
+{
+	return threadCounters.isEnabled;
+}
+
+bool HardwareCounters::IsSupported(int counter)
+{
+	return counter >= 0 && counter < NUM_HW_COUNTERS && threadCounters.groupIndex[counter] != -1;
+}
+
+bool HardwareCounters::Read(HardwareCounterValues& values)
+{
+	const ThreadCounters& counters = threadCounters;
+	if (!counters.isEnabled)
+	{
+		return false;
+	}
+
+	//read_format layout: number of counters, time enabled, time running, then each counter's value
+	uint64_t buffer[3 + NUM_HW_COUNTERS];
+	const ssize_t expectedSize = static_cast<ssize_t>(sizeof(uint64_t) * (3 + counters.numInGroup));
+	if (read(counters.leaderFd, buffer, sizeof(buffer)) < expectedSize)
+	{
+		return false;
+	}
+
+	values.timeEnabled = buffer[1];
+	values.timeRunning = buffer[2];
+	for (int counter = 0; counter < NUM_HW_COUNTERS; counter++)
+	{
+		values.values[counter] = (counters.groupIndex[counter] != -1) ? buffer[3 + counters.groupIndex[counter]] : 0;
+	}
+	return true;
+}
+
+#else
+
+bool HardwareCounters::Enable()
+{
+	LOG(ERROR, GENERAL, "Hardware counters are only supported on Linux");
+	return false;
+}
+
+void HardwareCounters::Disable()
+{
+}
+
+bool HardwareCounters::IsEnabled()
+{
+	return false;
+}
+
+bool HardwareCounters::IsSupported(int /*counter*/)
+{
+	return false;
+}
+
+bool HardwareCounters::Read(HardwareCounterValues& /*counters*/)
+{
+	return false;
+}
+
+#endif
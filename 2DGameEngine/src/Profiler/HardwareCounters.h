@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////
+// HardwareCounters
+////////////////////////////////////////////////////////////////////////
+// CPU performance counters for the calling thread, read through
+// perf_event_open on Linux. SystemTimer reads them around every system
+// update so each system gets its own cycles, instructions, cache misses
+// and branch misses, which tells us whether it's memory or branch bound.
+// Counters the CPU/kernel won't give us (containers and VMs often allow
+// none at all) are just reported as unsupported, and everything else
+// keeps working. When there are more events than hardware counters the
+// kernel takes turns with them, so the values only cover the time the
+// group was running and GetScaled() scales them up to the whole time.
+// On other platforms Enable() always fails
+////////////////////////////////////////////////////////////////////////
+
+enum HardwareCounter
+{
+	HW_CYCLES,
+	HW_INSTRUCTIONS,
+	HW_L1D_MISSES,
+	HW_LLC_MISSES,
+	HW_BRANCH_MISSES,
+	NUM_HW_COUNTERS
+};
+
+const char* GetHardwareCounterName(int counter);
+
+struct HardwareCounterValues
+{
+	uint64_t values[NUM_HW_COUNTERS] = {};
+	uint64_t timeEnabled = 0; //nanoseconds the group was enabled
+	uint64_t timeRunning = 0; //nanoseconds it was actually counting, less than enabled when it was multiplexed
+
+	HardwareCounterValues& operator +=(const HardwareCounterValues& other)
+	{
+		for (int i = 0; i < NUM_HW_COUNTERS; i++)
+		{
+			values[i] += other.values[i];
+		}
+		timeEnabled += other.timeEnabled;
+		timeRunning += other.timeRunning;
+		return *this;
+	}
+
+	HardwareCounterValues operator -(const HardwareCounterValues& other) const
+	{
+		HardwareCounterValues difference;
+		for (int i = 0; i < NUM_HW_COUNTERS; i++)
+		{
+			difference.values[i] = values[i] - other.values[i];
+		}
+		difference.timeEnabled = timeEnabled - other.timeEnabled;
+		difference.timeRunning = timeRunning - other.timeRunning;
+		return difference;
+	}
+
+	//false when the group never got onto the hardware, the values are meaningless then (show n/a, not 0)
+	bool HasRun() const
+	{
+		return timeRunning > 0;
+	}
+
+	//The count scaled up to the whole time the group was enabled
+	double GetScaled(int counter) const
+	{
+		return HasRun() ? static_cast<double>(values[counter]) * (static_cast<double>(timeEnabled) / timeRunning) : 0.0;
+	}
+};
+
+class HardwareCounters
+{
+public:
+	//Opens the counters for the calling thread. Returns false if none of them could be opened
+	static bool Enable();
+	static void Disable();
+	static bool IsEnabled(); //on the calling thread
+	static bool IsSupported(int counter); //on the calling thread
+
+	//Current totals for the calling thread, as counted (use GetScaled()), unsupported counters stay 0
+	static bool Read(HardwareCounterValues& counters);
+};
@@ -0,0 +1,120 @@
+#include "Profiler.h"
+#include "../Logger/Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//Buffers are never freed, so zones from threads that have already finished can still be written out.
+//The mutex is only taken when a thread registers and when a trace is written, never when recording
+static std::mutex threadBuffersMutex;
+static std::vector<std::unique_ptr<ProfilerThreadBuffer>> threadBuffers;
+
+//Taken when the first thread registers. Comparing it with the time the trace is written
+//tells us how many ticks there are per nanosecond
+static uint64_t calibrationTicks = 0;
+static uint64_t calibrationNanoseconds = 0;
+
+ProfilerThreadBuffer* Profiler::RegisterThread()
+{
+	std::lock_guard<std::mutex> lock(threadBuffersMutex);
+	if (threadBuffers.empty())
+	{
+		calibrationTicks = Now();
+		calibrationNanoseconds = GetClockNanoseconds();
+	}
+	threadBuffers.push_back(std::make_unique<ProfilerThreadBuffer>());
+	ProfilerThreadBuffer* buffer = threadBuffers.back().get();
+	buffer->threadId = static_cast<uint32_t>(threadBuffers.size());
+	buffer->threadName = "Thread " + std::to_string(buffer->threadId);
+	return buffer;
+}
+
+void Profiler::SetThreadName(const std::string& name)
+{
+	ProfilerThreadBuffer& buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(threadBuffersMutex);
+	buffer.threadName = name;
+}
+
+//zone and thread names are ours, but escape them anyway so the file is always valid JSON
+static void WriteJsonString(FILE* file, const char* text)
+{
+	std::fputc('"', file);
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			std::fputc('\\', file);
+		}
+		std::fputc(*c, file);
+	}
+	std::fputc('"', file);
+}
+
+bool Profiler::WriteChromeTrace(const std::string& filePath)
+{
+	FILE* file = std::fopen(filePath.c_str(), "w");
+	if (!file)
+	{
+		LOG(ERROR, GENERAL, "Could not open profiler trace {}", filePath);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(threadBuffersMutex);
+
+	const uint64_t ticksNow = Now();
+	const uint64_t nanosecondsNow = GetClockNanoseconds();
+	double nanosecondsPerTick = 1.0;
+	if (ticksNow > calibrationTicks && nanosecondsNow > calibrationNanoseconds)
+	{
+		nanosecondsPerTick = static_cast<double>(nanosecondsNow - calibrationNanoseconds) / (ticksNow - calibrationTicks);
+	}
+
+	std::fputs("{\"traceEvents\":[\n", file);
+	bool isFirstEvent = true;
+	size_t numZones = 0;
+	std::vector<ProfileZoneRecord> records;
+	for (const auto& buffer : threadBuffers)
+	{
+		//copy out everything that's still in the ring, then throw away whatever the thread overwrote meanwhile
+		const uint64_t endIndex = buffer->GetWriteIndex();
+		uint64_t beginIndex = (endIndex > PROFILER_BUFFER_SIZE) ? endIndex - PROFILER_BUFFER_SIZE : 0;
+		records.clear();
+		for (uint64_t i = beginIndex; i < endIndex; i++)
+		{
+			records.push_back(buffer->GetRecord(i));
+		}
+		const uint64_t writeIndexAfterCopy = buffer->GetWriteIndex();
+		//the slot of writeIndexAfterCopy - PROFILER_BUFFER_SIZE may be half written by the zone the thread is storing right now
+		const uint64_t firstValidIndex = (writeIndexAfterCopy >= PROFILER_BUFFER_SIZE) ? writeIndexAfterCopy - PROFILER_BUFFER_SIZE + 1 : 0;
+		const size_t numOverwritten = static_cast<size_t>(std::min<uint64_t>(firstValidIndex > beginIndex ? firstValidIndex - beginIndex : 0, records.size()));
+
+		std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", isFirstEvent ? "" : ",\n", buffer->threadId);
+		WriteJsonString(file, buffer->threadName.c_str());
+		std::fputs("}}", file);
+		isFirstEvent = false;
+
+		for (size_t i = numOverwritten; i < records.size(); i++)
+		{
+			//chrome wants microseconds from any starting point, complete ("X") events nest by their times so depth isn't needed
+			const ProfileZoneRecord& record = records[i];
+			std::fputs(",\n{\"name\":", file);
+			WriteJsonString(file, record.name);
+			std::fprintf
+			(
+				file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->threadId,
+				(static_cast<double>(record.startTicks - calibrationTicks) * nanosecondsPerTick) / 1000.0,
+				(static_cast<double>(record.endTicks - record.startTicks) * nanosecondsPerTick) / 1000.0
+			);
+			numZones++;
+		}
+	}
+	std::fputs("\n]}\n", file);
+	std::fclose(file);
+
+	LOG(INFO, GENERAL, "Wrote {} profiler zones to {}", numZones, filePath);
+	return true;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//On x86 the time stamp counter is a lot cheaper to read than the OS clock, which keeps zones well under 50ns.
+//Ticks are turned into real time when the trace is written
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PROFILER_USE_TSC
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// Profiler
+////////////////////////////////////////////////////////////////////////
+// Scoped timing zones that can be written out as a Chrome trace
+// (open it in chrome://tracing or ui.perfetto.dev).
+//
+//		void MovementSystem::Update(double deltaTime)
+//		{
+//			PROFILE_SCOPE("MovementSystem::Update");
+//			...
+//		}
+//
+// Every thread records into its own ring buffer, so recording a zone
+// never takes a lock: it's two counter reads and one store. When a buffer
+// is full the oldest zones get overwritten, so a trace always holds the
+// last PROFILER_BUFFER_SIZE zones of every thread.
+// Zones are only compiled in when ENABLE_PROFILER is defined (it is for
+// Debug builds), otherwise PROFILE_SCOPE does nothing at all
+////////////////////////////////////////////////////////////////////////
+
+const uint64_t PROFILER_BUFFER_SIZE = 1 << 16; //zones kept per thread, must be a power of two
+
+struct ProfileZoneRecord
+{
+	const char* name; //must be a string literal, only the pointer is stored
+	uint64_t startTicks;
+	uint64_t endTicks;
+	uint32_t depth;
+};
+
+//A single producer ring buffer, only its own thread ever writes to it
+class ProfilerThreadBuffer
+{
+private:
+	ProfileZoneRecord records[PROFILER_BUFFER_SIZE];
+	std::atomic<uint64_t> writeIndex{ 0 }; //number of zones ever written
+
+public:
+	uint32_t threadId = 0;
+	uint32_t depth = 0; //how many zones are currently open on this thread
+	std::string threadName;
+
+	void Push(const char* name, uint64_t startTicks, uint64_t endTicks, uint32_t zoneDepth)
+	{
+		const uint64_t index = writeIndex.load(std::memory_order_relaxed);
+		records[index & (PROFILER_BUFFER_SIZE - 1)] = { name, startTicks, endTicks, zoneDepth };
+		writeIndex.store(index + 1, std::memory_order_release);
+	}
+
+	uint64_t GetWriteIndex() const
+	{
+		return writeIndex.load(std::memory_order_acquire);
+	}
+
+	const ProfileZoneRecord& GetRecord(uint64_t index) const
+	{
+		return records[index & (PROFILER_BUFFER_SIZE - 1)];
+	}
+};
+
+class Profiler
+{
+private:
+	static ProfilerThreadBuffer* RegisterThread();
+
+public:
+	//Current time in profiler ticks (TSC cycles on x86, nanoseconds everywhere else)
+	static uint64_t Now()
+	{
+#if defined(PROFILER_USE_TSC)
+		return __rdtsc();
+#else
+		return GetClockNanoseconds();
+#endif
+	}
+
+	static uint64_t GetClockNanoseconds()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	//The calling thread's buffer, created the first time a thread records a zone
+	static ProfilerThreadBuffer& GetThreadBuffer()
+	{
+		thread_local ProfilerThreadBuffer* buffer = nullptr;
+		if (!buffer)
+		{
+			buffer = RegisterThread();
+		}
+		return *buffer;
+	}
+
+	//Shows up as the track name in the trace viewer
+	static void SetThreadName(const std::string& name);
+
+	//Writes every thread's recorded zones as Chrome trace JSON. Can be called at any time,
+	//zones that get overwritten while it's copying are left out
+	static bool WriteChromeTrace(const std::string& filePath);
+};
+
+//Records a zone from construction until it goes out of scope. Use PROFILE_SCOPE instead of this directly
+class ProfileZone
+{
+private:
+	ProfilerThreadBuffer& buffer;
+	const char* name;
+	uint64_t startTicks;
+
+public:
+	ProfileZone(const char* name) : buffer(Profiler::GetThreadBuffer()), name(name)
+	{
+		buffer.depth++;
+		startTicks = Profiler::Now();
+	}
+
+	~ProfileZone()
+	{
+		const uint64_t endTicks = Profiler::Now();
+		buffer.depth--;
+		buffer.Push(name, startTicks, endTicks, buffer.depth);
+	}
+};
+
+#if defined(ENABLE_PROFILER)
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
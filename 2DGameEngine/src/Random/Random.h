@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////
+// Random
+////////////////////////////////////////////////////////////////////////
+// Small seeded random number generator (PCG32). Unlike rand() or
+// std::random_device it gives the exact same sequence on every platform
+// for the same seed, which is what deterministic simulation needs.
+// Each system owns one, seeded from the registry seed and the system's
+// position in the system order, so systems don't affect each other's rolls.
+////////////////////////////////////////////////////////////////////////
+class Random
+{
+private:
+	uint64_t state = 0x853c49e6748fea9bull;
+	uint64_t increment = 0xda3e39cb94b95bdbull; //must be odd, selects the stream
+
+public:
+	Random() = default;
+	Random(uint64_t seed, uint64_t stream = 0)
+	{
+		Seed(seed, stream);
+	}
+
+	void Seed(uint64_t seed, uint64_t stream = 0)
+	{
+		state = 0;
+		increment = (stream << 1u) | 1u;
+		NextUInt();
+		state += seed;
+		NextUInt();
+	}
+
+	uint32_t NextUInt()
+	{
+		const uint64_t oldState = state;
+		state = oldState * 6364136223846793005ull + increment;
+		const uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+		const uint32_t rotation = static_cast<uint32_t>(oldState >> 59u);
+		return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+	}
+
+	//float in [0, 1)
+	float NextFloat()
+	{
+		return (NextUInt() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	//int in [min, max]
+	int Range(int min, int max)
+	{
+		const uint32_t span = static_cast<uint32_t>(max - min) + 1u;
+		return min + static_cast<int>(span == 0 ? NextUInt() : NextUInt() % span);
+	}
+
+	uint64_t GetState() const
+	{
+		return state;
+	}
+
+	uint64_t GetIncrement() const
+	{
+		return increment;
+	}
+
+	//used when restoring a saved simulation
+	void SetState(uint64_t newState, uint64_t newIncrement)
+	{
+		state = newState;
+		increment = newIncrement;
+	}
+};
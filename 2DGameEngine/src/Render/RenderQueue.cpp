@@ -0,0 +1,203 @@
+#include "RenderQueue.h"
+#include "../Components/SpriteComponent.h"
+#include "../Components/TransformComponent.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+//Draw order inside a layer. The entity id at the end makes it a total order, so the sort doesn't need to be stable
+static bool IsDrawnBefore(const RenderItem& a, const RenderItem& b)
+{
+	if (a.sortY != b.sortY)
+	{
+		return a.sortY < b.sortY;
+	}
+	if (a.texture != b.texture)
+	{
+		return std::less<SDL_Texture*>()(a.texture, b.texture);
+	}
+	return a.entity < b.entity;
+}
+
+//Close to one pass when the list is already nearly sorted, which it is from one frame to the next
+static void InsertionSort(RenderItemList& items)
+{
+	for (size_t i = 1; i < items.size(); i++)
+	{
+		if (!IsDrawnBefore(items[i], items[i - 1]))
+		{
+			continue;
+		}
+		const RenderItem item = items[i];
+		size_t j = i;
+		do
+		{
+			items[j] = items[j - 1];
+			j--;
+		} while (j > 0 && IsDrawnBefore(item, items[j - 1]));
+		items[j] = item;
+	}
+}
+
+void RenderQueue::Remove(Entity entity)
+{
+	//the item itself is dropped by the next Update(), it's in the middle of a bucket
+	const size_t entityId = static_cast<size_t>(entity.GetId());
+	if (entityId < entityVersions.size())
+	{
+		entityVersions[entityId]++;
+		lastVisibleFrames[entityId] = 0;
+	}
+}
+
+void RenderQueue::Clear()
+{
+	for (auto& layer : layers)
+	{
+		layer.items.clear();
+		layer.arrivals.clear();
+	}
+	arrivals.clear();
+	std::fill(lastVisibleFrames.begin(), lastVisibleFrames.end(), 0);
+	numItems = 0;
+}
+
+bool RenderQueue::IsValid(const RenderItem& item) const
+{
+	return entityVersions[item.entity.GetId()] == item.version;
+}
+
+bool RenderQueue::IsVisible(const RenderItem& item) const
+{
+	return lastVisibleFrames[item.entity.GetId()] == frame;
+}
+
+RenderLayer& RenderQueue::FindOrAddLayer(int zIndex)
+{
+	auto layer = std::lower_bound
+	(
+		layers.begin(),
+		layers.end(),
+		zIndex,
+		[](const RenderLayer& layer, int z) { return layer.zIndex < z; }
+	);
+	if (layer == layers.end() || layer->zIndex != zIndex)
+	{
+		//only when a zIndex is used for the first time
+		layer = layers.insert(layer, RenderLayer{ zIndex, {}, {} });
+	}
+	return *layer;
+}
+
+int RenderQueue::Refresh(RenderItem& item, const CameraComponent& camera, const AssetStore& assetStore) const
+{
+	const auto& sprite = item.entity.ReadComponent<SpriteComponent>();
+	const auto& transform = item.entity.ReadComponent<TransformComponent>();
+
+	const float width = static_cast<float>(sprite.width * transform.scale.x);
+	const float height = static_cast<float>(sprite.height * transform.scale.y);
+	//srcRect is on the sprite's own image, the item's is on the texture (an atlas page for most sprites)
+	const TextureRegion& region = assetStore.GetTextureRegion(sprite.assetHandle);
+	item.texture = region.texture;
+	item.srcRect = region.MapRect(sprite.srcRect);
+	item.dstRect =
+	{
+		camera.viewport.x + static_cast<int>((transform.position.x - camera.position.x) * camera.zoom),
+		camera.viewport.y + static_cast<int>((transform.position.y - camera.position.y) * camera.zoom),
+		static_cast<int>(width * camera.zoom),
+		static_cast<int>(height * camera.zoom)
+	};
+	item.rotation = transform.rotation;
+	//in the world rather than on screen, so moving or zooming the camera can't change the draw order
+	item.sortY = static_cast<int>(transform.position.y + height);
+	return sprite.zIndex;
+}
+
+void RenderQueue::SortLayer(RenderLayer& layer)
+{
+	InsertionSort(layer.items);
+	if (layer.arrivals.empty())
+	{
+		return;
+	}
+
+	//arrivals can be anywhere (a whole level at once when it loads), so they get a proper sort and are merged in
+	std::sort(layer.arrivals.begin(), layer.arrivals.end(), IsDrawnBefore);
+	mergeBuffer.clear();
+	std::merge
+	(
+		layer.items.begin(), layer.items.end(),
+		layer.arrivals.begin(), layer.arrivals.end(),
+		std::back_inserter(mergeBuffer),
+		IsDrawnBefore
+	);
+	layer.items.swap(mergeBuffer);
+	layer.arrivals.clear();
+}
+
+void RenderQueue::Update(const SpatialEntityList& visibleEntities, const CameraComponent& camera, const AssetStore& assetStore)
+{
+	frame++;
+
+	//Mark everything visible this frame. Whatever wasn't visible last frame isn't in a layer yet, so it arrives
+	for (const auto& entity : visibleEntities)
+	{
+		const size_t entityId = static_cast<size_t>(entity.GetId());
+		if (entityId >= lastVisibleFrames.size())
+		{
+			lastVisibleFrames.resize(entityId + 1, 0);
+			entityVersions.resize(entityId + 1, 0);
+		}
+		if (lastVisibleFrames[entityId] != frame - 1)
+		{
+			RenderItem item = { entity, entityVersions[entityId], 0, nullptr, {}, {}, 0.0 };
+			arrivals.push_back(item);
+		}
+		lastVisibleFrames[entityId] = frame;
+	}
+
+	//Refresh every item, drop the removed and the no longer visible ones and send the ones whose zIndex changed to their new layer
+	for (auto& layer : layers)
+	{
+		size_t numKept = 0;
+		for (auto& item : layer.items)
+		{
+			if (!IsValid(item) || !IsVisible(item))
+			{
+				continue;
+			}
+			if (Refresh(item, camera, assetStore) != layer.zIndex)
+			{
+				arrivals.push_back(item);
+				continue;
+			}
+			layer.items[numKept++] = item;
+		}
+		layer.items.erase(layer.items.begin() + numKept, layer.items.end());
+	}
+
+	//New and moved items go to the arrivals of their layer. Adding a layer can move the others, so it's done after the loop above
+	for (auto& item : arrivals)
+	{
+		const int zIndex = Refresh(item, camera, assetStore);
+		FindOrAddLayer(zIndex).arrivals.push_back(item);
+	}
+	arrivals.clear();
+
+	numItems = 0;
+	for (auto& layer : layers)
+	{
+		SortLayer(layer);
+		numItems += static_cast<int>(layer.items.size());
+	}
+}
+
+const std::vector<RenderLayer>& RenderQueue::GetLayers() const
+{
+	return layers;
+}
+
+int RenderQueue::GetNumItems() const
+{
+	return numItems;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <SDL.h>
+#include "../ECS/ECS.h"
+#include "../AssetStore/AssetStore.h"
+#include "../Components/CameraComponent.h"
+#include "../Memory/MemoryTracker.h"
+#include "../Spatial/SpatialGrid.h"
+
+////////////////////////////////////////////////////////////////////////
+// RenderQueue
+////////////////////////////////////////////////////////////////////////
+// The draw list of the render system, kept from one frame to the next.
+// Only sprites the camera can see are in it. Every Update() gets this
+// frame's visible entities: the ones that weren't visible last frame
+// come in as arrivals, and items that aren't visible any more are
+// dropped, so the work depends on what's on screen, not on the size of
+// the world.
+// Sprites live in one bucket per zIndex, and inside a bucket they're
+// ordered by the bottom edge of the sprite in the world (so units lower
+// on screen are drawn in front), then by texture, then by entity id.
+// That's a total order, so sprites never swap places between frames.
+// A sprite whose zIndex changes moves to its new bucket on the next
+// Update(). Because things only move a little between frames, the
+// buckets are kept sorted with an insertion sort, which is close to a
+// single pass over input that's already nearly sorted. New arrivals are
+// sorted on their own and merged in.
+// Once every bucket has grown to its working size, an Update() makes no
+// heap allocations
+////////////////////////////////////////////////////////////////////////
+struct RenderItem
+{
+	Entity entity;
+	uint32_t version; //matches the entity's version in the queue while the item is still valid
+	int sortY; //bottom edge of the sprite in the world
+	SDL_Texture* texture; //nullptr if the texture was never loaded
+	SDL_Rect srcRect; //on the texture, already moved to the sprite's place in the atlas
+	SDL_Rect dstRect; //on screen, after the camera
+	double rotation;
+};
+
+typedef std::vector<RenderItem, TrackingAllocator<RenderItem, MEMORY_TAG_RENDER>> RenderItemList;
+
+struct RenderLayer
+{
+	int zIndex;
+	RenderItemList items; //sorted, in draw order
+	RenderItemList arrivals; //added or moved here since the last Update(), merged into items by Update()
+};
+
+class RenderQueue
+{
+private:
+	std::vector<RenderLayer> layers; //sorted by zIndex
+	RenderItemList arrivals; //entities that came into view this frame, not in a layer yet
+	RenderItemList mergeBuffer; //swapped with a layer's items when merging arrivals, so neither is ever freed
+	std::vector<uint32_t, TrackingAllocator<uint32_t, MEMORY_TAG_RENDER>> entityVersions; //by entity id, bumped every time the entity is removed
+	std::vector<uint32_t, TrackingAllocator<uint32_t, MEMORY_TAG_RENDER>> lastVisibleFrames; //by entity id, 0 = not visible since it was added
+	uint32_t frame = 1; //starts past 0, so "visible last frame" is never true for an entity that hasn't been seen
+	int numItems = 0;
+
+	bool IsValid(const RenderItem& item) const;
+	bool IsVisible(const RenderItem& item) const;
+	RenderLayer& FindOrAddLayer(int zIndex);
+	//Copies what's needed to draw the entity out of its components. Returns the sprite's zIndex
+	int Refresh(RenderItem& item, const CameraComponent& camera, const AssetStore& assetStore) const;
+	void SortLayer(RenderLayer& layer);
+
+public:
+	//An entity left the render system, its item is dropped even if the id is reused straight away
+	void Remove(Entity entity);
+	void Clear();
+
+	//Takes this frame's visible entities (in any order), picks up their positions, textures and zIndex
+	//changes and puts every bucket back in order
+	void Update(const SpatialEntityList& visibleEntities, const CameraComponent& camera, const AssetStore& assetStore);
+
+	//In draw order, valid until the next Update()
+	const std::vector<RenderLayer>& GetLayers() const;
+	//Visible sprites in the last Update()
+	int GetNumItems() const;
+};
@@ -0,0 +1,577 @@
+#include "TextRenderer.h"
+#include "../AssetStore/CookedAssets.h"
+#include "../Determinism/StateHasher.h"
+#include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+const int GLYPH_PADDING = 1; //empty pixels between glyphs on a page, so neighbours never bleed into each other
+const Uint16 GLYPH_REPLACEMENT = '?';
+
+//Returns the next character and moves past it. Anything that isn't valid UTF-8 is one byte of GLYPH_REPLACEMENT,
+//and so is anything past the basic multilingual plane, which SDL_ttf's glyph functions can't take
+static Uint16 DecodeUtf8(std::string_view text, size_t& position)
+{
+	const unsigned char first = static_cast<unsigned char>(text[position++]);
+	if (first < 0x80)
+	{
+		return first;
+	}
+	int numContinuations;
+	uint32_t character;
+	if ((first & 0xE0) == 0xC0)
+	{
+		numContinuations = 1;
+		character = first & 0x1F;
+	}
+	else if ((first & 0xF0) == 0xE0)
+	{
+		numContinuations = 2;
+		character = first & 0x0F;
+	}
+	else if ((first & 0xF8) == 0xF0)
+	{
+		numContinuations = 3;
+		character = first & 0x07;
+	}
+	else
+	{
+		return GLYPH_REPLACEMENT;
+	}
+	if (text.size() - position < static_cast<size_t>(numContinuations))
+	{
+		return GLYPH_REPLACEMENT;
+	}
+	for (int i = 0; i < numContinuations; i++)
+	{
+		const unsigned char next = static_cast<unsigned char>(text[position + i]);
+		if ((next & 0xC0) != 0x80)
+		{
+			return GLYPH_REPLACEMENT;
+		}
+		character = (character << 6) | (next & 0x3F);
+	}
+	position += numContinuations;
+	return character <= 0xFFFF ? static_cast<Uint16>(character) : GLYPH_REPLACEMENT;
+}
+
+void TextRenderer::Initialize(SDL_Renderer* renderer, bool isPremultipliedAlpha)
+{
+	this->renderer = renderer;
+	this->isPremultipliedAlpha = isPremultipliedAlpha;
+	blendMode = isPremultipliedAlpha ? AssetStore::GetPremultipliedBlendMode() : SDL_BLENDMODE_BLEND;
+	shapedTexts.resize(MAX_SHAPED_TEXTS + 1);
+	buckets.assign(MAX_SHAPED_TEXTS * 2, -1);
+}
+
+void TextRenderer::Destroy()
+{
+	for (auto& font : fonts)
+	{
+		TTF_CloseFont(font.font);
+	}
+	fonts.clear();
+	for (auto& page : pages)
+	{
+		SDL_DestroyTexture(page.texture);
+	}
+	pages.clear();
+	isAtlasFull = false;
+	shapedTexts.clear();
+	buckets.clear();
+	clockHand = 0;
+	numShapedTexts = 0;
+	numUsedThisFrame = 0;
+	numUsedLastFrame = 0;
+	queuedGlyphs.clear();
+	renderer = nullptr;
+}
+
+FontHandle TextRenderer::LoadFont(const AssetStore& assetStore, const std::string& filePath, int pointSize)
+{
+	Font font;
+	SDL_RWops* file = assetStore.OpenFile(filePath, font.buffer);
+	if (!file)
+	{
+		return FONT_HANDLE_INVALID;
+	}
+	font.font = TTF_OpenFontRW(file, 1, pointSize); //closes the file, even when it fails
+	if (!font.font)
+	{
+		LOG(ERROR, RENDER, "Could not open font {}: {}", filePath, SDL_GetError());
+		return FONT_HANDLE_INVALID;
+	}
+	font.height = TTF_FontHeight(font.font);
+	font.lineSkip = TTF_FontLineSkip(font.font);
+	std::fill(std::begin(font.asciiGlyphs), std::end(font.asciiGlyphs), -1);
+	fonts.push_back(std::move(font));
+	LOG(INFO, RENDER, "Font {} loaded at {}pt", filePath, pointSize);
+	return static_cast<FontHandle>(fonts.size() - 1);
+}
+
+int TextRenderer::GetLineHeight(FontHandle font) const
+{
+	return font == FONT_HANDLE_INVALID ? 0 : fonts[font].height;
+}
+
+int TextRenderer::GetLineSkip(FontHandle font) const
+{
+	return font == FONT_HANDLE_INVALID ? 0 : fonts[font].lineSkip;
+}
+
+int TextRenderer::FindGlyph(Font& font, Uint16 character)
+{
+	if (character < 128)
+	{
+		if (font.asciiGlyphs[character] < 0)
+		{
+			font.asciiGlyphs[character] = RasterizeGlyph(font, character);
+		}
+		return font.asciiGlyphs[character];
+	}
+	const auto found = font.otherGlyphs.find(character);
+	if (found != font.otherGlyphs.end())
+	{
+		return found->second;
+	}
+	const int glyph = RasterizeGlyph(font, character);
+	font.otherGlyphs[character] = glyph;
+	return glyph;
+}
+
+int TextRenderer::RasterizeGlyph(Font& font, Uint16 character)
+{
+	//the metrics of a character the font doesn't have are .notdef's, so that has to be asked about first
+	int minX, maxX, minY, maxY, advance;
+	if (!TTF_GlyphIsProvided(font.font, character) || TTF_GlyphMetrics(font.font, character, &minX, &maxX, &minY, &maxY, &advance) != 0)
+	{
+		return character == GLYPH_REPLACEMENT ? -1 : FindGlyph(font, GLYPH_REPLACEMENT);
+	}
+	Glyph glyph;
+	glyph.advance = advance;
+
+	//white, the color comes from the vertices (or the texture's color mod) when it's drawn
+	const SDL_Color white = { 255, 255, 255, 255 };
+	SDL_Surface* rendered = TTF_RenderGlyph_Blended(font.font, character, white);
+	SDL_Surface* surface = rendered && rendered->format->format != SDL_PIXELFORMAT_ARGB8888 ? SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0) : rendered;
+	if (surface && SDL_LockSurface(surface) == 0)
+	{
+		//cropped to the pixels with any ink, the surface is the whole line high and mostly empty
+		int left = surface->w;
+		int right = -1;
+		int top = surface->h;
+		int bottom = -1;
+		for (int y = 0; y < surface->h; y++)
+		{
+			const uint32_t* row = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(surface->pixels) + y * surface->pitch);
+			for (int x = 0; x < surface->w; x++)
+			{
+				if (row[x] >> 24)
+				{
+					left = std::min(left, x);
+					right = std::max(right, x);
+					top = std::min(top, y);
+					bottom = std::max(bottom, y);
+				}
+			}
+		}
+		if (right >= 0)
+		{
+			const SDL_Rect ink = { left, top, right - left + 1, bottom - top + 1 };
+			if (AddToPage(surface, ink, glyph))
+			{
+				//the surface's top left is the pen position at the top of the line
+				glyph.offsetX = ink.x;
+				glyph.offsetY = ink.y;
+			}
+		}
+		SDL_UnlockSurface(surface);
+	}
+	if (surface != rendered)
+	{
+		SDL_FreeSurface(surface);
+	}
+	SDL_FreeSurface(rendered);
+
+	font.glyphs.push_back(glyph);
+	return static_cast<int>(font.glyphs.size() - 1);
+}
+
+bool TextRenderer::AddToPage(SDL_Surface* surface, const SDL_Rect& ink, Glyph& glyph)
+{
+	if (!renderer || isAtlasFull || ink.w + GLYPH_PADDING > GLYPH_PAGE_SIZE || ink.h + GLYPH_PADDING > GLYPH_PAGE_SIZE)
+	{
+		return false;
+	}
+
+	//glyphs are only ever added to the last page, a shelf at a time
+	GlyphPage* page = pages.empty() ? nullptr : &pages.back();
+	if (page && page->shelfX + ink.w + GLYPH_PADDING > GLYPH_PAGE_SIZE)
+	{
+		page->shelfX = 0;
+		page->shelfY += page->shelfHeight;
+		page->shelfHeight = 0;
+	}
+	if (!page || page->shelfY + ink.h + GLYPH_PADDING > GLYPH_PAGE_SIZE)
+	{
+		if (pages.size() == MAX_GLYPH_PAGES)
+		{
+			LOG(WARNING, RENDER, "All {} glyph pages are full, glyphs that aren't on one yet won't be drawn", MAX_GLYPH_PAGES);
+			isAtlasFull = true;
+			return false;
+		}
+		SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, GLYPH_PAGE_SIZE, GLYPH_PAGE_SIZE);
+		if (!texture)
+		{
+			LOG(ERROR, RENDER, "Could not create a glyph page: {}", SDL_GetError());
+			isAtlasFull = true;
+			return false;
+		}
+		//cleared once, glyphs only ever write their own rect and the padding around them has to stay empty
+		const std::vector<uint32_t> clear(static_cast<size_t>(GLYPH_PAGE_SIZE) * GLYPH_PAGE_SIZE, 0);
+		SDL_UpdateTexture(texture, NULL, clear.data(), GLYPH_PAGE_SIZE * sizeof(uint32_t));
+		SDL_SetTextureBlendMode(texture, blendMode);
+		pages.push_back(GlyphPage());
+		page = &pages.back();
+		page->texture = texture;
+	}
+
+	uint32_t* pixels = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(surface->pixels) + ink.y * surface->pitch) + ink.x;
+	if (isPremultipliedAlpha)
+	{
+		for (int y = 0; y < ink.h; y++)
+		{
+			PremultiplyAlpha(reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(pixels) + y * surface->pitch), ink.w);
+		}
+	}
+	glyph.page = static_cast<int>(pages.size() - 1);
+	glyph.srcRect = { page->shelfX, page->shelfY, ink.w, ink.h };
+	SDL_UpdateTexture(page->texture, &glyph.srcRect, pixels, surface->pitch);
+	page->shelfX += ink.w + GLYPH_PADDING;
+	page->shelfHeight = std::max(page->shelfHeight, ink.h + GLYPH_PADDING);
+	pendingGlyphUploads++;
+	return true;
+}
+
+uint64_t TextRenderer::HashText(FontHandle font, std::string_view text)
+{
+	StateHasher hasher;
+	hasher.Add(font);
+	hasher.AddBytes(text.data(), text.size());
+	return hasher.GetHash();
+}
+
+void TextRenderer::Unlink(int slot)
+{
+	int* link = &buckets[shapedTexts[slot].hash & (buckets.size() - 1)];
+	while (*link != slot)
+	{
+		link = &shapedTexts[*link].next;
+	}
+	*link = shapedTexts[slot].next;
+}
+
+void TextRenderer::MarkUsedThisFrame(ShapedText& shapedText)
+{
+	if (shapedText.lastUsedFrame == frame)
+	{
+		return;
+	}
+	if (shapedText.lastUsedFrame + 1 == frame)
+	{
+		numUsedLastFrame--;
+	}
+	numUsedThisFrame++;
+	shapedText.lastUsedFrame = frame;
+}
+
+int TextRenderer::TakeSlot()
+{
+	//A string that hasn't been drawn since before the last Flush() first, so a counter that changes every frame keeps
+	//reusing the few slots its old values were in and their memory. Then a slot that's never been used, and last a
+	//string that hasn't been drawn this frame. A pass only runs when there's a slot of its kind, so it always finds
+	//one, and past MAX_SHAPED_TEXTS strings in a frame nothing is scanned
+	const int numCandidates[3] = { numShapedTexts - numUsedThisFrame - numUsedLastFrame, MAX_SHAPED_TEXTS - numShapedTexts, numUsedLastFrame };
+	for (int pass = 0; pass < 3; pass++)
+	{
+		if (numCandidates[pass] <= 0)
+		{
+			continue;
+		}
+		for (int i = 0; i < MAX_SHAPED_TEXTS; i++)
+		{
+			const int slot = clockHand;
+			clockHand = (clockHand + 1) % MAX_SHAPED_TEXTS;
+			const ShapedText& shapedText = shapedTexts[slot];
+			const bool isFree = shapedText.font == FONT_HANDLE_INVALID;
+			if (pass == 1 && isFree)
+			{
+				numShapedTexts++;
+				return slot;
+			}
+			const bool isStale = !isFree && shapedText.lastUsedFrame + 1 < frame;
+			const bool isUnusedThisFrame = !isFree && shapedText.lastUsedFrame < frame;
+			if ((pass == 0 && isStale) || (pass == 2 && isUnusedThisFrame))
+			{
+				if (pass == 2)
+				{
+					numUsedLastFrame--;
+				}
+				Unlink(slot);
+				return slot;
+			}
+		}
+	}
+	return MAX_SHAPED_TEXTS; //every slot has been drawn this frame, shaped into the spare one that's never kept
+}
+
+const TextRenderer::ShapedText& TextRenderer::Shape(FontHandle font, std::string_view text)
+{
+	const uint64_t hash = HashText(font, text);
+	int& bucket = buckets[hash & (buckets.size() - 1)];
+	for (int slot = bucket; slot >= 0; slot = shapedTexts[slot].next)
+	{
+		ShapedText& shapedText = shapedTexts[slot];
+		if (shapedText.hash == hash && shapedText.font == font && shapedText.text == text)
+		{
+			MarkUsedThisFrame(shapedText);
+			return shapedText;
+		}
+	}
+
+	PROFILE_SCOPE("TextRenderer::Shape");
+	const int slot = TakeSlot();
+	ShapedText& shapedText = shapedTexts[slot];
+	//assigned over the slot's last string and glyphs, so their memory is reused
+	shapedText.font = font;
+	shapedText.text.assign(text);
+	shapedText.hash = hash;
+	shapedText.lastUsedFrame = frame;
+	if (slot < MAX_SHAPED_TEXTS)
+	{
+		numUsedThisFrame++; //TakeSlot() already took it out of the count it was in
+	}
+	shapedText.glyphs.clear();
+	Font& shapedFont = fonts[font];
+	int penX = 0;
+	Uint16 previous = 0;
+	for (size_t position = 0; position < text.size(); )
+	{
+		const Uint16 character = DecodeUtf8(text, position);
+		const int glyph = FindGlyph(shapedFont, character);
+		if (glyph < 0)
+		{
+			continue;
+		}
+		if (previous != 0)
+		{
+			penX += TTF_GetFontKerningSizeGlyphs(shapedFont.font, previous, character);
+		}
+		shapedText.glyphs.push_back({ glyph, penX });
+		penX += shapedFont.glyphs[glyph].advance;
+		previous = character;
+	}
+	shapedText.width = penX;
+	if (slot < MAX_SHAPED_TEXTS)
+	{
+		shapedText.next = bucket;
+		bucket = slot;
+	}
+	pendingShapes++;
+	return shapedText;
+}
+
+int TextRenderer::DrawText(FontHandle font, std::string_view text, float x, float y, SDL_Color color, TextAlign align)
+{
+	if (font == FONT_HANDLE_INVALID || text.empty() || buckets.empty())
+	{
+		return 0;
+	}
+	const ShapedText& shapedText = Shape(font, text);
+	if (align == TEXT_ALIGN_CENTER)
+	{
+		x -= shapedText.width * 0.5f;
+	}
+	else if (align == TEXT_ALIGN_RIGHT)
+	{
+		x -= static_cast<float>(shapedText.width);
+	}
+	if (isPremultipliedAlpha)
+	{
+		//the glyphs are premultiplied white, so the color has to be too
+		color.r = static_cast<Uint8>(color.r * color.a / 255);
+		color.g = static_cast<Uint8>(color.g * color.a / 255);
+		color.b = static_cast<Uint8>(color.b * color.a / 255);
+	}
+	const int left = static_cast<int>(std::lround(x));
+	const int top = static_cast<int>(std::lround(y));
+	const std::vector<Glyph>& glyphs = fonts[font].glyphs;
+	for (const auto& shapedGlyph : shapedText.glyphs)
+	{
+		const Glyph& glyph = glyphs[shapedGlyph.glyph];
+		if (glyph.page < 0)
+		{
+			continue;
+		}
+		const SDL_Rect dstRect = { left + shapedGlyph.penX + glyph.offsetX, top + glyph.offsetY, glyph.srcRect.w, glyph.srcRect.h };
+		queuedGlyphs.push_back({ glyph.page, glyph.srcRect, dstRect, color });
+	}
+	return shapedText.width;
+}
+
+int TextRenderer::MeasureText(FontHandle font, std::string_view text)
+{
+	if (font == FONT_HANDLE_INVALID || text.empty() || buckets.empty())
+	{
+		return 0;
+	}
+	return Shape(font, text).width;
+}
+
+void TextRenderer::DrawGlyphsOneByOne()
+{
+	for (const auto& queued : queuedGlyphs)
+	{
+		SDL_Texture* texture = pages[queued.page].texture;
+		SDL_SetTextureColorMod(texture, queued.color.r, queued.color.g, queued.color.b);
+		SDL_SetTextureAlphaMod(texture, queued.color.a);
+		SDL_RenderCopy(renderer, texture, &queued.srcRect, &queued.dstRect);
+		numDrawCalls++;
+	}
+	//the batched path colors the vertices, the pages themselves stay white
+	for (const auto& page : pages)
+	{
+		SDL_SetTextureColorMod(page.texture, 255, 255, 255);
+		SDL_SetTextureAlphaMod(page.texture, 255);
+	}
+}
+
+#if TEXT_RENDERER_HAS_GEOMETRY
+bool TextRenderer::DrawBatches()
+{
+	const size_t numQuads = queuedGlyphs.size();
+	if (vertices.size() < numQuads * 4)
+	{
+		vertices.resize(numQuads * 4);
+	}
+	for (size_t quad = indices.size() / 6; quad < numQuads; quad++)
+	{
+		const int first = static_cast<int>(quad * 4);
+		indices.insert(indices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
+	}
+
+	const float inversePageSize = 1.0f / GLYPH_PAGE_SIZE;
+	for (size_t i = 0; i < numQuads; i++)
+	{
+		const QueuedGlyph& queued = queuedGlyphs[i];
+		const float x0 = static_cast<float>(queued.dstRect.x);
+		const float y0 = static_cast<float>(queued.dstRect.y);
+		const float x1 = static_cast<float>(queued.dstRect.x + queued.dstRect.w);
+		const float y1 = static_cast<float>(queued.dstRect.y + queued.dstRect.h);
+		const float u0 = queued.srcRect.x * inversePageSize;
+		const float v0 = queued.srcRect.y * inversePageSize;
+		const float u1 = (queued.srcRect.x + queued.srcRect.w) * inversePageSize;
+		const float v1 = (queued.srcRect.y + queued.srcRect.h) * inversePageSize;
+		SDL_Vertex* vertex = &vertices[i * 4];
+		vertex[0] = { { x0, y0 }, queued.color, { u0, v0 } };
+		vertex[1] = { { x1, y0 }, queued.color, { u1, v0 } };
+		vertex[2] = { { x1, y1 }, queued.color, { u1, v1 } };
+		vertex[3] = { { x0, y1 }, queued.color, { u0, v1 } };
+	}
+
+	//every run of glyphs in a row on the same page is one batch, the vertices are already in order
+	size_t first = 0;
+	while (first < numQuads)
+	{
+		const int page = queuedGlyphs[first].page;
+		size_t last = first + 1;
+		while (last < numQuads && queuedGlyphs[last].page == page)
+		{
+			last++;
+		}
+		const int numRunQuads = static_cast<int>(last - first);
+		const int result = SDL_RenderGeometry(renderer, pages[page].texture, &vertices[first * 4], numRunQuads * 4, indices.data(), numRunQuads * 6);
+		numDrawCalls++;
+		if (result != 0)
+		{
+			return false;
+		}
+		first = last;
+	}
+	return true;
+}
+#endif
+
+void TextRenderer::Flush()
+{
+	PROFILE_SCOPE("TextRenderer::Flush");
+	numDrawCalls = 0;
+	numGlyphsDrawn = static_cast<int>(queuedGlyphs.size());
+	if (renderer && !queuedGlyphs.empty())
+	{
+#if TEXT_RENDERER_HAS_GEOMETRY
+		if (isBatchingEnabled && !DrawBatches())
+		{
+			//the rest of this frame's text is lost, every frame after this is drawn one glyph at a time
+			LOG(ERROR, RENDER, "SDL_RenderGeometry failed, drawing text one glyph at a time from now on: {}", SDL_GetError());
+			isBatchingEnabled = false;
+		}
+		else if (!isBatchingEnabled)
+		{
+			DrawGlyphsOneByOne();
+		}
+#else
+		DrawGlyphsOneByOne();
+#endif
+	}
+	queuedGlyphs.clear();
+	numGlyphUploads = pendingGlyphUploads;
+	numShapes = pendingShapes;
+	pendingGlyphUploads = 0;
+	pendingShapes = 0;
+	numUsedLastFrame = numUsedThisFrame;
+	numUsedThisFrame = 0;
+	frame++;
+}
+
+void TextRenderer::SetBatching(bool enabled)
+{
+	isBatchingEnabled = enabled;
+}
+
+bool TextRenderer::IsBatchingEnabled() const
+{
+	return isBatchingEnabled && TEXT_RENDERER_HAS_GEOMETRY;
+}
+
+int TextRenderer::GetNumDrawCalls() const
+{
+	return numDrawCalls;
+}
+
+int TextRenderer::GetNumGlyphsDrawn() const
+{
+	return numGlyphsDrawn;
+}
+
+int TextRenderer::GetNumGlyphUploads() const
+{
+	return numGlyphUploads;
+}
+
+int TextRenderer::GetNumShapes() const
+{
+	return numShapes;
+}
+
+int TextRenderer::GetNumPages() const
+{
+	return static_cast<int>(pages.size());
+}
+
+int TextRenderer::GetNumShapedTexts() const
+{
+	return numShapedTexts;
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "../AssetStore/AssetStore.h"
+#include "../Memory/MemoryTracker.h"
+
+//SDL_RenderGeometry is only in SDL 2.0.18 and newer, older versions always draw one glyph at a time
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define TEXT_RENDERER_HAS_GEOMETRY 1
+#else
+#define TEXT_RENDERER_HAS_GEOMETRY 0
+#endif
+
+typedef int FontHandle;
+const FontHandle FONT_HANDLE_INVALID = -1;
+
+//Which part of the line DrawText()'s x is
+enum TextAlign : uint8_t
+{
+	TEXT_ALIGN_LEFT,
+	TEXT_ALIGN_CENTER,
+	TEXT_ALIGN_RIGHT
+};
+
+const int GLYPH_PAGE_SIZE = 512; //glyph atlas pages are square, in pixels
+const int MAX_GLYPH_PAGES = 8;
+const int MAX_SHAPED_TEXTS = 1024; //strings kept shaped between frames
+
+////////////////////////////////////////////////////////////////////////
+// TextRenderer
+////////////////////////////////////////////////////////////////////////
+// Text drawn with SDL_ttf, without a surface and a texture per string
+// per frame like TTF_RenderText does.
+// A glyph is rasterized the first time it's drawn, cropped to its ink,
+// and copied into a glyph page: a 512x512 texture shared by every font,
+// filled shelf by shelf. After that it's only ever a quad on that page.
+// Shaping a string (decoding the UTF-8, finding each glyph, kerning the
+// pairs) is cached too, so a label that's drawn every frame is shaped
+// once. The cache is a fixed number of slots. A new string is shaped
+// over one that hasn't been drawn for a frame, keeping that slot's
+// string and glyph list memory, so counters that change every frame
+// cycle through a few slots and don't allocate either.
+// DrawText() only queues the glyphs. Flush() draws everything queued
+// since the last one, in order, one SDL_RenderGeometry batch per run of
+// glyphs on the same page, which for a frame's worth of labels is
+// usually a single draw call.
+// Once every glyph and string on screen has been seen and the buffers
+// have grown to their working size, a frame of text makes no heap
+// allocations and uploads nothing.
+// Fonts are closed by Destroy(), which has to be called before TTF_Quit()
+////////////////////////////////////////////////////////////////////////
+class TextRenderer
+{
+private:
+	struct Glyph
+	{
+		int page = -1; //-1 for glyphs with nothing to draw (spaces) or that didn't fit
+		SDL_Rect srcRect = { 0, 0, 0, 0 }; //on the page
+		int offsetX = 0; //of the ink, from the pen position and the top of the line
+		int offsetY = 0;
+		int advance = 0;
+	};
+
+	struct Font
+	{
+		TTF_Font* font = nullptr;
+		std::vector<uint8_t> buffer; //the file, when it was decompressed from a pack, SDL_ttf reads from it for as long as the font is open
+		int height = 0;
+		int lineSkip = 0;
+		int asciiGlyphs[128]; //index into glyphs, -1 = not rasterized yet
+		std::unordered_map<Uint16, int> otherGlyphs; //the rest of the basic multilingual plane
+		std::vector<Glyph> glyphs;
+	};
+
+	struct GlyphPage
+	{
+		SDL_Texture* texture = nullptr;
+		int shelfX = 0; //where the next glyph goes on the current shelf
+		int shelfY = 0;
+		int shelfHeight = 0;
+	};
+
+	struct ShapedGlyph
+	{
+		int glyph; //index into the font's glyphs
+		int penX;
+	};
+
+	//A string shaped with one font. Slots are chained into buckets by the hash of their font and text
+	struct ShapedText
+	{
+		FontHandle font = FONT_HANDLE_INVALID;
+		std::string text;
+		uint64_t hash = 0;
+		int next = -1; //next slot in the same bucket
+		uint32_t lastUsedFrame = 0;
+		int width = 0;
+		std::vector<ShapedGlyph> glyphs;
+	};
+
+	struct QueuedGlyph
+	{
+		int page;
+		SDL_Rect srcRect;
+		SDL_Rect dstRect; //whole pixels, so the glyphs stay sharp
+		SDL_Color color;
+	};
+
+	SDL_Renderer* renderer = nullptr;
+	bool isPremultipliedAlpha = false;
+	SDL_BlendMode blendMode = SDL_BLENDMODE_BLEND;
+	std::vector<Font> fonts;
+	std::vector<GlyphPage> pages;
+	bool isAtlasFull = false; //logged once, glyphs that don't fit aren't drawn
+
+	std::vector<ShapedText> shapedTexts; //MAX_SHAPED_TEXTS slots, and a last one for strings that find every slot in use this frame
+	std::vector<int> buckets; //first slot of each bucket, -1 = empty
+	int clockHand = 0; //the next slot looked at when one has to be reused
+	int numShapedTexts = 0;
+	//slots drawn this frame and last frame (and not since), the rest are stale. TakeSlot() only looks for a kind
+	//of slot there is one of, and once every slot has been drawn this frame it doesn't look at all
+	int numUsedThisFrame = 0;
+	int numUsedLastFrame = 0;
+	uint32_t frame = 1;
+
+	//kept between frames so they don't get allocated again every frame
+	std::vector<QueuedGlyph, TrackingAllocator<QueuedGlyph, MEMORY_TAG_RENDER>> queuedGlyphs;
+#if TEXT_RENDERER_HAS_GEOMETRY
+	std::vector<SDL_Vertex, TrackingAllocator<SDL_Vertex, MEMORY_TAG_RENDER>> vertices; //only ever grows
+	std::vector<int, TrackingAllocator<int, MEMORY_TAG_RENDER>> indices; //the same 6 indices per quad every frame, so only ever extended
+#endif
+	bool isBatchingEnabled = true;
+
+	int numDrawCalls = 0;
+	int numGlyphsDrawn = 0;
+	int numGlyphUploads = 0;
+	int numShapes = 0; //strings that weren't in the cache
+	int pendingGlyphUploads = 0; //since the last Flush()
+	int pendingShapes = 0;
+
+	static uint64_t HashText(FontHandle font, std::string_view text);
+	//Index into the font's glyphs, rasterized the first time. -1 if the font can't draw it
+	int FindGlyph(Font& font, Uint16 character);
+	int RasterizeGlyph(Font& font, Uint16 character);
+	bool AddToPage(SDL_Surface* surface, const SDL_Rect& ink, Glyph& glyph);
+	const ShapedText& Shape(FontHandle font, std::string_view text);
+	void MarkUsedThisFrame(ShapedText& shapedText);
+	int TakeSlot();
+	void Unlink(int slot);
+	void DrawGlyphsOneByOne();
+#if TEXT_RENDERER_HAS_GEOMETRY
+	bool DrawBatches();
+#endif
+
+public:
+	//Glyphs are premultiplied when the asset store's textures are, so text blends like everything else. Call it
+	//before loading fonts, after AssetStore::EnablePremultipliedAlpha()
+	void Initialize(SDL_Renderer* renderer, bool isPremultipliedAlpha);
+	//Closes the fonts and frees the glyph pages
+	void Destroy();
+
+	//Opens the font through the asset store, so it can come from the pack. Returns FONT_HANDLE_INVALID if it can't
+	FontHandle LoadFont(const AssetStore& assetStore, const std::string& filePath, int pointSize);
+	//Height of a line of text, and the distance from one line to the next
+	int GetLineHeight(FontHandle font) const;
+	int GetLineSkip(FontHandle font) const;
+
+	//Queues a single line of UTF-8 text with its top at y on screen and its left edge, center or right edge at x,
+	//drawn by the next Flush(). Characters outside the basic multilingual plane, or that the font doesn't have, are
+	//drawn as '?'. Returns the width of the line in pixels, the string is only shaped once for both
+	int DrawText(FontHandle font, std::string_view text, float x, float y, SDL_Color color, TextAlign align = TEXT_ALIGN_LEFT);
+	//Width of the line in pixels, shaped through the same cache as DrawText()
+	int MeasureText(FontHandle font, std::string_view text);
+	//Draws the queued text. Strings not drawn since the previous Flush() become the first to be reused
+	void Flush();
+
+	//Batched drawing (on by default), off draws one glyph at a time
+	void SetBatching(bool enabled);
+	bool IsBatchingEnabled() const;
+
+	//Stats of the last Flush()
+	int GetNumDrawCalls() const;
+	int GetNumGlyphsDrawn() const;
+	int GetNumGlyphUploads() const;
+	int GetNumShapes() const;
+	int GetNumPages() const;
+	int GetNumShapedTexts() const;
+};
@@ -0,0 +1,442 @@
+#include "Replay.h"
+#include "../Logger/Logger.h"
+#include "../Compression/Lz4.h"
+#include <cstring>
+
+const char REPLAY_MAGIC[4] = { 'R', 'P', 'L', 'Y' };
+const uint32_t REPLAY_VERSION = 6; //2: snapshots include killed and free entity ids, 3: sprites store asset handles, 4: the camera is an entity, 5: tiles aren't entities, 6: the camera viewport isn't saved
+
+const uint8_t RECORD_KEYFRAME = 100;
+const uint8_t RECORD_END = 101;
+
+//keyframe payload: compression, stored size, for LZ4 the original size, then the stored bytes
+const uint8_t KEYFRAME_UNCOMPRESSED = 0;
+const uint8_t KEYFRAME_LZ4 = 1;
+const uint64_t MAX_KEYFRAME_SIZE = 1ull << 30; //decompressed, far more than any registry we'd snapshot
+
+
+//Reading variable length integers straight from the file
+static bool ReadVarUInt(std::ifstream& file, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		const int byte = file.get();
+		if (byte == EOF)
+		{
+			return false;
+		}
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static int64_t ZigZagDecode(uint64_t value)
+{
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static bool IsInputEventRecord(uint8_t recordType)
+{
+	return recordType <= INPUT_MOUSE_BUTTON_UP;
+}
+
+
+bool ReplayRecorder::Open(const std::string& filePath, const ReplayHeader& header)
+{
+	file.open(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG(ERROR, GAME, "Could not open replay file {} for recording", filePath);
+		return false;
+	}
+
+	previousTick = 0;
+	buffer.clear();
+	BinaryWriter writer(buffer);
+	writer.WriteBytes(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+	writer.Add(REPLAY_VERSION);
+	writer.Add(header.seed);
+	writer.Add(static_cast<uint32_t>(header.tickRate));
+	writer.Add(static_cast<uint32_t>(header.keyframeInterval));
+	FlushBuffer();
+
+	LOG(INFO, GAME, "Recording replay to {}", filePath);
+	return true;
+}
+
+void ReplayRecorder::Close(int finalTick)
+{
+	if (!file.is_open())
+	{
+		return;
+	}
+	WriteRecord(finalTick, RECORD_END);
+	FlushBuffer();
+	file.close();
+}
+
+bool ReplayRecorder::IsOpen() const
+{
+	return file.is_open();
+}
+
+void ReplayRecorder::WriteRecord(int tick, uint8_t recordType)
+{
+	BinaryWriter writer(buffer);
+	writer.WriteVarUInt(static_cast<uint64_t>(tick - previousTick));
+	writer.Add(recordType);
+	previousTick = tick;
+}
+
+void ReplayRecorder::FlushBuffer()
+{
+	file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+	buffer.clear();
+}
+
+void ReplayRecorder::WriteEvent(const InputEvent& inputEvent)
+{
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	WriteRecord(inputEvent.tick, inputEvent.type);
+	BinaryWriter writer(buffer);
+	writer.WriteVarInt(inputEvent.code);
+	if (inputEvent.type == INPUT_MOUSE_MOTION || inputEvent.type == INPUT_MOUSE_BUTTON_DOWN || inputEvent.type == INPUT_MOUSE_BUTTON_UP)
+	{
+		writer.WriteVarInt(inputEvent.x);
+		writer.WriteVarInt(inputEvent.y);
+	}
+	FlushBuffer();
+}
+
+void ReplayRecorder::WriteKeyframe(int tick, const Registry& registry)
+{
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	WriteRecord(tick, RECORD_KEYFRAME);
+	FlushBuffer();
+
+	//snapshot into the buffer first so we know its size
+	BinaryWriter snapshotWriter(buffer);
+	registry.SaveState(snapshotWriter);
+	const size_t snapshotSize = buffer.size();
+
+	//most of a snapshot is small integers and repeated components, LZ4 usually shrinks it a lot
+	compressedBuffer.resize(Lz4CompressBound(snapshotSize));
+	const size_t compressedSize = Lz4Compress(buffer.data(), snapshotSize, compressedBuffer.data(), compressedBuffer.size());
+	const bool isCompressed = compressedSize > 0 && compressedSize < snapshotSize;
+
+	prefixBuffer.clear();
+	BinaryWriter prefixWriter(prefixBuffer);
+	prefixWriter.Add(isCompressed ? KEYFRAME_LZ4 : KEYFRAME_UNCOMPRESSED);
+	prefixWriter.WriteVarUInt(isCompressed ? compressedSize : snapshotSize);
+	if (isCompressed)
+	{
+		prefixWriter.WriteVarUInt(snapshotSize);
+	}
+	file.write(reinterpret_cast<const char*>(prefixBuffer.data()), prefixBuffer.size());
+	if (isCompressed)
+	{
+		file.write(reinterpret_cast<const char*>(compressedBuffer.data()), static_cast<std::streamsize>(compressedSize));
+		buffer.clear();
+	}
+	else
+	{
+		FlushBuffer();
+	}
+}
+
+
+bool ReplayPlayer::Open(const std::string& filePath)
+{
+	file.open(filePath, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG(ERROR, GAME, "Could not open replay file {}", filePath);
+		return false;
+	}
+
+	char magic[sizeof(REPLAY_MAGIC)];
+	uint32_t version = 0;
+	uint32_t tickRate = 0;
+	uint32_t keyframeInterval = 0;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(&header.seed), sizeof(header.seed));
+	file.read(reinterpret_cast<char*>(&tickRate), sizeof(tickRate));
+	file.read(reinterpret_cast<char*>(&keyframeInterval), sizeof(keyframeInterval));
+	if (!file || std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0 || version != REPLAY_VERSION)
+	{
+		LOG(ERROR, GAME, "{} is not a replay file (or is from an incompatible version)", filePath);
+		file.close();
+		return false;
+	}
+	header.tickRate = static_cast<int>(tickRate);
+	header.keyframeInterval = static_cast<int>(keyframeInterval);
+	firstRecordOffset = file.tellg();
+	file.seekg(0, std::ios::end);
+	fileSize = file.tellg();
+	file.seekg(firstRecordOffset);
+
+	//Scan the records once to find the keyframes. Keyframe payloads are skipped over,
+	//so this only reads the (small) input events. Scanning instead of relying on an
+	//index at the end of the file means a replay from a crashed session still works
+	keyframes.clear();
+	endTick = 0;
+	cursorTick = 0;
+	while (true)
+	{
+		const int previousTick = cursorTick;
+		const std::streamoff recordOffset = file.tellg();
+		if (!ReadRecordHeader())
+		{
+			break;
+		}
+		cursorTick = nextRecordTick;
+
+		if (nextRecordType == RECORD_KEYFRAME)
+		{
+			if (!SkipKeyframePayload())
+			{
+				break; //a truncated or corrupt keyframe, the replay ends before it
+			}
+			keyframes.push_back({ nextRecordTick, previousTick, recordOffset });
+		}
+		else if (nextRecordType == RECORD_END)
+		{
+			endTick = nextRecordTick;
+			break;
+		}
+		else if (IsInputEventRecord(nextRecordType))
+		{
+			InputEvent ignored;
+			if (!ReadEventPayload(ignored))
+			{
+				break;
+			}
+		}
+		else
+		{
+			LOG(ERROR, GAME, "Unknown record type {} at tick {} in replay {}, playing it back only up to there", nextRecordType, nextRecordTick, filePath);
+			break;
+		}
+		endTick = std::max(endTick, nextRecordTick + 1);
+	}
+
+	//back to the start for playback
+	file.clear();
+	file.seekg(firstRecordOffset);
+	cursorTick = 0;
+	hasNextRecord = ReadRecordHeader();
+
+	LOG(INFO, GAME, "Loaded replay {} ({} ticks, {} keyframes)", filePath, endTick, keyframes.size());
+	return true;
+}
+
+bool ReplayPlayer::IsOpen() const
+{
+	return file.is_open();
+}
+
+const ReplayHeader& ReplayPlayer::GetHeader() const
+{
+	return header;
+}
+
+bool ReplayPlayer::ReadRecordHeader()
+{
+	uint64_t tickDelta = 0;
+	if (!ReadVarUInt(file, tickDelta))
+	{
+		return false;
+	}
+	const int type = file.get();
+	if (type == EOF)
+	{
+		return false;
+	}
+	nextRecordTick = cursorTick + static_cast<int>(tickDelta);
+	nextRecordType = static_cast<uint8_t>(type);
+	return true;
+}
+
+bool ReplayPlayer::ReadEventPayload(InputEvent& inputEvent)
+{
+	uint64_t value = 0;
+	inputEvent.tick = nextRecordTick;
+	inputEvent.type = static_cast<InputEventType>(nextRecordType);
+	if (!ReadVarUInt(file, value))
+	{
+		return false;
+	}
+	inputEvent.code = static_cast<int>(ZigZagDecode(value));
+
+	if (inputEvent.type == INPUT_MOUSE_MOTION || inputEvent.type == INPUT_MOUSE_BUTTON_DOWN || inputEvent.type == INPUT_MOUSE_BUTTON_UP)
+	{
+		uint64_t x = 0;
+		uint64_t y = 0;
+		if (!ReadVarUInt(file, x) || !ReadVarUInt(file, y))
+		{
+			return false;
+		}
+		inputEvent.x = static_cast<int>(ZigZagDecode(x));
+		inputEvent.y = static_cast<int>(ZigZagDecode(y));
+	}
+	return true;
+}
+
+bool ReplayPlayer::ReadKeyframePayloadHeader(int& compression, uint64_t& size, uint64_t& originalSize)
+{
+	compression = file.get();
+	if (compression != KEYFRAME_UNCOMPRESSED && compression != KEYFRAME_LZ4)
+	{
+		LOG(ERROR, GAME, "Unsupported replay keyframe compression {} at tick {}", compression, nextRecordTick);
+		return false;
+	}
+	if (!ReadVarUInt(file, size))
+	{
+		return false;
+	}
+	originalSize = size;
+	if (compression == KEYFRAME_LZ4 && !ReadVarUInt(file, originalSize))
+	{
+		return false;
+	}
+
+	const std::streamoff payloadOffset = file.tellg();
+	const uint64_t remaining = payloadOffset >= 0 && payloadOffset <= fileSize ? static_cast<uint64_t>(fileSize - payloadOffset) : 0;
+	if (size > remaining || size > MAX_KEYFRAME_SIZE || originalSize > MAX_KEYFRAME_SIZE)
+	{
+		LOG(ERROR, GAME, "Replay keyframe at tick {} is {} bytes ({} decompressed) but there are only {} bytes left in the file", nextRecordTick, size, originalSize, remaining);
+		return false;
+	}
+	return true;
+}
+
+bool ReplayPlayer::SkipKeyframePayload()
+{
+	int compression = 0;
+	uint64_t size = 0;
+	uint64_t originalSize = 0;
+	if (!ReadKeyframePayloadHeader(compression, size, originalSize))
+	{
+		return false;
+	}
+	file.seekg(static_cast<std::streamoff>(size), std::ios::cur);
+	return true;
+}
+
+void ReplayPlayer::ReadEventsForTick(int tick, std::vector<InputEvent>& events)
+{
+	while (hasNextRecord && nextRecordTick <= tick)
+	{
+		cursorTick = nextRecordTick;
+		if (nextRecordType == RECORD_KEYFRAME)
+		{
+			if (!SkipKeyframePayload())
+			{
+				hasNextRecord = false;
+				return;
+			}
+		}
+		else if (nextRecordType == RECORD_END || !IsInputEventRecord(nextRecordType))
+		{
+			//Open() already reported an unknown record, the replay ends there
+			hasNextRecord = false;
+			return;
+		}
+		else
+		{
+			InputEvent inputEvent;
+			if (!ReadEventPayload(inputEvent))
+			{
+				hasNextRecord = false;
+				return;
+			}
+			//events for ticks we already passed (after a seek) are dropped
+			if (inputEvent.tick == tick)
+			{
+				events.push_back(inputEvent);
+			}
+		}
+		hasNextRecord = ReadRecordHeader();
+	}
+}
+
+bool ReplayPlayer::IsFinished(int tick) const
+{
+	return tick >= endTick;
+}
+
+int ReplayPlayer::SeekToKeyframe(int tick, Registry& registry)
+{
+	//keyframes were found in tick order, so take the last one that isn't past the tick
+	const Keyframe* keyframe = nullptr;
+	for (const auto& candidate : keyframes)
+	{
+		if (candidate.tick > tick)
+		{
+			break;
+		}
+		keyframe = &candidate;
+	}
+	if (!keyframe)
+	{
+		return -1;
+	}
+
+	file.clear();
+	file.seekg(keyframe->offset);
+	cursorTick = keyframe->previousTick;
+	if (!ReadRecordHeader() || nextRecordType != RECORD_KEYFRAME)
+	{
+		LOG(ERROR, GAME, "Replay keyframe index is out of date");
+		return -1;
+	}
+	cursorTick = nextRecordTick;
+
+	int compression = 0;
+	uint64_t size = 0;
+	uint64_t originalSize = 0;
+	if (!ReadKeyframePayloadHeader(compression, size, originalSize))
+	{
+		return -1;
+	}
+
+	std::vector<uint8_t> stored(size);
+	file.read(reinterpret_cast<char*>(stored.data()), static_cast<std::streamsize>(size));
+	std::vector<uint8_t> snapshot;
+	if (compression == KEYFRAME_LZ4)
+	{
+		snapshot.resize(originalSize);
+		if (file && !Lz4Decompress(stored.data(), stored.size(), snapshot.data(), snapshot.size()))
+		{
+			LOG(ERROR, GAME, "Replay keyframe at tick {} is corrupt", keyframe->tick);
+			return -1;
+		}
+	}
+	else
+	{
+		snapshot.swap(stored);
+	}
+	BinaryReader reader(snapshot.data(), snapshot.size());
+	if (!file || !registry.LoadState(reader))
+	{
+		LOG(ERROR, GAME, "Could not load replay keyframe at tick {}", keyframe->tick);
+		return -1;
+	}
+
+	hasNextRecord = ReadRecordHeader();
+	return keyframe->tick;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../ECS/ECS.h"
+
+////////////////////////////////////////////////////////////////////////
+// Input events
+////////////////////////////////////////////////////////////////////////
+// The parts of an SDL_Event that gameplay cares about, stamped with the
+// simulation tick they were handled on. Game::ProcessInput turns SDL
+// events into these, so live input and replayed input go down the same path
+////////////////////////////////////////////////////////////////////////
+enum InputEventType : uint8_t
+{
+	INPUT_QUIT,
+	INPUT_KEY_DOWN,
+	INPUT_KEY_UP,
+	INPUT_MOUSE_MOTION,
+	INPUT_MOUSE_BUTTON_DOWN,
+	INPUT_MOUSE_BUTTON_UP
+};
+
+struct InputEvent
+{
+	int tick = 0;
+	InputEventType type = INPUT_QUIT;
+	int code = 0; //key code or mouse button
+	int x = 0; //mouse position
+	int y = 0;
+};
+
+const int DEFAULT_KEYFRAME_INTERVAL = 600; //10 seconds at 60 ticks per second
+
+struct ReplayHeader
+{
+	uint64_t seed = 0;
+	int tickRate = 60;
+	int keyframeInterval = DEFAULT_KEYFRAME_INTERVAL;
+};
+
+
+////////////////////////////////////////////////////////////////////////
+// Replay file
+////////////////////////////////////////////////////////////////////////
+// header: "RPLY", version, seed, tick rate, keyframe interval
+// then a stream of records, each one starting with the number of ticks
+// since the previous record (a variable length integer, so a run of
+// ticks with no input costs nothing) and a record type:
+//		input event - key/button code and mouse position
+//		keyframe	- a registry snapshot, taken before the input of its tick,
+//					  LZ4 compressed when that makes it smaller
+//		end		 - marks the tick the session stopped at
+////////////////////////////////////////////////////////////////////////
+class ReplayRecorder
+{
+private:
+	std::ofstream file;
+	int previousTick = 0;
+	std::vector<uint8_t> buffer; //reused for every record so recording doesn't allocate each tick
+	std::vector<uint8_t> compressedBuffer; //keyframe snapshots, reused the same way
+	std::vector<uint8_t> prefixBuffer; //a keyframe's compression and sizes, reused the same way
+
+	void WriteRecord(int tick, uint8_t recordType);
+	void FlushBuffer();
+
+public:
+	bool Open(const std::string& filePath, const ReplayHeader& header);
+	void Close(int finalTick);
+	bool IsOpen() const;
+
+	void WriteEvent(const InputEvent& inputEvent);
+	void WriteKeyframe(int tick, const Registry& registry);
+};
+
+class ReplayPlayer
+{
+private:
+	struct Keyframe
+	{
+		int tick;
+		int previousTick; //tick of the record before it, the record deltas continue from here
+		std::streamoff offset;
+	};
+
+	std::ifstream file;
+	ReplayHeader header;
+	std::vector<Keyframe> keyframes;
+	std::streamoff firstRecordOffset = 0;
+	std::streamoff fileSize = 0;
+	int endTick = 0; //first tick that isn't part of the replay
+
+	//the next record, read ahead so we know which tick it belongs to
+	bool hasNextRecord = false;
+	int nextRecordTick = 0;
+	uint8_t nextRecordType = 0;
+	int cursorTick = 0;
+
+	bool ReadRecordHeader();
+	bool ReadEventPayload(InputEvent& inputEvent);
+	//false when the sizes don't fit in what's left of the file, so a corrupt replay can't make us allocate gigabytes
+	bool ReadKeyframePayloadHeader(int& compression, uint64_t& size, uint64_t& originalSize);
+	bool SkipKeyframePayload();
+
+public:
+	bool Open(const std::string& filePath);
+	bool IsOpen() const;
+	const ReplayHeader& GetHeader() const;
+
+	//appends every event that was recorded on this tick
+	void ReadEventsForTick(int tick, std::vector<InputEvent>& events);
+
+	//true once every recorded tick has been played
+	bool IsFinished(int tick) const;
+
+	//Loads the closest keyframe at or before the tick into the registry and
+	//moves playback there. Returns the keyframe's tick, or -1 if there isn't one
+	int SeekToKeyframe(int tick, Registry& registry);
+};
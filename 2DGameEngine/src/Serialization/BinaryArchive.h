@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+// BinaryWriter / BinaryReader
+////////////////////////////////////////////////////////////////////////
+// Archives that save and load the same Serialize(archive) functions the
+// StateHasher uses, so a component only ever lists its data once.
+// Plain values are written as raw little endian bytes, and counts/sizes
+// as variable length integers (small numbers only take a single byte).
+////////////////////////////////////////////////////////////////////////
+class BinaryWriter
+{
+private:
+	std::vector<uint8_t>& buffer;
+
+public:
+	BinaryWriter(std::vector<uint8_t>& buffer) : buffer(buffer) {}
+
+	void WriteBytes(const void* bytes, size_t size)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(bytes);
+		buffer.insert(buffer.end(), data, data + size);
+	}
+
+	void WriteVarUInt(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			buffer.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		buffer.push_back(static_cast<uint8_t>(value));
+	}
+
+	//zigzag encoding so small negative numbers stay small too
+	void WriteVarInt(int64_t value)
+	{
+		WriteVarUInt((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+	}
+
+	template <typename T>
+	void Add(const T& value)
+	{
+		static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "BinaryWriter can only write plain values, give the type a Serialize function");
+		WriteBytes(&value, sizeof(T));
+	}
+
+	void Add(const std::string& value)
+	{
+		WriteVarUInt(value.size());
+		WriteBytes(value.data(), value.size());
+	}
+
+	template <typename ...TValues>
+	void operator ()(const TValues& ...values)
+	{
+		(Add(values), ...);
+	}
+
+	size_t GetSize() const
+	{
+		return buffer.size();
+	}
+};
+
+class BinaryReader
+{
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t position = 0;
+	bool failed = false; //set when we try to read past the end, everything read after that is 0
+
+public:
+	BinaryReader(const void* data, size_t size) : data(static_cast<const uint8_t*>(data)), size(size) {}
+
+	bool ReadBytes(void* bytes, size_t count)
+	{
+		if (failed || count > size - position)
+		{
+			failed = true;
+			std::memset(bytes, 0, count);
+			return false;
+		}
+		std::memcpy(bytes, data + position, count);
+		position += count;
+		return true;
+	}
+
+	uint64_t ReadVarUInt()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t byte = 0;
+			if (!ReadBytes(&byte, 1))
+			{
+				return 0;
+			}
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+		failed = true;
+		return 0;
+	}
+
+	int64_t ReadVarInt()
+	{
+		const uint64_t value = ReadVarUInt();
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	template <typename T>
+	void Add(T& value)
+	{
+		static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "BinaryReader can only read plain values, give the type a Serialize function");
+		ReadBytes(&value, sizeof(T));
+	}
+
+	void Add(std::string& value)
+	{
+		const uint64_t length = ReadVarUInt();
+		if (failed || length > size - position)
+		{
+			failed = true;
+			value.clear();
+			return;
+		}
+		value.assign(reinterpret_cast<const char*>(data + position), length);
+		position += length;
+	}
+
+	template <typename ...TValues>
+	void operator ()(TValues& ...values)
+	{
+		(Add(values), ...);
+	}
+
+	bool HasFailed() const
+	{
+		return failed;
+	}
+
+	bool IsAtEnd() const
+	{
+		return position >= size;
+	}
+};
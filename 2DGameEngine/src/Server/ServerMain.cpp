@@ -0,0 +1,293 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <string>
+#include <cstdio>
+#include "../Game/Game.h"
+#include "../Determinism/StateHashLog.h"
+#include "../Stress/StressScene.h"
+#include "../Profiler/Profiler.h"
+#include "../Profiler/HardwareCounters.h"
+
+//Dedicated server / batch simulation entry point.
+//Runs the registry and all the simulation systems without a window, renderer or audio
+//
+//  --ticks <n>       run n ticks as fast as possible and exit (0 = run until quit)
+//  --tick-rate <hz>  simulation rate, used for the fixed delta time and to pace the loop when --ticks isn't given
+//  --deterministic   fixed tick, seeded random numbers and a state hash every tick
+//  --seed <n>        random seed for deterministic mode (default 1)
+//  --hash-log <file> write the per tick state hashes to a file (implies --deterministic)
+//  --compare-hashes <a> <b>  compare two hash logs and report the first tick/component that differs
+//  --replay <file>   play back a recorded session as fast as possible (until it ends, or for --ticks)
+//  --seek <tick>     start the replay at the closest keyframe and simulate up to this tick
+//  --stress <preset> load a generated stress scene instead of the level (runs 1000 ticks unless --ticks is given)
+//  --map-size <c>x<r> override the stress scene's map size in tiles
+//  --movers <n>      override the number of tanks/trucks/choppers in the stress scene
+//  --churn <n>       override how many movers are killed and respawned every tick
+//  --csv <file>      write frame time, per system time, entity counts and peak memory for every tick
+//  --list-presets    print the stress presets and exit
+//  --trace <file>    write the profiler zones as a Chrome trace on exit (needs a build with ENABLE_PROFILER)
+//  --max-frame-allocations <n>  after the warm up, report every tick that makes more than n heap allocations on the game thread
+//                    and exit with code 3 if there were any (our target is 0)
+//  --allocation-warmup <ticks>  ticks to ignore before checking allocations (default 60)
+//  --hw-counters     count cycles/instructions/cache and branch misses per system and print IPC and
+//                    misses per entity on exit (Linux only, carries on without them if they're unavailable)
+//  --offscreen <w>x<h>  draw every tick with SDL's software renderer into a w x h surface, so render
+//                    times show up in the summary (e.g. --stress 50k-sprites --offscreen 1920x1080)
+//  --no-batching     draw one sprite at a time instead of batching by texture, to compare against
+//  --no-tile-cache   draw every visible tile every frame instead of baked tilemap chunks, to compare against
+//  --texture-budget <MB>  texture memory kept before unused textures are evicted
+//  --switch-scene-every <ticks>  switch between the level and the stress scene, so textures get released, evicted
+//                    and reloaded (e.g. --stress jungle --offscreen 800x600 --texture-budget 0 --switch-scene-every 100)
+//  --log-filter <spec>  log levels, e.g. "warning" or "info,ecs=debug" (debug messages only exist in Debug builds)
+int main(int argc, char* argv[])
+{
+    int numTicks = 0;
+    int tickRate = 60;
+    bool deterministic = false;
+    unsigned long long seed = 1;
+    std::string hashLogPath;
+    std::string replayPath;
+    int seekTick = 0;
+    std::string stressName;
+    int mapNumCols = -1;
+    int mapNumRows = -1;
+    int numMovers = -1;
+    int churnPerTick = -1;
+    std::string csvPath;
+    std::string tracePath;
+    int maxFrameAllocations = -1;
+    int allocationWarmupTicks = 60;
+    int offscreenWidth = 0;
+    int offscreenHeight = 0;
+    bool renderBatching = true;
+    bool tileChunkCaching = true;
+    int textureBudgetMegabytes = -1;
+    int sceneSwitchInterval = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            numTicks = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+        {
+            tickRate = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--deterministic") == 0)
+        {
+            deterministic = true;
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--hash-log") == 0 && i + 1 < argc)
+        {
+            hashLogPath = argv[++i];
+            deterministic = true;
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--seek") == 0 && i + 1 < argc)
+        {
+            seekTick = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--stress") == 0 && i + 1 < argc)
+        {
+            stressName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--map-size") == 0 && i + 1 < argc)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &mapNumCols, &mapNumRows) != 2)
+            {
+                std::cerr << "--map-size expects <cols>x<rows>, e.g. 200x150" << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--movers") == 0 && i + 1 < argc)
+        {
+            numMovers = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--churn") == 0 && i + 1 < argc)
+        {
+            churnPerTick = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            csvPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--offscreen") == 0 && i + 1 < argc)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &offscreenWidth, &offscreenHeight) != 2)
+            {
+                std::cerr << "--offscreen expects <width>x<height>, e.g. 1920x1080" << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--no-batching") == 0)
+        {
+            renderBatching = false;
+        }
+        else if (std::strcmp(argv[i], "--no-tile-cache") == 0)
+        {
+            tileChunkCaching = false;
+        }
+        else if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+        {
+            textureBudgetMegabytes = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--switch-scene-every") == 0 && i + 1 < argc)
+        {
+            sceneSwitchInterval = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--max-frame-allocations") == 0 && i + 1 < argc)
+        {
+            maxFrameAllocations = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--allocation-warmup") == 0 && i + 1 < argc)
+        {
+            allocationWarmupTicks = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--hw-counters") == 0)
+        {
+            HardwareCounters::Enable();
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--log-filter") == 0 && i + 1 < argc)
+        {
+            if (!Logger::SetLevelsFromString(argv[++i]))
+            {
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--list-presets") == 0)
+        {
+            for (const auto& preset : GetStressPresets())
+            {
+                std::cout << preset.name << "\t" << preset.description << std::endl;
+            }
+            return 0;
+        }
+        else if (std::strcmp(argv[i], "--compare-hashes") == 0 && i + 2 < argc)
+        {
+            const bool match = StateHashLog::Compare(argv[i + 1], argv[i + 2]);
+            return match ? 0 : 2;
+        }
+        else
+        {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [--ticks <n>] [--tick-rate <hz>] [--deterministic] [--seed <n>] [--hash-log <file>] [--replay <file> [--seek <tick>]]" << std::endl;
+            std::cerr << "       " << argv[0] << " --stress <preset> [--map-size <c>x<r>] [--movers <n>] [--churn <n>] [--csv <file>] [--offscreen <w>x<h>] [--no-batching] [--no-tile-cache] [--texture-budget <MB>] [--switch-scene-every <ticks>] [--ticks <n>] [--trace <file>] [--hw-counters] [--max-frame-allocations <n>] [--log-filter <spec>]" << std::endl;
+            std::cerr << "       " << argv[0] << " --list-presets" << std::endl;
+            std::cerr << "       " << argv[0] << " --compare-hashes <a> <b>" << std::endl;
+            return 1;
+        }
+    }
+
+    if (tickRate <= 0)
+    {
+        tickRate = 60;
+    }
+
+    Game game;
+    game.SetHeadless(true);
+    game.SetOffscreenRender(offscreenWidth, offscreenHeight);
+    game.SetRenderBatching(renderBatching);
+    game.SetTileChunkCaching(tileChunkCaching);
+    if (textureBudgetMegabytes >= 0)
+    {
+        game.SetTextureMemoryBudget(static_cast<size_t>(textureBudgetMegabytes) * 1024 * 1024);
+    }
+    game.SetSceneSwitchInterval(sceneSwitchInterval);
+    game.SetTargetFps(tickRate);
+    game.SetFixedDeltaTime(1.0 / tickRate);
+    if (!replayPath.empty())
+    {
+        //the replay brings its own seed and tick rate
+        if (!game.StartReplay(replayPath, seekTick))
+        {
+            return 1;
+        }
+        if (numTicks <= 0)
+        {
+            numTicks = INT_MAX; //until the replay ends
+        }
+        if (!hashLogPath.empty() && !game.OpenStateHashLog(hashLogPath))
+        {
+            return 1;
+        }
+    }
+    else if (deterministic)
+    {
+        game.EnableDeterministicMode(seed);
+        if (!hashLogPath.empty() && !game.OpenStateHashLog(hashLogPath))
+        {
+            return 1;
+        }
+    }
+
+    if (!stressName.empty())
+    {
+        const StressPreset* found = FindStressPreset(stressName);
+        if (!found)
+        {
+            std::cerr << "Unknown stress preset " << stressName << ", use --list-presets to see them" << std::endl;
+            return 1;
+        }
+        StressPreset preset = *found;
+        if (mapNumCols > 0 && mapNumRows > 0)
+        {
+            preset.mapNumCols = mapNumCols;
+            preset.mapNumRows = mapNumRows;
+        }
+        if (numMovers >= 0)
+        {
+            preset.numMovers = numMovers;
+        }
+        if (churnPerTick >= 0)
+        {
+            preset.churnPerTick = churnPerTick;
+        }
+        game.SetStressPreset(preset);
+        if (numTicks <= 0)
+        {
+            numTicks = 1000;
+        }
+    }
+    game.SetFrameAllocationLimit(maxFrameAllocations, allocationWarmupTicks);
+    if (!csvPath.empty() && !game.OpenFrameReport(csvPath))
+    {
+        return 1;
+    }
+
+    Profiler::SetThreadName("Server");
+    game.Initialize();
+    if (numTicks > 0)
+    {
+        game.RunTicks(numTicks);
+    }
+    else
+    {
+        game.Run();
+    }
+    game.Destroy();
+
+    if (!tracePath.empty())
+    {
+        Profiler::WriteChromeTrace(tracePath);
+    }
+
+    if (game.GetNumFramesOverAllocationLimit() > 0)
+    {
+        return 3;
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+static bool Overlaps(const SDL_FRect& a, const SDL_FRect& b)
+{
+	return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+SpatialGrid::SpatialGrid()
+{
+	cells.resize(1);
+}
+
+int SpatialGrid::GetCell(float x, float y) const
+{
+	const int col = std::clamp(static_cast<int>(std::floor(x / cellSize)), 0, numCols - 1);
+	const int row = std::clamp(static_cast<int>(std::floor(y / cellSize)), 0, numRows - 1);
+	return row * numCols + col;
+}
+
+void SpatialGrid::AddToCell(Entity entity, int cell)
+{
+	Entry& entry = entries[entity.GetId()];
+	entry.cell = cell;
+	entry.slot = static_cast<int>(cells[cell].size());
+	cells[cell].push_back(entity);
+}
+
+void SpatialGrid::RemoveFromCell(Entity entity)
+{
+	//swap with the last one in the cell so nothing has to shift
+	Entry& entry = entries[entity.GetId()];
+	SpatialEntityList& cellEntities = cells[entry.cell];
+	const Entity last = cellEntities.back();
+	cellEntities[entry.slot] = last;
+	entries[last.GetId()].slot = entry.slot;
+	cellEntities.pop_back();
+	entry.cell = -1;
+}
+
+void SpatialGrid::SetWorldSize(float width, float height, float newCellSize)
+{
+	cellSize = std::max(newCellSize, 1.0f);
+	numCols = std::max(1, static_cast<int>(std::ceil(width / cellSize)));
+	numRows = std::max(1, static_cast<int>(std::ceil(height / cellSize)));
+
+	//only happens when a level loads, so a temporary list is fine
+	SpatialEntityList binned;
+	for (auto& cellEntities : cells)
+	{
+		binned.insert(binned.end(), cellEntities.begin(), cellEntities.end());
+		cellEntities.clear();
+	}
+	cells.resize(static_cast<size_t>(numCols) * numRows);
+
+	for (const auto& entity : binned)
+	{
+		const Entry& entry = entries[entity.GetId()];
+		AddToCell(entity, GetCell(entry.bounds.x, entry.bounds.y));
+	}
+}
+
+void SpatialGrid::Insert(Entity entity, const SDL_FRect& bounds, bool isDynamic)
+{
+	const size_t entityId = static_cast<size_t>(entity.GetId());
+	if (entityId >= entries.size())
+	{
+		entries.resize(entityId + 1);
+	}
+	if (entries[entityId].cell >= 0)
+	{
+		Remove(entity);
+	}
+
+	Entry& entry = entries[entityId];
+	entry.bounds = bounds;
+	maxWidth = std::max(maxWidth, bounds.w);
+	maxHeight = std::max(maxHeight, bounds.h);
+	AddToCell(entity, GetCell(bounds.x, bounds.y));
+
+	if (isDynamic)
+	{
+		entry.dynamicSlot = static_cast<int>(dynamicEntities.size());
+		dynamicEntities.push_back(entity);
+	}
+}
+
+void SpatialGrid::Remove(Entity entity)
+{
+	const size_t entityId = static_cast<size_t>(entity.GetId());
+	if (entityId >= entries.size() || entries[entityId].cell < 0)
+	{
+		return;
+	}
+	RemoveFromCell(entity);
+
+	Entry& entry = entries[entityId];
+	if (entry.dynamicSlot >= 0)
+	{
+		const Entity last = dynamicEntities.back();
+		dynamicEntities[entry.dynamicSlot] = last;
+		entries[last.GetId()].dynamicSlot = entry.dynamicSlot;
+		dynamicEntities.pop_back();
+		entry.dynamicSlot = -1;
+	}
+}
+
+void SpatialGrid::Move(Entity entity, const SDL_FRect& bounds)
+{
+	Entry& entry = entries[entity.GetId()];
+	entry.bounds = bounds;
+	maxWidth = std::max(maxWidth, bounds.w);
+	maxHeight = std::max(maxHeight, bounds.h);
+
+	const int cell = GetCell(bounds.x, bounds.y);
+	if (cell != entry.cell)
+	{
+		RemoveFromCell(entity);
+		AddToCell(entity, cell);
+	}
+}
+
+void SpatialGrid::Clear()
+{
+	for (auto& cellEntities : cells)
+	{
+		cellEntities.clear();
+	}
+	for (auto& entry : entries)
+	{
+		entry = Entry();
+	}
+	dynamicEntities.clear();
+	maxWidth = 0.0f;
+	maxHeight = 0.0f;
+}
+
+void SpatialGrid::Query(const SDL_FRect& area, SpatialEntityList& result) const
+{
+	//an entity can start up to its size before the area and still reach into it
+	const int firstCell = GetCell(area.x - maxWidth, area.y - maxHeight);
+	const int lastCell = GetCell(area.x + area.w, area.y + area.h);
+	const int firstCol = firstCell % numCols;
+	const int firstRow = firstCell / numCols;
+	const int lastCol = lastCell % numCols;
+	const int lastRow = lastCell / numCols;
+
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		for (int col = firstCol; col <= lastCol; col++)
+		{
+			for (const auto& entity : cells[row * numCols + col])
+			{
+				if (Overlaps(entries[entity.GetId()].bounds, area))
+				{
+					result.push_back(entity);
+				}
+			}
+		}
+	}
+}
+
+const SpatialEntityList& SpatialGrid::GetDynamicEntities() const
+{
+	return dynamicEntities;
+}
+
+int SpatialGrid::GetNumCells() const
+{
+	return static_cast<int>(cells.size());
+}
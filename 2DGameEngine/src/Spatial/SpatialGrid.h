@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <SDL.h>
+#include "../ECS/ECS.h"
+#include "../Memory/MemoryTracker.h"
+
+typedef std::vector<Entity, TrackingAllocator<Entity, MEMORY_TAG_RENDER>> SpatialEntityList;
+
+////////////////////////////////////////////////////////////////////////
+// SpatialGrid
+////////////////////////////////////////////////////////////////////////
+// Uniform grid over the world. Every entity goes in the cell its top
+// left corner is in, so finding what overlaps an area only looks at the
+// cells under it (widened by the biggest entity seen), not at every
+// entity in the world.
+// Anything outside the world size is kept in the nearest edge cell, so
+// entities that wander off the map are still found, just less cheaply.
+// Entities that can move are listed separately, so whoever moves them
+// can put them back in the right cell with Move() without touching the
+// static ones
+////////////////////////////////////////////////////////////////////////
+class SpatialGrid
+{
+private:
+	struct Entry
+	{
+		int cell = -1; //-1 when the entity isn't in the grid
+		int slot = 0; //index in the cell's list
+		int dynamicSlot = -1; //index in dynamicEntities, -1 for static entities
+		SDL_FRect bounds = {};
+	};
+
+	float cellSize = 256.0f;
+	int numCols = 1;
+	int numRows = 1;
+	std::vector<SpatialEntityList> cells;
+	std::vector<Entry, TrackingAllocator<Entry, MEMORY_TAG_RENDER>> entries; //by entity id
+	SpatialEntityList dynamicEntities;
+	float maxWidth = 0.0f; //biggest bounds inserted, queries are widened by this
+	float maxHeight = 0.0f;
+
+	int GetCell(float x, float y) const;
+	void AddToCell(Entity entity, int cell);
+	void RemoveFromCell(Entity entity);
+
+public:
+	SpatialGrid();
+
+	//Cells are made to cover the world, everything already in the grid is put back in its new cell
+	void SetWorldSize(float width, float height, float newCellSize = 256.0f);
+
+	void Insert(Entity entity, const SDL_FRect& bounds, bool isDynamic);
+	void Remove(Entity entity);
+	//Updates the bounds, the entity only changes cell if its top left corner crossed into another one
+	void Move(Entity entity, const SDL_FRect& bounds);
+	void Clear();
+
+	//Adds every entity whose bounds overlap the area to result
+	void Query(const SDL_FRect& area, SpatialEntityList& result) const;
+
+	const SpatialEntityList& GetDynamicEntities() const;
+	int GetNumCells() const;
+};
@@ -0,0 +1,72 @@
+#include "FrameReport.h"
+#include "ProcessStats.h"
+#include "../Logger/Logger.h"
+#include <cstdio>
+
+bool FrameReport::Open(const std::string& filePath)
+{
+	file.open(filePath, std::ios::out | std::ios::trunc);
+	hasWrittenHeader = false;
+	if (!file.is_open())
+	{
+		LOG(ERROR, GAME, "Could not open frame report {}", filePath);
+		return false;
+	}
+	return true;
+}
+
+void FrameReport::Close()
+{
+	if (file.is_open())
+	{
+		file.close();
+	}
+}
+
+bool FrameReport::IsOpen() const
+{
+	return file.is_open();
+}
+
+void FrameReport::WriteFrame(int tick, double frameMilliseconds, double updateMilliseconds, double registryUpdateMilliseconds, const Registry& registry)
+{
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	const auto& systems = registry.GetSystems();
+	if (!hasWrittenHeader)
+	{
+		file << "tick,frame_ms,update_ms,registry_update_ms";
+		for (const auto& system : systems)
+		{
+			file << "," << system->GetName() << "_ms";
+		}
+		for (const auto& system : systems)
+		{
+			file << "," << system->GetName() << "_entities";
+		}
+		file << ",live_entities,peak_rss_kb\n";
+		numSystemColumns = systems.size();
+		hasWrittenHeader = true;
+	}
+
+	//format into a stack buffer, this runs every tick
+	char buffer[64];
+	std::snprintf(buffer, sizeof(buffer), "%d,%.4f,%.4f,%.4f", tick, frameMilliseconds, updateMilliseconds, registryUpdateMilliseconds);
+	file << buffer;
+
+	//systems added after the header was written don't get a column
+	const size_t numColumns = std::min(numSystemColumns, systems.size());
+	for (size_t i = 0; i < numColumns; i++)
+	{
+		std::snprintf(buffer, sizeof(buffer), ",%.4f", systems[i]->GetLastUpdateTime());
+		file << buffer;
+	}
+	for (size_t i = 0; i < numColumns; i++)
+	{
+		file << "," << systems[i]->GetNumEntities();
+	}
+	file << "," << registry.GetNumLiveEntities() << "," << (GetPeakResidentBytes() / 1024) << "\n";
+}
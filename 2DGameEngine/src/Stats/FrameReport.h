@@ -0,0 +1,29 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include "../ECS/ECS.h"
+
+////////////////////////////////////////////////////////////////////////
+// FrameReport
+////////////////////////////////////////////////////////////////////////
+// Writes one CSV row per tick: frame time, update time, registry update
+// time, how long each system took and how many entities it has, the
+// number of live entities and the peak resident memory of the process.
+// The system columns are taken from the registry on the first row, so
+// every system that's been added shows up without extra work
+////////////////////////////////////////////////////////////////////////
+class FrameReport
+{
+private:
+	std::ofstream file;
+	bool hasWrittenHeader = false;
+	size_t numSystemColumns = 0;
+
+public:
+	bool Open(const std::string& filePath);
+	void Close();
+	bool IsOpen() const;
+
+	void WriteFrame(int tick, double frameMilliseconds, double updateMilliseconds, double registryUpdateMilliseconds, const Registry& registry);
+};
@@ -0,0 +1,58 @@
+#include "ProcessStats.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+size_t GetPeakResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#elif defined(__linux__)
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		return static_cast<size_t>(usage.ru_maxrss) * 1024; //reported in kilobytes
+	}
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+size_t GetCurrentResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#elif defined(__linux__)
+	//second number in statm is the resident set, in pages
+	FILE* statm = std::fopen("/proc/self/statm", "r");
+	if (!statm)
+	{
+		return 0;
+	}
+	unsigned long totalPages = 0;
+	unsigned long residentPages = 0;
+	const int read = std::fscanf(statm, "%lu %lu", &totalPages, &residentPages);
+	std::fclose(statm);
+	return (read == 2) ? static_cast<size_t>(residentPages) * sysconf(_SC_PAGESIZE) : 0;
+#else
+	return 0;
+#endif
+}
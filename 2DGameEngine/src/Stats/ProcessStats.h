@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+
+//Memory used by the whole process, as the operating system sees it
+size_t GetPeakResidentBytes(); //highest resident set size (working set on Windows) so far
+size_t GetCurrentResidentBytes();
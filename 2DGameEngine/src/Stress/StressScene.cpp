@@ -0,0 +1,127 @@
+#include "StressScene.h"
+#include "../Components/TransformComponent.h"
+#include "../Components/RigidBodyComponent.h"
+#include "../Components/SpriteComponent.h"
+#include "../Components/AnimationComponent.h"
+#include "../Logger/Logger.h"
+
+//same tile layout as the jungle level
+const int STRESS_TILE_SIZE = 32;
+const double STRESS_TILE_SCALE = 2.0;
+const int STRESS_TILESET_COLS = 10;
+const int STRESS_TILESET_ROWS = 3;
+
+const float STRESS_MAX_SPEED = 60.0f;
+
+
+const std::vector<StressPreset>& GetStressPresets()
+{
+	static const std::vector<StressPreset> presets =
+	{
+		{ "10k-movers", "10,000 tanks, trucks and choppers moving on a 100x100 map", 100, 100, 10000, 0 },
+		{ "1m-static-tiles", "1000x1000 tile map (1,000,000 static tiles) and nothing moving", 1000, 1000, 0, 0 },
+		{ "churn", "5,000 movers with 500 killed and respawned every tick", 50, 50, 5000, 500 },
+		{ "50k-sprites", "200x200 tile map (40,000 tiles) and 10,000 movers, for render benchmarks (use --offscreen)", 200, 200, 10000, 0 },
+		{ "jungle", "jungle sized map (25x20) with a handful of movers, for sanity checks", 25, 20, 3, 0 }
+	};
+	return presets;
+}
+
+const StressPreset* FindStressPreset(const std::string& name)
+{
+	for (const auto& preset : GetStressPresets())
+	{
+		if (preset.name == name)
+		{
+			return &preset;
+		}
+	}
+	return nullptr;
+}
+
+void StressScene::Load(Registry& registry, Tilemap& tilemap, const StressPreset& stressPreset, uint64_t seed)
+{
+	preset = stressPreset;
+	random.Seed(seed, 0x57e55);
+	movers.clear();
+	movers.reserve(preset.numMovers);
+
+	//looked up once here, spawning during churn only copies the handles
+	tilemapImage = AssetIds::Intern("tilemap-image");
+	tankImage = AssetIds::Intern("tiger-tank-image"); //not the level's tank, so switching to the level leaves its texture unused
+	truckImage = AssetIds::Intern("truck-image");
+	chopperImage = AssetIds::Intern("chopper-image");
+
+	//any tile from the jungle tileset
+	tilemap.Create(preset.mapNumCols, preset.mapNumRows, STRESS_TILE_SIZE, static_cast<float>(STRESS_TILE_SCALE), tilemapImage, STRESS_TILESET_COLS);
+	for (int y = 0; y < preset.mapNumRows; y++)
+	{
+		for (int x = 0; x < preset.mapNumCols; x++)
+		{
+			const int tilesetCol = random.Range(0, STRESS_TILESET_COLS - 1);
+			const int tilesetRow = random.Range(0, STRESS_TILESET_ROWS - 1);
+			tilemap.SetTile(x, y, static_cast<uint16_t>(tilesetRow * STRESS_TILESET_COLS + tilesetCol));
+		}
+	}
+	worldWidth = tilemap.GetWidth();
+	worldHeight = tilemap.GetHeight();
+
+	for (int i = 0; i < preset.numMovers; i++)
+	{
+		SpawnMover(registry);
+	}
+
+	LOG
+	(
+		INFO, GAME, "Loaded stress scene {}: {}x{} tiles, {} movers, churn {} per tick",
+		preset.name, preset.mapNumCols, preset.mapNumRows, preset.numMovers, preset.churnPerTick
+	);
+}
+
+void StressScene::SpawnMover(Registry& registry)
+{
+	const glm::vec2 position(random.NextFloat() * worldWidth, random.NextFloat() * worldHeight);
+	const glm::vec2 velocity((random.NextFloat() * 2.0f - 1.0f) * STRESS_MAX_SPEED, (random.NextFloat() * 2.0f - 1.0f) * STRESS_MAX_SPEED);
+
+	Entity mover = registry.CreateEntity();
+	mover.AddComponent<TransformComponent>(position, glm::vec2(1.0, 1.0), 0.0);
+	mover.AddComponent<RigidBodyComponent>(velocity);
+
+	//same mix of units as the jungle level
+	switch (random.Range(0, 2))
+	{
+	case 0:
+		mover.AddComponent<SpriteComponent>(tankImage, 32, 32, 2);
+		break;
+	case 1:
+		mover.AddComponent<SpriteComponent>(truckImage, 32, 32, 1);
+		break;
+	default:
+		mover.AddComponent<SpriteComponent>(chopperImage, 32, 32, 2);
+		mover.AddComponent<AnimationComponent>();
+		break;
+	}
+	movers.push_back(mover);
+}
+
+void StressScene::Update(Registry& registry)
+{
+	const int churn = std::min(preset.churnPerTick, static_cast<int>(movers.size()));
+	for (int i = 0; i < churn; i++)
+	{
+		//swap the victim to the back so removing it from the list is cheap
+		const int victim = random.Range(0, static_cast<int>(movers.size()) - 1);
+		std::swap(movers[victim], movers.back());
+		movers.back().Kill();
+		movers.pop_back();
+	}
+	for (int i = 0; i < churn; i++)
+	{
+		SpawnMover(registry);
+	}
+}
+
+const StressPreset& StressScene::GetPreset() const
+{
+	return preset;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "../ECS/ECS.h"
+#include "../Random/Random.h"
+#include "../AssetStore/AssetHandle.h"
+#include "../Tilemap/Tilemap.h"
+
+////////////////////////////////////////////////////////////////////////
+// Stress scenes
+////////////////////////////////////////////////////////////////////////
+// Generated levels for load testing the whole game. A preset says how
+// big the tile map is, how many tanks/trucks/choppers drive around on it
+// and how many of them get killed and respawned every tick.
+// They're meant to look like our real traffic:
+//		10k-movers		- lots of units moving at once
+//		1m-static-tiles - a huge map that mostly sits still
+//		churn			- units constantly spawning and dying
+//		50k-sprites		- enough sprites on screen to measure the renderer
+////////////////////////////////////////////////////////////////////////
+struct StressPreset
+{
+	std::string name;
+	std::string description;
+	int mapNumCols = 25;
+	int mapNumRows = 20;
+	int numMovers = 0; //tanks, trucks and choppers
+	int churnPerTick = 0; //movers killed and respawned every tick
+};
+
+const std::vector<StressPreset>& GetStressPresets();
+const StressPreset* FindStressPreset(const std::string& name);
+
+class StressScene
+{
+private:
+	StressPreset preset;
+	Random random;
+	std::vector<Entity> movers; //alive movers, churn picks its victims from here
+	float worldWidth = 0.0f;
+	float worldHeight = 0.0f;
+	AssetHandle tilemapImage = ASSET_HANDLE_PLACEHOLDER;
+	AssetHandle tankImage = ASSET_HANDLE_PLACEHOLDER;
+	AssetHandle truckImage = ASSET_HANDLE_PLACEHOLDER;
+	AssetHandle chopperImage = ASSET_HANDLE_PLACEHOLDER;
+
+	void SpawnMover(Registry& registry);
+
+public:
+	//Fills the tilemap and spawns the movers. The systems and textures are set up by the game as usual
+	void Load(Registry& registry, Tilemap& tilemap, const StressPreset& stressPreset, uint64_t seed);
+
+	//Kills and respawns churnPerTick movers, call once per tick
+	void Update(Registry& registry);
+
+	const StressPreset& GetPreset() const;
+};
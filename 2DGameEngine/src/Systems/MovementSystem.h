@@ -3,6 +3,7 @@
 #include "../ECS/ECS.h"
 #include "../Components/RigidBodyComponent.h"
 #include "../Components/TransformComponent.h"
+#include "../Profiler/Profiler.h"
 
 
 class MovementSystem: public System
@@ -21,6 +22,8 @@ public:
 
 	void Update(double deltaTime)
 	{
+		PROFILE_SCOPE("MovementSystem::Update");
+
 		//TODO:
 		//update entitiy position based on velocity
 		// loop all entities that the system is interested in
@@ -31,7 +34,7 @@ public:
 		{
 			//update entity position based on velocity
 			auto& transform = entity.GetComponent<TransformComponent>();
-			const auto rigidBody = entity.GetComponent<RigidBodyComponent>();
+			const auto& rigidBody = entity.ReadComponent<RigidBodyComponent>();
 
 			transform.position.x += rigidBody.velocity.x * deltaTime;
 			transform.position.y += rigidBody.velocity.y * deltaTime;
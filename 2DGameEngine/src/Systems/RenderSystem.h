@@ -3,97 +3,313 @@
 #include "../ECS/ECS.h"
 #include "../Components/SpriteComponent.h"
 #include "../Components/TransformComponent.h"
+#include "../Components/RigidBodyComponent.h"
+#include "../Components/CameraComponent.h"
 #include <SDL.h>
 #include "../AssetStore/AssetStore.h"
+#include "../Logger/Logger.h"
+#include "../Render/RenderQueue.h"
+#include "../Spatial/SpatialGrid.h"
 #include <algorithm>
+#include <cmath>
+#include "../Profiler/Profiler.h"
 
+//SDL_RenderGeometry is only in SDL 2.0.18 and newer, older versions always draw one sprite at a time
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define RENDER_SYSTEM_HAS_GEOMETRY 1
+#else
+#define RENDER_SYSTEM_HAS_GEOMETRY 0
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// RenderSystem
+////////////////////////////////////////////////////////////////////////
+// Draws what the camera can see, in the order of the RenderQueue: by
+// zIndex, then lower on screen in front.
+// Every sprite is kept in a SpatialGrid through the system's entity
+// hooks, so finding the visible ones only looks at the grid cells under
+// the camera. Sprites with a rigid body can move, so they're put back in
+// the right cell at the start of every frame, the tiles are binned once
+// and cost nothing while they're off screen. Only the visible sprites
+// go to the queue, which keeps them sorted from one frame to the next.
+// Every run of sprites in a row that share a texture goes to SDL as one
+// batch of quads through SDL_RenderGeometry instead of one
+// SDL_RenderCopyEx each. Unrotated sprites (nearly all of them, tiles
+// never rotate) take a fast path that writes the four corners straight
+// from the destination rect.
+// SetBatching(false) goes back to one SDL_RenderCopyEx per sprite, which
+// is what the batched path gets measured against
+////////////////////////////////////////////////////////////////////////
 class RenderSystem: public System
 {
-public:
-	RenderSystem()
+private:
+	RenderQueue renderQueue;
+	SpatialGrid spatialGrid;
+	SpatialEntityList visibleEntities; //kept between frames so it doesn't get allocated again every frame
+	bool isBatchingEnabled = true;
+#if RENDER_SYSTEM_HAS_GEOMETRY
+	//kept between frames so they don't get allocated again every frame
+	std::vector<SDL_Vertex, TrackingAllocator<SDL_Vertex, MEMORY_TAG_RENDER>> vertices; //only ever grows, numBatchVertices of them are in use
+	int numBatchVertices = 0;
+	std::vector<int, TrackingAllocator<int, MEMORY_TAG_RENDER>> indices; //the same 6 indices per quad every frame, so only ever extended
+#endif
+	int numDrawCalls = 0;
+
+	//The area of the world the sprite covers, rotated sprites get a square big enough for any angle
+	static SDL_FRect GetWorldBounds(Entity entity)
 	{
-		RequireComponent<TransformComponent>();
-		RequireComponent<SpriteComponent>();
+		const auto& sprite = entity.ReadComponent<SpriteComponent>();
+		const auto& transform = entity.ReadComponent<TransformComponent>();
+		const float width = static_cast<float>(sprite.width * transform.scale.x);
+		const float height = static_cast<float>(sprite.height * transform.scale.y);
+		if (transform.rotation == 0.0)
+		{
+			return { transform.position.x, transform.position.y, width, height };
+		}
+		const float diagonal = std::sqrt(width * width + height * height);
+		return
+		{
+			transform.position.x + (width - diagonal) * 0.5f,
+			transform.position.y + (height - diagonal) * 0.5f,
+			diagonal,
+			diagonal
+		};
 	}
 
-	void Update(SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore)
+	//The original path, one call per sprite
+	void DrawSprite(SDL_Renderer* renderer, const RenderItem& sprite)
 	{
-		//Create vector with both sprite and transform component of all entities
-		struct RenderableEntity
-		{ //this groups the sprite and transform component together as we want to sort them together
-			TransformComponent transformComponent;
-			SpriteComponent spriteComponent;
-		};
-		std::vector<RenderableEntity> renderableEntities;
-		for (auto entity : GetSystemEntities())
+		SDL_RenderCopyEx
+		(
+			renderer,
+			sprite.texture,
+			&sprite.srcRect,
+			&sprite.dstRect,
+			sprite.rotation,
+			NULL, //centre of sprite
+			SDL_FLIP_NONE //whether to flip or not
+		);
+		numDrawCalls++;
+	}
+
+#if RENDER_SYSTEM_HAS_GEOMETRY
+	void AddQuad(const RenderItem& sprite, float inverseTextureWidth, float inverseTextureHeight)
+	{
+		//clamped like SDL_RenderCopyEx clips the source rect, the placeholder texture is smaller than most sprites
+		const float u0 = std::min(sprite.srcRect.x * inverseTextureWidth, 1.0f);
+		const float v0 = std::min(sprite.srcRect.y * inverseTextureHeight, 1.0f);
+		const float u1 = std::min((sprite.srcRect.x + sprite.srcRect.w) * inverseTextureWidth, 1.0f);
+		const float v1 = std::min((sprite.srcRect.y + sprite.srcRect.h) * inverseTextureHeight, 1.0f);
+		const SDL_Color white = { 255, 255, 255, 255 };
+
+		SDL_FPoint corners[4];
+		if (sprite.rotation == 0.0)
+		{
+			//fast path, the quad is just the destination rect
+			const float x0 = static_cast<float>(sprite.dstRect.x);
+			const float y0 = static_cast<float>(sprite.dstRect.y);
+			const float x1 = static_cast<float>(sprite.dstRect.x + sprite.dstRect.w);
+			const float y1 = static_cast<float>(sprite.dstRect.y + sprite.dstRect.h);
+			corners[0] = { x0, y0 };
+			corners[1] = { x1, y0 };
+			corners[2] = { x1, y1 };
+			corners[3] = { x0, y1 };
+		}
+		else
+		{
+			//rotated clockwise (in degrees) around the centre of the rect, like SDL_RenderCopyEx
+			const float radians = static_cast<float>(glm::radians(sprite.rotation));
+			const float cosine = std::cos(radians);
+			const float sine = std::sin(radians);
+			const float halfWidth = sprite.dstRect.w * 0.5f;
+			const float halfHeight = sprite.dstRect.h * 0.5f;
+			const float centreX = sprite.dstRect.x + halfWidth;
+			const float centreY = sprite.dstRect.y + halfHeight;
+			const float offsets[4][2] = { { -halfWidth, -halfHeight }, { halfWidth, -halfHeight }, { halfWidth, halfHeight }, { -halfWidth, halfHeight } };
+			for (int i = 0; i < 4; i++)
+			{
+				corners[i].x = centreX + offsets[i][0] * cosine - offsets[i][1] * sine;
+				corners[i].y = centreY + offsets[i][0] * sine + offsets[i][1] * cosine;
+			}
+		}
+
+		SDL_Vertex* vertex = &vertices[numBatchVertices];
+		vertex[0] = { corners[0], white, { u0, v0 } };
+		vertex[1] = { corners[1], white, { u1, v0 } };
+		vertex[2] = { corners[2], white, { u1, v1 } };
+		vertex[3] = { corners[3], white, { u0, v1 } };
+		numBatchVertices += 4;
+	}
+
+	//Makes sure there are indices for numQuads quads, two triangles each
+	void ReserveIndices(size_t numQuads)
+	{
+		for (size_t quad = indices.size() / 6; quad < numQuads; quad++)
 		{
-			RenderableEntity renderableEntity;
-			renderableEntity.spriteComponent = entity.GetComponent<SpriteComponent>();
-			renderableEntity.transformComponent = entity.GetComponent<TransformComponent>();
-			renderableEntities.emplace_back(renderableEntity);
+			const int first = static_cast<int>(quad * 4);
+			indices.insert(indices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
 		}
+	}
 
-		//Sort the vector by z-index
-		sort
-		(
-			renderableEntities.begin(), 
-			renderableEntities.end(), 
-			[](const RenderableEntity& a, const RenderableEntity& b)
+	//Returns false if the renderer can't draw geometry, nothing is drawn then
+	bool DrawBatch(SDL_Renderer* renderer, SDL_Texture* texture)
+	{
+		const int numQuads = numBatchVertices / 4;
+		if (numQuads == 0)
+		{
+			return true;
+		}
+		ReserveIndices(numQuads);
+		const int result = SDL_RenderGeometry(renderer, texture, vertices.data(), numBatchVertices, indices.data(), numQuads * 6);
+		numBatchVertices = 0;
+		numDrawCalls++;
+		return result == 0;
+	}
+
+	//Returns false if a batch couldn't be drawn
+	bool DrawBatched(SDL_Renderer* renderer)
+	{
+		//room for every sprite in one batch, so adding a quad never has to check
+		const size_t maxVertices = static_cast<size_t>(renderQueue.GetNumItems()) * 4;
+		if (vertices.size() < maxVertices)
+		{
+			vertices.resize(maxVertices);
+		}
+		numBatchVertices = 0;
+
+		SDL_Texture* batchTexture = nullptr;
+		float inverseTextureWidth = 1.0f;
+		float inverseTextureHeight = 1.0f;
+		for (const auto& layer : renderQueue.GetLayers())
+		{
+			for (const auto& item : layer.items)
 			{
-				return a.spriteComponent.zIndex < b.spriteComponent.zIndex;
+				if (!item.texture)
+				{
+					continue; //the texture was never loaded, there's nothing to draw
+				}
+				if (item.texture != batchTexture)
+				{
+					//everything up to the next texture change is one batch
+					if (!DrawBatch(renderer, batchTexture))
+					{
+						return false;
+					}
+					batchTexture = item.texture;
+					int textureWidth = 1;
+					int textureHeight = 1;
+					SDL_QueryTexture(batchTexture, NULL, NULL, &textureWidth, &textureHeight);
+					inverseTextureWidth = 1.0f / textureWidth;
+					inverseTextureHeight = 1.0f / textureHeight;
+				}
+				AddQuad(item, inverseTextureWidth, inverseTextureHeight);
 			}
-		);
+		}
+		return DrawBatch(renderer, batchTexture);
+	}
+#endif
 
+protected:
+	void OnEntityAdded(Entity entity) override
+	{
+		spatialGrid.Insert(entity, GetWorldBounds(entity), entity.HasComponent<RigidBodyComponent>());
+	}
+
+	void OnEntityRemoved(Entity entity) override
+	{
+		spatialGrid.Remove(entity);
+		renderQueue.Remove(entity);
+	}
+
+	void OnEntitiesCleared() override
+	{
+		spatialGrid.Clear();
+		renderQueue.Clear();
+	}
+
+public:
+	RenderSystem()
+	{
+		RequireComponent<TransformComponent>();
+		RequireComponent<SpriteComponent>();
+	}
+
+	void SetBatching(bool enabled)
+	{
+		isBatchingEnabled = enabled;
+	}
+
+	bool IsBatchingEnabled() const
+	{
+		return isBatchingEnabled && RENDER_SYSTEM_HAS_GEOMETRY;
+	}
 
+	//Draw calls made by the last Update()
+	int GetNumDrawCalls() const
+	{
+		return numDrawCalls;
+	}
 
+	//Sprites drawn by the last Update()
+	int GetNumVisibleSprites() const
+	{
+		return renderQueue.GetNumItems();
+	}
 
-		//loop all entities that the system is interested in
-		for (auto entity : renderableEntities)
+	//What the last Update() drew, for anything drawn over the sprites
+	const RenderQueue& GetRenderQueue() const
+	{
+		return renderQueue;
+	}
+
+	//Sizes the spatial grid to the level, call once the level is loaded
+	void SetWorldSize(float width, float height)
+	{
+		spatialGrid.SetWorldSize(width, height);
+	}
+
+	void Update(SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore, const CameraComponent& camera)
+	{
+		PROFILE_SCOPE("RenderSystem::Update");
+
+		//anything that moved last tick goes back to the cell it's in now
+		for (const auto& entity : spatialGrid.GetDynamicEntities())
 		{
-			const auto transform = entity.transformComponent;
-			const auto sprite = entity.spriteComponent;
+			spatialGrid.Move(entity, GetWorldBounds(entity));
+		}
+
+		visibleEntities.clear();
+		spatialGrid.Query(camera.GetWorldRect(), visibleEntities);
 
-			/*
-			* This was used for testing. We want to render textures now, not rectangles
-			* 
-			SDL_Rect objRect =
+		//picks up where the visible sprites are this frame and keeps the draw order sorted
+		renderQueue.Update(visibleEntities, camera, *assetStore);
+
+		numDrawCalls = 0;
+#if RENDER_SYSTEM_HAS_GEOMETRY
+		if (isBatchingEnabled)
+		{
+			if (DrawBatched(renderer))
 			{
-				static_cast<int>(transform.position.x),
-				static_cast<int>(transform.position.y),
-				sprite.width,
-				sprite.height
-			};
-			SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-			SDL_RenderFillRect(renderer, &objRect);
-			*/
-
-			//Set the source rectangle of our original sprite texture
-			SDL_Rect srcRect = sprite.srcRect;
-
-			//Set the destination rectangle with the x,y psition to be rendered
-			SDL_Rect dstRect =
+				return;
+			}
+			//the rest of this frame is lost, every frame after this is drawn one sprite at a time
+			LOG(ERROR, RENDER, "SDL_RenderGeometry failed, drawing sprites one at a time from now on: {}", SDL_GetError());
+			isBatchingEnabled = false;
+			return;
+		}
+#endif
+		//loop all entities that the system is interested in, in draw order
+		for (const auto& layer : renderQueue.GetLayers())
+		{
+			for (const auto& item : layer.items)
 			{
-				static_cast<int>(transform.position.x),
-				static_cast<int>(transform.position.y),
-				static_cast<int>(sprite.width * transform.scale.x),
-				static_cast<int>(sprite.height * transform.scale.y)
-			};
-
-			/* Draw the PNG texture */
-			SDL_RenderCopyEx
-			(
-				renderer,
-				assetStore->GetTexture(sprite.assetId),
-				&srcRect,
-				&dstRect,
-				transform.rotation,
-				NULL, //centre of sprite
-				SDL_FLIP_NONE //whether to flip or not
-			);
-			//in addition to the renderer, we need to pass the asset store to void Update()
-
+				if (item.texture)
+				{
+					DrawSprite(renderer, item);
+				}
+			}
 		}
 	}
 
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,288 @@
+#include "MapFile.h"
+#include "../Logger/Logger.h"
+#include "../Determinism/StateHasher.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+bool ImportTextMap(const std::string& filePath, int tilesetCols, int& numCols, int& numRows, std::vector<uint16_t>& tiles)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG(ERROR, ASSETS, "Could not open map {}", filePath);
+		return false;
+	}
+	const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	numCols = 0;
+	numRows = 0;
+	tiles.clear();
+	size_t position = 0;
+	int lineNumber = 0;
+	while (position < text.size())
+	{
+		size_t lineEnd = text.find('\n', position);
+		if (lineEnd == std::string::npos)
+		{
+			lineEnd = text.size();
+		}
+		size_t end = lineEnd;
+		if (end > position && text[end - 1] == '\r')
+		{
+			end--;
+		}
+		lineNumber++;
+
+		if (end > position)
+		{
+			int numLineTiles = 0;
+			size_t tileStart = position;
+			while (tileStart <= end)
+			{
+				size_t tileEnd = text.find(',', tileStart);
+				if (tileEnd == std::string::npos || tileEnd > end)
+				{
+					tileEnd = end;
+				}
+				const char* tile = text.data() + tileStart;
+				const int column = static_cast<int>(tileStart - position) + 1;
+				if (tileEnd - tileStart != 2 || tile[0] < '0' || tile[0] > '9' || tile[1] < '0' || tile[1] > '9')
+				{
+					LOG(ERROR, ASSETS, "{}:{}:{}: every tile should be two digits, the row and column in the tileset", filePath, lineNumber, column);
+					return false;
+				}
+				const int tilesetRow = tile[0] - '0';
+				const int tilesetCol = tile[1] - '0';
+				if (tilesetCol >= tilesetCols)
+				{
+					LOG(ERROR, ASSETS, "{}:{}:{}: the tileset only has {} columns", filePath, lineNumber, column, tilesetCols);
+					return false;
+				}
+				tiles.push_back(static_cast<uint16_t>(tilesetRow * tilesetCols + tilesetCol));
+				numLineTiles++;
+				tileStart = tileEnd + 1;
+			}
+
+			if (numRows == 0)
+			{
+				numCols = numLineTiles;
+			}
+			else if (numLineTiles != numCols)
+			{
+				LOG(ERROR, ASSETS, "{}:{}: row has {} tiles, the first row has {}", filePath, lineNumber, numLineTiles, numCols);
+				return false;
+			}
+			numRows++;
+		}
+		position = lineEnd + 1;
+	}
+
+	if (numRows == 0)
+	{
+		LOG(ERROR, ASSETS, "Map {} has no tiles", filePath);
+		return false;
+	}
+	return true;
+}
+
+uint64_t ComputeMapChecksum(const uint16_t* tiles, size_t numTiles)
+{
+	//Four independent lanes (the xxHash64 round), so the multiplies of one word don't wait on the last one.
+	//A single chain like StateHasher's runs at a quarter of the speed, which is most of the load time on big maps
+	const uint64_t prime1 = 0x9e3779b185ebca87ull;
+	const uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+	const auto round = [&](uint64_t lane, uint64_t word)
+	{
+		lane += word * prime2;
+		lane = (lane << 31) | (lane >> 33);
+		return lane * prime1;
+	};
+
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(tiles);
+	size_t size = numTiles * sizeof(uint16_t);
+	uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+	while (size >= 32)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes + i * 8, 8);
+			lanes[i] = round(lanes[i], word);
+		}
+		bytes += 32;
+		size -= 32;
+	}
+
+	//the lanes and whatever didn't fill a whole 32 bytes go through the StateHasher to mix them together
+	StateHasher hasher;
+	for (const uint64_t lane : lanes)
+	{
+		hasher.AddWord(lane);
+	}
+	hasher.AddBytes(bytes, size);
+	hasher.AddWord(numTiles);
+	return hasher.GetHash();
+}
+
+bool WriteBinaryMap(const std::string& filePath, const MapDescription& description, const std::vector<uint16_t>& tiles)
+{
+	const size_t numTiles = static_cast<size_t>(description.numCols) * description.numRows * description.numLayers;
+	if (tiles.size() != numTiles || numTiles == 0)
+	{
+		LOG(ERROR, ASSETS, "Map for {} should have {} tiles, it has {}", filePath, numTiles, tiles.size());
+		return false;
+	}
+	if (description.tilesetId.size() >= MAP_FILE_TILESET_ID_SIZE)
+	{
+		LOG(ERROR, ASSETS, "Tileset id {} is too long for a map file", description.tilesetId);
+		return false;
+	}
+
+	MapFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAP_FILE_MAGIC, sizeof(header.magic));
+	header.version = MAP_FILE_VERSION;
+	header.headerSize = sizeof(MapFileHeader);
+	header.numCols = static_cast<uint32_t>(description.numCols);
+	header.numRows = static_cast<uint32_t>(description.numRows);
+	header.numLayers = static_cast<uint32_t>(description.numLayers);
+	header.tileSize = static_cast<uint32_t>(description.tileSize);
+	header.tileScale = description.tileScale;
+	header.tilesetCols = static_cast<uint32_t>(description.tilesetCols);
+	header.checksum = ComputeMapChecksum(tiles.data(), tiles.size());
+	std::memcpy(header.tilesetId, description.tilesetId.data(), description.tilesetId.size());
+
+	//Written next to the map and renamed over it, so a game that has the old map mapped keeps its pages
+	//(truncating a mapped file under it crashes it) and a watcher sees one complete new file
+	const std::string tempFilePath = filePath + ".tmp";
+	{
+		std::ofstream file(tempFilePath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			LOG(ERROR, ASSETS, "Could not open {} for writing", tempFilePath);
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(tiles.data()), static_cast<std::streamsize>(tiles.size() * sizeof(uint16_t)));
+		file.close();
+		if (!file)
+		{
+			LOG(ERROR, ASSETS, "Failed writing map {}", tempFilePath);
+			std::error_code error;
+			std::filesystem::remove(tempFilePath, error);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempFilePath, filePath, error);
+	if (error)
+	{
+		LOG(ERROR, ASSETS, "Could not replace map {}: {}", filePath, error.message());
+		std::filesystem::remove(tempFilePath, error);
+		return false;
+	}
+	return true;
+}
+
+MapFile::MapFile(MapFile&& other) noexcept
+	: mappedFile(std::move(other.mappedFile)), data(std::exchange(other.data, nullptr)), header(std::exchange(other.header, nullptr))
+{
+}
+
+MapFile& MapFile::operator =(MapFile&& other) noexcept
+{
+	mappedFile = std::move(other.mappedFile);
+	data = std::exchange(other.data, nullptr);
+	header = std::exchange(other.header, nullptr);
+	return *this;
+}
+
+bool MapFile::Open(const std::string& filePath, bool verifyChecksum)
+{
+	Close();
+	if (!mappedFile.Open(filePath))
+	{
+		return false;
+	}
+	if (!Attach(mappedFile.GetData(), mappedFile.GetSize(), filePath, verifyChecksum))
+	{
+		mappedFile.Close();
+		return false;
+	}
+	return true;
+}
+
+bool MapFile::Open(const uint8_t* fileData, size_t fileSize, const std::string& filePath, bool verifyChecksum)
+{
+	Close();
+	return Attach(fileData, fileSize, filePath, verifyChecksum);
+}
+
+bool MapFile::Attach(const uint8_t* fileData, size_t fileSize, const std::string& filePath, bool verifyChecksum)
+{
+	const MapFileHeader* fileHeader = reinterpret_cast<const MapFileHeader*>(fileData);
+	if (fileSize < sizeof(MapFileHeader) || std::memcmp(fileHeader->magic, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC)) != 0)
+	{
+		LOG(ERROR, ASSETS, "{} isn't a map file", filePath);
+		return false;
+	}
+	if (fileHeader->version != MAP_FILE_VERSION || fileHeader->headerSize < sizeof(MapFileHeader) || fileHeader->headerSize % sizeof(uint16_t) != 0)
+	{
+		LOG(ERROR, ASSETS, "Map {} is version {}, we load version {}, cook it again", filePath, fileHeader->version, MAP_FILE_VERSION);
+		return false;
+	}
+
+	//done in 64 bits so a corrupt header can't overflow its way past the check
+	const uint64_t numTiles = static_cast<uint64_t>(fileHeader->numCols) * fileHeader->numRows * fileHeader->numLayers;
+	if (numTiles == 0 || fileHeader->tilesetCols == 0 || fileHeader->tileSize == 0 || fileHeader->headerSize + numTiles * sizeof(uint16_t) != fileSize)
+	{
+		LOG(ERROR, ASSETS, "Map {} is the wrong size for its header, it's probably truncated", filePath);
+		return false;
+	}
+
+	const uint16_t* tiles = reinterpret_cast<const uint16_t*>(fileData + fileHeader->headerSize);
+	if (verifyChecksum && ComputeMapChecksum(tiles, static_cast<size_t>(numTiles)) != fileHeader->checksum)
+	{
+		LOG(ERROR, ASSETS, "Map {} failed its checksum, it's corrupt", filePath);
+		return false;
+	}
+
+	data = fileData;
+	header = fileHeader;
+	return true;
+}
+
+void MapFile::Close()
+{
+	mappedFile.Close();
+	data = nullptr;
+	header = nullptr;
+}
+
+bool MapFile::IsOpen() const
+{
+	return header != nullptr;
+}
+
+MapDescription MapFile::GetDescription() const
+{
+	MapDescription description;
+	description.numCols = static_cast<int>(header->numCols);
+	description.numRows = static_cast<int>(header->numRows);
+	description.numLayers = static_cast<int>(header->numLayers);
+	description.tileSize = static_cast<int>(header->tileSize);
+	description.tileScale = header->tileScale;
+	description.tilesetCols = static_cast<int>(header->tilesetCols);
+	description.tilesetId.assign(header->tilesetId, strnlen(header->tilesetId, MAP_FILE_TILESET_ID_SIZE));
+	return description;
+}
+
+const uint16_t* MapFile::GetLayer(int layer) const
+{
+	const size_t layerSize = static_cast<size_t>(header->numCols) * header->numRows;
+	return reinterpret_cast<const uint16_t*>(data + header->headerSize) + layerSize * layer;
+}
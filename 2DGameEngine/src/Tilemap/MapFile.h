@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Platform/MappedFile.h"
+
+////////////////////////////////////////////////////////////////////////
+// Map files
+////////////////////////////////////////////////////////////////////////
+// Maps are written by hand as text (jungle.map): one line per row of
+// tiles, tiles separated by commas, and every tile two digits, the row
+// and then the column of the tile in the tileset ("21" is row 2, col 1).
+// The game loads a binary version cooked from the text by the
+// 2DGameEngineCooker tool:
+//
+//		MapFileHeader (80 bytes, little endian)
+//		numLayers arrays of numCols * numRows uint16_t tileset indices,
+//		row by row, layer 0 first
+//
+// The checksum in the header is ComputeMapChecksum() of the tile arrays,
+// a 4 lane hash built on the xxHash64 round.
+// A MapFile maps the file into memory (or uses it from a mapped asset
+// pack) and the tiles are used from there as they are, nothing is parsed
+// or copied
+////////////////////////////////////////////////////////////////////////
+const char MAP_FILE_MAGIC[4] = { 'T', 'M', 'A', 'P' };
+const uint32_t MAP_FILE_VERSION = 1;
+const size_t MAP_FILE_TILESET_ID_SIZE = 32;
+
+struct MapFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize; //the tiles start here, so later versions can add fields without breaking old loaders
+	uint32_t numCols;
+	uint32_t numRows;
+	uint32_t numLayers;
+	uint32_t tileSize; //in the tileset
+	float tileScale; //world pixels per tileset pixel
+	uint32_t tilesetCols;
+	uint32_t reserved;
+	uint64_t checksum;
+	char tilesetId[MAP_FILE_TILESET_ID_SIZE]; //asset id of the tileset, zero padded
+};
+
+static_assert(sizeof(MapFileHeader) == 80, "MapFileHeader is written to disk as it is, its size can't change");
+
+//Everything about a map except its tiles
+struct MapDescription
+{
+	int numCols = 0;
+	int numRows = 0;
+	int numLayers = 1;
+	int tileSize = 32;
+	float tileScale = 1.0f;
+	int tilesetCols = 1;
+	std::string tilesetId;
+};
+
+//Reads a text map into tiles (tileset row * tilesetCols + tileset col), the size comes from the file.
+//Returns false and logs the line and column of the first problem if the file isn't a valid map
+bool ImportTextMap(const std::string& filePath, int tilesetCols, int& numCols, int& numRows, std::vector<uint16_t>& tiles);
+
+uint64_t ComputeMapChecksum(const uint16_t* tiles, size_t numTiles);
+
+//tiles holds every layer one after the other, numCols * numRows * numLayers of them
+bool WriteBinaryMap(const std::string& filePath, const MapDescription& description, const std::vector<uint16_t>& tiles);
+
+class MapFile
+{
+private:
+	MappedFile mappedFile; //not open when the map is in memory someone else owns, like an asset pack
+	const uint8_t* data = nullptr;
+	const MapFileHeader* header = nullptr;
+
+	bool Attach(const uint8_t* fileData, size_t fileSize, const std::string& filePath, bool verifyChecksum);
+
+public:
+	MapFile() = default;
+	MapFile(MapFile&& other) noexcept;
+	MapFile& operator =(MapFile&& other) noexcept;
+
+	//Maps the file and checks the header and size. Checking the checksum reads every tile, which is
+	//most of the load time on big maps
+	bool Open(const std::string& filePath, bool verifyChecksum = true);
+	//The same for a map that's already in memory, an uncompressed asset pack entry. The memory has to stay there
+	//while the MapFile is open, the tiles are used from it
+	bool Open(const uint8_t* fileData, size_t fileSize, const std::string& filePath, bool verifyChecksum = true);
+	void Close();
+
+	bool IsOpen() const;
+	MapDescription GetDescription() const;
+	//Points into the mapped file, valid while the MapFile is open
+	const uint16_t* GetLayer(int layer) const;
+};
@@ -0,0 +1,427 @@
+#include "Tilemap.h"
+#include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+const size_t TILEMAP_MAX_FREE_TEXTURES = 16; //spare chunk textures kept for reuse, the rest are destroyed
+
+//Both edges are rounded on their own, so neighbouring chunks and tiles meet without gaps at any zoom
+static SDL_Rect WorldToScreen(const CameraComponent& camera, float left, float top, float right, float bottom)
+{
+	const int x0 = static_cast<int>(std::floor(camera.viewport.x + (left - camera.position.x) * camera.zoom));
+	const int y0 = static_cast<int>(std::floor(camera.viewport.y + (top - camera.position.y) * camera.zoom));
+	const int x1 = static_cast<int>(std::floor(camera.viewport.x + (right - camera.position.x) * camera.zoom));
+	const int y1 = static_cast<int>(std::floor(camera.viewport.y + (bottom - camera.position.y) * camera.zoom));
+	return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+void Tilemap::SetSize(int numCols, int numRows, int numLayers, int tileSize, float tileScale, AssetHandle tileset, int tilesetCols)
+{
+	DestroyTextures();
+
+	this->numCols = std::max(numCols, 0);
+	this->numRows = std::max(numRows, 0);
+	this->numLayers = std::max(numLayers, 0);
+	this->tileSize = std::max(tileSize, 1);
+	this->tileScale = tileScale;
+	this->tileset = tileset;
+	this->tilesetCols = std::max(tilesetCols, 1);
+
+	chunkNumTiles = std::max(1, static_cast<int>(TILEMAP_CHUNK_WORLD_SIZE / GetTileWorldSize()));
+	numChunkCols = (this->numCols + chunkNumTiles - 1) / chunkNumTiles;
+	numChunkRows = (this->numRows + chunkNumTiles - 1) / chunkNumTiles;
+	chunks.assign(static_cast<size_t>(numChunkCols) * numChunkRows, Chunk());
+}
+
+void Tilemap::Create(int numCols, int numRows, int tileSize, float tileScale, AssetHandle tileset, int tilesetCols, int numLayers)
+{
+	SetSize(numCols, numRows, numLayers, tileSize, tileScale, tileset, tilesetCols);
+	mapFile.Close();
+	tiles.assign(static_cast<size_t>(this->numCols) * this->numRows * this->numLayers, TILE_EMPTY);
+	tileData = tiles.data();
+}
+
+void Tilemap::Load(MapFile&& file)
+{
+	const MapDescription description = file.GetDescription();
+	SetSize
+	(
+		description.numCols, description.numRows, description.numLayers,
+		description.tileSize, description.tileScale, AssetIds::Intern(description.tilesetId), description.tilesetCols
+	);
+
+	//the layers are next to each other in the file, so all of them are used from the mapping as they are
+	mapFile = std::move(file);
+	tiles.clear();
+	tiles.shrink_to_fit();
+	tileData = mapFile.GetLayer(0);
+}
+
+void Tilemap::Reload(MapFile&& file)
+{
+	const MapDescription description = file.GetDescription();
+	if (description.numCols != numCols || description.numRows != numRows || description.numLayers != numLayers ||
+		description.tileSize != tileSize || description.tileScale != tileScale || description.tilesetCols != tilesetCols ||
+		AssetIds::Intern(description.tilesetId) != tileset || !tileData)
+	{
+		Load(std::move(file));
+		return;
+	}
+
+	//same shape, so every chunk that has a changed tile on any layer is marked, and the rest are left baked
+	const uint16_t* newTileData = file.GetLayer(0);
+	int numChangedChunks = 0;
+	for (int chunkIndex = 0; chunkIndex < static_cast<int>(chunks.size()); chunkIndex++)
+	{
+		const int firstCol = (chunkIndex % numChunkCols) * chunkNumTiles;
+		const int firstRow = (chunkIndex / numChunkCols) * chunkNumTiles;
+		const int chunkCols = std::min(firstCol + chunkNumTiles, numCols) - firstCol;
+		const int lastRow = std::min(firstRow + chunkNumTiles, numRows);
+		bool isChanged = false;
+		for (int layer = 0; layer < numLayers && !isChanged; layer++)
+		{
+			for (int row = firstRow; row < lastRow && !isChanged; row++)
+			{
+				const size_t index = GetTileIndex(firstCol, row, layer);
+				isChanged = !std::equal(tileData + index, tileData + index + chunkCols, newTileData + index);
+			}
+		}
+		if (isChanged)
+		{
+			chunks[chunkIndex].isDirty = true;
+			numChangedChunks++;
+		}
+	}
+	LOG(INFO, ASSETS, "Map reloaded, {} of {} chunks changed", numChangedChunks, chunks.size());
+
+	mapFile = std::move(file);
+	tiles.clear();
+	tiles.shrink_to_fit();
+	tileData = mapFile.GetLayer(0);
+}
+
+size_t Tilemap::GetTileIndex(int col, int row, int layer) const
+{
+	return (static_cast<size_t>(layer) * numRows + row) * numCols + col;
+}
+
+void Tilemap::SetTile(int col, int row, uint16_t tile, int layer)
+{
+	if (col < 0 || col >= numCols || row < 0 || row >= numRows || layer < 0 || layer >= numLayers)
+	{
+		return;
+	}
+	const size_t index = GetTileIndex(col, row, layer);
+	if (tileData[index] == tile)
+	{
+		return;
+	}
+	if (mapFile.IsOpen())
+	{
+		//the mapping is read only, the first change copies the tiles out of it
+		tiles.assign(tileData, tileData + static_cast<size_t>(numCols) * numRows * numLayers);
+		tileData = tiles.data();
+		mapFile.Close();
+	}
+	tiles[index] = tile;
+	chunks[(row / chunkNumTiles) * numChunkCols + col / chunkNumTiles].isDirty = true;
+}
+
+uint16_t Tilemap::GetTile(int col, int row, int layer) const
+{
+	if (col < 0 || col >= numCols || row < 0 || row >= numRows || layer < 0 || layer >= numLayers)
+	{
+		return TILE_EMPTY;
+	}
+	return tileData[GetTileIndex(col, row, layer)];
+}
+
+int Tilemap::GetNumCols() const
+{
+	return numCols;
+}
+
+int Tilemap::GetNumRows() const
+{
+	return numRows;
+}
+
+int Tilemap::GetNumLayers() const
+{
+	return numLayers;
+}
+
+float Tilemap::GetWidth() const
+{
+	return numCols * GetTileWorldSize();
+}
+
+float Tilemap::GetHeight() const
+{
+	return numRows * GetTileWorldSize();
+}
+
+float Tilemap::GetTileWorldSize() const
+{
+	return tileSize * tileScale;
+}
+
+float Tilemap::GetChunkWorldSize() const
+{
+	return chunkNumTiles * GetTileWorldSize();
+}
+
+bool Tilemap::PrepareChunk(SDL_Renderer* renderer, const TextureRegion& tilesetRegion, int chunkIndex)
+{
+	Chunk& chunk = chunks[chunkIndex];
+	if (!chunk.texture)
+	{
+		if (!freeTextures.empty())
+		{
+			chunk.texture = freeTextures.back();
+			freeTextures.pop_back();
+		}
+		else
+		{
+			//baked at the tileset's resolution and scaled up when it's copied, like the tiles themselves were
+			const int chunkTexels = chunkNumTiles * tileSize;
+			chunk.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, chunkTexels, chunkTexels);
+			if (!chunk.texture)
+			{
+				LOG(ERROR, RENDER, "Couldn't create a tilemap chunk texture, drawing tiles one by one from now on: {}", SDL_GetError());
+				isChunkCachingEnabled = false;
+				return false;
+			}
+			SDL_SetTextureBlendMode(chunk.texture, SDL_BLENDMODE_BLEND);
+		}
+		chunk.isDirty = true;
+		residentChunks.push_back(chunkIndex);
+	}
+
+	if (chunk.isDirty)
+	{
+		BakeChunk(renderer, tilesetRegion, chunkIndex);
+		chunk.isDirty = false;
+	}
+	return true;
+}
+
+void Tilemap::BakeChunk(SDL_Renderer* renderer, const TextureRegion& tilesetRegion, int chunkIndex)
+{
+	PROFILE_SCOPE("Tilemap::BakeChunk");
+
+	Uint8 red, green, blue, alpha;
+	SDL_GetRenderDrawColor(renderer, &red, &green, &blue, &alpha);
+	SDL_BlendMode tilesetBlendMode;
+	SDL_GetTextureBlendMode(tilesetRegion.texture, &tilesetBlendMode);
+	//the chunk holds the tileset's pixels, so it's blended the way they are (premultiplied when the asset store premultiplies).
+	//An opaque tileset still blends, so the empty tiles show through
+	const SDL_BlendMode blendMode = tilesetBlendMode == SDL_BLENDMODE_NONE ? SDL_BLENDMODE_BLEND : tilesetBlendMode;
+	SDL_SetTextureBlendMode(chunks[chunkIndex].texture, blendMode);
+
+	SDL_SetRenderTarget(renderer, chunks[chunkIndex].texture);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+	SDL_RenderClear(renderer);
+
+	const int firstCol = (chunkIndex % numChunkCols) * chunkNumTiles;
+	const int firstRow = (chunkIndex / numChunkCols) * chunkNumTiles;
+	const int lastCol = std::min(firstCol + chunkNumTiles, numCols);
+	const int lastRow = std::min(firstRow + chunkNumTiles, numRows);
+	for (int layer = 0; layer < numLayers; layer++)
+	{
+		//the bottom layer is copied straight in, blending it onto the empty texture and again when the chunk is drawn would darken soft edges
+		SDL_SetTextureBlendMode(tilesetRegion.texture, layer == 0 ? SDL_BLENDMODE_NONE : blendMode);
+		for (int row = firstRow; row < lastRow; row++)
+		{
+			const uint16_t* rowTiles = tileData + GetTileIndex(0, row, layer);
+			for (int col = firstCol; col < lastCol; col++)
+			{
+				const uint16_t tile = rowTiles[col];
+				if (tile == TILE_EMPTY)
+				{
+					continue;
+				}
+				const SDL_Rect srcRect = tilesetRegion.MapRect({ (tile % tilesetCols) * tileSize, (tile / tilesetCols) * tileSize, tileSize, tileSize });
+				const SDL_Rect dstRect = { (col - firstCol) * tileSize, (row - firstRow) * tileSize, tileSize, tileSize };
+				SDL_RenderCopy(renderer, tilesetRegion.texture, &srcRect, &dstRect);
+				numDrawCalls++;
+			}
+		}
+	}
+
+	SDL_SetTextureBlendMode(tilesetRegion.texture, tilesetBlendMode);
+	SDL_SetRenderTarget(renderer, nullptr);
+	SDL_SetRenderDrawColor(renderer, red, green, blue, alpha);
+}
+
+void Tilemap::DrawTiles(SDL_Renderer* renderer, const TextureRegion& tilesetRegion, const CameraComponent& camera, int firstCol, int firstRow, int lastCol, int lastRow)
+{
+	const float tileWorldSize = GetTileWorldSize();
+	for (int layer = 0; layer < numLayers; layer++)
+	{
+		for (int row = firstRow; row <= lastRow; row++)
+		{
+			const uint16_t* rowTiles = tileData + GetTileIndex(0, row, layer);
+			for (int col = firstCol; col <= lastCol; col++)
+			{
+				const uint16_t tile = rowTiles[col];
+				if (tile == TILE_EMPTY)
+				{
+					continue;
+				}
+				const SDL_Rect srcRect = tilesetRegion.MapRect({ (tile % tilesetCols) * tileSize, (tile / tilesetCols) * tileSize, tileSize, tileSize });
+				const SDL_Rect dstRect = WorldToScreen(camera, col * tileWorldSize, row * tileWorldSize, (col + 1) * tileWorldSize, (row + 1) * tileWorldSize);
+				SDL_RenderCopy(renderer, tilesetRegion.texture, &srcRect, &dstRect);
+				numDrawCalls++;
+			}
+		}
+	}
+}
+
+void Tilemap::ReleaseStaleChunks()
+{
+	size_t numKept = 0;
+	for (const int chunkIndex : residentChunks)
+	{
+		Chunk& chunk = chunks[chunkIndex];
+		if (frame - chunk.lastVisibleFrame <= TILEMAP_CHUNK_KEEP_FRAMES)
+		{
+			residentChunks[numKept++] = chunkIndex;
+			continue;
+		}
+		if (freeTextures.size() < TILEMAP_MAX_FREE_TEXTURES)
+		{
+			freeTextures.push_back(chunk.texture);
+		}
+		else
+		{
+			SDL_DestroyTexture(chunk.texture);
+		}
+		chunk.texture = nullptr;
+	}
+	residentChunks.resize(numKept);
+}
+
+void Tilemap::Render(SDL_Renderer* renderer, const AssetStore& assetStore, const CameraComponent& camera)
+{
+	PROFILE_SCOPE("Tilemap::Render");
+
+	frame++;
+	numDrawCalls = 0;
+	const TextureRegion& tilesetRegion = assetStore.GetTextureRegion(tileset);
+	if (!tilesetRegion.texture || !tileData)
+	{
+		return;
+	}
+	if (assetStore.GetTextureVersion(tileset) != tilesetVersion)
+	{
+		//the tileset's pixels were reloaded, every chunk baked from the old ones is stale
+		tilesetVersion = assetStore.GetTextureVersion(tileset);
+		InvalidateChunks();
+	}
+	if (isChunkCachingEnabled && !SDL_RenderTargetSupported(renderer))
+	{
+		LOG(ERROR, RENDER, "The renderer has no render targets, drawing tiles one by one");
+		isChunkCachingEnabled = false;
+	}
+
+	const SDL_FRect view = camera.GetWorldRect();
+	if (!isChunkCachingEnabled)
+	{
+		const float tileWorldSize = GetTileWorldSize();
+		DrawTiles
+		(
+			renderer, tilesetRegion, camera,
+			std::max(0, static_cast<int>(std::floor(view.x / tileWorldSize))),
+			std::max(0, static_cast<int>(std::floor(view.y / tileWorldSize))),
+			std::min(numCols - 1, static_cast<int>(std::floor((view.x + view.w) / tileWorldSize))),
+			std::min(numRows - 1, static_cast<int>(std::floor((view.y + view.h) / tileWorldSize)))
+		);
+		ReleaseStaleChunks(); //in case caching was turned off with chunks still cached
+		return;
+	}
+
+	const float chunkWorldSize = GetChunkWorldSize();
+	const int firstChunkCol = std::max(0, static_cast<int>(std::floor(view.x / chunkWorldSize)));
+	const int firstChunkRow = std::max(0, static_cast<int>(std::floor(view.y / chunkWorldSize)));
+	const int lastChunkCol = std::min(numChunkCols - 1, static_cast<int>(std::floor((view.x + view.w) / chunkWorldSize)));
+	const int lastChunkRow = std::min(numChunkRows - 1, static_cast<int>(std::floor((view.y + view.h) / chunkWorldSize)));
+	for (int chunkRow = firstChunkRow; chunkRow <= lastChunkRow; chunkRow++)
+	{
+		for (int chunkCol = firstChunkCol; chunkCol <= lastChunkCol; chunkCol++)
+		{
+			const int chunkIndex = chunkRow * numChunkCols + chunkCol;
+			chunks[chunkIndex].lastVisibleFrame = frame;
+			if (!PrepareChunk(renderer, tilesetRegion, chunkIndex))
+			{
+				//out of render targets, this chunk's tiles are drawn as they are
+				DrawTiles
+				(
+					renderer, tilesetRegion, camera,
+					chunkCol * chunkNumTiles,
+					chunkRow * chunkNumTiles,
+					std::min(numCols, (chunkCol + 1) * chunkNumTiles) - 1,
+					std::min(numRows, (chunkRow + 1) * chunkNumTiles) - 1
+				);
+				continue;
+			}
+			const SDL_Rect dstRect = WorldToScreen
+			(
+				camera,
+				chunkCol * chunkWorldSize,
+				chunkRow * chunkWorldSize,
+				(chunkCol + 1) * chunkWorldSize,
+				(chunkRow + 1) * chunkWorldSize
+			);
+			SDL_RenderCopy(renderer, chunks[chunkIndex].texture, NULL, &dstRect);
+			numDrawCalls++;
+		}
+	}
+	ReleaseStaleChunks();
+}
+
+void Tilemap::InvalidateChunks()
+{
+	for (const int chunkIndex : residentChunks)
+	{
+		chunks[chunkIndex].isDirty = true;
+	}
+}
+
+void Tilemap::DestroyTextures()
+{
+	for (const int chunkIndex : residentChunks)
+	{
+		SDL_DestroyTexture(chunks[chunkIndex].texture);
+		chunks[chunkIndex].texture = nullptr;
+		chunks[chunkIndex].isDirty = true;
+	}
+	residentChunks.clear();
+	for (SDL_Texture* texture : freeTextures)
+	{
+		SDL_DestroyTexture(texture);
+	}
+	freeTextures.clear();
+}
+
+void Tilemap::SetChunkCaching(bool enabled)
+{
+	isChunkCachingEnabled = enabled;
+}
+
+bool Tilemap::IsChunkCachingEnabled() const
+{
+	return isChunkCachingEnabled;
+}
+
+int Tilemap::GetNumDrawCalls() const
+{
+	return numDrawCalls;
+}
+
+int Tilemap::GetNumResidentChunks() const
+{
+	return static_cast<int>(residentChunks.size());
+}
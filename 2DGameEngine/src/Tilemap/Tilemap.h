@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <SDL.h>
+#include "../AssetStore/AssetStore.h"
+#include "../Components/CameraComponent.h"
+#include "../Memory/MemoryTracker.h"
+#include "MapFile.h"
+
+const uint16_t TILE_EMPTY = 0xFFFF; //nothing is drawn for this tile
+const float TILEMAP_CHUNK_WORLD_SIZE = 512.0f; //roughly how much of the world a chunk covers, in pixels
+const uint32_t TILEMAP_CHUNK_KEEP_FRAMES = 120; //a chunk's texture is kept this long after it was last on screen
+
+typedef std::vector<uint16_t, TrackingAllocator<uint16_t, MEMORY_TAG_TILEMAP>> TileList;
+
+////////////////////////////////////////////////////////////////////////
+// Tilemap
+////////////////////////////////////////////////////////////////////////
+// Static tile layers. Tiles aren't entities, each layer is one array of
+// tileset indices (row * tilesetCols + col), two bytes a tile. Layers
+// are drawn in order, layer 0 at the bottom.
+// A map loaded from a binary map file uses the tiles straight from the
+// mapped file. They're only copied into memory of our own the first
+// time SetTile() changes one.
+// The map is split into square chunks of about 512x512 world pixels.
+// The first time a chunk is on screen its tiles are drawn once into a
+// render target texture, and after that the chunk is a single copy per
+// frame. SetTile() only marks the chunk it's in as dirty, which is
+// re-baked the next time it's drawn.
+// Only chunks that were on screen recently have a texture. Ones that
+// have been off screen for a while hand theirs back to a small free
+// list, so a huge map never needs more textures than fit on screen.
+// Chunks are re-baked when the tileset is reloaded too, as the asset
+// store's version of it changes.
+// If the renderer can't make render targets (or caching is turned off)
+// the visible tiles are drawn one by one instead
+////////////////////////////////////////////////////////////////////////
+class Tilemap
+{
+private:
+	struct Chunk
+	{
+		SDL_Texture* texture = nullptr;
+		bool isDirty = true;
+		uint32_t lastVisibleFrame = 0;
+	};
+
+	int numCols = 0;
+	int numRows = 0;
+	int tileSize = 32; //in the tileset
+	float tileScale = 1.0f; //world pixels per tileset pixel
+	AssetHandle tileset = ASSET_HANDLE_PLACEHOLDER;
+	uint32_t tilesetVersion = 0; //the chunks were baked from this version of the tileset
+	int tilesetCols = 1;
+	int numLayers = 0;
+	const uint16_t* tileData = nullptr; //every layer one after the other, either tiles or the mapped file
+	TileList tiles;
+	MapFile mapFile; //open while tileData points into it
+
+	int chunkNumTiles = 1; //tiles along the side of a chunk
+	int numChunkCols = 0;
+	int numChunkRows = 0;
+	std::vector<Chunk, TrackingAllocator<Chunk, MEMORY_TAG_TILEMAP>> chunks;
+	std::vector<int, TrackingAllocator<int, MEMORY_TAG_TILEMAP>> residentChunks; //chunks that have a texture
+	std::vector<SDL_Texture*, TrackingAllocator<SDL_Texture*, MEMORY_TAG_TILEMAP>> freeTextures;
+	uint32_t frame = 0;
+	bool isChunkCachingEnabled = true;
+	int numDrawCalls = 0;
+
+	float GetTileWorldSize() const;
+	float GetChunkWorldSize() const;
+	//Gives the chunk a texture and bakes it if it's dirty. Returns false if there's no render target to draw into
+	bool PrepareChunk(SDL_Renderer* renderer, const TextureRegion& tilesetRegion, int chunkIndex);
+	void BakeChunk(SDL_Renderer* renderer, const TextureRegion& tilesetRegion, int chunkIndex);
+	void DrawTiles(SDL_Renderer* renderer, const TextureRegion& tilesetRegion, const CameraComponent& camera, int firstCol, int firstRow, int lastCol, int lastRow);
+	void ReleaseStaleChunks();
+	void SetSize(int numCols, int numRows, int numLayers, int tileSize, float tileScale, AssetHandle tileset, int tilesetCols);
+	size_t GetTileIndex(int col, int row, int layer) const;
+
+public:
+	//Every tile starts out empty. Drops any chunk textures the last map had
+	void Create(int numCols, int numRows, int tileSize, float tileScale, AssetHandle tileset, int tilesetCols, int numLayers = 1);
+	//Takes over an open map file and draws its tiles from it, the tileset is looked up by its asset id
+	void Load(MapFile&& file);
+	//Load() for a new version of the map that's already loaded. If only tiles changed, only the chunks they're in are
+	//re-baked and the rest keep their textures; a map with a different size or tileset is loaded from scratch
+	void Reload(MapFile&& file);
+	void SetTile(int col, int row, uint16_t tile, int layer = 0);
+	uint16_t GetTile(int col, int row, int layer = 0) const;
+
+	int GetNumCols() const;
+	int GetNumRows() const;
+	int GetNumLayers() const;
+	float GetWidth() const; //in world pixels
+	float GetHeight() const;
+
+	//Draws the part of the map the camera can see
+	void Render(SDL_Renderer* renderer, const AssetStore& assetStore, const CameraComponent& camera);
+	//Re-bakes every chunk the next time it's drawn, the contents of render targets are lost when the renderer resets them
+	void InvalidateChunks();
+	//Chunk textures have to go before the renderer does
+	void DestroyTextures();
+
+	void SetChunkCaching(bool enabled);
+	bool IsChunkCachingEnabled() const;
+	int GetNumDrawCalls() const; //made by the last Render()
+	int GetNumResidentChunks() const;
+};
@@ -0,0 +1,553 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "../AssetStore/AssetPack.h"
+#include "../AssetStore/CookedAssets.h"
+#include "../Determinism/StateHasher.h"
+#include "../Logger/Logger.h"
+#include "../Random/Random.h"
+#include "../Tilemap/MapFile.h"
+
+// 2DGameEngineCooker turns the assets we edit into the formats the game loads at runtime.
+//
+//  map <text map> [<text map>...] -o <file.bmap>
+//                    cooks text maps into a binary map, one layer per text map (all the same size, layer 0 first)
+//    --tileset <id>      asset id of the tileset the map is drawn with (default tilemap-image)
+//    --tileset-cols <n>  tiles across the tileset (default 10)
+//    --tile-size <px>    size of a tile in the tileset (default 32)
+//    --tile-scale <s>    world pixels per tileset pixel (default 2)
+//    --random <c>x<r>    fill a c x r map with random tiles instead of reading text maps, for load time tests
+//  verify <file.bmap> [<file.bmap>...]
+//                    checks binary maps and times how long they take to open
+//  pack <directory> [<directory>...] -o <file.pak>
+//                    packs every file under the directories into one asset pack, named by their paths as given
+//    --no-compress       store every file as it is
+//  verify-pack <file.pak>
+//                    lists a pack and checks every file in it against its content hash
+//  cook <directory> [<directory>...] -o <cooked directory>
+//                    cooks every image under the directories into pixels the game uploads as they are (.cimg) and
+//                    every text map into a binary map, and lists them in the cooked directory's manifest.txt.
+//                    Sources that haven't changed since the last cook are skipped (see CookedAssets.h)
+//    --no-compress       store the pixels as they are
+//    --force             cook everything again
+//    --tileset, --tileset-cols, --tile-size, --tile-scale    for the maps, as for map
+//
+// e.g. 2DGameEngineCooker map ./assets/tilemaps/jungle.map -o ./assets/tilemaps/jungle.bmap
+//      2DGameEngineCooker pack ./assets -o ./assets.pak
+//      2DGameEngineCooker cook ./assets -o ./cooked
+
+//The level's tileset, jungle.png
+static MapDescription GetDefaultMapDescription()
+{
+    MapDescription description;
+    description.tileSize = 32;
+    description.tileScale = 2.0f;
+    description.tilesetCols = 10;
+    description.tilesetId = "tilemap-image";
+    return description;
+}
+
+//Takes argv[i] (and its value) if it's one of the options that describe a map
+static bool ParseMapOption(int argc, char* argv[], int& i, MapDescription& description)
+{
+    if (std::strcmp(argv[i], "--tileset") == 0 && i + 1 < argc)
+    {
+        description.tilesetId = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--tileset-cols") == 0 && i + 1 < argc)
+    {
+        description.tilesetCols = std::atoi(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc)
+    {
+        description.tileSize = std::atoi(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--tile-scale") == 0 && i + 1 < argc)
+    {
+        description.tileScale = static_cast<float>(std::atof(argv[++i]));
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static int CookMap(int argc, char* argv[])
+{
+    std::vector<std::string> inputPaths;
+    std::string outputPath;
+    MapDescription description = GetDefaultMapDescription();
+    int randomCols = 0;
+    int randomRows = 0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (ParseMapOption(argc, argv, i, description))
+        {
+            continue;
+        }
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--random") == 0 && i + 1 < argc)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &randomCols, &randomRows) != 2 || randomCols <= 0 || randomRows <= 0)
+            {
+                std::cerr << "--random expects <cols>x<rows>, e.g. 4096x4096" << std::endl;
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-')
+        {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+        else
+        {
+            inputPaths.push_back(argv[i]);
+        }
+    }
+    if (outputPath.empty() || (inputPaths.empty() && randomCols == 0) || description.tilesetCols <= 0 || description.tileSize <= 0)
+    {
+        std::cerr << "Usage: map <text map> [<text map>...] -o <file.bmap> [--tileset <id>] [--tileset-cols <n>] [--tile-size <px>] [--tile-scale <s>] [--random <c>x<r>]" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint16_t> tiles;
+    if (randomCols > 0)
+    {
+        //same kind of map as the stress scenes, any tile from the first three rows of the tileset
+        Random random(1);
+        description.numCols = randomCols;
+        description.numRows = randomRows;
+        description.numLayers = 1;
+        tiles.resize(static_cast<size_t>(randomCols) * randomRows);
+        for (auto& tile : tiles)
+        {
+            tile = static_cast<uint16_t>(random.Range(0, description.tilesetCols * 3 - 1));
+        }
+    }
+    else
+    {
+        description.numLayers = static_cast<int>(inputPaths.size());
+        for (const auto& inputPath : inputPaths)
+        {
+            int numCols = 0;
+            int numRows = 0;
+            std::vector<uint16_t> layer;
+            if (!ImportTextMap(inputPath, description.tilesetCols, numCols, numRows, layer))
+            {
+                return 1;
+            }
+            if (tiles.empty())
+            {
+                description.numCols = numCols;
+                description.numRows = numRows;
+            }
+            else if (numCols != description.numCols || numRows != description.numRows)
+            {
+                std::cerr << inputPath << " is " << numCols << "x" << numRows << ", the first layer is " << description.numCols << "x" << description.numRows << std::endl;
+                return 1;
+            }
+            tiles.insert(tiles.end(), layer.begin(), layer.end());
+        }
+    }
+
+    if (!WriteBinaryMap(outputPath, description, tiles))
+    {
+        return 1;
+    }
+    std::cout << "Cooked " << outputPath << ": " << description.numCols << "x" << description.numRows << " tiles, "
+        << description.numLayers << " layer(s), " << (sizeof(MapFileHeader) + tiles.size() * sizeof(uint16_t)) << " bytes" << std::endl;
+    return 0;
+}
+
+static int VerifyMaps(int argc, char* argv[])
+{
+    if (argc == 0)
+    {
+        std::cerr << "Usage: verify <file.bmap> [<file.bmap>...]" << std::endl;
+        return 1;
+    }
+
+    int numFailed = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        MapFile mapFile;
+        const bool isOpen = mapFile.Open(argv[i]);
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!isOpen)
+        {
+            numFailed++;
+            continue;
+        }
+        const MapDescription description = mapFile.GetDescription();
+        std::printf
+        (
+            "%s: %dx%d tiles, %d layer(s), tileset %s (%d across, %dpx tiles at x%.2f), opened and checked in %.2f ms\n",
+            argv[i], description.numCols, description.numRows, description.numLayers, description.tilesetId.c_str(),
+            description.tilesetCols, description.tileSize, description.tileScale, milliseconds
+        );
+    }
+    return numFailed == 0 ? 0 : 1;
+}
+
+static int PackAssets(int argc, char* argv[])
+{
+    std::vector<std::string> directories;
+    std::string outputPath;
+    bool isCompressionEnabled = true;
+    for (int i = 0; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-compress") == 0)
+        {
+            isCompressionEnabled = false;
+        }
+        else if (argv[i][0] == '-')
+        {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+        else
+        {
+            directories.push_back(argv[i]);
+        }
+    }
+    if (outputPath.empty() || directories.empty())
+    {
+        std::cerr << "Usage: pack <directory> [<directory>...] -o <file.pak> [--no-compress]" << std::endl;
+        return 1;
+    }
+
+    std::vector<AssetPackSource> sources;
+    for (const auto& directory : directories)
+    {
+        std::error_code error;
+        for (auto entry = std::filesystem::recursive_directory_iterator(directory, error); !error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+        {
+            std::error_code entryError;
+            if (!entry->is_regular_file(entryError) || entry->path().extension() == ".tmp")
+            {
+                continue;
+            }
+            AssetPackSource source;
+            source.filePath = entry->path().string();
+            source.name = GetAssetPackName(source.filePath);
+            //binary maps are used in place from the pack's mapping, so they can't be compressed, and cooked images
+            //were already compressed by the cook if that was worth it
+            source.isCompressible = isCompressionEnabled && entry->path().extension() != ".bmap" && entry->path().extension() != COOKED_IMAGE_EXTENSION;
+            sources.push_back(source);
+        }
+        if (error)
+        {
+            std::cerr << "Could not read " << directory << ": " << error.message() << std::endl;
+            return 1;
+        }
+    }
+
+    AssetPackSummary summary;
+    if (!WriteAssetPack(outputPath, sources, summary))
+    {
+        return 1;
+    }
+    std::cout << "Packed " << outputPath << ": " << summary.numEntries << " files (" << summary.numCompressed << " compressed), "
+        << summary.totalSize << " bytes in " << summary.packSize << " bytes" << std::endl;
+    return 0;
+}
+
+static int VerifyPack(int argc, char* argv[])
+{
+    if (argc != 1)
+    {
+        std::cerr << "Usage: verify-pack <file.pak>" << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    AssetPack pack;
+    if (!pack.Open(argv[0]))
+    {
+        std::cerr << "Could not open " << argv[0] << std::endl;
+        return 1;
+    }
+    int numFailed = 0;
+    std::vector<uint8_t> buffer;
+    for (int i = 0; i < pack.GetNumEntries(); i++)
+    {
+        AssetPackFile file;
+        pack.GetFile(i, file);
+        StateHasher hasher;
+        const bool isRead = AssetPack::Read(file, buffer);
+        hasher.AddBytes(buffer.data(), buffer.size());
+        const bool isValid = isRead && hasher.GetHash() == file.contentHash;
+        if (!isValid)
+        {
+            numFailed++;
+        }
+        std::cout << pack.GetName(i) << ": " << file.size << " bytes";
+        if (file.IsCompressed())
+        {
+            std::cout << ", " << file.storedSize << " compressed";
+        }
+        std::cout << (isValid ? "" : ", CORRUPT") << std::endl;
+    }
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%d files, %d corrupt, opened and checked in %.2f ms\n", pack.GetNumEntries(), numFailed, milliseconds);
+    return numFailed == 0 ? 0 : 1;
+}
+
+static bool IsCookedImage(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().string();
+    for (char& c : extension)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp" || extension == ".tga";
+}
+
+//Decodes the image with SDL_image, like the game would, and writes its pixels premultiplied
+static bool CookImage(const std::vector<uint8_t>& data, const std::string& inputPath, const std::string& outputPath, bool isCompressible, uint64_t sourceHash)
+{
+    SDL_Surface* image = IMG_Load_RW(SDL_RWFromConstMem(data.data(), static_cast<int>(data.size())), 1);
+    SDL_Surface* surface = image ? SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0) : nullptr;
+    SDL_FreeSurface(image);
+    if (!surface)
+    {
+        std::cerr << "Could not decode " << inputPath << ": " << SDL_GetError() << std::endl;
+        return false;
+    }
+    std::vector<uint32_t> pixels(static_cast<size_t>(surface->w) * surface->h);
+    SDL_LockSurface(surface);
+    for (int row = 0; row < surface->h; row++)
+    {
+        std::memcpy(pixels.data() + static_cast<size_t>(row) * surface->w, static_cast<const uint8_t*>(surface->pixels) + row * surface->pitch, surface->w * sizeof(uint32_t));
+    }
+    SDL_UnlockSurface(surface);
+    const int width = surface->w;
+    const int height = surface->h;
+    SDL_FreeSurface(surface);
+
+    PremultiplyAlpha(pixels.data(), pixels.size());
+    return WriteCookedImage(outputPath, width, height, pixels.data(), isCompressible, sourceHash);
+}
+
+static int CookAssets(int argc, char* argv[])
+{
+    std::vector<std::string> directories;
+    std::string outputDirectory;
+    MapDescription description = GetDefaultMapDescription();
+    bool isCompressionEnabled = true;
+    bool isForced = false;
+    for (int i = 0; i < argc; i++)
+    {
+        if (ParseMapOption(argc, argv, i, description))
+        {
+            continue;
+        }
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-compress") == 0)
+        {
+            isCompressionEnabled = false;
+        }
+        else if (std::strcmp(argv[i], "--force") == 0)
+        {
+            isForced = true;
+        }
+        else if (argv[i][0] == '-')
+        {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+        else
+        {
+            directories.push_back(argv[i]);
+        }
+    }
+    if (outputDirectory.empty() || directories.empty() || description.tilesetCols <= 0 || description.tileSize <= 0)
+    {
+        std::cerr << "Usage: cook <directory> [<directory>...] -o <cooked directory> [--no-compress] [--force] [--tileset <id>] [--tileset-cols <n>] [--tile-size <px>] [--tile-scale <s>]" << std::endl;
+        return 1;
+    }
+
+    //what was cooked last time, by source name
+    const std::filesystem::path outputRoot(outputDirectory);
+    const std::string manifestPath = (outputRoot / COOKED_MANIFEST_FILE_NAME).string();
+    std::unordered_map<std::string, CookedManifestEntry> cookedBefore;
+    std::ifstream manifestFile(manifestPath, std::ios::binary);
+    if (manifestFile.is_open() && !isForced)
+    {
+        const std::string text((std::istreambuf_iterator<char>(manifestFile)), std::istreambuf_iterator<char>());
+        std::vector<CookedManifestEntry> entries;
+        std::string error;
+        if (!ParseCookedManifest(text, entries, error))
+        {
+            std::cerr << manifestPath << " is corrupt (" << error << "), cooking everything again" << std::endl;
+            entries.clear();
+        }
+        for (const auto& entry : entries)
+        {
+            cookedBefore[entry.sourceName] = entry;
+        }
+    }
+    manifestFile.close();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<CookedManifestEntry> entries;
+    int numCooked = 0;
+    int numUpToDate = 0;
+    int numFailed = 0;
+    for (const auto& directory : directories)
+    {
+        std::error_code error;
+        for (auto entry = std::filesystem::recursive_directory_iterator(directory, error); !error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+        {
+            std::error_code entryError;
+            const std::filesystem::path& path = entry->path();
+            const bool isImage = IsCookedImage(path);
+            if (!entry->is_regular_file(entryError) || (!isImage && path.extension() != ".map"))
+            {
+                continue; //everything else is loaded as it is
+            }
+
+            const std::string inputPath = path.string();
+            std::ifstream file(inputPath, std::ios::binary);
+            if (!file.is_open())
+            {
+                std::cerr << "Could not open " << inputPath << std::endl;
+                numFailed++;
+                continue;
+            }
+            const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            CookedManifestEntry cooked;
+            cooked.sourceName = GetAssetPackName(inputPath);
+            cooked.cookedName = isImage ? cooked.sourceName + COOKED_IMAGE_EXTENSION : std::filesystem::path(cooked.sourceName).replace_extension(COOKED_MAP_EXTENSION).generic_string();
+            //everything the cooked file depends on, so changing a format or an option cooks it again too
+            StateHasher hasher;
+            hasher.AddBytes(data.data(), data.size());
+            const uint64_t sourceHash = hasher.GetHash();
+            if (isImage)
+            {
+                hasher(COOKED_IMAGE_VERSION, isCompressionEnabled);
+            }
+            else
+            {
+                hasher(MAP_FILE_VERSION, description.tileSize, description.tileScale, description.tilesetCols, description.tilesetId);
+            }
+            cooked.inputHash = hasher.GetHash();
+
+            const std::filesystem::path outputPath = outputRoot / cooked.cookedName;
+            const auto before = cookedBefore.find(cooked.sourceName);
+            if (before != cookedBefore.end() && before->second.inputHash == cooked.inputHash && before->second.cookedName == cooked.cookedName && std::filesystem::is_regular_file(outputPath, entryError))
+            {
+                entries.push_back(cooked);
+                numUpToDate++;
+                continue;
+            }
+
+            std::filesystem::create_directories(outputPath.parent_path(), entryError);
+            bool isCooked = false;
+            if (isImage)
+            {
+                isCooked = CookImage(data, inputPath, outputPath.string(), isCompressionEnabled, sourceHash);
+            }
+            else
+            {
+                MapDescription mapDescription = description;
+                std::vector<uint16_t> tiles;
+                isCooked = ImportTextMap(inputPath, description.tilesetCols, mapDescription.numCols, mapDescription.numRows, tiles) &&
+                    WriteBinaryMap(outputPath.string(), mapDescription, tiles);
+            }
+            if (!isCooked)
+            {
+                numFailed++; //left out of the manifest, so the game loads the source
+                continue;
+            }
+            std::cout << "Cooked " << inputPath << " -> " << outputPath.generic_string() << std::endl;
+            entries.push_back(cooked);
+            numCooked++;
+        }
+        if (error)
+        {
+            std::cerr << "Could not read " << directory << ": " << error.message() << std::endl;
+            return 1;
+        }
+    }
+
+    //cooked files whose source is gone (or failed this time) would only be loaded by mistake
+    int numRemoved = 0;
+    for (const auto& before : cookedBefore)
+    {
+        const bool isKept = std::any_of(entries.begin(), entries.end(), [&before](const CookedManifestEntry& entry) { return entry.cookedName == before.second.cookedName; });
+        std::error_code error;
+        if (!isKept && std::filesystem::remove(outputRoot / before.second.cookedName, error))
+        {
+            numRemoved++;
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const CookedManifestEntry& a, const CookedManifestEntry& b) { return a.sourceName < b.sourceName; });
+    std::error_code error;
+    std::filesystem::create_directories(outputRoot, error);
+    if (!WriteCookedManifest(manifestPath, entries))
+    {
+        return 1;
+    }
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%s: %d cooked, %d up to date, %d removed, %d failed in %.2f ms\n", manifestPath.c_str(), numCooked, numUpToDate, numRemoved, numFailed, milliseconds);
+    return numFailed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2 && std::strcmp(argv[1], "map") == 0)
+    {
+        return CookMap(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "verify") == 0)
+    {
+        return VerifyMaps(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "pack") == 0)
+    {
+        return PackAssets(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "verify-pack") == 0)
+    {
+        return VerifyPack(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "cook") == 0)
+    {
+        return CookAssets(argc - 2, argv + 2);
+    }
+
+    std::cerr << "Usage: " << argv[0] << " map <text map> [<text map>...] -o <file.bmap> [options]" << std::endl;
+    std::cerr << "       " << argv[0] << " verify <file.bmap> [<file.bmap>...]" << std::endl;
+    std::cerr << "       " << argv[0] << " pack <directory> [<directory>...] -o <file.pak> [--no-compress]" << std::endl;
+    std::cerr << "       " << argv[0] << " verify-pack <file.pak>" << std::endl;
+    std::cerr << "       " << argv[0] << " cook <directory> [<directory>...] -o <cooked directory> [options]" << std::endl;
+    return 1;
+}